@@ -0,0 +1,72 @@
+#pragma once
+
+#include <juce_gui_basics/juce_gui_basics.h>
+
+#include "PluginProcessor.h"
+
+/**
+	CpuMeter
+	Small strip showing how much of the audio callback budget the two models use.
+	It polls the processor's InferenceProfiler from the message thread.
+*/
+class CpuMeter : public juce::Component, private juce::Timer
+{
+
+public:
+	CpuMeter(MagicKnobProcessor &proc) : audioProc(proc)
+	{
+		startTimerHz(10);
+	}
+
+	~CpuMeter() override
+	{
+		stopTimer();
+	}
+
+	void paint(juce::Graphics &g) override
+	{
+		auto bounds = getLocalBounds().toFloat();
+
+		g.setColour(juce::Colours::black.withAlpha(0.3f));
+		g.fillRoundedRectangle(bounds, 3.0f);
+
+		auto load = (float)juce::jlimit(0.0, 1.0, snapshot.loadMean);
+		auto peak = (float)juce::jlimit(0.0, 1.0, snapshot.loadPeak);
+
+		g.setColour(snapshot.deadlineMisses > 0 ? juce::Colours::indianred : juce::Colours::khaki);
+		g.fillRoundedRectangle(bounds.withWidth(bounds.getWidth() * load), 3.0f);
+
+		g.setColour(juce::Colours::whitesmoke);
+		g.drawVerticalLine((int)(bounds.getWidth() * peak), bounds.getY(), bounds.getBottom());
+
+		const auto &dist = snapshot.stages[InferenceProfiler::distStage];
+		const auto &lpf = snapshot.stages[InferenceProfiler::lpfStage];
+		const auto &resample = snapshot.stages[InferenceProfiler::resampleStage];
+
+		juce::String text;
+		text << "CPU " << juce::String(snapshot.loadMean * 100.0, 1) << "%"
+			 << "  dist " << juce::String(dist.meanUs, 1) << "/" << juce::String(dist.p99Us, 1) << " us"
+			 << "  lpf " << juce::String(lpf.meanUs, 1) << "/" << juce::String(lpf.p99Us, 1) << " us";
+
+		if (resample.maxUs > 0.0)
+			text << "  src " << juce::String(resample.meanUs, 1) << "/" << juce::String(resample.p99Us, 1) << " us";
+
+		text << "  misses " << juce::String((juce::int64)snapshot.deadlineMisses);
+
+		g.setColour(juce::Colours::white);
+		g.setFont(12.0f);
+		g.drawFittedText(text, getLocalBounds().reduced(4, 0), juce::Justification::centredLeft, 1);
+	}
+
+private:
+	void timerCallback() override
+	{
+		snapshot = audioProc.getInferenceProfiler().getSnapshot();
+		repaint();
+	}
+
+	MagicKnobProcessor &audioProc;
+	InferenceProfiler::Snapshot snapshot;
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(CpuMeter)
+};
@@ -0,0 +1,186 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+/**
+	InferenceProfiler
+	Per-instance timing of the neural network stages inside processBlock.
+	The audio thread writes the duration of every stage into fixed-size rings of atomics,
+	so recording never locks or allocates. Readers (the editor's CPU meter, test harnesses)
+	take a snapshot and compute min/mean/p99/max over the most recent blocks.
+*/
+class InferenceProfiler
+{
+public:
+	enum Stage
+	{
+		distStage = 0,
+		lpfStage,
+		resampleStage, // converting to and from the models' sample rate
+		totalStage,
+		numStages
+	};
+
+	static constexpr int historySize = 1024; // number of blocks kept for the rolling statistics
+
+	struct StageStats
+	{
+		double minUs = 0.0;
+		double meanUs = 0.0;
+		double p99Us = 0.0;
+		double maxUs = 0.0;
+	};
+
+	struct Snapshot
+	{
+		StageStats stages[numStages];
+		uint64_t numBlocks = 0;
+		uint64_t deadlineMisses = 0;
+		double budgetUs = 0.0; // time available for the last recorded block
+		double loadMean = 0.0; // mean total time relative to the block budget
+		double loadPeak = 0.0; // max total time relative to the block budget
+	};
+
+	InferenceProfiler()
+	{
+		reset();
+	}
+
+	/** Sets the sample rate used to compute the real-time deadline of every block. */
+	void prepare(double newSampleRate)
+	{
+		sampleRate.store(newSampleRate, std::memory_order_relaxed);
+		reset();
+	}
+
+	/** Clears all the recorded blocks and counters. */
+	void reset()
+	{
+		for (auto &ring : history)
+			for (auto &slot : ring)
+				slot.store(0, std::memory_order_relaxed);
+
+		for (auto &slot : budgetHistory)
+			slot.store(0, std::memory_order_relaxed);
+
+		writeIndex.store(0, std::memory_order_release);
+		deadlineMisses.store(0, std::memory_order_relaxed);
+	}
+
+	/** Returns the current value of the high resolution tick counter. */
+	static inline int64_t now() noexcept
+	{
+		return juce::Time::getHighResolutionTicks();
+	}
+
+	/**
+		Records the stage durations (in ticks) of a block of numSamples samples.
+		Called from the audio thread: wait-free, no allocation.
+	*/
+	void recordBlock(const int64_t (&stageTicks)[numStages], int numSamples) noexcept
+	{
+		const auto idx = writeIndex.load(std::memory_order_relaxed);
+		const auto slot = (size_t)(idx % historySize);
+
+		for (int s = 0; s < numStages; ++s)
+			history[s][slot].store(stageTicks[s], std::memory_order_relaxed);
+
+		const auto sr = sampleRate.load(std::memory_order_relaxed);
+		const auto budgetTicks = sr > 0.0 ? (int64_t)((double)numSamples / sr * (double)ticksPerSecond) : (int64_t)0;
+		budgetHistory[slot].store(budgetTicks, std::memory_order_relaxed);
+
+		if (budgetTicks > 0 && stageTicks[totalStage] > budgetTicks)
+			deadlineMisses.fetch_add(1, std::memory_order_relaxed);
+
+		writeIndex.store(idx + 1, std::memory_order_release);
+	}
+
+	/** Computes the rolling statistics over the most recent blocks (not real-time safe). */
+	Snapshot getSnapshot() const
+	{
+		Snapshot snap;
+		snap.numBlocks = writeIndex.load(std::memory_order_acquire);
+		snap.deadlineMisses = deadlineMisses.load(std::memory_order_relaxed);
+
+		const auto count = (size_t)std::min<uint64_t>(snap.numBlocks, (uint64_t)historySize);
+		if (count == 0)
+			return snap;
+
+		const auto toUs = 1.0e6 / (double)ticksPerSecond;
+		std::vector<int64_t> values(count);
+
+		for (int s = 0; s < numStages; ++s)
+		{
+			for (size_t i = 0; i < count; ++i)
+				values[i] = history[s][i].load(std::memory_order_relaxed);
+
+			std::sort(values.begin(), values.end());
+
+			double sum = 0.0;
+			for (auto v : values)
+				sum += (double)v;
+
+			const auto p99Idx = std::min(count - 1, (size_t)((double)count * 0.99));
+
+			auto &stats = snap.stages[s];
+			stats.minUs = (double)values.front() * toUs;
+			stats.maxUs = (double)values.back() * toUs;
+			stats.meanUs = sum / (double)count * toUs;
+			stats.p99Us = (double)values[p99Idx] * toUs;
+		}
+
+		const auto lastSlot = (size_t)((snap.numBlocks - 1) % historySize);
+		snap.budgetUs = (double)budgetHistory[lastSlot].load(std::memory_order_relaxed) * toUs;
+
+		if (snap.budgetUs > 0.0)
+		{
+			snap.loadMean = snap.stages[totalStage].meanUs / snap.budgetUs;
+			snap.loadPeak = snap.stages[totalStage].maxUs / snap.budgetUs;
+		}
+
+		return snap;
+	}
+
+	/** Writes a human-readable report of the current statistics, e.g. for a headless test harness. */
+	void dump(std::ostream &os) const
+	{
+		static const char *stageNames[numStages] = {"dist", "lpf", "resample", "total"};
+
+		const auto snap = getSnapshot();
+		os << "Inference profile over " << std::min<uint64_t>(snap.numBlocks, (uint64_t)historySize)
+		   << " of " << snap.numBlocks << " blocks (budget " << snap.budgetUs << " us/block)" << std::endl;
+
+		for (int s = 0; s < numStages; ++s)
+		{
+			const auto &stats = snap.stages[s];
+			os << "  " << stageNames[s]
+			   << ": min " << stats.minUs
+			   << " us, mean " << stats.meanUs
+			   << " us, p99 " << stats.p99Us
+			   << " us, max " << stats.maxUs << " us" << std::endl;
+		}
+
+		os << "  load: mean " << snap.loadMean * 100.0 << "%, peak " << snap.loadPeak * 100.0 << "%" << std::endl;
+		os << "  deadline misses: " << snap.deadlineMisses << std::endl;
+	}
+
+private:
+	const int64_t ticksPerSecond = juce::Time::getHighResolutionTicksPerSecond();
+
+	std::atomic<double> sampleRate{0.0};
+
+	std::array<std::array<std::atomic<int64_t>, historySize>, numStages> history;
+	std::array<std::atomic<int64_t>, historySize> budgetHistory;
+
+	std::atomic<uint64_t> writeIndex{0};
+	std::atomic<uint64_t> deadlineMisses{0};
+
+	JUCE_DECLARE_NON_COPYABLE(InferenceProfiler)
+};
@@ -9,12 +9,30 @@
 // #include <thread>
 
 MagicKnobEditor::MagicKnobEditor(MagicKnobProcessor &p)
-	: AudioProcessorEditor(&p), audioProcessor(p), tabs{p}
+	: AudioProcessorEditor(&p), audioProcessor(p), tabs{p}, cpuMeter{p}
 {
 	setOpaque(true);
 	addAndMakeVisible(tabs);
+	addAndMakeVisible(cpuMeter);
 
-	setSize(500, 500);
+	// the item ids follow the order of SampleRateMode, starting from 1
+	addAndMakeVisible(sampleRateModeBox);
+	sampleRateModeBox.addItem("Host rate", 1);
+	sampleRateModeBox.addItem("RNN correction", 2);
+	sampleRateModeBox.addItem("Resample", 3);
+	sampleRateModeBox.setSelectedId((int)audioProcessor.getSampleRateMode() + 1, juce::dontSendNotification);
+	sampleRateModeBox.onChange = [this]
+	{ audioProcessor.setSampleRateMode((SampleRateMode)(sampleRateModeBox.getSelectedId() - 1)); };
+
+	// the item ids are the oversampling factors
+	addAndMakeVisible(oversamplingBox);
+	for (int factor = 1; factor <= RTNeural::Oversampler<float>::max_factor; factor *= 2)
+		oversamplingBox.addItem("Dist " + juce::String(factor) + "x", factor);
+	oversamplingBox.setSelectedId(audioProcessor.getDistOversampling(), juce::dontSendNotification);
+	oversamplingBox.onChange = [this]
+	{ audioProcessor.setDistOversampling(oversamplingBox.getSelectedId()); };
+
+	setSize(500, 520);
 }
 
 MagicKnobEditor::~MagicKnobEditor()
@@ -34,7 +52,15 @@ void MagicKnobEditor::paint(juce::Graphics &g)
 
 void MagicKnobEditor::resized()
 {
-	int padding = 4;
+	int padding = 4, meterHeight = 16, modeBoxWidth = 120, oversamplingBoxWidth = 70;
 
-	tabs.setBounds(getLocalBounds().reduced(padding));
+	auto bounds = getLocalBounds().reduced(padding);
+	auto meterBounds = bounds.removeFromBottom(meterHeight);
+	sampleRateModeBox.setBounds(meterBounds.removeFromRight(modeBoxWidth));
+	meterBounds.removeFromRight(padding);
+	oversamplingBox.setBounds(meterBounds.removeFromRight(oversamplingBoxWidth));
+	meterBounds.removeFromRight(padding);
+	cpuMeter.setBounds(meterBounds);
+	bounds.removeFromBottom(padding);
+	tabs.setBounds(bounds);
 }
@@ -10,6 +10,7 @@
 
 #include "KnobPage.h"
 #include "RectPage.h"
+#include "CpuMeter.h"
 
 /**
     Custom TabComponent with KnobPage and RectPage.
@@ -89,6 +90,9 @@ private:
     MagicKnobProcessor &audioProcessor;
 
     OurTabbedComponent tabs;
+    CpuMeter cpuMeter;
+    juce::ComboBox sampleRateModeBox; // how the models handle the host sample rate
+    juce::ComboBox oversamplingBox;   // oversampling factor of the distortion models
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(MagicKnobEditor)
 };
\ No newline at end of file
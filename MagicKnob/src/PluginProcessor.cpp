@@ -5,6 +5,32 @@
 #include "PluginEditor.h"
 #include "juce_core/system/juce_PlatformDefs.h"
 
+namespace
+{
+	// runs `process(inputs, outputs, numSamples)` over the block, in chunks that fit in `modelInputs`.
+	// 2-input models take the knob value as the second input, 1-input models only take the audio
+	template <typename ProcessFn>
+	void processInChunks(std::vector<float> &modelInputs, int inSize, float *x, int numSamples, float knobValue, ProcessFn &&process)
+	{
+		const auto maxChunkSize = (int)modelInputs.size() / inSize;
+		if (maxChunkSize == 0)
+			return;
+
+		for (int start = 0; start < numSamples; start += maxChunkSize)
+		{
+			const auto chunkSize = std::min(maxChunkSize, numSamples - start);
+			for (int n = 0; n < chunkSize; ++n)
+			{
+				modelInputs[(size_t)(n * inSize)] = x[start + n];
+				for (int i = 1; i < inSize; ++i)
+					modelInputs[(size_t)(n * inSize + i)] = knobValue;
+			}
+
+			process(modelInputs.data(), x + start, chunkSize);
+		}
+	}
+}
+
 MagicKnobProcessor::MagicKnobProcessor()
 #ifndef JucePlugin_PreferredChannelConfigurations
 	: AudioProcessor(BusesProperties()
@@ -94,6 +120,23 @@ void MagicKnobProcessor::changeProgramName(int index, const juce::String &newNam
 
 void MagicKnobProcessor::prepareToPlay(double sampleRate, int samplesPerBlock)
 {
+	profiler.prepare(sampleRate);
+	hostSampleRate = sampleRate;
+
+	for (auto &resampler : resamplers)
+		resampler.prepare(sampleRate, modelSampleRate, samplesPerBlock);
+
+	// the models may run on more samples per block than the host, when the host rate is lower
+	maxBlockSize = std::max(samplesPerBlock, resamplers[0].getMaxModelBlockSize());
+	modelInputs.resize((size_t)(2 * maxBlockSize));
+
+	for (auto &oversampler : distOversamplers)
+		oversampler.prepare(oversampler.getFactor(), maxBlockSize);
+
+	numChannels = getTotalNumInputChannels();
+
+	updateLatency();
+
 	loadNextModel("dist");
 	loadNextModel("lpf");
 }
@@ -145,34 +188,80 @@ void MagicKnobProcessor::processBlock(juce::AudioBuffer<float> &buffer, juce::Mi
 		buffer.clear(i, 0, buffer.getNumSamples());
 
 	// use compile-time model
-	for (int ch = 0; ch < numInChannels; ++ch)
+	// each model runs over the whole block, so that every stage can be timed on its own
+	const auto numSamples = buffer.getNumSamples();
+	int64_t stageTicks[InferenceProfiler::numStages] = {};
+	const auto blockStart = InferenceProfiler::now();
+
+	const juce::SpinLock::ScopedLockType lock(modelLock);
+	if (powerState)
 	{
-		auto *x = buffer.getWritePointer(ch);
-		for (int n = 0; n < buffer.getNumSamples(); ++n)
+		for (int ch = 0; ch < numInChannels; ++ch)
 		{
-			if (powerState)
-			{
-				// std::cout << "DIST: " << distKnobValue << " LPF: " << lpfKnobValue << std::endl;
+			auto *x = buffer.getWritePointer(ch);
 
-				// NET A 2 INPUT
-				float tempDist[2] = {x[n], distKnobValue};
-				const float *inputArr = tempDist;
-				x[n] = modelsDist[ch].forward(inputArr);
+			if (sampleRateMode == SampleRateMode::resample)
+			{
+				// the conversion time is whatever the channel took, apart from the models
+				const auto channelStart = InferenceProfiler::now();
+				const auto modelTicks = stageTicks[InferenceProfiler::distStage] + stageTicks[InferenceProfiler::lpfStage];
 
-				float tempLpf[2] = {x[n], lpfKnobValue};
-				const float *inputArrLpf = tempLpf;
-				x[n] = modelsLPF[ch].forward(inputArrLpf);
+				resamplers[ch].process(x, numSamples, [&](float *y, int numModelSamples)
+									   { processModels(ch, y, numModelSamples, stageTicks); });
 
-				// NET A 1 INPUT
-				// float input[] = { x[n] };
-				// x[n] = modelsDist[ch].forward (input);
+				const auto channelModelTicks = stageTicks[InferenceProfiler::distStage] + stageTicks[InferenceProfiler::lpfStage] - modelTicks;
+				stageTicks[InferenceProfiler::resampleStage] += InferenceProfiler::now() - channelStart - channelModelTicks;
 			}
 			else
 			{
-				x[n] = x[n];
+				processModels(ch, x, numSamples, stageTicks);
 			}
 		}
 	}
+
+	stageTicks[InferenceProfiler::totalStage] = InferenceProfiler::now() - blockStart;
+	profiler.recordBlock(stageTicks, numSamples);
+}
+
+void MagicKnobProcessor::processModels(int channel, float *x, int numSamples, int64_t (&stageTicks)[InferenceProfiler::numStages])
+{
+	auto stageStart = InferenceProfiler::now();
+	if (sharedDist != nullptr)
+	{
+		// only shared without oversampling
+		processModel(*sharedDist, channel, x, numSamples, distKnobValue);
+	}
+	else if (modelsDist[channel] != nullptr)
+	{
+		auto &distModel = *modelsDist[channel];
+		distOversamplers[channel].process(x, numSamples, [&](float *y, int numOversampled)
+										  { processModel(distModel, y, numOversampled, distKnobValue); });
+	}
+
+	auto stageEnd = InferenceProfiler::now();
+	stageTicks[InferenceProfiler::distStage] += stageEnd - stageStart;
+
+	if (sharedLPF != nullptr)
+		processModel(*sharedLPF, channel, x, numSamples, lpfKnobValue);
+	else if (modelsLPF[channel] != nullptr)
+		processModel(*modelsLPF[channel], x, numSamples, lpfKnobValue);
+
+	stageTicks[InferenceProfiler::lpfStage] += InferenceProfiler::now() - stageEnd;
+}
+
+void MagicKnobProcessor::processModel(RTNeural::ModelHandle<float> &model, float *x, int numSamples, float knobValue)
+{
+	// one virtual call per chunk, the static models run their inlined per-sample code
+	processInChunks(modelInputs, model.getInSize(), x, numSamples, knobValue, [&](const float *in, float *out, int n)
+					{ model.process(in, out, n); });
+}
+
+void MagicKnobProcessor::processModel(SharedModel &model, int channel, float *x, int numSamples, float knobValue)
+{
+	// the workers run the block with the other instances, and the output is the one of an earlier block
+	const auto waitForOutput = isNonRealtime();
+	processInChunks(modelInputs, model.getInSize(), x, numSamples, knobValue, [&](const float *in, float *out, int n)
+					{ model.process(channel, in, out, n, waitForOutput); });
 }
 
 bool MagicKnobProcessor::hasEditor() const
@@ -243,26 +332,53 @@ void MagicKnobProcessor::searchJsonModelsInDir(std::string modelFolder)
 	std::cout << std::endl;
 }
 
-void MagicKnobProcessor::loadModel(std::ifstream &jsonStream, ModelType &model)
+ModelHandle MagicKnobProcessor::loadModel(std::ifstream &jsonStream, int oversamplingFactor)
 {
 	nlohmann::json modelJson;
 	jsonStream >> modelJson;
 
-	auto &lstm = model.get<0>();
 	// note that the "lstm." is a prefix used to find the
 	// lstm data in the json file so your python
 	// needs to name the lstm layer 'lstm' if you use lstm. as your prefix
-	std::string prefix = "lstm.";
-	// for LSTM layers, number of hidden  = number of params in a hidden weight set
-	// divided by 4
-	auto hidden_count = modelJson[prefix + "weight_ih_l0"].size() / 4;
-	// assert that the number of hidden units is the same as this count
-	// to ensure the json file we are importing matches the model we defined.
-	RTNeural::torch_helpers::loadLSTM<float>(modelJson, prefix, lstm);
-
-	auto &dense = model.get<1>();
+	const std::string prefix = "lstm.";
+	// for LSTM layers, number of hidden = number of params in a hidden weight set
+	// divided by 4, and each row of the input weights has one value per input
+	const auto hidden_count = (int)modelJson[prefix + "weight_ih_l0"].size() / 4;
+	const auto input_count = (int)modelJson[prefix + "weight_ih_l0"][0].size();
+
+	// build the topology from the json file, the registry then picks the matching static model
+	auto model = std::make_unique<RTNeural::Model<float>>(input_count);
+	auto lstm = std::make_unique<RTNeural::LSTMLayer<float>>(input_count, hidden_count);
+	auto dense = std::make_unique<RTNeural::Dense<float>>(hidden_count, 1);
+	RTNeural::torch_helpers::loadLSTM<float>(modelJson, prefix, *lstm);
 	// as per the lstm prefix, here the json needs a key prefixed with dense.
-	RTNeural::torch_helpers::loadDense<float>(modelJson, "dense.", dense);
+	RTNeural::torch_helpers::loadDense<float>(modelJson, "dense.", *dense);
+	model->addLayer(lstm.release());
+	model->addLayer(dense.release());
+
+	// with the sample rate correction, the LSTM state is delayed by the ratio between the host and training rates,
+	// which only works when the host runs at the training rate or faster.
+	// An oversampled model always needs the correction, to behave as it did at the rate it was trained at
+	const auto rateRatio = hostSampleRate / modelSampleRate;
+	const auto baseDelay = sampleRateMode == SampleRateMode::rnnCorrection ? (float)std::max(1.0, rateRatio) : 1.0f;
+	const auto lstmDelay = baseDelay * (float)oversamplingFactor;
+
+	auto handle = ModelRegistry::create(std::move(model), [&](auto &staticModel)
+										{
+		RTNeural::torch_helpers::loadLSTM<float>(modelJson, prefix, staticModel.template get<0>());
+		RTNeural::torch_helpers::loadDense<float>(modelJson, "dense.", staticModel.template get<1>());
+		staticModel.template get<0>().prepare(lstmDelay); });
+
+	std::cout << "Loaded LSTM model with " << input_count << " inputs and " << hidden_count << " hidden units ("
+			  << (handle->isStatic() ? "static" : "dynamic") << ")" << std::endl;
+
+	if (sampleRateMode == SampleRateMode::rnnCorrection && (!handle->isStatic() || rateRatio < 1.0))
+		std::cout << "The sample rate correction is not available for this model at " << hostSampleRate << " Hz" << std::endl;
+
+	if (oversamplingFactor > 1 && !handle->isStatic())
+		std::cout << "The sample rate correction is not available for this model, it will sound different when oversampled" << std::endl;
+
+	return handle;
 }
 
 void MagicKnobProcessor::setDistKnobValue(float val)
@@ -301,15 +417,52 @@ void MagicKnobProcessor::setCurrPowerState(bool newState)
 	powerState = newState;
 }
 
-void MagicKnobProcessor::loadModelFromJson(ModelType *models, std::string path)
+void MagicKnobProcessor::loadModelFromJson(ModelHandle *models, std::unique_ptr<SharedModel> &shared, std::string path, int oversamplingFactor)
 {
 	std::cout << "Loading model at path: " << path << std::endl;
 	std::ifstream jsonStream(path, std::ifstream::binary);
-	loadModel(jsonStream, models[0]);
+	ModelHandle newModels[2];
+	newModels[0] = loadModel(jsonStream, oversamplingFactor);
 
 	jsonStream.clear();
 	jsonStream.seekg(0, std::ios::beg);
-	loadModel(jsonStream, models[1]);
+	newModels[1] = loadModel(jsonStream, oversamplingFactor);
+
+	// the shared service runs the plain LSTM, so the instances that need
+	// the sample rate correction, the oversampling or the resampling keep their own models
+	const auto needsCorrection = sampleRateMode == SampleRateMode::rnnCorrection && hostSampleRate > modelSampleRate;
+	std::unique_ptr<SharedModel> newShared;
+	if (sharedInference && sampleRateMode != SampleRateMode::resample && !needsCorrection && oversamplingFactor == 1)
+	{
+		jsonStream.clear();
+		jsonStream.seekg(0, std::ios::beg);
+		nlohmann::json modelJson;
+		jsonStream >> modelJson;
+
+		newShared = std::make_unique<SharedModel>(sharedPool->getService(path, modelJson), numChannels, std::max(maxBlockSize, 1));
+		if (!newShared->isValid(numChannels))
+		{
+			std::cout << "The shared inference service is full, the model runs on its own" << std::endl;
+			newShared.reset();
+		}
+	}
+
+	// the old models are deleted here, after the lock is released
+	{
+		const juce::SpinLock::ScopedLockType lock(modelLock);
+		std::swap(models[0], newModels[0]);
+		std::swap(models[1], newModels[1]);
+		std::swap(shared, newShared);
+	}
+}
+
+void MagicKnobProcessor::reloadCurrentModels()
+{
+	if (currModelDist >= 0)
+		loadModelFromJson(modelsDist, sharedDist, modelFolder + distModelFiles[currModelDist % distModelFiles.size()], getDistOversampling());
+
+	if (currModelLPF >= 0)
+		loadModelFromJson(modelsLPF, sharedLPF, modelFolder + lpfModelFiles[currModelLPF % lpfModelFiles.size()]);
 }
 
 void MagicKnobProcessor::loadNextModel(std::string knobId)
@@ -317,22 +470,17 @@ void MagicKnobProcessor::loadNextModel(std::string knobId)
 	if (knobId == "dist")
 	{
 		++currModelDist;
-
-		modelsDist[0].reset();
-		modelsDist[1].reset();
-
-		loadModelFromJson(modelsDist, modelFolder + distModelFiles[currModelDist % distModelFiles.size()]);
+		loadModelFromJson(modelsDist, sharedDist, modelFolder + distModelFiles[currModelDist % distModelFiles.size()], getDistOversampling());
 	}
 
 	if (knobId == "lpf")
 	{
 		++currModelLPF;
-
-		modelsLPF[0].reset();
-		modelsLPF[1].reset();
-
-		loadModelFromJson(modelsLPF, modelFolder + lpfModelFiles[currModelLPF % lpfModelFiles.size()]);
+		loadModelFromJson(modelsLPF, sharedLPF, modelFolder + lpfModelFiles[currModelLPF % lpfModelFiles.size()]);
 	}
+
+	// the shared models add latency
+	updateLatency();
 }
 
 std::string MagicKnobProcessor::getCurrentModel(std::string knobId)
@@ -353,4 +501,93 @@ std::string MagicKnobProcessor::getCurrentModel(std::string knobId)
 	assert(splitted.size() == 5);
 
 	return splitted[4];
+}
+
+InferenceProfiler &MagicKnobProcessor::getInferenceProfiler()
+{
+	return profiler;
+}
+
+void MagicKnobProcessor::dumpInferenceProfile(std::ostream &os) const
+{
+	profiler.dump(os);
+}
+
+void MagicKnobProcessor::setSampleRateMode(SampleRateMode newMode)
+{
+	if (newMode == sampleRateMode)
+		return;
+
+	{
+		const juce::SpinLock::ScopedLockType lock(modelLock);
+		sampleRateMode = newMode;
+		for (auto &resampler : resamplers)
+			resampler.reset();
+	}
+
+	// the LSTM delay is set when the models are loaded
+	reloadCurrentModels();
+	updateLatency();
+}
+
+SampleRateMode MagicKnobProcessor::getSampleRateMode() const
+{
+	return sampleRateMode;
+}
+
+void MagicKnobProcessor::setDistOversampling(int factor)
+{
+	if (factor == getDistOversampling())
+		return;
+
+	// the filters are allocated here, and swapped in while the audio thread is locked out
+	RTNeural::Oversampler<float> newOversamplers[2];
+	for (auto &oversampler : newOversamplers)
+		oversampler.prepare(factor, std::max(maxBlockSize, 1));
+
+	{
+		const juce::SpinLock::ScopedLockType lock(modelLock);
+		std::swap(distOversamplers[0], newOversamplers[0]);
+		std::swap(distOversamplers[1], newOversamplers[1]);
+	}
+
+	// the LSTM delay is set when the models are loaded
+	reloadCurrentModels();
+	updateLatency();
+}
+
+int MagicKnobProcessor::getDistOversampling() const
+{
+	return distOversamplers[0].getFactor();
+}
+
+void MagicKnobProcessor::setSharedInference(bool shouldShare)
+{
+	if (shouldShare == sharedInference)
+		return;
+
+	sharedInference = shouldShare;
+	reloadCurrentModels();
+	updateLatency();
+}
+
+bool MagicKnobProcessor::getSharedInference() const
+{
+	return sharedInference;
+}
+
+void MagicKnobProcessor::updateLatency()
+{
+	// the oversampling runs at the model rate when resampling
+	auto latency = distOversamplers[0].getLatency();
+	if (sampleRateMode == SampleRateMode::resample)
+		latency = resamplers[0].getLatency() + latency * hostSampleRate / modelSampleRate;
+
+	// the shared models return the output of an earlier block
+	if (sharedDist != nullptr)
+		latency += sharedDist->getLatency();
+	if (sharedLPF != nullptr)
+		latency += sharedLPF->getLatency();
+
+	setLatencySamples((int)std::lround(latency));
 }
\ No newline at end of file
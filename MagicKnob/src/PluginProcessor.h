@@ -24,7 +24,32 @@
 #include <iostream>
 #include <RTNeural/RTNeural.h>
 
-using ModelType = RTNeural::ModelT<float, 2, 1, RTNeural::LSTMLayerT<float, 2, 16>, RTNeural::DenseT<float, 16, 1>>;
+#include "InferenceProfiler.h"
+#include "SharedInference.h"
+
+// the LSTMs use the interpolated sample rate correction, so that they can run at a multiple of the training rate
+template <int inSize, int hiddenSize>
+using LSTMModelType = RTNeural::ModelT<float, inSize, 1,
+									   RTNeural::LSTMLayerT<float, inSize, hiddenSize, RTNeural::SampleRateCorrectionMode::LinInterp>,
+									   RTNeural::DenseT<float, hiddenSize, 1>>;
+
+// the architectures that are compiled as static models, any other model runs on the dynamic RTNeural::Model
+using ModelRegistry = RTNeural::ModelRegistry<float,
+											  LSTMModelType<2, 16>,
+											  LSTMModelType<2, 32>,
+											  LSTMModelType<1, 16>,
+											  LSTMModelType<1, 32>>;
+using ModelHandle = std::unique_ptr<RTNeural::ModelHandle<float>>;
+
+/**
+	How the models handle a host sample rate that differs from the rate they were trained at
+*/
+enum class SampleRateMode
+{
+	hostRate,	   // run the models at the host rate, the tone shifts with the sample rate
+	rnnCorrection, // run at the host rate, with the LSTM state delayed by the rate ratio (RTNeural::SampleRateCorrectionMode)
+	resample	   // convert to the training rate, run the models, and convert back (adds latency)
+};
 
 /**
 	PluginProcessor
@@ -71,7 +96,7 @@ public:
 	void addMidi(juce::MidiMessage msg, int sampleOffset);
 
 	void searchJsonModelsInDir(std::string modelFolder);
-	void loadModel(std::ifstream &jsonStream, ModelType &model);
+	ModelHandle loadModel(std::ifstream &jsonStream, int oversamplingFactor = 1);
 
 	void setDistKnobValue(float val);
 	void setLPFKnobValue(float val);
@@ -85,6 +110,21 @@ public:
 	void loadNextModel(std::string knobId);
 	std::string getCurrentModel(std::string knobId);
 
+	InferenceProfiler &getInferenceProfiler();
+	void dumpInferenceProfile(std::ostream &os) const;
+
+	void setSampleRateMode(SampleRateMode newMode);
+	SampleRateMode getSampleRateMode() const;
+
+	void setDistOversampling(int factor);
+	int getDistOversampling() const;
+
+	// run the models together with the other instances that use them (adds one block of latency)
+	void setSharedInference(bool shouldShare);
+	bool getSharedInference() const;
+
+	static constexpr double modelSampleRate = 44100.0; // the rate used by myk_data.py for the training data
+
 private:
 	bool powerState;
 
@@ -97,9 +137,31 @@ private:
 	std::string lpfModelJson, lpfRandomModelJson;															 // lpf models
 	std::vector<std::string> distModelFiles, lpfModelFiles;
 
-	ModelType modelsDist[2], modelsLPF[2];
+	ModelHandle modelsDist[2], modelsLPF[2];
+	std::unique_ptr<SharedModel> sharedDist, sharedLPF; // used instead of the models above when set
+	juce::SpinLock modelLock; // held by the audio thread while processing, and while swapping in new models
+
+	std::vector<float> modelInputs; // interleaved input frames for one block of samples
+
+	double hostSampleRate = modelSampleRate;
+	SampleRateMode sampleRateMode = SampleRateMode::hostRate; // changed under the model lock
+	RTNeural::ModelResampler<float> resamplers[2];			  // one per channel, prepared for the host rate in prepareToPlay
+
+	int maxBlockSize = 0;
+	RTNeural::Oversampler<float> distOversamplers[2]; // the distortion models generate harmonics that would alias
+
+	InferenceProfiler profiler;
+
+	bool sharedInference = false;
+	int numChannels = 2;
+	juce::SharedResourcePointer<SharedInferencePool> sharedPool;
 
-	void loadModelFromJson(ModelType *models, std::string path);
+	void loadModelFromJson(ModelHandle *models, std::unique_ptr<SharedModel> &shared, std::string path, int oversamplingFactor = 1);
+	void reloadCurrentModels();
+	void updateLatency();
+	void processModels(int channel, float *x, int numSamples, int64_t (&stageTicks)[InferenceProfiler::numStages]);
+	void processModel(RTNeural::ModelHandle<float> &model, float *x, int numSamples, float knobValue);
+	void processModel(SharedModel &model, int channel, float *x, int numSamples, float knobValue);
 
 	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(MagicKnobProcessor)
 };
\ No newline at end of file
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <juce_core/juce_core.h>
+#include <RTNeural/RTNeural.h>
+
+using SharedInferenceService = RTNeural::SharedInferenceService<float>;
+
+/**
+	SharedInferencePool
+	The shared inference services of every plugin instance in the process, one per model file.
+	Each instance holds the pool through a juce::SharedResourcePointer, so that the instances
+	that load the same model run it as one batch. A service is created by the first instance
+	that loads its model, and deleted when the last instance stops using it.
+*/
+class SharedInferencePool
+{
+public:
+	std::shared_ptr<SharedInferenceService> getService(const std::string &path, const nlohmann::json &modelJson)
+	{
+		const std::lock_guard<std::mutex> lock(mutex);
+		auto service = services[path].lock();
+		if (service != nullptr)
+			return service;
+
+		// the same layers as MagicKnobProcessor::loadModel()
+		const auto hiddenCount = (int)modelJson.at("lstm.weight_ih_l0").size() / 4;
+		const auto inputCount = (int)modelJson.at("lstm.weight_ih_l0").at(0).size();
+		RTNeural::BatchedLSTMDense<float> model(inputCount, hiddenCount);
+		RTNeural::torch_helpers::loadLSTM<float>(modelJson, "lstm.", model.lstm);
+		RTNeural::torch_helpers::loadDense<float>(modelJson, "dense.", model.dense);
+
+		RTNeural::SharedInferenceSettings settings;
+		settings.num_workers = juce::jlimit(1, 4, (int)std::thread::hardware_concurrency() / 4);
+		service = std::make_shared<SharedInferenceService>(std::move(model), settings);
+		services[path] = service;
+		return service;
+	}
+
+private:
+	std::mutex mutex;
+	std::map<std::string, std::weak_ptr<SharedInferenceService>> services;
+};
+
+/**
+	SharedModel
+	The streams of one plugin instance on a shared inference service, one per channel.
+	The streams are registered when the model is created, and unregistered when it is deleted.
+*/
+class SharedModel
+{
+public:
+	SharedModel(std::shared_ptr<SharedInferenceService> sharedService, int numChannels, int maxBlockSize)
+		: service(std::move(sharedService))
+	{
+		for (int ch = 0; ch < std::min(numChannels, 2); ++ch)
+			streams[ch] = service->registerStream(maxBlockSize);
+	}
+
+	~SharedModel()
+	{
+		for (auto stream : streams)
+			if (stream >= 0)
+				service->unregisterStream(stream);
+	}
+
+	// false if the service had no room for the streams, the instance then runs its own models
+	bool isValid(int numChannels) const
+	{
+		for (int ch = 0; ch < std::min(numChannels, 2); ++ch)
+			if (streams[ch] < 0)
+				return false;
+		return true;
+	}
+
+	int getInSize() const { return service->getModel().getInSize(); }
+	int getLatency() const { return service->getLatency(streams[0]); }
+
+	void process(int channel, const float *input, float *output, int numSamples, bool waitForOutput)
+	{
+		// when rendering offline, the host does not wait for the workers, so the instance does
+		while (waitForOutput && service->getNumOutputFrames(streams[channel]) < numSamples)
+			if (service->processPending() == 0)
+				std::this_thread::yield();
+
+		service->process(streams[channel], input, output, numSamples);
+	}
+
+private:
+	std::shared_ptr<SharedInferenceService> service;
+	int streams[2] = {-1, -1};
+
+	JUCE_DECLARE_NON_COPYABLE(SharedModel)
+};
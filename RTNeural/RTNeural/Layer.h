@@ -1,6 +1,7 @@
 #ifndef LAYER_H_INCLUDED
 #define LAYER_H_INCLUDED
 
+#include "arena.h"
 #include <cstddef>
 #include <string>
 
@@ -39,6 +40,24 @@ public:
     /** Implements the forward propagation step for this layer. */
     virtual void forward(const T* input, T* out) noexcept = 0;
 
+    /** Returns the number of values in a snapshot of this layer's state (0 for stateless layers). */
+    virtual int getStateSize() const noexcept { return 0; }
+
+    /** Copies the state of this layer into a buffer of getStateSize() values. */
+    virtual void getState(T* /*state*/) const noexcept { }
+
+    /** Restores the state of this layer from a buffer written by getState(). */
+    virtual void setState(const T* /*state*/) noexcept { }
+
+    /**
+     * Returns the number of values that this layer needs from an arena
+     * for its weights and state, or 0 if the layer does not use arenas.
+     */
+    virtual size_t getArenaSize() const noexcept { return 0; }
+
+    /** Moves the weights and state of this layer into memory allocated from the arena. */
+    virtual void moveToArena(Arena<T>&) { }
+
     const int in_size;
     const int out_size;
 };
@@ -1,6 +1,8 @@
 #ifndef MODEL_H_INCLUDED
 #define MODEL_H_INCLUDED
 
+#include <algorithm>
+#include <typeinfo>
 #include <vector>
 
 #include "Layer.h"
@@ -11,13 +13,18 @@
 #include "batchnorm/batchnorm2d.tpp"
 #include "conv1d/conv1d.h"
 #include "conv1d/conv1d.tpp"
+#include "conv1d_fft/conv1d_fft.h"
+#include "conv1d_fft/conv1d_fft.tpp"
 #include "conv2d/conv2d.h"
 #include "conv2d/conv2d.tpp"
 #include "dense/dense.h"
+#include "dilated_conv_stack/dilated_conv_stack.h"
+#include "dilated_conv_stack/dilated_conv_stack.tpp"
 #include "gru/gru.h"
 #include "gru/gru.tpp"
 #include "lstm/lstm.h"
 #include "lstm/lstm.tpp"
+#include "profiling.h"
 
 namespace RTNeural
 {
@@ -27,6 +34,19 @@ namespace RTNeural
  *
  *  Instances of this class should typically be created
  *  `json_parser::parseJson`.
+ *
+ *  Whenever a layer is added, the model rebuilds a flat "execution plan":
+ *  every step calls a layer's forward() through a function pointer that
+ *  was resolved from the layer's concrete type (so the calls are not
+ *  virtual for RTNeural's own layers), and a Dense, Conv1D, Conv2D or
+ *  batch-norm layer followed by an activation is run as a single step,
+ *  with the activation applied in place. The layer outputs are stored in
+ *  a single aligned buffer.
+ *
+ *  The weights and state of the layers that support it are also moved
+ *  into a single arena owned by the model, so the whole network is laid
+ *  out contiguously in memory. Layers that are added to a model must
+ *  not outlive it.
  */
 template <typename T>
 class Model
@@ -67,9 +87,51 @@ public:
     void addLayer(Layer<T>* layer)
     {
         layers.push_back(layer);
-        outs.push_back(vec_type(layer->out_size, (T)0));
+#if RTNEURAL_ENABLE_LAYER_TIMING
+        layer_timings.push_back({});
+#endif
+        buildPlan();
+    }
+
+    /**
+     * Simplifies the network for inference, once all of the layers have been added.
+     *
+     * Batch-norm layers that directly follow a Dense or Conv1D layer are folded
+     * into that layer's weights and biases, and layers that would pass their
+     * input through unchanged (batch-norm layers with a unity scale and zero
+     * shift, or a ReLU following another ReLU) are removed. The outputs of the
+     * optimized model only differ from the original by floating-point rounding.
+     *
+     * Returns the number of layers that were removed.
+     */
+    int optimize()
+    {
+        const auto num_layers = layers.size();
+        for(size_t i = 0; i < layers.size();)
+        {
+            auto* batch_norm = dynamic_cast<BatchNorm1DLayer<T>*>(layers[i]);
+            const bool folded = batch_norm != nullptr && i > 0 && foldBatchNorm(layers[i - 1], *batch_norm);
+            if(folded || isIdentity(layers[i], i > 0 ? layers[i - 1] : nullptr))
+            {
+                delete layers[i];
+                layers.erase(layers.begin() + (std::ptrdiff_t)i);
+                continue;
+            }
+
+            ++i;
+        }
+
+#if RTNEURAL_ENABLE_LAYER_TIMING
+        layer_timings.assign(layers.size(), {});
+#endif
+        buildPlan();
+
+        return (int)(num_layers - layers.size());
     }
 
+    /** Returns the number of steps in the execution plan, after fusing layers. */
+    int getNumPlanSteps() const noexcept { return (int)plan.size(); }
+
     /** Resets the state of the network layers. */
     void reset()
     {
@@ -77,25 +139,90 @@ public:
             l->reset();
     }
 
+    /** Returns the number of values in a snapshot of the state of the network layers. */
+    int getStateSize() const noexcept
+    {
+        int size = 0;
+        for(auto* l : layers)
+            size += l->getStateSize();
+        return size;
+    }
+
+    /**
+     * Copies the state of the network layers into a buffer of getStateSize() values.
+     *
+     * Snapshots are only valid for a model with the same layers, built with the same backend.
+     */
+    void getState(T* state) const noexcept
+    {
+        for(auto* l : layers)
+        {
+            l->getState(state);
+            state += l->getStateSize();
+        }
+    }
+
+    /** Restores the state of the network layers from a buffer written by getState(). */
+    void setState(const T* state) noexcept
+    {
+        for(auto* l : layers)
+        {
+            l->setState(state);
+            state += l->getStateSize();
+        }
+    }
+
     /** Performs forward propagation for this model. */
     inline T forward(const T* input)
     {
-        layers[0]->forward(input, outs[0].data());
-
-        for(int i = 1; i < (int)layers.size(); ++i)
+        // the plan alternates between two output buffers
+        const T* x = input;
+        T* out = outs.data();
+        for(int i = 0; i < (int)plan.size(); ++i)
         {
-            layers[i]->forward(outs[i - 1].data(), outs[i].data());
+#if RTNEURAL_ENABLE_LAYER_TIMING
+            const auto start = profiling::readTicks();
+            plan[i].forward(plan[i].layers, x, out);
+            layer_timings[i].record(start);
+#else
+            plan[i].forward(plan[i].layers, x, out);
+#endif
+            x = out;
+            out = (out == outs.data() ? outs.data() + buffer_size : outs.data());
         }
 
-        return outs.back()[0];
+        return x[0];
     }
 
     /** Returns a pointer to the output of the final layer in the network. */
     inline const T* getOutputs() const noexcept
     {
-        return outs.back().data();
+        return outs.data() + (plan.size() % 2 == 0 ? buffer_size : 0);
+    }
+
+#if RTNEURAL_ENABLE_LAYER_TIMING
+    /** Returns the accumulated timing of each layer, in sequential order. */
+    const std::vector<profiling::LayerTiming>& getLayerTimings() const noexcept
+    {
+        return layer_timings;
     }
 
+    /** Clears the accumulated layer timings. */
+    void resetLayerTimings() noexcept
+    {
+        for(auto& t : layer_timings)
+            t.reset();
+    }
+
+    /** Prints a per-layer breakdown of the accumulated timings. */
+    void printLayerTimings(std::ostream& os) const
+    {
+        profiling::printLayerTimings(os, layer_timings.data(), layer_timings.size(),
+            [this](size_t i)
+            { return layers[i]->getName(); });
+    }
+#endif
+
     /** A vector storing the network layers in sequential order. */
     std::vector<Layer<T>*> layers;
 
@@ -108,8 +235,242 @@ private:
     using vec_type = std::vector<T>;
 #endif
 
+    using ForwardFn = void (*)(Layer<T>* const*, const T*, T*);
+
+    /** One step of the execution plan: a layer, optionally fused with the following activation. */
+    struct PlanStep
+    {
+        ForwardFn forward;
+        Layer<T>* layers[2];
+    };
+
+    template <typename LayerType>
+    static void forwardLayer(Layer<T>* const* ls, const T* input, T* out) noexcept
+    {
+        static_cast<LayerType*>(ls[0])->LayerType::forward(input, out);
+    }
+
+    template <typename LayerType, typename ActivationType>
+    static void forwardFused(Layer<T>* const* ls, const T* input, T* out) noexcept
+    {
+        static_cast<LayerType*>(ls[0])->LayerType::forward(input, out);
+        static_cast<ActivationType*>(ls[1])->ActivationType::forward(out, out);
+    }
+
+    static void forwardVirtual(Layer<T>* const* ls, const T* input, T* out) noexcept
+    {
+        ls[0]->forward(input, out);
+    }
+
+    template <typename LayerType>
+    static bool isType(const Layer<T>* layer) noexcept
+    {
+        return typeid(*layer) == typeid(LayerType);
+    }
+
+    /** Returns a non-virtual forward function for the layer's concrete type, if it is a known layer. */
+    static ForwardFn findForward(const Layer<T>* layer) noexcept
+    {
+        if(isType<Dense<T>>(layer))
+            return &forwardLayer<Dense<T>>;
+        if(isType<Conv1D<T>>(layer))
+            return &forwardLayer<Conv1D<T>>;
+        if(isType<FFTConv1D<T>>(layer))
+            return &forwardLayer<FFTConv1D<T>>;
+        if(isType<GRULayer<T>>(layer))
+            return &forwardLayer<GRULayer<T>>;
+        if(isType<LSTMLayer<T>>(layer))
+            return &forwardLayer<LSTMLayer<T>>;
+        if(isType<TanhActivation<T>>(layer))
+            return &forwardLayer<TanhActivation<T>>;
+        if(isType<ReLuActivation<T>>(layer))
+            return &forwardLayer<ReLuActivation<T>>;
+        if(isType<SigmoidActivation<T>>(layer))
+            return &forwardLayer<SigmoidActivation<T>>;
+        if(isType<SoftmaxActivation<T>>(layer))
+            return &forwardLayer<SoftmaxActivation<T>>;
+#if !RTNEURAL_USE_ACCELERATE
+        if(isType<FastTanh<T>>(layer))
+            return &forwardLayer<FastTanh<T>>;
+        if(isType<ELuActivation<T>>(layer))
+            return &forwardLayer<ELuActivation<T>>;
+        if(isType<PReLUActivation<T>>(layer))
+            return &forwardLayer<PReLUActivation<T>>;
+        if(isType<BatchNorm1DLayer<T>>(layer))
+            return &forwardLayer<BatchNorm1DLayer<T>>;
+        if(isType<BatchNorm2DLayer<T>>(layer))
+            return &forwardLayer<BatchNorm2DLayer<T>>;
+        if(isType<Conv2D<T>>(layer))
+            return &forwardLayer<Conv2D<T>>;
+#endif
+
+        return &forwardVirtual;
+    }
+
+    /** Returns a fused forward function for a layer of the given type followed by an activation, or nullptr. */
+    template <typename LayerType>
+    static ForwardFn findFusedActivation(const Layer<T>* activation) noexcept
+    {
+        if(isType<TanhActivation<T>>(activation))
+            return &forwardFused<LayerType, TanhActivation<T>>;
+        if(isType<ReLuActivation<T>>(activation))
+            return &forwardFused<LayerType, ReLuActivation<T>>;
+        if(isType<SigmoidActivation<T>>(activation))
+            return &forwardFused<LayerType, SigmoidActivation<T>>;
+        if(isType<SoftmaxActivation<T>>(activation))
+            return &forwardFused<LayerType, SoftmaxActivation<T>>;
+#if !RTNEURAL_USE_ACCELERATE
+        if(isType<FastTanh<T>>(activation))
+            return &forwardFused<LayerType, FastTanh<T>>;
+        if(isType<ELuActivation<T>>(activation))
+            return &forwardFused<LayerType, ELuActivation<T>>;
+        if(isType<PReLUActivation<T>>(activation))
+            return &forwardFused<LayerType, PReLUActivation<T>>;
+#endif
+
+        return nullptr;
+    }
+
+    /** Returns a fused forward function for a layer followed by an activation, or nullptr. */
+    static ForwardFn findFusedForward(const Layer<T>* layer, const Layer<T>* activation) noexcept
+    {
+        if(isType<Dense<T>>(layer))
+            return findFusedActivation<Dense<T>>(activation);
+        if(isType<Conv1D<T>>(layer))
+            return findFusedActivation<Conv1D<T>>(activation);
+#if !RTNEURAL_USE_ACCELERATE
+        if(isType<BatchNorm1DLayer<T>>(layer))
+            return findFusedActivation<BatchNorm1DLayer<T>>(activation);
+        if(isType<BatchNorm2DLayer<T>>(layer))
+            return findFusedActivation<BatchNorm2DLayer<T>>(activation);
+        if(isType<Conv2D<T>>(layer))
+            return findFusedActivation<Conv2D<T>>(activation);
+#endif
+
+        return nullptr;
+    }
+
+    /**
+     * Folds a batch-norm layer into the Dense or Conv1D layer before it, so that
+     * the layer's outputs are scaled and shifted by its weights and biases.
+     * Returns false if the previous layer can't absorb the batch-norm.
+     */
+    static bool foldBatchNorm(Layer<T>* layer, const BatchNorm1DLayer<T>& batch_norm)
+    {
+        if(layer->out_size != batch_norm.in_size)
+            return false;
+
+        if(auto* dense = dynamic_cast<Dense<T>*>(layer))
+        {
+            std::vector<std::vector<T>> weights((size_t)dense->out_size, std::vector<T>((size_t)dense->in_size));
+            std::vector<T> bias((size_t)dense->out_size);
+            for(int i = 0; i < dense->out_size; ++i)
+            {
+                for(int k = 0; k < dense->in_size; ++k)
+                    weights[(size_t)i][(size_t)k] = batch_norm.getScale(i) * dense->getWeight(i, k);
+                bias[(size_t)i] = batch_norm.getScale(i) * dense->getBias(i) + batch_norm.getShift(i);
+            }
+
+            dense->setWeights(weights);
+            dense->setBias(bias.data());
+            return true;
+        }
+
+        if(auto* conv = dynamic_cast<Conv1D<T>*>(layer))
+        {
+            const auto kernel_size = conv->getKernelSize();
+            std::vector<std::vector<std::vector<T>>> weights((size_t)conv->out_size,
+                std::vector<std::vector<T>>((size_t)conv->in_size, std::vector<T>((size_t)kernel_size)));
+            std::vector<T> bias((size_t)conv->out_size);
+            for(int i = 0; i < conv->out_size; ++i)
+            {
+                for(int k = 0; k < conv->in_size; ++k)
+                    for(int j = 0; j < kernel_size; ++j)
+                        weights[(size_t)i][(size_t)k][(size_t)j] = batch_norm.getScale(i) * conv->getWeight(i, k, j);
+                bias[(size_t)i] = batch_norm.getScale(i) * conv->getBias(i) + batch_norm.getShift(i);
+            }
+
+            conv->setWeights(weights);
+            conv->setBias(bias);
+            return true;
+        }
+
+        return false;
+    }
+
+    /** Returns true if a layer passes its input through unchanged, when it follows the previous layer. */
+    static bool isIdentity(const Layer<T>* layer, const Layer<T>* previous) noexcept
+    {
+        if(auto* batch_norm = dynamic_cast<const BatchNorm1DLayer<T>*>(layer))
+        {
+            for(int i = 0; i < batch_norm->out_size; ++i)
+            {
+                if(batch_norm->getScale(i) != (T)1 || batch_norm->getShift(i) != (T)0)
+                    return false;
+            }
+            return true;
+        }
+
+        return previous != nullptr && isType<ReLuActivation<T>>(layer) && isType<ReLuActivation<T>>(previous);
+    }
+
+    /** Rebuilds the execution plan and the output buffers for the current layers. */
+    void buildPlan()
+    {
+        plan.clear();
+        for(size_t i = 0; i < layers.size(); ++i)
+        {
+#if !RTNEURAL_ENABLE_LAYER_TIMING // keep one step per layer, so every layer is timed separately
+            if(i + 1 < layers.size())
+            {
+                if(auto fused = findFusedForward(layers[i], layers[i + 1]))
+                {
+                    plan.push_back({ fused, { layers[i], layers[i + 1] } });
+                    ++i;
+                    continue;
+                }
+            }
+#endif
+            plan.push_back({ findForward(layers[i]), { layers[i], nullptr } });
+        }
+
+        // two output buffers, each starting on an aligned boundary
+        constexpr int alignment = std::max((int)(RTNEURAL_DEFAULT_ALIGNMENT / sizeof(T)), 1);
+        int max_size = 0;
+        for(auto* l : layers)
+            max_size = std::max(max_size, l->out_size);
+        buffer_size = ((max_size + alignment - 1) / alignment) * alignment;
+        outs.assign((size_t)(2 * buffer_size), (T)0);
+
+        gatherLayerMemory();
+    }
+
+    /** Moves the weights and state of all layers into a single arena. */
+    void gatherLayerMemory()
+    {
+        size_t arena_size = 0;
+        for(auto* l : layers)
+            arena_size += l->getArenaSize();
+
+        Arena<T> new_arena(arena_size);
+        for(auto* l : layers)
+        {
+            if(l->getArenaSize() > 0)
+                l->moveToArena(new_arena);
+        }
+
+        arena = std::move(new_arena);
+    }
+
     const int in_size;
-    std::vector<vec_type> outs;
+    std::vector<PlanStep> plan;
+    int buffer_size = 0;
+    vec_type outs;
+    Arena<T> arena;
+
+#if RTNEURAL_ENABLE_LAYER_TIMING
+    std::vector<profiling::LayerTiming> layer_timings;
+#endif
 };
 
 } // namespace RTNeural
@@ -66,6 +66,17 @@ namespace modelt_detail
             std::get<idx>(t).forward(std::get<idx - 1>(t).outs);
             forward_unroll<idx + 1, Niter - 1>::call(t);
         }
+
+#if RTNEURAL_ENABLE_LAYER_TIMING
+        template <typename T, typename Timings>
+        static void call(T& t, Timings& timings)
+        {
+            const auto start = profiling::readTicks();
+            std::get<idx>(t).forward(std::get<idx - 1>(t).outs);
+            timings[idx].record(start);
+            forward_unroll<idx + 1, Niter - 1>::call(t, timings);
+        }
+#endif
     };
 
     template <size_t idx>
@@ -73,6 +84,91 @@ namespace modelt_detail
     {
         template <typename T>
         static void call(T&) { }
+
+#if RTNEURAL_ENABLE_LAYER_TIMING
+        template <typename T, typename Timings>
+        static void call(T&, Timings&) { }
+#endif
+    };
+
+    /** Number of values in a snapshot of a layer's state (0 for layers without a getStateSize() method). */
+    template <typename LayerType, typename = void>
+    struct layer_state_size : std::integral_constant<int, 0>
+    {
+    };
+
+    template <typename LayerType>
+    struct layer_state_size<LayerType, decltype((void)LayerType::getStateSize())>
+        : std::integral_constant<int, LayerType::getStateSize()>
+    {
+    };
+
+    /** Total number of values in a snapshot of the state of a set of layers. */
+    template <typename... Layers>
+    struct model_state_size;
+
+    template <>
+    struct model_state_size<> : std::integral_constant<int, 0>
+    {
+    };
+
+    template <typename First, typename... Rest>
+    struct model_state_size<First, Rest...>
+        : std::integral_constant<int, layer_state_size<First>::value + model_state_size<Rest...>::value>
+    {
+    };
+
+    /** Copies/restores the state of a single layer (no-ops for stateless layers). */
+    template <typename T, typename LayerType>
+    std::enable_if_t<(layer_state_size<LayerType>::value > 0), void>
+    getLayerState(const LayerType& layer, T* state) noexcept
+    {
+        layer.getState(state);
+    }
+
+    template <typename T, typename LayerType>
+    std::enable_if_t<(layer_state_size<LayerType>::value == 0), void>
+    getLayerState(const LayerType&, T*) noexcept
+    {
+    }
+
+    template <typename T, typename LayerType>
+    std::enable_if_t<(layer_state_size<LayerType>::value > 0), void>
+    setLayerState(LayerType& layer, const T* state) noexcept
+    {
+        layer.setState(state);
+    }
+
+    template <typename T, typename LayerType>
+    std::enable_if_t<(layer_state_size<LayerType>::value == 0), void>
+    setLayerState(LayerType&, const T*) noexcept
+    {
+    }
+
+    /** True for the static layers that a following batch-norm can be folded into. */
+    template <typename LayerType>
+    struct can_fold_batchnorm : std::false_type
+    {
+    };
+
+    template <typename T, int in_size, int out_size>
+    struct can_fold_batchnorm<DenseT<T, in_size, out_size>> : std::true_type
+    {
+    };
+
+    template <typename T, int in_size, int out_size, int kernel_size, int dilation_rate, bool dynamic_state>
+    struct can_fold_batchnorm<Conv1DT<T, in_size, out_size, kernel_size, dilation_rate, dynamic_state>> : std::true_type
+    {
+    };
+
+    template <typename LayerType>
+    struct is_batchnorm : std::false_type
+    {
+    };
+
+    template <typename T, int size, bool affine>
+    struct is_batchnorm<BatchNorm1DT<T, size, affine>> : std::true_type
+    {
     };
 
     template <typename T, typename LayerType>
@@ -166,8 +262,8 @@ namespace modelt_detail
         }
     }
 
-    template <typename T, int in_size, int out_size, SampleRateCorrectionMode mode>
-    void loadLayer(GRULayerT<T, in_size, out_size, mode>& gru, int& json_stream_idx, const nlohmann::json& l,
+    template <typename T, int in_size, int out_size, SampleRateCorrectionMode mode, int rank>
+    void loadLayer(GRULayerT<T, in_size, out_size, mode, rank>& gru, int& json_stream_idx, const nlohmann::json& l,
         const std::string& type, int layerDims, bool debug)
     {
         using namespace json_parser;
@@ -182,8 +278,8 @@ namespace modelt_detail
         json_stream_idx++;
     }
 
-    template <typename T, int in_size, int out_size, SampleRateCorrectionMode mode>
-    void loadLayer(LSTMLayerT<T, in_size, out_size, mode>& lstm, int& json_stream_idx, const nlohmann::json& l,
+    template <typename T, int in_size, int out_size, SampleRateCorrectionMode mode, int rank>
+    void loadLayer(LSTMLayerT<T, in_size, out_size, mode, rank>& lstm, int& json_stream_idx, const nlohmann::json& l,
         const std::string& type, int layerDims, bool debug)
     {
         using namespace json_parser;
@@ -274,8 +370,11 @@ namespace modelt_detail
             return;
         }
 
+        // whether each static layer (and the one after the last) is a batch-norm layer
+        const bool layer_is_batchnorm[] = { is_batchnorm<Layers>::value..., false };
+
         int json_stream_idx = 0;
-        modelt_detail::forEachInTuple([&](auto& layer, size_t)
+        modelt_detail::forEachInTuple([&](auto& layer, size_t layer_idx)
             {
                 if(json_stream_idx >= (int)json_layers.size())
                 {
@@ -283,7 +382,7 @@ namespace modelt_detail
                     return;
                 }
 
-                const auto l = json_layers.at(json_stream_idx);
+                auto l = json_layers.at(json_stream_idx);
                 const auto type = l["type"].get<std::string>();
                 const auto layerShape = l["shape"];
 
@@ -316,7 +415,19 @@ namespace modelt_detail
                     return;
                 }
 
-                modelt_detail::loadLayer<T>(layer, json_stream_idx, l, type, layerDims, debug); },
+                // a batch-norm that is in the json, but not in the static model, is folded into the layer before it
+                const bool fold_batchnorm = can_fold_batchnorm<std::decay_t<decltype(layer)>>::value
+                    && !layer_is_batchnorm[layer_idx + 1]
+                    && json_stream_idx + 1 < (int)json_layers.size()
+                    && foldBatchNorm<T>(l, json_layers.at(json_stream_idx + 1));
+
+                modelt_detail::loadLayer<T>(layer, json_stream_idx, l, type, layerDims, debug);
+
+                if(fold_batchnorm)
+                {
+                    debug_print("  folded the following batchnorm layer", debug);
+                    json_stream_idx++;
+                } },
             layers);
     }
 } // namespace modelt_detail
@@ -333,6 +444,11 @@ namespace modelt_detail
  *      DenseT<double, 8, 1>
  *  > model;
  *  ```
+ *
+ *  When loading from json, a batch-norm layer that directly follows a dense
+ *  or conv1d layer may be left out of the static model, in which case
+ *  parseJson() folds it into that layer's weights and biases (the static
+ *  equivalent of Model::optimize()).
  */
 template <typename T, int in_size, int out_size, typename... Layers>
 class ModelT
@@ -374,6 +490,40 @@ public:
             layers);
     }
 
+    /** Number of values in a snapshot of the state of the network layers. */
+    static constexpr int state_size = modelt_detail::model_state_size<Layers...>::value;
+
+    /** Returns the number of values in a snapshot of the state of the network layers (same as `state_size`). */
+    static constexpr int getStateSize() noexcept { return state_size; }
+
+    /**
+     * Copies the state of the network layers into a buffer of `state_size` values.
+     *
+     * Snapshots are only valid for the same model type, built with the same backend.
+     */
+    void getState(T* state) const noexcept
+    {
+        int offset = 0;
+        modelt_detail::forEachInTuple([&](const auto& layer, size_t)
+            {
+                modelt_detail::getLayerState(layer, state + offset);
+                offset += modelt_detail::layer_state_size<std::decay_t<decltype(layer)>>::value;
+            },
+            layers);
+    }
+
+    /** Restores the state of the network layers from a buffer written by getState(). */
+    void setState(const T* state) noexcept
+    {
+        int offset = 0;
+        modelt_detail::forEachInTuple([&](auto& layer, size_t)
+            {
+                modelt_detail::setLayerState(layer, state + offset);
+                offset += modelt_detail::layer_state_size<std::decay_t<decltype(layer)>>::value;
+            },
+            layers);
+    }
+
     /** Performs forward propagation for this model. */
     template <int N = in_size>
     inline typename std::enable_if<(N > 1), T>::type
@@ -387,8 +537,7 @@ public:
 #else // RTNEURAL_USE_STL
         std::copy(input, input + in_size, v_ins);
 #endif
-        std::get<0>(layers).forward(v_ins);
-        modelt_detail::forward_unroll<1, n_layers - 1>::call(layers);
+        forwardLayers(v_ins);
 
 #if RTNEURAL_USE_XSIMD
         for(int i = 0; i < v_out_size; ++i)
@@ -414,8 +563,7 @@ public:
         v_ins[0] = input[0];
 #endif
 
-        std::get<0>(layers).forward(v_ins);
-        modelt_detail::forward_unroll<1, n_layers - 1>::call(layers);
+        forwardLayers(v_ins);
 
 #if RTNEURAL_USE_XSIMD
         for(int i = 0; i < v_out_size; ++i)
@@ -448,7 +596,50 @@ public:
         return parseJson(parent, debug, custom_layers);
     }
 
+#if RTNEURAL_ENABLE_LAYER_TIMING
+    /** Returns the accumulated timing of each layer, in sequential order. */
+    const std::array<profiling::LayerTiming, sizeof...(Layers)>& getLayerTimings() const noexcept
+    {
+        return layer_timings;
+    }
+
+    /** Clears the accumulated layer timings. */
+    void resetLayerTimings() noexcept
+    {
+        for(auto& t : layer_timings)
+            t.reset();
+    }
+
+    /** Prints a per-layer breakdown of the accumulated timings. */
+    void printLayerTimings(std::ostream& os) const
+    {
+        std::string names[n_layers];
+        modelt_detail::forEachInTuple([&](const auto& layer, size_t i)
+            { names[i] = layer.getName(); },
+            layers);
+
+        profiling::printLayerTimings(os, layer_timings.data(), n_layers,
+            [&names](size_t i)
+            { return names[i]; });
+    }
+#endif
+
 private:
+    /** Runs every layer in sequence, starting from the model input. */
+    template <typename InputType>
+    inline void forwardLayers(const InputType& ins)
+    {
+#if RTNEURAL_ENABLE_LAYER_TIMING
+        const auto start = profiling::readTicks();
+        std::get<0>(layers).forward(ins);
+        layer_timings[0].record(start);
+        modelt_detail::forward_unroll<1, n_layers - 1>::call(layers, layer_timings);
+#else
+        std::get<0>(layers).forward(ins);
+        modelt_detail::forward_unroll<1, n_layers - 1>::call(layers);
+#endif
+    }
+
 #if RTNEURAL_USE_XSIMD
     using v_type = xsimd::simd_type<T>;
     static constexpr auto v_size = (int)v_type::size;
@@ -469,6 +660,10 @@ private:
 
     std::tuple<Layers...> layers;
     static constexpr size_t n_layers = sizeof...(Layers);
+
+#if RTNEURAL_ENABLE_LAYER_TIMING
+    std::array<profiling::LayerTiming, n_layers> layer_timings {};
+#endif
 };
 
 #if RTNEURAL_USE_EIGEN || !RTNEURAL_USE_XSIMD
@@ -526,6 +721,40 @@ public:
             layers);
     }
 
+    /** Number of values in a snapshot of the state of the network layers. */
+    static constexpr int state_size = modelt_detail::model_state_size<Layers...>::value;
+
+    /** Returns the number of values in a snapshot of the state of the network layers (same as `state_size`). */
+    static constexpr int getStateSize() noexcept { return state_size; }
+
+    /**
+     * Copies the state of the network layers into a buffer of `state_size` values.
+     *
+     * Snapshots are only valid for the same model type, built with the same backend.
+     */
+    void getState(T* state) const noexcept
+    {
+        int offset = 0;
+        modelt_detail::forEachInTuple([&](const auto& layer, size_t)
+            {
+                modelt_detail::getLayerState(layer, state + offset);
+                offset += modelt_detail::layer_state_size<std::decay_t<decltype(layer)>>::value;
+            },
+            layers);
+    }
+
+    /** Restores the state of the network layers from a buffer written by getState(). */
+    void setState(const T* state) noexcept
+    {
+        int offset = 0;
+        modelt_detail::forEachInTuple([&](auto& layer, size_t)
+            {
+                modelt_detail::setLayerState(layer, state + offset);
+                offset += modelt_detail::layer_state_size<std::decay_t<decltype(layer)>>::value;
+            },
+            layers);
+    }
+
     /** Performs forward propagation for this model. */
     inline T forward(const T* input)
     {
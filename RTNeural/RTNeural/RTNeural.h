@@ -19,4 +19,8 @@
 #include "Model.h"
 #include "ModelT.h"
 #include "model_loader.h"
+#include "model_registry.h"
+#include "offline_render.h"
+#include "resampling.h"
+#include "shared_inference.h"
 #include "torch_helpers.h"
@@ -27,11 +27,9 @@ public:
     /** Performs forward propagation for tanh activation. */
     inline void forward(const T* input, T* out) noexcept override
     {
-        inVec = Eigen::Map<const Eigen::Matrix<T, Eigen::Dynamic, 1>, RTNeuralEigenAlignment>(
-            input, Layer<T>::in_size, 1);
-        outVec = inVec.array().tanh();
-
-        std::copy(outVec.data(), outVec.data() + Layer<T>::in_size, out);
+        auto inMap = Eigen::Map<const Eigen::Array<T, Eigen::Dynamic, 1>>(input, Layer<T>::in_size, 1);
+        auto outMap = Eigen::Map<Eigen::Array<T, Eigen::Dynamic, 1>>(out, Layer<T>::in_size, 1);
+        outMap = inMap.tanh();
     }
 
     Eigen::Matrix<T, Eigen::Dynamic, 1> inVec;
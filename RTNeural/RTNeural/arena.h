@@ -0,0 +1,122 @@
+#ifndef ARENA_H_INCLUDED
+#define ARENA_H_INCLUDED
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#ifndef RTNEURAL_DEFAULT_ALIGNMENT
+#define RTNEURAL_DEFAULT_ALIGNMENT 16
+#endif
+
+namespace RTNeural
+{
+
+/**
+ * A single aligned block of memory, that layers allocate their
+ * weights and state from.
+ *
+ * Allocations are never freed individually: the whole arena is
+ * released at once when it is destroyed. Every allocation starts
+ * on a RTNEURAL_DEFAULT_ALIGNMENT boundary, and is zero-initialized.
+ */
+template <typename T>
+class Arena
+{
+public:
+    Arena() = default;
+
+    /** Creates an arena with space for the given number of values (see alignedSize()). */
+    explicit Arena(size_t num_values)
+        : capacity(num_values)
+    {
+        if(capacity == 0)
+            return;
+
+        raw_memory.reset(new char[capacity * sizeof(T) + RTNEURAL_DEFAULT_ALIGNMENT]);
+        const auto address = reinterpret_cast<std::uintptr_t>(raw_memory.get());
+        const auto offset = (RTNEURAL_DEFAULT_ALIGNMENT - address % RTNEURAL_DEFAULT_ALIGNMENT) % RTNEURAL_DEFAULT_ALIGNMENT;
+        memory = reinterpret_cast<T*>(raw_memory.get() + offset);
+        std::fill(memory, memory + capacity, (T)0);
+    }
+
+    Arena(Arena&&) noexcept = default;
+    Arena& operator=(Arena&&) noexcept = default;
+
+    /** Returns the number of values used by an allocation of `count` values, including alignment padding. */
+    static constexpr size_t alignedSize(size_t count) noexcept
+    {
+        return ((count + values_per_alignment - 1) / values_per_alignment) * values_per_alignment;
+    }
+
+    /** Allocates `count` values from the arena. */
+    T* allocate(size_t count) noexcept
+    {
+        assert(used + alignedSize(count) <= capacity && "Arena is too small!");
+
+        T* result = memory + used;
+        used += alignedSize(count);
+        return result;
+    }
+
+    /** Returns the number of values that the arena can hold. */
+    size_t getCapacity() const noexcept { return capacity; }
+
+    /** Returns the number of values that have been allocated. */
+    size_t getNumUsed() const noexcept { return used; }
+
+private:
+    static constexpr size_t values_per_alignment = std::max((size_t)RTNEURAL_DEFAULT_ALIGNMENT / sizeof(T), (size_t)1);
+
+    std::unique_ptr<char[]> raw_memory;
+    T* memory = nullptr;
+    size_t capacity = 0;
+    size_t used = 0;
+};
+
+/**
+ * The contiguous block of memory holding the weights and state of a
+ * dynamic layer.
+ *
+ * The block is allocated from an arena owned by the layer, and can
+ * later be moved into a larger arena that is shared with the other
+ * layers of a model (see Model::addLayer()).
+ */
+template <typename T>
+class LayerMemory
+{
+public:
+    /** Allocates a zero-initialized block of `num_values` values. */
+    explicit LayerMemory(size_t num_values)
+        : size(num_values)
+        , own_arena(num_values)
+    {
+        memory = own_arena.allocate(size);
+    }
+
+    /** Returns a pointer to the start of the block. */
+    T* data() const noexcept { return memory; }
+
+    /** Returns the number of values in the block. */
+    size_t getSize() const noexcept { return size; }
+
+    /** Moves the block into the given arena, and releases the previous memory if the layer owned it. */
+    void moveTo(Arena<T>& arena)
+    {
+        T* new_memory = arena.allocate(size);
+        std::copy(memory, memory + size, new_memory);
+        memory = new_memory;
+        own_arena = Arena<T>();
+    }
+
+private:
+    const size_t size;
+    Arena<T> own_arena;
+    T* memory = nullptr;
+};
+
+} // namespace RTNeural
+
+#endif // ARENA_H_INCLUDED
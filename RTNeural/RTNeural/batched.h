@@ -0,0 +1,514 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "common.h"
+
+namespace RTNeural
+{
+
+/*
+ * Batched variants of the static layers, that run `batch_size` independent
+ * sequences in lockstep through the same weights.
+ *
+ * The inputs, outputs and states of the batched layers are [size x batch_size]
+ * matrices, stored row by row, so the values of one feature for every sequence
+ * are contiguous: value i of sequence b is at index i * batch_size + b. Each
+ * step multiplies the weights by a whole matrix of inputs, instead of one
+ * vector per sequence, so the weights are loaded once for every sequence.
+ *
+ * The layers take their weights with the same methods as the static layers,
+ * so the `torch_helpers` loaders can be used on them, and the output of one
+ * layer (`outs`) can be passed directly to the `forward()` method of the next.
+ */
+#ifndef DOXYGEN
+namespace batched_detail
+{
+#if RTNEURAL_USE_EIGEN
+    /** Row-major [rows x cols] matrix (Eigen needs single-column matrices to be column-major). */
+    template <typename T, int rows, int cols>
+    using matrix_type = Eigen::Matrix<T, rows, cols, (cols == 1 && rows != 1) ? Eigen::ColMajor : Eigen::RowMajor>;
+
+    template <typename T, int size>
+    using array_map_type = Eigen::Map<Eigen::Array<T, size, 1>>;
+
+    template <typename ArrayType>
+    inline auto sigmoid(const ArrayType& x) noexcept
+    {
+        using T = typename ArrayType::Scalar;
+        return (T)1 / ((T)1 + (-x).exp());
+    }
+#else
+    template <typename T>
+    inline T sigmoid(T x) noexcept
+    {
+        return (T)1 / ((T)1 + std::exp(-x));
+    }
+#endif
+
+    /** Sets every value of row k of a [rows x batch_size] matrix to bias[k]. */
+    template <typename T, int rows, int batch_size>
+    inline void fillRows(const T* bias, T* outs) noexcept
+    {
+        for(int k = 0; k < rows; ++k)
+            std::fill(outs + k * batch_size, outs + (k + 1) * batch_size, bias[k]);
+    }
+
+    /** outs [rows x batch_size] += weights [rows x cols] * ins [cols x batch_size], all stored row by row. */
+    template <typename T, int rows, int cols, int batch_size>
+    inline void multiplyAdd(const T* weights, const T* ins, T* outs) noexcept
+    {
+#if RTNEURAL_USE_EIGEN
+        Eigen::Map<matrix_type<T, rows, batch_size>>(outs).noalias()
+            += Eigen::Map<const matrix_type<T, rows, cols>>(weights) * Eigen::Map<const matrix_type<T, cols, batch_size>>(ins);
+#else
+        // the innermost loop runs over the sequences, which are contiguous
+        for(int k = 0; k < rows; ++k)
+        {
+            T* out_row = outs + k * batch_size;
+            for(int i = 0; i < cols; ++i)
+            {
+                const auto w = weights[k * cols + i];
+                const T* in_row = ins + i * batch_size;
+                for(int b = 0; b < batch_size; ++b)
+                    out_row[b] += w * in_row[b];
+            }
+        }
+#endif
+    }
+} // namespace batched_detail
+#endif // DOXYGEN
+
+/**
+ * Batched variant of DenseT.
+ *
+ * @param batch_sizet: the number of sequences that are processed at once
+ */
+template <typename T, int in_sizet, int out_sizet, int batch_sizet>
+class DenseBatchT
+{
+public:
+    static constexpr auto in_size = in_sizet;
+    static constexpr auto out_size = out_sizet;
+    static constexpr auto batch_size = batch_sizet;
+
+    DenseBatchT()
+    {
+        std::fill(std::begin(weights), std::end(weights), (T)0);
+        std::fill(std::begin(bias), std::end(bias), (T)0);
+        std::fill(std::begin(outs), std::end(outs), (T)0);
+    }
+
+    /** Returns the name of this layer. */
+    std::string getName() const noexcept { return "dense"; }
+
+    /** Returns false since dense is not an activation layer. */
+    constexpr bool isActivation() const noexcept { return false; }
+
+    /** Reset is a no-op, since Dense does not have state. */
+    void reset() { }
+
+    /** Performs forward propagation for this layer, with an [in_size x batch_size] input. */
+    inline void forward(const T (&ins)[in_size * batch_size]) noexcept
+    {
+        batched_detail::fillRows<T, out_size, batch_size>(bias, outs);
+        batched_detail::multiplyAdd<T, out_size, in_size, batch_size>(weights, ins, outs);
+    }
+
+    /**
+     * Sets the layer weights from a given vector.
+     *
+     * The dimension of the weights vector must be
+     * weights[out_size][in_size]
+     */
+    void setWeights(const std::vector<std::vector<T>>& newWeights)
+    {
+        for(int i = 0; i < out_size; ++i)
+            for(int k = 0; k < in_size; ++k)
+                weights[i * in_size + k] = newWeights[i][k];
+    }
+
+    /**
+     * Sets the layer weights from a given vector.
+     *
+     * The dimension of the weights array must be
+     * weights[out_size][in_size]
+     */
+    void setWeights(T** newWeights)
+    {
+        for(int i = 0; i < out_size; ++i)
+            for(int k = 0; k < in_size; ++k)
+                weights[i * in_size + k] = newWeights[i][k];
+    }
+
+    /**
+     * Sets the layer bias from a given array of size
+     * bias[out_size]
+     */
+    void setBias(const T* b)
+    {
+        std::copy(b, b + out_size, bias);
+    }
+
+    /** The [out_size x batch_size] output. */
+    T outs alignas(RTNEURAL_DEFAULT_ALIGNMENT)[out_size * batch_size];
+
+private:
+    T weights alignas(RTNEURAL_DEFAULT_ALIGNMENT)[out_size * in_size];
+    T bias[out_size];
+};
+
+//====================================================
+/**
+ * Batched variant of LSTMLayerT, with tanh activation
+ * and sigmoid recurrent activation.
+ *
+ * To ensure that the recurrent state of every sequence
+ * is initialized to zero, please make sure to call
+ * `reset()` before your first call to the `forward()` method.
+ *
+ * @param batch_sizet: the number of sequences that are processed at once
+ */
+template <typename T, int in_sizet, int out_sizet, int batch_sizet>
+class LSTMLayerBatchT
+{
+    static constexpr auto state_size = out_sizet * batch_sizet;
+
+public:
+    static constexpr auto in_size = in_sizet;
+    static constexpr auto out_size = out_sizet;
+    static constexpr auto batch_size = batch_sizet;
+
+    LSTMLayerBatchT()
+    {
+        std::fill(std::begin(kernel_weights), std::end(kernel_weights), (T)0);
+        std::fill(std::begin(recurrent_weights), std::end(recurrent_weights), (T)0);
+        std::fill(std::begin(bias), std::end(bias), (T)0);
+        reset();
+    }
+
+    /** Returns the name of this layer. */
+    std::string getName() const noexcept { return "lstm"; }
+
+    /** Returns false since LSTM is not an activation. */
+    constexpr bool isActivation() const noexcept { return false; }
+
+    /** Resets the state of every sequence. */
+    void reset()
+    {
+        std::fill(std::begin(outs), std::end(outs), (T)0);
+        std::fill(std::begin(cells), std::end(cells), (T)0);
+    }
+
+    /** Performs forward propagation for this layer, with an [in_size x batch_size] input. */
+    inline void forward(const T (&ins)[in_size * batch_size]) noexcept
+    {
+        // stacked [i, f, c, o] pre-activations, with the rows of each gate next to each other
+        batched_detail::fillRows<T, 4 * out_size, batch_size>(bias, gates);
+        batched_detail::multiplyAdd<T, 4 * out_size, in_size, batch_size>(kernel_weights, ins, gates);
+        batched_detail::multiplyAdd<T, 4 * out_size, out_size, batch_size>(recurrent_weights, outs, gates);
+
+#if RTNEURAL_USE_EIGEN
+        using gate_map = batched_detail::array_map_type<T, state_size>;
+        gate_map i_gate(gates), f_gate(gates + state_size), c_gate(gates + 2 * state_size), o_gate(gates + 3 * state_size);
+        gate_map c_vec(cells), h_vec(outs);
+
+        c_vec = batched_detail::sigmoid(f_gate) * c_vec + batched_detail::sigmoid(i_gate) * c_gate.tanh();
+        h_vec = batched_detail::sigmoid(o_gate) * c_vec.tanh();
+#else
+        for(int n = 0; n < state_size; ++n)
+        {
+            cells[n] = batched_detail::sigmoid(gates[state_size + n]) * cells[n]
+                + batched_detail::sigmoid(gates[n]) * std::tanh(gates[2 * state_size + n]);
+            outs[n] = batched_detail::sigmoid(gates[3 * state_size + n]) * std::tanh(cells[n]);
+        }
+#endif
+    }
+
+    /**
+     * Sets the layer kernel weights.
+     *
+     * The weights vector must have size weights[in_size][4 * out_size]
+     */
+    void setWVals(const std::vector<std::vector<T>>& wVals)
+    {
+        for(int i = 0; i < in_size; ++i)
+            for(int k = 0; k < 4 * out_size; ++k)
+                kernel_weights[k * in_size + i] = wVals[i][k];
+    }
+
+    /**
+     * Sets the layer recurrent weights.
+     *
+     * The weights vector must have size weights[out_size][4 * out_size]
+     */
+    void setUVals(const std::vector<std::vector<T>>& uVals)
+    {
+        for(int i = 0; i < out_size; ++i)
+            for(int k = 0; k < 4 * out_size; ++k)
+                recurrent_weights[k * out_size + i] = uVals[i][k];
+    }
+
+    /**
+     * Sets the layer bias.
+     *
+     * The bias vector must have size weights[4 * out_size]
+     */
+    void setBVals(const std::vector<T>& bVals)
+    {
+        std::copy(bVals.begin(), bVals.begin() + 4 * out_size, bias);
+    }
+
+    /** The [out_size x batch_size] output, which is also the recurrent state. */
+    T outs alignas(RTNEURAL_DEFAULT_ALIGNMENT)[state_size];
+
+private:
+    // stacked [i, f, c, o] weights, stored row by row
+    T kernel_weights alignas(RTNEURAL_DEFAULT_ALIGNMENT)[4 * out_size * in_size];
+    T recurrent_weights alignas(RTNEURAL_DEFAULT_ALIGNMENT)[4 * out_size * out_size];
+    T bias[4 * out_size];
+
+    T gates alignas(RTNEURAL_DEFAULT_ALIGNMENT)[4 * state_size];
+    T cells alignas(RTNEURAL_DEFAULT_ALIGNMENT)[state_size];
+};
+
+//====================================================
+/**
+ * Batched variant of GRULayerT, with tanh activation
+ * and sigmoid recurrent activation.
+ *
+ * To ensure that the recurrent state of every sequence
+ * is initialized to zero, please make sure to call
+ * `reset()` before your first call to the `forward()` method.
+ *
+ * @param batch_sizet: the number of sequences that are processed at once
+ */
+template <typename T, int in_sizet, int out_sizet, int batch_sizet>
+class GRULayerBatchT
+{
+    static constexpr auto state_size = out_sizet * batch_sizet;
+
+public:
+    static constexpr auto in_size = in_sizet;
+    static constexpr auto out_size = out_sizet;
+    static constexpr auto batch_size = batch_sizet;
+
+    GRULayerBatchT()
+    {
+        std::fill(std::begin(kernel_weights), std::end(kernel_weights), (T)0);
+        std::fill(std::begin(recurrent_weights), std::end(recurrent_weights), (T)0);
+        std::fill(std::begin(kernel_bias), std::end(kernel_bias), (T)0);
+        std::fill(std::begin(recurrent_bias), std::end(recurrent_bias), (T)0);
+        reset();
+    }
+
+    /** Returns the name of this layer. */
+    std::string getName() const noexcept { return "gru"; }
+
+    /** Returns false since GRU is not an activation layer. */
+    constexpr bool isActivation() const noexcept { return false; }
+
+    /** Resets the state of every sequence. */
+    void reset()
+    {
+        std::fill(std::begin(outs), std::end(outs), (T)0);
+    }
+
+    /** Performs forward propagation for this layer, with an [in_size x batch_size] input. */
+    inline void forward(const T (&ins)[in_size * batch_size]) noexcept
+    {
+        // stacked [z, r, c] pre-activations of the input and of the recurrent state
+        batched_detail::fillRows<T, 3 * out_size, batch_size>(kernel_bias, x_gates);
+        batched_detail::multiplyAdd<T, 3 * out_size, in_size, batch_size>(kernel_weights, ins, x_gates);
+        batched_detail::fillRows<T, 3 * out_size, batch_size>(recurrent_bias, h_gates);
+        batched_detail::multiplyAdd<T, 3 * out_size, out_size, batch_size>(recurrent_weights, outs, h_gates);
+
+#if RTNEURAL_USE_EIGEN
+        using gate_map = batched_detail::array_map_type<T, state_size>;
+        gate_map z_gate(x_gates), r_gate(x_gates + state_size), c_gate(x_gates + 2 * state_size);
+        gate_map z_recurrent(h_gates), r_recurrent(h_gates + state_size), c_recurrent(h_gates + 2 * state_size);
+        gate_map h_vec(outs);
+
+        z_gate = batched_detail::sigmoid(z_gate + z_recurrent);
+        r_gate = batched_detail::sigmoid(r_gate + r_recurrent);
+        c_gate = (c_gate + r_gate * c_recurrent).tanh();
+        h_vec = ((T)1 - z_gate) * c_gate + z_gate * h_vec;
+#else
+        for(int n = 0; n < state_size; ++n)
+        {
+            const auto z = batched_detail::sigmoid(x_gates[n] + h_gates[n]);
+            const auto r = batched_detail::sigmoid(x_gates[state_size + n] + h_gates[state_size + n]);
+            const auto c = std::tanh(x_gates[2 * state_size + n] + r * h_gates[2 * state_size + n]);
+            outs[n] = ((T)1 - z) * c + z * outs[n];
+        }
+#endif
+    }
+
+    /**
+     * Sets the layer kernel weights.
+     *
+     * The weights vector must have size weights[in_size][3 * out_size]
+     */
+    void setWVals(const std::vector<std::vector<T>>& wVals)
+    {
+        for(int i = 0; i < in_size; ++i)
+            for(int k = 0; k < 3 * out_size; ++k)
+                kernel_weights[k * in_size + i] = wVals[i][k];
+    }
+
+    /**
+     * Sets the layer recurrent weights.
+     *
+     * The weights vector must have size weights[out_size][3 * out_size]
+     */
+    void setUVals(const std::vector<std::vector<T>>& uVals)
+    {
+        for(int i = 0; i < out_size; ++i)
+            for(int k = 0; k < 3 * out_size; ++k)
+                recurrent_weights[k * out_size + i] = uVals[i][k];
+    }
+
+    /**
+     * Sets the layer bias.
+     *
+     * The bias vector must have size weights[2][3 * out_size]
+     */
+    void setBVals(const std::vector<std::vector<T>>& bVals)
+    {
+        // the recurrent biases of z and r don't depend on the reset gate, so they are folded into the kernel biases
+        for(int k = 0; k < 2 * out_size; ++k)
+        {
+            kernel_bias[k] = bVals[0][k] + bVals[1][k];
+            recurrent_bias[k] = (T)0;
+        }
+
+        for(int k = 2 * out_size; k < 3 * out_size; ++k)
+        {
+            kernel_bias[k] = bVals[0][k];
+            recurrent_bias[k] = bVals[1][k];
+        }
+    }
+
+    /** The [out_size x batch_size] output, which is also the recurrent state. */
+    T outs alignas(RTNEURAL_DEFAULT_ALIGNMENT)[state_size];
+
+private:
+    // stacked [z, r, c] weights, stored row by row
+    T kernel_weights alignas(RTNEURAL_DEFAULT_ALIGNMENT)[3 * out_size * in_size];
+    T recurrent_weights alignas(RTNEURAL_DEFAULT_ALIGNMENT)[3 * out_size * out_size];
+    T kernel_bias[3 * out_size];
+    T recurrent_bias[3 * out_size];
+
+    T x_gates alignas(RTNEURAL_DEFAULT_ALIGNMENT)[3 * state_size];
+    T h_gates alignas(RTNEURAL_DEFAULT_ALIGNMENT)[3 * state_size];
+};
+
+//====================================================
+/**
+ * Batched variant of Conv1DT, with no activation.
+ *
+ * The layer has a "state" made up of the past inputs of every
+ * sequence. To ensure that the state is initialized to zero,
+ * please make sure to call `reset()` before your first call to
+ * the `forward()` method.
+ *
+ * @param batch_sizet: the number of sequences that are processed at once
+ */
+template <typename T, int in_sizet, int out_sizet, int kernel_size, int dilation_rate, int batch_sizet>
+class Conv1DBatchT
+{
+    static constexpr auto state_size = (kernel_size - 1) * dilation_rate + 1;
+    static constexpr auto frame_size = in_sizet * batch_sizet;
+
+public:
+    static constexpr auto in_size = in_sizet;
+    static constexpr auto out_size = out_sizet;
+    static constexpr auto batch_size = batch_sizet;
+    static constexpr auto dilation = dilation_rate;
+    static constexpr auto kernel_length = kernel_size;
+
+    Conv1DBatchT()
+    {
+        std::fill(std::begin(weights), std::end(weights), (T)0);
+        std::fill(std::begin(bias), std::end(bias), (T)0);
+        std::fill(std::begin(outs), std::end(outs), (T)0);
+        reset();
+    }
+
+    /** Returns the name of this layer. */
+    std::string getName() const noexcept { return "conv1d"; }
+
+    /** Returns false since convolution is not an activation layer. */
+    constexpr bool isActivation() const noexcept { return false; }
+
+    /** Resets the state of every sequence. */
+    void reset()
+    {
+        std::fill(std::begin(state), std::end(state), (T)0);
+        state_ptr = 0;
+    }
+
+    /** Performs forward propagation for this layer, with an [in_size x batch_size] input. */
+    inline void forward(const T (&ins)[in_size * batch_size]) noexcept
+    {
+        // insert the input frame into a mirrored circular buffer
+        std::copy(ins, ins + frame_size, state + state_ptr * frame_size);
+        std::copy(ins, ins + frame_size, state + (state_ptr + state_size) * frame_size);
+
+        // one product per kernel tap, reading the dilated input frames in place
+        batched_detail::fillRows<T, out_size, batch_size>(bias, outs);
+        for(int k = 0; k < kernel_size; ++k)
+        {
+            const T* frame = state + (state_ptr + state_size - k * dilation_rate) * frame_size;
+            batched_detail::multiplyAdd<T, out_size, in_size, batch_size>(weights + k * out_size * in_size, frame, outs);
+        }
+
+        state_ptr = (state_ptr == state_size - 1 ? 0 : state_ptr + 1); // iterate state pointer forwards
+    }
+
+    /**
+     * Sets the layer weights.
+     *
+     * The weights vector must have size weights[out_size][in_size][kernel_size * dilation]
+     */
+    void setWeights(const std::vector<std::vector<std::vector<T>>>& ws)
+    {
+        for(int i = 0; i < out_size; ++i)
+            for(int k = 0; k < in_size; ++k)
+                for(int j = 0; j < kernel_size; ++j)
+                    weights[(j * out_size + i) * in_size + k] = ws[i][k][j];
+    }
+
+    /**
+     * Sets the layer biases.
+     *
+     * The bias vector must have size bias[out_size]
+     */
+    void setBias(const std::vector<T>& biasVals)
+    {
+        std::copy(biasVals.begin(), biasVals.begin() + out_size, bias);
+    }
+
+    /** Returns the size of the convolution kernel. */
+    int getKernelSize() const noexcept { return kernel_size; }
+
+    /** Returns the convolution dilation rate. */
+    int getDilationRate() const noexcept { return dilation_rate; }
+
+    /** The [out_size x batch_size] output. */
+    T outs alignas(RTNEURAL_DEFAULT_ALIGNMENT)[out_size * batch_size];
+
+private:
+    /** One [out_size x in_size] weights matrix per kernel tap, stored row by row. */
+    T weights alignas(RTNEURAL_DEFAULT_ALIGNMENT)[kernel_size * out_size * in_size];
+    T bias[out_size];
+
+    /** Mirrored circular buffer of input frames: every frame is written at state_ptr and state_ptr + state_size. */
+    T state alignas(RTNEURAL_DEFAULT_ALIGNMENT)[2 * state_size * frame_size];
+    int state_ptr = 0;
+};
+
+} // namespace RTNeural
@@ -43,6 +43,12 @@ public:
     /** Set's the layer "epsilon" value. */
     void setEpsilon(T epsilon);
 
+    /** Returns the multiplier applied to the given channel, so that out = scale * in + shift. */
+    T getScale(int i) const noexcept { return multiplier(i); }
+
+    /** Returns the offset added to the given channel, so that out = scale * in + shift. */
+    T getShift(int i) const noexcept { return beta(i) - multiplier(i) * running_mean(i); }
+
 private:
     void updateMultiplier();
 
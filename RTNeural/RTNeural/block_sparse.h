@@ -0,0 +1,243 @@
+#ifndef BLOCK_SPARSE_H_INCLUDED
+#define BLOCK_SPARSE_H_INCLUDED
+
+#include <algorithm>
+#include <cassert>
+#include <vector>
+
+#include "common.h"
+
+namespace RTNeural
+{
+
+/**
+ * Block-sparse storage for a [rows x cols] weight matrix.
+ *
+ * The matrix is split into blocks of `block_rows` consecutive rows
+ * of a single column (4x1, 8x1, etc., to match the width of a SIMD
+ * register). Only the blocks that contain a non-zero weight are
+ * stored, grouped by block row, so that multiply() skips the blocks
+ * that were pruned to zero, while the values within a block are
+ * still processed together.
+ */
+template <typename T>
+class BlockSparseMatrix
+{
+public:
+    /** The default block height, which suits 128-bit SIMD registers with floats. */
+    static constexpr int default_block_rows = 4;
+
+    /** Creates an empty matrix, with the given block height (1, 2, 4, 8, or 16). */
+    explicit BlockSparseMatrix(int blockRows = default_block_rows)
+        : block_rows(blockRows)
+    {
+        assert((block_rows == 1 || block_rows == 2 || block_rows == 4 || block_rows == 8 || block_rows == 16)
+            && "Unsupported block size!");
+    }
+
+    /**
+     * Returns the fraction of the blocks of a [rows x cols] matrix that
+     * contain a non-zero weight, where `weight(i, k)` returns the weight
+     * in row i and column k.
+     */
+    template <typename WeightFunc>
+    T getDensity(int rows, int cols, WeightFunc&& weight) const
+    {
+        const auto num_block_rows = (rows + block_rows - 1) / block_rows;
+        if(num_block_rows * cols == 0)
+            return (T)1;
+
+        int num_blocks = 0;
+        for(int rb = 0; rb < num_block_rows; ++rb)
+            for(int k = 0; k < cols; ++k)
+                num_blocks += isNonZeroBlock(rows, rb, k, weight) ? 1 : 0;
+
+        return (T)num_blocks / (T)(num_block_rows * cols);
+    }
+
+    /**
+     * Stores the non-zero blocks of a [rows x cols] matrix if at most
+     * `max_density` of its blocks contain a non-zero weight, and returns
+     * true. Otherwise the matrix is left empty, and this returns false.
+     * `weight(i, k)` returns the weight in row i and column k.
+     */
+    template <typename WeightFunc>
+    bool setWeights(int rows, int cols, T max_density, WeightFunc&& weight)
+    {
+        clear();
+        if(max_density <= (T)0 || getDensity(rows, cols, weight) > max_density)
+            return false;
+
+        num_rows = rows;
+        num_block_rows = (rows + block_rows - 1) / block_rows;
+        block_starts.push_back(0);
+        for(int rb = 0; rb < num_block_rows; ++rb)
+        {
+            for(int k = 0; k < cols; ++k)
+            {
+                if(!isNonZeroBlock(rows, rb, k, weight))
+                    continue;
+
+                // the last block row is zero-padded, so that the kernel doesn't need to check the row count
+                block_cols.push_back(k);
+                for(int j = 0; j < block_rows; ++j)
+                    block_values.push_back(rb * block_rows + j < rows ? weight(rb * block_rows + j, k) : (T)0);
+            }
+            block_starts.push_back((int)block_cols.size());
+        }
+
+        return true;
+    }
+
+    /** Releases the stored blocks. */
+    void clear()
+    {
+        num_rows = 0;
+        num_block_rows = 0;
+        block_starts.clear();
+        block_cols.clear();
+        block_values.clear();
+    }
+
+    /** Returns true if no matrix is stored. */
+    bool isEmpty() const noexcept { return num_rows == 0; }
+
+    /** Returns the number of stored (non-zero) blocks. */
+    int getNumBlocks() const noexcept { return (int)block_cols.size(); }
+
+    /** Computes out = W * in, where `in` has `cols` values and `out` has `rows` values. */
+    inline void multiply(const T* in, T* out) const noexcept
+    {
+#if RTNEURAL_USE_XSIMD
+        if(block_rows == (int)xsimd::simd_type<T>::size)
+        {
+            multiplySimdBlocks(in, out);
+            return;
+        }
+#endif
+
+        switch(block_rows)
+        {
+        case 1:
+            multiplyBlocks<1>(in, out);
+            break;
+        case 2:
+            multiplyBlocks<2>(in, out);
+            break;
+        case 4:
+            multiplyBlocks<4>(in, out);
+            break;
+        case 8:
+            multiplyBlocks<8>(in, out);
+            break;
+        default:
+            multiplyBlocks<16>(in, out);
+            break;
+        }
+    }
+
+private:
+    template <int block_size>
+    inline void multiplyBlocks(const T* in, T* out) const noexcept
+    {
+        const T* values = block_values.data();
+        const int* cols = block_cols.data();
+        for(int rb = 0; rb < num_block_rows; ++rb)
+        {
+            const auto row = rb * block_size;
+            const auto num_out = std::min(block_size, num_rows - row);
+            const int end = block_starts[(size_t)rb + 1];
+
+#if RTNEURAL_USE_EIGEN
+            // two accumulators, so that consecutive blocks don't wait on each other
+            using block_type = Eigen::Matrix<T, block_size, 1>;
+            block_type sums0 = block_type::Zero();
+            block_type sums1 = block_type::Zero();
+            int b = block_starts[(size_t)rb];
+            for(; b + 1 < end; b += 2, values += 2 * block_size)
+            {
+                sums0.noalias() += Eigen::Map<const block_type>(values) * in[cols[b]];
+                sums1.noalias() += Eigen::Map<const block_type>(values + block_size) * in[cols[b + 1]];
+            }
+
+            if(b < end)
+            {
+                sums0.noalias() += Eigen::Map<const block_type>(values) * in[cols[b]];
+                values += block_size;
+            }
+
+            sums0 += sums1;
+            std::copy(sums0.data(), sums0.data() + num_out, out + row);
+#else
+            T sums[block_size] {};
+            for(int b = block_starts[(size_t)rb]; b < end; ++b, values += block_size)
+            {
+                const auto x = in[cols[b]];
+                for(int j = 0; j < block_size; ++j)
+                    sums[j] += values[j] * x;
+            }
+
+            std::copy(sums, sums + num_out, out + row);
+#endif
+        }
+    }
+
+#if RTNEURAL_USE_XSIMD
+    /** multiply() for blocks that fill exactly one SIMD register. */
+    inline void multiplySimdBlocks(const T* in, T* out) const noexcept
+    {
+        using b_type = xsimd::simd_type<T>;
+        constexpr auto block_size = (int)b_type::size;
+
+        const T* values = block_values.data();
+        const int* cols = block_cols.data();
+        for(int rb = 0; rb < num_block_rows; ++rb)
+        {
+            // two accumulators, so that consecutive blocks don't wait on each other
+            b_type sums0((T)0);
+            b_type sums1((T)0);
+            int b = block_starts[(size_t)rb];
+            const int end = block_starts[(size_t)rb + 1];
+            for(; b + 1 < end; b += 2, values += 2 * block_size)
+            {
+                sums0 = xsimd::fma(xsimd::load_unaligned(values), b_type(in[cols[b]]), sums0);
+                sums1 = xsimd::fma(xsimd::load_unaligned(values + block_size), b_type(in[cols[b + 1]]), sums1);
+            }
+
+            if(b < end)
+            {
+                sums0 = xsimd::fma(xsimd::load_unaligned(values), b_type(in[cols[b]]), sums0);
+                values += block_size;
+            }
+
+            T sums[block_size];
+            (sums0 + sums1).store_unaligned(sums);
+
+            const auto row = rb * block_size;
+            std::copy(sums, sums + std::min(block_size, num_rows - row), out + row);
+        }
+    }
+#endif
+
+    template <typename WeightFunc>
+    bool isNonZeroBlock(int rows, int rb, int k, WeightFunc& weight) const
+    {
+        for(int i = rb * block_rows; i < std::min((rb + 1) * block_rows, rows); ++i)
+            if(weight(i, k) != (T)0)
+                return true;
+
+        return false;
+    }
+
+    int block_rows;
+    int num_rows = 0;
+    int num_block_rows = 0;
+
+    std::vector<int> block_starts; // [num_block_rows + 1] indices of the first block of each block row
+    std::vector<int> block_cols; // [num_blocks] column of each block
+    std::vector<T> block_values; // [num_blocks][block_rows] weights of each block
+};
+
+} // namespace RTNeural
+
+#endif // BLOCK_SPARSE_H_INCLUDED
@@ -1,5 +1,9 @@
 #pragma once
 
+#include <algorithm>
+#include <memory>
+#include <vector>
+
 namespace RTNeural
 {
 
@@ -23,6 +27,53 @@ enum class SampleRateCorrectionMode
     LinInterp, // sample rate correction with linear interpolation (can be used with non-integer delay lengths)
 };
 
+/**
+ * Ring buffer used by the recurrent layers to delay their state
+ * when doing sample-rate correction.
+ *
+ * Each element holds one state vector (of type `VecType`). The
+ * capacity is rounded up to a power of two when the delay line is
+ * prepared, so that reading, writing and advancing the delay line
+ * costs the same, regardless of the delay length.
+ */
+template <typename VecType, typename Allocator = std::allocator<VecType>>
+class SampleRateCorrectionDelay
+{
+public:
+    /** Allocates the delay line, so that it can read values up to `maxDelay` samples old. */
+    void prepare(int maxDelay)
+    {
+        int capacity = 1;
+        while(capacity < maxDelay + 1)
+            capacity *= 2;
+
+        buffer.resize((size_t)capacity);
+        mask = capacity - 1;
+        writeIndex = 0;
+    }
+
+    /** Fills the delay line with the given value. */
+    void fill(const VecType& value)
+    {
+        std::fill(buffer.begin(), buffer.end(), value);
+        writeIndex = 0;
+    }
+
+    /** Returns the element to write for the current sample. */
+    VecType& write() noexcept { return buffer[(size_t)writeIndex]; }
+
+    /** Returns the element written `delay` samples ago (0 is the current sample). */
+    const VecType& read(int delay) const noexcept { return buffer[(size_t)((writeIndex - delay) & mask)]; }
+
+    /** Moves on to the next sample. */
+    void advance() noexcept { writeIndex = (writeIndex + 1) & mask; }
+
+private:
+    std::vector<VecType, Allocator> buffer = std::vector<VecType, Allocator>(1);
+    int mask = 0;
+    int writeIndex = 0;
+};
+
 /** Divides two numbers and rounds up if there is a remainder. */
 template <typename T>
 constexpr T ceil_div(T num, T den)
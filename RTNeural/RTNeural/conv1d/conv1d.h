@@ -27,6 +27,9 @@ namespace RTNeural
  * to the layer. To ensure that the state is initialized to zero,
  * please make sure to call `reset()` before your first call to
  * the `forward()` method.
+ *
+ * The weights, bias, state and block processing buffers are stored
+ * row-major in a single contiguous block of memory.
  */
 template <typename T>
 class Conv1D final : public Layer<T>
@@ -44,45 +47,59 @@ public:
     Conv1D(std::initializer_list<int> sizes);
     Conv1D(const Conv1D& other);
     Conv1D& operator=(const Conv1D& other);
-    virtual ~Conv1D();
 
     /** Resets the layer state. */
     void reset() override;
 
+    /** Returns the number of values in a snapshot of the layer state. */
+    int getStateSize() const noexcept override { return state_size * Layer<T>::in_size + 1; }
+
+    /** Copies the layer state into a buffer of getStateSize() values. */
+    void getState(T* stateOut) const noexcept override;
+
+    /** Restores the layer state from a buffer written by getState(). */
+    void setState(const T* stateIn) noexcept override;
+
     /** Returns the name of this layer. */
     std::string getName() const noexcept override { return "conv1d"; }
 
     /** Performs forward propagation for this layer. */
     inline void forward(const T* input, T* h) noexcept override
     {
-        // insert input into a circular buffer
-        std::copy(input, input + Layer<T>::in_size, state[state_ptr]);
+        const auto in_size = Layer<T>::in_size;
 
-        // set state pointers to particular columns of the buffer
-        setStatePointers();
+        // insert input into a mirrored circular buffer
+        std::copy(input, input + in_size, state + state_ptr * in_size);
+        std::copy(input, input + in_size, state + (state_ptr + state_size) * in_size);
 
-        // copy selected columns to a helper variable
-        for(int k = 0; k < kernel_size; ++k)
-        {
-            const auto& col = state[state_ptrs[k]];
-            std::copy(col, col + Layer<T>::in_size, state_cols[k]);
-        }
-
-        // perform multi-channel convolution
+        // perform multi-channel convolution, reading the dilated taps in place
+        const T* newest = state + (state_ptr + state_size) * in_size;
         for(int i = 0; i < Layer<T>::out_size; ++i)
         {
+            const T* w = weights + i * kernel_size * in_size;
             h[i] = bias[i];
             for(int k = 0; k < kernel_size; ++k)
                 h[i] = std::inner_product(
-                    weights[i][k],
-                    weights[i][k] + Layer<T>::in_size,
-                    state_cols[k],
+                    w + k * in_size,
+                    w + (k + 1) * in_size,
+                    newest - k * dilation_rate * in_size,
                     h[i]);
         }
 
         state_ptr = (state_ptr == state_size - 1 ? 0 : state_ptr + 1); // iterate state pointer forwards
     }
 
+    /**
+     * Performs forward propagation for a block of samples.
+     *
+     * The input contains num_samples frames of in_size values, and the
+     * output receives num_samples frames of out_size values. The dilated
+     * taps of the block are gathered into an im2col matrix, so that the
+     * inner loops run over many samples at once. The results are
+     * bit-identical to calling forward() once per frame.
+     */
+    void forwardBlock(const T* input, T* h, int num_samples) noexcept;
+
     /**
      * Sets the layer weights.
      *
@@ -100,29 +117,48 @@ public:
     /** Returns the size of the convolution kernel. */
     int getKernelSize() const noexcept { return kernel_size; }
 
+    /** Returns the weight for output channel i, input channel k, and kernel tap j (as in setWeights()). */
+    T getWeight(int i, int k, int j) const noexcept { return weights[(i * kernel_size + j) * Layer<T>::in_size + k]; }
+
+    /** Returns the bias value at the given index. */
+    T getBias(int i) const noexcept { return bias[i]; }
+
     /** Returns the convolution dilation rate. */
     int getDilationRate() const noexcept { return dilation_rate; }
 
+    /** Returns the number of values this layer allocates from an arena. */
+    size_t getArenaSize() const noexcept override { return memory.getSize(); }
+
+    /** Moves the weights and state of this layer into the arena. */
+    void moveToArena(Arena<T>& arena) override;
+
 private:
+    /** forwardBlock() works through the block in chunks of this many samples. */
+    static constexpr int block_chunk_size = 64;
+
+    static size_t getMemorySize(int in_size, int out_size, int kernel_size, int state_size) noexcept;
+    void assignMemory() noexcept;
+
     const int dilation_rate;
     const int kernel_size;
     const int state_size;
 
-    T*** weights;
-    T* bias;
+    LayerMemory<T> memory;
 
-    T** state;
-    T** state_cols;
+    T* weights; // [out_size][kernel_size][in_size]
+    T* bias;
 
-    int* state_ptrs;
+    /**
+     * Mirrored circular buffer of 2 * state_size inputs. Every input is
+     * written at state_ptr and state_ptr + state_size, so the most recent
+     * state_size inputs can always be read without wrapping around.
+     */
+    T* state; // [2 * state_size][in_size]
     int state_ptr = 0;
 
-    /** Sets pointers to state array columns. */
-    inline void setStatePointers()
-    {
-        for(int k = 0; k < kernel_size; ++k)
-            state_ptrs[k] = (state_ptr + state_size - k * dilation_rate) % state_size;
-    }
+    /** im2col matrix [(in_size * kernel_size) x block_chunk_size], with the samples for each tap stored contiguously. */
+    T* block_cols;
+    T* block_outs;
 };
 
 //====================================================
@@ -162,23 +198,23 @@ public:
     /** Resets the layer state. */
     void reset();
 
+    /** Returns the number of values in a snapshot of the layer state. */
+    static constexpr int getStateSize() noexcept { return state_size * in_size + 1; }
+
+    /** Copies the layer state into a buffer of getStateSize() values. */
+    void getState(T* stateOut) const noexcept;
+
+    /** Restores the layer state from a buffer written by getState(). */
+    void setState(const T* stateIn) noexcept;
+
     /** Performs forward propagation for this layer. */
     inline void forward(const T (&ins)[in_size]) noexcept
     {
-        // insert input into a circular buffer
+        // insert input into a mirrored circular buffer
         std::copy(std::begin(ins), std::end(ins), state[state_ptr].begin());
+        std::copy(std::begin(ins), std::end(ins), state[state_ptr + state_size].begin());
 
-        // set state pointers to particular columns of the buffer
-        setStatePointers();
-
-        // copy selected columns to a helper variable
-        for(int k = 0; k < kernel_size; ++k)
-        {
-            const auto& col = state[state_ptrs[k]];
-            std::copy(col.begin(), col.end(), state_cols[k].begin());
-        }
-
-        // perform multi-channel convolution
+        // perform multi-channel convolution, reading the dilated taps in place
         for(int i = 0; i < out_size; ++i)
         {
             outs[i] = bias[i];
@@ -186,7 +222,7 @@ public:
                 outs[i] = std::inner_product(
                     weights[i][k].begin(),
                     weights[i][k].end(),
-                    state_cols[k].begin(),
+                    state[state_ptr + state_size - k * dilation_rate].begin(),
                     outs[i]);
         }
 
@@ -219,30 +255,21 @@ private:
     template <int DS = dynamic_state>
     typename std::enable_if<DS, void>::type resize_state()
     {
-        state.resize(state_size, {});
+        state.resize(2 * state_size, {});
     }
 
     template <int DS = dynamic_state>
     typename std::enable_if<!DS, void>::type resize_state() { }
 
-    using state_type = typename std::conditional<dynamic_state, std::vector<std::array<T, in_size>>, std::array<std::array<T, in_size>, state_size>>::type;
+    using state_type = typename std::conditional<dynamic_state, std::vector<std::array<T, in_size>>, std::array<std::array<T, in_size>, 2 * state_size>>::type;
     using weights_type = std::array<std::array<T, in_size>, kernel_size>;
 
+    /** Mirrored circular buffer: every input is written at state_ptr and state_ptr + state_size. */
     alignas(RTNEURAL_DEFAULT_ALIGNMENT) state_type state;
-    alignas(RTNEURAL_DEFAULT_ALIGNMENT) weights_type state_cols;
-
     int state_ptr = 0;
-    std::array<int, kernel_size> state_ptrs;
 
     alignas(RTNEURAL_DEFAULT_ALIGNMENT) weights_type weights[out_size];
     alignas(RTNEURAL_DEFAULT_ALIGNMENT) std::array<T, out_size> bias;
-
-    /** Sets pointers to state array columns. */
-    inline void setStatePointers()
-    {
-        for(int k = 0; k < kernel_size; ++k)
-            state_ptrs[k] = (state_ptr + state_size - k * dilation_rate) % state_size;
-    }
 };
 } // namespace RTNeural
 #endif
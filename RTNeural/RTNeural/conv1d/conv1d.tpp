@@ -11,29 +11,39 @@ Conv1D<T>::Conv1D(int in_size, int out_size, int kernel_size, int dilation)
     , dilation_rate(dilation)
     , kernel_size(kernel_size)
     , state_size((kernel_size - 1) * dilation + 1)
+    , memory(getMemorySize(in_size, out_size, kernel_size, state_size))
 {
-    weights = new T**[out_size];
-    for(int i = 0; i < out_size; ++i)
-    {
-        weights[i] = new T*[kernel_size];
-        for(int k = 0; k < kernel_size; ++k)
-        {
-            weights[i][k] = new T[in_size];
-            std::fill(weights[i][k], weights[i][k] + in_size, (T)0);
-        }
-    }
-
-    bias = new T[out_size];
+    assignMemory();
+}
 
-    state = new T*[state_size];
-    for(int k = 0; k < state_size; ++k)
-        state[k] = new T[in_size];
+template <typename T>
+size_t Conv1D<T>::getMemorySize(int in_size, int out_size, int kernel_size, int state_size) noexcept
+{
+    return Arena<T>::alignedSize((size_t)(out_size * kernel_size * in_size))
+        + Arena<T>::alignedSize((size_t)out_size)
+        + Arena<T>::alignedSize((size_t)(2 * state_size * in_size))
+        + Arena<T>::alignedSize((size_t)(in_size * kernel_size * block_chunk_size))
+        + Arena<T>::alignedSize((size_t)block_chunk_size);
+}
 
-    state_cols = new T*[kernel_size];
-    for(int k = 0; k < kernel_size; ++k)
-        state_cols[k] = new T[in_size];
+template <typename T>
+void Conv1D<T>::assignMemory() noexcept
+{
+    const auto in_size = Layer<T>::in_size;
+    const auto out_size = Layer<T>::out_size;
+
+    weights = memory.data();
+    bias = weights + Arena<T>::alignedSize((size_t)(out_size * kernel_size * in_size));
+    state = bias + Arena<T>::alignedSize((size_t)out_size);
+    block_cols = state + Arena<T>::alignedSize((size_t)(2 * state_size * in_size));
+    block_outs = block_cols + Arena<T>::alignedSize((size_t)(in_size * kernel_size * block_chunk_size));
+}
 
-    state_ptrs = new int[kernel_size];
+template <typename T>
+void Conv1D<T>::moveToArena(Arena<T>& arena)
+{
+    memory.moveTo(arena);
+    assignMemory();
 }
 
 template <typename T>
@@ -58,43 +68,81 @@ Conv1D<T>& Conv1D<T>::operator=(const Conv1D<T>& other)
 }
 
 template <typename T>
-Conv1D<T>::~Conv1D()
+void Conv1D<T>::reset()
 {
-    for(int i = 0; i < Layer<T>::out_size; ++i)
-    {
-        for(int k = 0; k < kernel_size; ++k)
-            delete[] weights[i][k];
-
-        delete[] weights[i];
-    }
-
-    delete[] weights;
-    delete[] bias;
-
-    for(int k = 0; k < state_size; ++k)
-        delete[] state[k];
-    delete[] state;
+    std::fill(state, state + 2 * state_size * Layer<T>::in_size, (T)0);
+    state_ptr = 0;
+}
 
-    for(int k = 0; k < kernel_size; ++k)
-        delete[] state_cols[k];
-    delete[] state_cols;
+template <typename T>
+void Conv1D<T>::getState(T* stateOut) const noexcept
+{
+    // the second half of the circular buffer mirrors the first half
+    std::copy(state, state + state_size * Layer<T>::in_size, stateOut);
+    stateOut[state_size * Layer<T>::in_size] = (T)state_ptr;
+}
 
-    delete[] state_ptrs;
+template <typename T>
+void Conv1D<T>::setState(const T* stateIn) noexcept
+{
+    const auto num_values = state_size * Layer<T>::in_size;
+    std::copy(stateIn, stateIn + num_values, state);
+    std::copy(stateIn, stateIn + num_values, state + num_values);
+    state_ptr = (int)stateIn[num_values];
 }
 
 template <typename T>
-void Conv1D<T>::reset()
+void Conv1D<T>::forwardBlock(const T* input, T* h, int num_samples) noexcept
 {
-    for(int k = 0; k < state_size; ++k)
-        std::fill(state[k], state[k] + Layer<T>::in_size, (T)0);
+    const auto in_size = Layer<T>::in_size;
+    const auto out_size = Layer<T>::out_size;
 
-    for(int k = 0; k < kernel_size; ++k)
-        std::fill(state_cols[k], state_cols[k] + Layer<T>::in_size, (T)0);
+    for(int n0 = 0; n0 < num_samples; n0 += block_chunk_size)
+    {
+        const auto n_chunk = std::min(num_samples - n0, (int)block_chunk_size);
 
-    for(int k = 0; k < kernel_size; ++k)
-        state_ptrs[k] = 0;
+        // gather the taps of every sample into an im2col matrix, newest tap first.
+        // Taps from before the start of the block come from the state buffer.
+        for(int k = 0; k < kernel_size; ++k)
+        {
+            T* tap_rows = block_cols + k * in_size * block_chunk_size;
+            for(int n = 0; n < n_chunk; ++n)
+            {
+                const auto m = n0 + n - k * dilation_rate;
+                const T* x = m >= 0 ? input + m * in_size : state + (state_ptr + state_size + m) * in_size;
+                for(int c = 0; c < in_size; ++c)
+                    tap_rows[c * block_chunk_size + n] = x[c];
+            }
+        }
 
-    state_ptr = 0;
+        // accumulate the taps in the same order as forward(), over all samples at once
+        T* outs = block_outs;
+        for(int i = 0; i < out_size; ++i)
+        {
+            std::fill(outs, outs + n_chunk, bias[i]);
+            for(int k = 0; k < kernel_size; ++k)
+            {
+                for(int c = 0; c < in_size; ++c)
+                {
+                    const auto w = weights[(i * kernel_size + k) * in_size + c];
+                    const T* row = block_cols + (k * in_size + c) * block_chunk_size;
+                    for(int n = 0; n < n_chunk; ++n)
+                        outs[n] = outs[n] + w * row[n];
+                }
+            }
+
+            for(int n = 0; n < n_chunk; ++n)
+                h[(n0 + n) * out_size + i] = outs[n];
+        }
+    }
+
+    // push the most recent inputs into the state buffer
+    for(int n = std::max(0, num_samples - state_size); n < num_samples; ++n)
+    {
+        std::copy(input + n * in_size, input + (n + 1) * in_size, state + state_ptr * in_size);
+        std::copy(input + n * in_size, input + (n + 1) * in_size, state + (state_ptr + state_size) * in_size);
+        state_ptr = (state_ptr == state_size - 1 ? 0 : state_ptr + 1);
+    }
 }
 
 template <typename T>
@@ -103,7 +151,7 @@ void Conv1D<T>::setWeights(const std::vector<std::vector<std::vector<T>>>& ws)
     for(int i = 0; i < Layer<T>::out_size; ++i)
         for(int k = 0; k < Layer<T>::in_size; ++k)
             for(int j = 0; j < kernel_size; ++j)
-                weights[i][j][k] = ws[i][k][j];
+                weights[(i * kernel_size + j) * Layer<T>::in_size + k] = ws[i][k][j];
 }
 
 template <typename T>
@@ -135,17 +183,31 @@ Conv1DT<T, in_sizet, out_sizet, kernel_size, dilation_rate, dynamic_state>::Conv
 template <typename T, int in_sizet, int out_sizet, int kernel_size, int dilation_rate, bool dynamic_state>
 void Conv1DT<T, in_sizet, out_sizet, kernel_size, dilation_rate, dynamic_state>::reset()
 {
-    for(int i = 0; i < state_size; ++i)
+    for(int i = 0; i < 2 * state_size; ++i)
         for(int k = 0; k < in_size; ++k)
             state[i][k] = (T)0.0;
 
-    for(int i = 0; i < kernel_size; ++i)
-        for(int k = 0; k < in_size; ++k)
-            state_cols[i][k] = (T)0.0;
-
     state_ptr = 0;
-    for(int i = 0; i < kernel_size; ++i)
-        state_ptrs[i] = 0;
+}
+
+template <typename T, int in_sizet, int out_sizet, int kernel_size, int dilation_rate, bool dynamic_state>
+void Conv1DT<T, in_sizet, out_sizet, kernel_size, dilation_rate, dynamic_state>::getState(T* stateOut) const noexcept
+{
+    // the second half of the circular buffer mirrors the first half
+    for(int i = 0; i < state_size; ++i)
+        std::copy(state[i].begin(), state[i].end(), stateOut + i * in_size);
+    stateOut[state_size * in_size] = (T)state_ptr;
+}
+
+template <typename T, int in_sizet, int out_sizet, int kernel_size, int dilation_rate, bool dynamic_state>
+void Conv1DT<T, in_sizet, out_sizet, kernel_size, dilation_rate, dynamic_state>::setState(const T* stateIn) noexcept
+{
+    for(int i = 0; i < state_size; ++i)
+    {
+        std::copy(stateIn + i * in_size, stateIn + (i + 1) * in_size, state[i].begin());
+        std::copy(stateIn + i * in_size, stateIn + (i + 1) * in_size, state[i + state_size].begin());
+    }
+    state_ptr = (int)stateIn[state_size * in_size];
 }
 
 template <typename T, int in_sizet, int out_sizet, int kernel_size, int dilation_rate, bool dynamic_state>
@@ -23,6 +23,15 @@ public:
     /** Resets the layer state. */
     void reset() override;
 
+    /** Returns the number of values in a snapshot of the layer state. */
+    int getStateSize() const noexcept override { return state_size * Layer<T>::in_size + 1; }
+
+    /** Copies the layer state into a buffer of getStateSize() values. */
+    void getState(T* stateOut) const noexcept override;
+
+    /** Restores the layer state from a buffer written by getState(). */
+    void setState(const T* stateIn) noexcept override;
+
     /** Returns the name of this layer. */
     std::string getName() const noexcept override { return "conv1d"; }
 
@@ -41,6 +50,19 @@ public:
         state_ptr = (state_ptr == 0 ? state_size - 1 : state_ptr - 1); // iterate state pointer in reverse
     }
 
+    /**
+     * Performs forward propagation for a block of samples.
+     *
+     * The input contains num_samples frames of in_size values, and the
+     * output receives num_samples frames of out_size values. This backend
+     * processes the block one frame at a time.
+     */
+    void forwardBlock(const T* input, T* h, int num_samples) noexcept
+    {
+        for(int n = 0; n < num_samples; ++n)
+            forward(input + n * Layer<T>::in_size, h + n * Layer<T>::out_size);
+    }
+
     /** Sets the layer weights. */
     void setWeights(const std::vector<std::vector<std::vector<T>>>& weights);
 
@@ -50,6 +72,12 @@ public:
     /** Returns the size of the convolution kernel. */
     int getKernelSize() const noexcept { return kernel_size; }
 
+    /** Returns the weight for output channel i, input channel k, and kernel tap j (as in setWeights()). */
+    T getWeight(int i, int k, int j) const noexcept { return kernelWeights[i][k][j * dilation_rate]; }
+
+    /** Returns the bias value at the given index. */
+    T getBias(int i) const noexcept { return bias[i]; }
+
     /** Returns the convolution dilation rate. */
     int getDilationRate() const noexcept { return dilation_rate; }
 
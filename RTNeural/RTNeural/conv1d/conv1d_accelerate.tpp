@@ -73,6 +73,26 @@ void Conv1D<T>::reset()
         std::fill(state[k], &state[k][2 * state_size], (T)0);
 }
 
+template <typename T>
+void Conv1D<T>::getState(T* stateOut) const noexcept
+{
+    // the second half of each circular buffer mirrors the first half
+    for(int k = 0; k < Layer<T>::in_size; ++k)
+        std::copy(state[k], state[k] + state_size, stateOut + k * state_size);
+    stateOut[state_size * Layer<T>::in_size] = (T)state_ptr;
+}
+
+template <typename T>
+void Conv1D<T>::setState(const T* stateIn) noexcept
+{
+    for(int k = 0; k < Layer<T>::in_size; ++k)
+    {
+        std::copy(stateIn + k * state_size, stateIn + (k + 1) * state_size, state[k]);
+        std::copy(stateIn + k * state_size, stateIn + (k + 1) * state_size, state[k] + state_size);
+    }
+    state_ptr = (int)stateIn[state_size * Layer<T>::in_size];
+}
+
 template <typename T>
 void Conv1D<T>::setWeights(const std::vector<std::vector<std::vector<T>>>& weights)
 {
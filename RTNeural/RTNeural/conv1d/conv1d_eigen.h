@@ -38,30 +38,45 @@ public:
     /** Resets the layer state. */
     void reset() override;
 
+    /** Returns the number of values in a snapshot of the layer state. */
+    int getStateSize() const noexcept override { return state_size * Layer<T>::in_size + 1; }
+
+    /** Copies the layer state into a buffer of getStateSize() values. */
+    void getState(T* stateOut) const noexcept override;
+
+    /** Restores the layer state from a buffer written by getState(). */
+    void setState(const T* stateIn) noexcept override;
+
     /** Returns the name of this layer. */
     std::string getName() const noexcept override { return "conv1d"; }
 
     /** Performs forward propagation for this layer. */
     inline void forward(const T* input, T* h) noexcept override
     {
-        // insert input into a circular buffer
-        state.col(state_ptr) = Eigen::Map<const Eigen::Vector<T, Eigen::Dynamic>,
+        // insert input into a mirrored circular buffer
+        const auto inVec = Eigen::Map<const Eigen::Vector<T, Eigen::Dynamic>,
             RTNeuralEigenAlignment>(input, Layer<T>::in_size);
+        state.col(state_ptr) = inVec;
+        state.col(state_ptr + state_size) = inVec;
 
-        // set state pointers to the particular columns of the buffer
-        setStatePointers();
-
-        // copy selected columns to a helper variable
-        for(int k = 0; k < kernel_size; ++k)
-            state_cols.col(k) = state.col(state_ptrs(k));
-
-        // perform a multichannel convolution
-        for(int i = 0; i < Layer<T>::out_size; ++i)
-            h[i] = state_cols.cwiseProduct(kernelWeights[i]).sum() + bias(i);
+        // perform a multichannel convolution, reading the dilated taps in place
+        convolve<1>(state.data() + (state_ptr + 1) * Layer<T>::in_size, dilation_rate * Layer<T>::in_size, 0, h);
 
         state_ptr = (state_ptr == state_size - 1 ? 0 : state_ptr + 1); // iterate state pointer forwards
     }
 
+    /**
+     * Performs forward propagation for a block of samples.
+     *
+     * The input contains num_samples frames of in_size values, and the
+     * output receives num_samples frames of out_size values. For layers
+     * with few outputs, the dilated taps of the block are gathered into an
+     * im2col matrix, which is then multiplied by the weights several samples
+     * at a time. The results are bit-identical to calling forward() once
+     * per frame.
+     */
+    void forwardBlock(const T* input, T* h, int num_samples) noexcept;
+
     /**
      * Sets the layer weights.
      *
@@ -79,6 +94,12 @@ public:
     /** Returns the size of the convolution kernel. */
     int getKernelSize() const noexcept { return kernel_size; }
 
+    /** Returns the weight for output channel i, input channel k, and kernel tap j (as in setWeights()). */
+    T getWeight(int i, int k, int j) const noexcept { return kernelWeights(i, (kernel_size - 1 - j) * Layer<T>::in_size + k); }
+
+    /** Returns the bias value at the given index. */
+    T getBias(int i) const noexcept { return bias(i); }
+
     /** Returns the convolution dilation rate. */
     int getDilationRate() const noexcept { return dilation_rate; }
 
@@ -87,19 +108,87 @@ private:
     const int kernel_size;
     const int state_size;
 
-    std::vector<Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>> kernelWeights;
+    /**
+     * Weights matrix of size [out_size x (in_size * kernel_size)], with one
+     * block of in_size columns per kernel tap, starting from the oldest tap.
+     */
+    Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic> kernelWeights;
     Eigen::Vector<T, Eigen::Dynamic> bias;
 
+    /**
+     * Mirrored circular buffer of 2 * state_size inputs. Every input is
+     * written at state_ptr and state_ptr + state_size, so the most recent
+     * state_size inputs can always be read without wrapping around.
+     */
     Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic> state;
-    Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic> state_cols;
-    Eigen::VectorXi state_ptrs;
     int state_ptr = 0;
 
-    /** Sets pointers to state array columns. */
-    inline void setStatePointers()
+    /** forwardBlock() works through the block in chunks of this many samples. */
+    static constexpr int block_chunk_size = 64;
+
+    /** im2col matrix of size [(in_size * kernel_size) x block_chunk_size], one column of taps per sample. */
+    Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic> block_cols;
+
+    /**
+     * With few outputs, computing one sample at a time leaves most of the
+     * accumulator registers unused, so forwardBlock() computes several samples
+     * at once from the im2col matrix. Wider layers already keep the SIMD units
+     * busy, and are processed frame by frame.
+     */
+    bool usesIm2col() const noexcept { return Layer<T>::out_size * (int)sizeof(T) <= 64; }
+
+    /**
+     * Computes the outputs for num_cols samples. Tap (k, c) of sample s
+     * is read from x[k * tap_stride + c + s * sample_stride], with taps
+     * ordered from the oldest.
+     */
+    template <int num_cols>
+    inline void convolve(const T* x, int tap_stride, int sample_stride, T* h) const noexcept
+    {
+        // keep roughly 8 SIMD registers of accumulators busy
+        constexpr int max_tile_rows = 128 / (num_cols * (int)sizeof(T));
+        convolveRows<max_tile_rows, num_cols>(0, x, tap_stride, sample_stride, h);
+    }
+
+    /** Covers the outputs from i0 with tiles of the given size, then with smaller tiles. */
+    template <int rows, int num_cols>
+    inline void convolveRows(int i0, const T* x, int tap_stride, int sample_stride, T* h) const noexcept
     {
+        for(; i0 + rows <= Layer<T>::out_size; i0 += rows)
+            convolveTile<rows, num_cols>(i0, x, tap_stride, sample_stride, h);
+
+        constexpr int min_vector_rows = 16 / (int)sizeof(T);
+        constexpr int next_rows = rows / 2 >= min_vector_rows ? rows / 2 : 1;
+        if(rows > 1 && i0 < Layer<T>::out_size)
+            convolveRows<next_rows, num_cols>(i0, x, tap_stride, sample_stride, h);
+    }
+
+    /**
+     * Computes a [rows x num_cols] tile of outputs, starting at output i0.
+     * Every output is accumulated in the same order regardless of the tile
+     * size, so forward() and forwardBlock() give bit-identical results.
+     */
+    template <int rows, int num_cols>
+    inline void convolveTile(int i0, const T* x, int tap_stride, int sample_stride, T* h) const noexcept
+    {
+        using column_type = Eigen::Matrix<T, rows, 1>;
+        column_type acc[num_cols];
+        for(int s = 0; s < num_cols; ++s)
+            acc[s] = bias.template segment<rows>(i0);
+
         for(int k = 0; k < kernel_size; ++k)
-            state_ptrs[k] = (state_ptr + state_size - k * dilation_rate) % state_size;
+        {
+            const T* x_k = x + k * tap_stride;
+            for(int c = 0; c < Layer<T>::in_size; ++c)
+            {
+                const column_type w = kernelWeights.col(k * Layer<T>::in_size + c).template segment<rows>(i0);
+                for(int s = 0; s < num_cols; ++s)
+                    acc[s] += w * x_k[c + s * sample_stride];
+            }
+        }
+
+        for(int s = 0; s < num_cols; ++s)
+            Eigen::Map<column_type>(h + i0 + s * Layer<T>::out_size) = acc[s];
     }
 };
 
@@ -126,9 +215,8 @@ class Conv1DT
     using vec_type = Eigen::Vector<T, out_sizet>;
 
     static constexpr auto state_size = (kernel_size - 1) * dilation_rate + 1;
-    using state_type = Eigen::Matrix<T, in_sizet, dynamic_state ? Eigen::Dynamic : state_size>;
-    using weights_type = Eigen::Matrix<T, in_sizet, kernel_size>;
-    using state_ptrs_type = Eigen::Vector<int, kernel_size>;
+    using state_type = Eigen::Matrix<T, in_sizet, dynamic_state ? Eigen::Dynamic : 2 * state_size>;
+    using weights_type = Eigen::Matrix<T, out_sizet, in_sizet>;
 
 public:
     static constexpr auto in_size = in_sizet;
@@ -147,22 +235,26 @@ public:
     /** Resets the layer state. */
     void reset();
 
+    /** Returns the number of values in a snapshot of the layer state. */
+    static constexpr int getStateSize() noexcept { return state_size * in_size + 1; }
+
+    /** Copies the layer state into a buffer of getStateSize() values. */
+    void getState(T* stateOut) const noexcept;
+
+    /** Restores the layer state from a buffer written by getState(). */
+    void setState(const T* stateIn) noexcept;
+
     /** Performs forward propagation for this layer. */
     inline void forward(const Eigen::Matrix<T, in_size, 1>& ins) noexcept
     {
-        // insert input into a circular buffer
+        // insert input into a mirrored circular buffer
         state.col(state_ptr) = ins;
+        state.col(state_ptr + state_size) = ins;
 
-        // set state pointers to particular columns of the buffer
-        setStatePointers();
-
-        // copy selected columns to a helper variable
+        // perform a multichannel convolution, reading the dilated taps in place
+        outs = bias;
         for(int k = 0; k < kernel_length; ++k)
-            state_cols.col(k) = state.col(state_ptrs(k));
-
-        // perform a multichannel convolution
-        for(int i = 0; i < out_size; ++i)
-            outs(i) = state_cols.cwiseProduct(weights[i]).sum() + bias(i);
+            outs.noalias() += weights[k] * state.col(state_ptr + state_size - k * dilation_rate);
 
         state_ptr = (state_ptr == state_size - 1 ? 0 : state_ptr + 1); // iterate state pointer forwards
     }
@@ -192,26 +284,18 @@ public:
 private:
     void resize_state()
     {
-        state.resize(in_sizet, state_size);
+        state.resize(in_sizet, 2 * state_size);
     }
 
     T outs_internal alignas(RTNEURAL_DEFAULT_ALIGNMENT)[out_size];
 
+    /** Mirrored circular buffer: every input is written at state_ptr and state_ptr + state_size. */
     state_type state;
-    weights_type state_cols;
-
     int state_ptr = 0;
-    state_ptrs_type state_ptrs;
 
-    weights_type weights[out_size];
+    /** One [out_size x in_size] weights matrix per kernel tap. */
+    weights_type weights[kernel_size];
     vec_type bias;
-
-    /** Sets pointers to state array columns. */
-    inline void setStatePointers()
-    {
-        for(int k = 0; k < kernel_size; ++k)
-            state_ptrs[k] = (state_ptr + state_size - k * dilation_rate) % state_size;
-    }
 };
 
 } // RTNeural
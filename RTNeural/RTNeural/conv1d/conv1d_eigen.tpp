@@ -10,14 +10,13 @@ Conv1D<T>::Conv1D(int in_size, int out_size, int kernel_size, int dilation)
     , kernel_size(kernel_size)
     , state_size((kernel_size - 1) * dilation + 1)
 {
-    kernelWeights.resize(out_size);
-    for(int i = 0; i < out_size; ++i)
-        kernelWeights[i] = Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>::Zero(in_size, kernel_size);
+    kernelWeights = Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>::Zero(out_size, in_size * kernel_size);
 
     bias = Eigen::Vector<T, Eigen::Dynamic>::Zero(out_size);
-    state = Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>::Zero(in_size, state_size);
-    state_cols = Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>::Zero(in_size, kernel_size);
-    state_ptrs = Eigen::Vector<int, Eigen::Dynamic>::Zero(kernel_size);
+    state = Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>::Zero(in_size, 2 * state_size);
+
+    if(usesIm2col())
+        block_cols = Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>::Zero(in_size * kernel_size, block_chunk_size);
 }
 
 template <typename T>
@@ -45,18 +44,88 @@ template <typename T>
 void Conv1D<T>::reset()
 {
     state_ptr = 0;
-    state_ptrs.setZero();
-    state_cols.setZero();
     state.setZero();
 }
 
+template <typename T>
+void Conv1D<T>::getState(T* stateOut) const noexcept
+{
+    // the second half of the circular buffer mirrors the first half
+    const auto num_values = state_size * Layer<T>::in_size;
+    std::copy(state.data(), state.data() + num_values, stateOut);
+    stateOut[num_values] = (T)state_ptr;
+}
+
+template <typename T>
+void Conv1D<T>::setState(const T* stateIn) noexcept
+{
+    const auto num_values = state_size * Layer<T>::in_size;
+    std::copy(stateIn, stateIn + num_values, state.data());
+    std::copy(stateIn, stateIn + num_values, state.data() + num_values);
+    state_ptr = (int)stateIn[num_values];
+}
+
+template <typename T>
+void Conv1D<T>::forwardBlock(const T* input, T* h, int num_samples) noexcept
+{
+    using MatrixType = Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>;
+    const auto in_size = Layer<T>::in_size;
+    const auto out_size = Layer<T>::out_size;
+    const auto depth = in_size * kernel_size;
+    constexpr int tile_cols = 4;
+
+    if(!usesIm2col())
+    {
+        for(int n = 0; n < num_samples; ++n)
+            forward(input + n * in_size, h + n * out_size);
+        return;
+    }
+
+    for(int n0 = 0; n0 < num_samples; n0 += block_chunk_size)
+    {
+        const auto n_chunk = std::min(num_samples - n0, (int)block_chunk_size);
+
+        // gather the taps of every sample into an im2col matrix, oldest tap first.
+        // Taps from before the start of the block come from the state buffer.
+        for(int k = 0; k < kernel_size; ++k)
+        {
+            const auto delay = (kernel_size - 1 - k) * dilation_rate;
+            const auto n_past = std::max(0, std::min(n_chunk, delay - n0));
+            auto tap_rows = block_cols.block(k * in_size, 0, in_size, n_chunk);
+
+            if(n_past > 0)
+                tap_rows.leftCols(n_past) = state.middleCols(state_ptr + state_size + n0 - delay, n_past);
+
+            if(n_past < n_chunk)
+                tap_rows.rightCols(n_chunk - n_past) = Eigen::Map<const MatrixType>(
+                    input + (n0 + n_past - delay) * in_size, in_size, n_chunk - n_past);
+        }
+
+        int s = 0;
+        for(; s + tile_cols <= n_chunk; s += tile_cols)
+            convolve<tile_cols>(block_cols.col(s).data(), in_size, depth, h + (n0 + s) * out_size);
+
+        for(; s < n_chunk; ++s)
+            convolve<1>(block_cols.col(s).data(), in_size, depth, h + (n0 + s) * out_size);
+    }
+
+    // push the most recent inputs into the state buffer
+    for(int n = std::max(0, num_samples - state_size); n < num_samples; ++n)
+    {
+        const auto inVec = Eigen::Map<const Eigen::Vector<T, Eigen::Dynamic>>(input + n * in_size, in_size);
+        state.col(state_ptr) = inVec;
+        state.col(state_ptr + state_size) = inVec;
+        state_ptr = (state_ptr == state_size - 1 ? 0 : state_ptr + 1);
+    }
+}
+
 template <typename T>
 void Conv1D<T>::setWeights(const std::vector<std::vector<std::vector<T>>>& weights)
 {
     for(int i = 0; i < Layer<T>::out_size; ++i)
         for(int k = 0; k < Layer<T>::in_size; ++k)
             for(int j = 0; j < kernel_size; ++j)
-                kernelWeights[i](k, j) = weights[i][k][j];
+                kernelWeights(i, (kernel_size - 1 - j) * Layer<T>::in_size + k) = weights[i][k][j];
 }
 
 template <typename T>
@@ -71,7 +140,7 @@ template <typename T, int in_sizet, int out_sizet, int kernel_size, int dilation
 Conv1DT<T, in_sizet, out_sizet, kernel_size, dilation_rate, dynamic_state>::Conv1DT()
     : outs(outs_internal)
 {
-    for(int k = 0; k < out_size; ++k)
+    for(int k = 0; k < kernel_size; ++k)
         weights[k] = weights_type::Zero();
 
     bias = vec_type::Zero();
@@ -84,18 +153,32 @@ template <typename T, int in_sizet, int out_sizet, int kernel_size, int dilation
 void Conv1DT<T, in_sizet, out_sizet, kernel_size, dilation_rate, dynamic_state>::reset()
 {
     state.setZero();
-    state_cols = weights_type::Zero();
-    state_ptrs = state_ptrs_type::Zero();
     state_ptr = 0;
 }
 
+template <typename T, int in_sizet, int out_sizet, int kernel_size, int dilation_rate, bool dynamic_state>
+void Conv1DT<T, in_sizet, out_sizet, kernel_size, dilation_rate, dynamic_state>::getState(T* stateOut) const noexcept
+{
+    // the second half of the circular buffer mirrors the first half
+    std::copy(state.data(), state.data() + state_size * in_size, stateOut);
+    stateOut[state_size * in_size] = (T)state_ptr;
+}
+
+template <typename T, int in_sizet, int out_sizet, int kernel_size, int dilation_rate, bool dynamic_state>
+void Conv1DT<T, in_sizet, out_sizet, kernel_size, dilation_rate, dynamic_state>::setState(const T* stateIn) noexcept
+{
+    std::copy(stateIn, stateIn + state_size * in_size, state.data());
+    std::copy(stateIn, stateIn + state_size * in_size, state.data() + state_size * in_size);
+    state_ptr = (int)stateIn[state_size * in_size];
+}
+
 template <typename T, int in_sizet, int out_sizet, int kernel_size, int dilation_rate, bool dynamic_state>
 void Conv1DT<T, in_sizet, out_sizet, kernel_size, dilation_rate, dynamic_state>::setWeights(const std::vector<std::vector<std::vector<T>>>& ws)
 {
     for(int i = 0; i < out_size; ++i)
         for(int k = 0; k < in_size; ++k)
             for(int j = 0; j < kernel_size; ++j)
-                weights[i](k, j) = ws[i][k][j];
+                weights[j](i, k) = ws[i][k][j];
 }
 
 template <typename T, int in_sizet, int out_sizet, int kernel_size, int dilation_rate, bool dynamic_state>
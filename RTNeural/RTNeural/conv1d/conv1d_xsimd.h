@@ -40,36 +40,49 @@ public:
     /** Resets the layer state. */
     void reset() override;
 
+    /** Returns the number of values in a snapshot of the layer state. */
+    int getStateSize() const noexcept override { return state_size * Layer<T>::in_size + 1; }
+
+    /** Copies the layer state into a buffer of getStateSize() values. */
+    void getState(T* stateOut) const noexcept override;
+
+    /** Restores the layer state from a buffer written by getState(). */
+    void setState(const T* stateIn) noexcept override;
+
     /** Returns the name of this layer. */
     std::string getName() const noexcept override { return "conv1d"; }
 
     /** Performs forward propagation for this layer. */
     inline void forward(const T* input, T* h) noexcept override
     {
-        // insert input into a circular buffer
+        // insert input into a mirrored circular buffer
         vCopy(input, state[state_ptr].data(), Layer<T>::in_size);
+        vCopy(input, state[state_ptr + state_size].data(), Layer<T>::in_size);
 
-        // set state pointers to particular columns of the buffer
-        setStatePointers();
-
-        // copy selected columns to a helper variable
-        for(int k = 0; k < kernel_size; ++k)
-        {
-            const auto& col = state[state_ptrs[k]];
-            vCopy(col.data(), state_cols[k].data(), Layer<T>::in_size);
-        }
-
-        // perform multi-channel convolution
+        // perform multi-channel convolution, reading the dilated taps in place
         vCopy(bias.data(), h, Layer<T>::out_size);
         for(int i = 0; i < Layer<T>::out_size; ++i)
         {
             for(int k = 0; k < kernel_size; ++k)
-                h[i] += vMult(weights[i][k].data(), state_cols[k].data(), prod_state.data(), Layer<T>::in_size);
+                h[i] += vMult(weights[i][k].data(), state[state_ptr + state_size - k * dilation_rate].data(), prod_state.data(), Layer<T>::in_size);
         }
 
         state_ptr = (state_ptr == state_size - 1 ? 0 : state_ptr + 1); // iterate state pointer forwards
     }
 
+    /**
+     * Performs forward propagation for a block of samples.
+     *
+     * The input contains num_samples frames of in_size values, and the
+     * output receives num_samples frames of out_size values. This backend
+     * processes the block one frame at a time.
+     */
+    void forwardBlock(const T* input, T* h, int num_samples) noexcept
+    {
+        for(int n = 0; n < num_samples; ++n)
+            forward(input + n * Layer<T>::in_size, h + n * Layer<T>::out_size);
+    }
+
     /**
      * Sets the layer weights.
      *
@@ -87,6 +100,12 @@ public:
     /** Returns the size of the convolution kernel. */
     int getKernelSize() const noexcept { return kernel_size; }
 
+    /** Returns the weight for output channel i, input channel k, and kernel tap j (as in setWeights()). */
+    T getWeight(int i, int k, int j) const noexcept { return weights[i][j][k]; }
+
+    /** Returns the bias value at the given index. */
+    T getBias(int i) const noexcept { return bias[i]; }
+
     /** Returns the convolution dilation rate. */
     int getDilationRate() const noexcept { return dilation_rate; }
 
@@ -102,20 +121,15 @@ private:
     vec3_type weights;
     vec_type bias;
 
+    /**
+     * Mirrored circular buffer of 2 * state_size inputs. Every input is
+     * written at state_ptr and state_ptr + state_size, so the most recent
+     * state_size inputs can always be read without wrapping around.
+     */
     vec2_type state;
-    vec2_type state_cols;
-
     int state_ptr = 0;
-    std::vector<int> state_ptrs;
 
     vec_type prod_state;
-
-    /** Sets pointers to state array columns. */
-    inline void setStatePointers()
-    {
-        for(int k = 0; k < kernel_size; ++k)
-            state_ptrs[k] = (state_ptr + state_size - k * dilation_rate) % state_size;
-    }
 };
 
 //====================================================
@@ -159,62 +173,25 @@ public:
     /** Resets the layer state. */
     void reset();
 
-    /** Performs forward propagation for this layer. */
-    template <int DR = dilation_rate>
-    inline typename std::enable_if<(DR > 1), void>::type
-    forward(const v_type (&ins)[v_in_size]) noexcept
-    {
-        // insert input into a circular buffer
-        std::copy(std::begin(ins), std::end(ins), state[state_ptr].begin());
+    /** Returns the number of values in a snapshot of the layer state. */
+    static constexpr int getStateSize() noexcept { return state_size * v_in_size * v_size + 1; }
 
-        // set state pointers to particular columns of the buffer
-        setStatePointers();
+    /** Copies the layer state into a buffer of getStateSize() values. */
+    void getState(T* stateOut) const noexcept;
 
-        // copy selected columns to a helper variable
-        for(int k = 0; k < kernel_size; ++k)
-        {
-            const auto& col = state[state_ptrs[k]];
-            std::copy(col.begin(), col.end(), state_cols[k].begin());
-        }
-
-        // perform multi-channel convolution
-        for(int i = 0; i < v_out_size; ++i)
-        {
-            alignas(RTNEURAL_DEFAULT_ALIGNMENT) T out_sum[v_size] {};
-            for(int k = 0; k < v_size && (i * v_size + k) < out_size; ++k)
-            {
-                assert(i * v_size + k < out_size);
-                const auto& subWeights = weights[i * v_size + k];
-                v_type accum {};
-                for(int j = 0; j < kernel_size; ++j)
-                {
-                    accum += std::inner_product(
-                        subWeights[j].begin(),
-                        subWeights[j].end(),
-                        state_cols[j].begin(),
-                        v_type {});
-                }
-                out_sum[k] = xsimd::reduce_add(accum);
-            }
-
-            outs[i] = xsimd::load_aligned(out_sum) + bias[i];
-        }
-
-        state_ptr = (state_ptr == state_size - 1 ? 0 : state_ptr + 1); // iterate state pointer forwards
-    }
+    /** Restores the layer state from a buffer written by getState(). */
+    void setState(const T* stateIn) noexcept;
 
     /** Performs forward propagation for this layer. */
     template <int DR = dilation_rate, int KS = kernel_size>
-    inline typename std::enable_if<(DR == 1 && KS > 1), void>::type
+    inline typename std::enable_if<!(DR == 1 && KS == 1), void>::type
     forward(const v_type (&ins)[v_in_size]) noexcept
     {
-        // insert input into a circular buffer
+        // insert input into a mirrored circular buffer
         std::copy(std::begin(ins), std::end(ins), state[state_ptr].begin());
+        std::copy(std::begin(ins), std::end(ins), state[state_ptr + state_size].begin());
 
-        // set state pointers to particular columns of the buffer
-        setStatePointers();
-
-        // perform multi-channel convolution
+        // perform multi-channel convolution, reading the dilated taps in place
         for(int i = 0; i < v_out_size; ++i)
         {
             alignas(RTNEURAL_DEFAULT_ALIGNMENT) T out_sum[v_size] {};
@@ -227,7 +204,7 @@ public:
                     accum += std::inner_product(
                         subWeights[j].begin(),
                         subWeights[j].end(),
-                        state[(state_ptr + state_size - j) % state_size].begin(),
+                        state[state_ptr + state_size - j * dilation_rate].begin(),
                         v_type {});
                 }
                 out_sum[k] = xsimd::reduce_add(accum);
@@ -287,31 +264,22 @@ private:
     template <int DS = dynamic_state>
     typename std::enable_if<DS, void>::type resize_state()
     {
-        state.resize(state_size, {});
+        state.resize(2 * state_size, {});
     }
 
     template <int DS = dynamic_state>
     typename std::enable_if<!DS, void>::type resize_state() { }
 
     using state_col_type = std::array<v_type, v_in_size>;
-    using state_type = typename std::conditional<dynamic_state, std::vector<state_col_type, xsimd::aligned_allocator<state_col_type>>, std::array<state_col_type, state_size>>::type;
+    using state_type = typename std::conditional<dynamic_state, std::vector<state_col_type, xsimd::aligned_allocator<state_col_type>>, std::array<state_col_type, 2 * state_size>>::type;
     using weights_type = std::array<std::array<v_type, v_in_size>, kernel_size>;
 
+    /** Mirrored circular buffer: every input is written at state_ptr and state_ptr + state_size. */
     state_type state {};
-    weights_type state_cols {};
-
     int state_ptr = 0;
-    std::array<int, kernel_size> state_ptrs {};
 
     weights_type weights[out_size] {};
     v_type bias[v_out_size] {};
-
-    /** Sets pointers to state array columns. */
-    inline void setStatePointers()
-    {
-        for(int k = 0; k < kernel_size; ++k)
-            state_ptrs[k] = (state_ptr + state_size - k * dilation_rate) % state_size;
-    }
 };
 } // namespace RTNeural
 
@@ -12,9 +12,7 @@ Conv1D<T>::Conv1D(int in_size, int out_size, int kernel_size, int dilation)
 {
     weights = vec3_type(out_size, vec2_type(kernel_size, vec_type(in_size, (T)0)));
     bias.resize(out_size, (T)0);
-    state = vec2_type(state_size, vec_type(in_size, (T)0));
-    state_cols = vec2_type(kernel_size, vec_type(in_size, (T)0));
-    state_ptrs.resize(kernel_size);
+    state = vec2_type(2 * state_size, vec_type(in_size, (T)0));
     prod_state.resize(in_size);
 }
 
@@ -42,16 +40,32 @@ Conv1D<T>::~Conv1D() = default;
 template <typename T>
 void Conv1D<T>::reset()
 {
-    for(int k = 0; k < state_size; ++k)
+    for(int k = 0; k < 2 * state_size; ++k)
         std::fill(state[k].begin(), state[k].end(), (T)0);
 
-    for(int k = 0; k < kernel_size; ++k)
-        std::fill(state_cols[k].begin(), state_cols[k].end(), (T)0);
-
-    std::fill(state_ptrs.begin(), state_ptrs.end(), 0);
     state_ptr = 0;
 }
 
+template <typename T>
+void Conv1D<T>::getState(T* stateOut) const noexcept
+{
+    // the second half of the circular buffer mirrors the first half
+    for(int k = 0; k < state_size; ++k)
+        std::copy(state[k].begin(), state[k].end(), stateOut + k * Layer<T>::in_size);
+    stateOut[state_size * Layer<T>::in_size] = (T)state_ptr;
+}
+
+template <typename T>
+void Conv1D<T>::setState(const T* stateIn) noexcept
+{
+    for(int k = 0; k < state_size; ++k)
+    {
+        std::copy(stateIn + k * Layer<T>::in_size, stateIn + (k + 1) * Layer<T>::in_size, state[k].begin());
+        std::copy(stateIn + k * Layer<T>::in_size, stateIn + (k + 1) * Layer<T>::in_size, state[k + state_size].begin());
+    }
+    state_ptr = (int)stateIn[state_size * Layer<T>::in_size];
+}
+
 template <typename T>
 void Conv1D<T>::setWeights(const std::vector<std::vector<std::vector<T>>>& ws)
 {
@@ -90,17 +104,35 @@ Conv1DT<T, in_sizet, out_sizet, kernel_size, dilation_rate, dynamic_state>::Conv
 template <typename T, int in_sizet, int out_sizet, int kernel_size, int dilation_rate, bool dynamic_state>
 void Conv1DT<T, in_sizet, out_sizet, kernel_size, dilation_rate, dynamic_state>::reset()
 {
-    for(int i = 0; i < state_size; ++i)
+    for(int i = 0; i < 2 * state_size; ++i)
         for(int k = 0; k < v_in_size; ++k)
             state[i][k] = v_type((T)0.0);
 
-    for(int i = 0; i < kernel_size; ++i)
+    state_ptr = 0;
+}
+
+template <typename T, int in_sizet, int out_sizet, int kernel_size, int dilation_rate, bool dynamic_state>
+void Conv1DT<T, in_sizet, out_sizet, kernel_size, dilation_rate, dynamic_state>::getState(T* stateOut) const noexcept
+{
+    // the second half of the circular buffer mirrors the first half
+    for(int i = 0; i < state_size; ++i)
         for(int k = 0; k < v_in_size; ++k)
-            state_cols[i][k] = v_type((T)0.0);
+            state[i][k].store_unaligned(stateOut + (i * v_in_size + k) * v_size);
+    stateOut[state_size * v_in_size * v_size] = (T)state_ptr;
+}
 
-    state_ptr = 0;
-    for(int i = 0; i < kernel_size; ++i)
-        state_ptrs[i] = 0;
+template <typename T, int in_sizet, int out_sizet, int kernel_size, int dilation_rate, bool dynamic_state>
+void Conv1DT<T, in_sizet, out_sizet, kernel_size, dilation_rate, dynamic_state>::setState(const T* stateIn) noexcept
+{
+    for(int i = 0; i < state_size; ++i)
+    {
+        for(int k = 0; k < v_in_size; ++k)
+        {
+            state[i][k] = xsimd::load_unaligned(stateIn + (i * v_in_size + k) * v_size);
+            state[i + state_size][k] = state[i][k];
+        }
+    }
+    state_ptr = (int)stateIn[state_size * v_in_size * v_size];
 }
 
 template <typename T, int in_sizet, int out_sizet, int kernel_size, int dilation_rate, bool dynamic_state>
@@ -0,0 +1,149 @@
+#ifndef CONV1D_FFT_H_INCLUDED
+#define CONV1D_FFT_H_INCLUDED
+
+#include "../Layer.h"
+#include "../common.h"
+#include "fft.h"
+#include <numeric>
+#include <vector>
+
+namespace RTNeural
+{
+
+/**
+ * Dynamic implementation of a 1-dimensional convolution layer
+ * with no activation, for long convolution kernels.
+ *
+ * The kernel is split into partitions of `partition_size` samples.
+ * The first partition (the taps with a delay shorter than the
+ * partition size) is computed directly for every sample, and the
+ * remaining partitions use uniformly partitioned overlap-save FFT
+ * convolution, so the layer adds no latency. The outputs match
+ * `Conv1D` up to floating-point rounding.
+ *
+ * The FFT work is done on the last sample of every block of
+ * `partition_size` samples. To ensure that the state is initialized
+ * to zero, please make sure to call `reset()` before your first call
+ * to the `forward()` method.
+ */
+template <typename T>
+class FFTConv1D final : public Layer<T>
+{
+public:
+    /**
+     * Constructs a convolution layer for the given dimensions.
+     *
+     * @param in_size: the input size for the layer
+     * @param out_size: the output size for the layer
+     * @param kernel_size: the size of the convolution kernel
+     * @param dilation: the dilation rate to use for dilated convolution
+     * @param partition_size: the FFT partition size (rounded up to a power of 2), or 0 to choose one from the kernel span
+     */
+    FFTConv1D(int in_size, int out_size, int kernel_size, int dilation, int partition_size = 0);
+
+    /** Resets the layer state. */
+    void reset() override;
+
+    /** Returns the number of values in a snapshot of the layer state. */
+    int getStateSize() const noexcept override { return (int)(fdl_re.size() + fdl_im.size() + input_buffer.size() + tail_outputs.size()) + 2; }
+
+    /** Copies the layer state into a buffer of getStateSize() values. */
+    void getState(T* stateOut) const noexcept override;
+
+    /** Restores the layer state from a buffer written by getState(). */
+    void setState(const T* stateIn) noexcept override;
+
+    /** Returns the name of this layer. */
+    std::string getName() const noexcept override { return "conv1d_fft"; }
+
+    /** Performs forward propagation for this layer. */
+    inline void forward(const T* input, T* h) noexcept override
+    {
+        // the input buffer holds the previous and current blocks, one frame per sample
+        T* frame = input_buffer.data() + (partition_size + block_pos) * Layer<T>::in_size;
+        std::copy(input, input + Layer<T>::in_size, frame);
+
+        for(int i = 0; i < Layer<T>::out_size; ++i)
+        {
+            h[i] = bias[i] + tail_outputs[i * partition_size + block_pos];
+
+            // head partition: direct convolution
+            const T* w = head_weights.data() + i * head_taps * Layer<T>::in_size;
+            for(int k = 0; k < head_taps; ++k)
+                h[i] = std::inner_product(
+                    w + k * Layer<T>::in_size,
+                    w + (k + 1) * Layer<T>::in_size,
+                    frame - k * dilation_rate * Layer<T>::in_size,
+                    h[i]);
+        }
+
+        if(++block_pos == partition_size)
+        {
+            processBlock();
+            block_pos = 0;
+        }
+    }
+
+    /**
+     * Sets the layer weights.
+     *
+     * The weights vector must have size weights[out_size][in_size][kernel_size]
+     */
+    void setWeights(const std::vector<std::vector<std::vector<T>>>& weights);
+
+    /**
+     * Sets the layer biases.
+     *
+     * The bias vector must have size bias[out_size]
+     */
+    void setBias(const std::vector<T>& biasVals);
+
+    /** Returns the size of the convolution kernel. */
+    int getKernelSize() const noexcept { return kernel_size; }
+
+    /** Returns the convolution dilation rate. */
+    int getDilationRate() const noexcept { return dilation_rate; }
+
+    /** Returns the FFT partition size. */
+    int getPartitionSize() const noexcept { return partition_size; }
+
+    /** Returns the number of FFT partitions after the directly computed head partition. */
+    int getNumFFTPartitions() const noexcept { return num_partitions; }
+
+    /** Chooses a partition size for a kernel, balancing the direct head against the FFT work. */
+    static int choosePartitionSize(int kernel_size, int dilation) noexcept;
+
+private:
+    /** Computes the FFT partitions of the next block, once a block of input is complete. */
+    void processBlock() noexcept;
+
+    const int dilation_rate;
+    const int kernel_size;
+    const int partition_size;
+    const int num_partitions;
+    const int head_taps;
+
+    fft_detail::RealFFT<T> fft;
+    const int num_bins;
+
+    std::vector<T> head_weights; // [out_size][head_taps][in_size]
+    std::vector<T> bias;
+
+    /** Kernel partition spectra: [out_size][in_size][num_partitions][num_bins]. */
+    std::vector<T> kernel_re, kernel_im;
+
+    /** Frequency-domain delay line of input spectra: [in_size][num_partitions][num_bins]. */
+    std::vector<T> fdl_re, fdl_im;
+    int fdl_pos = 0;
+
+    std::vector<T> accum_re, accum_im;
+    std::vector<T> time_buffer; // 2 * partition_size
+
+    std::vector<T> input_buffer; // [2 * partition_size][in_size]
+    std::vector<T> tail_outputs; // [out_size][partition_size]
+    int block_pos = 0;
+};
+
+} // namespace RTNeural
+
+#endif // CONV1D_FFT_H_INCLUDED
@@ -0,0 +1,199 @@
+#include "conv1d_fft.h"
+
+namespace RTNeural
+{
+
+namespace fft_detail
+{
+    static inline int nextPowerOf2(int x) noexcept
+    {
+        int p = 1;
+        while(p < x)
+            p <<= 1;
+        return p;
+    }
+
+    static inline int numFFTPartitions(int kernel_size, int dilation, int partition_size) noexcept
+    {
+        const auto span = (kernel_size - 1) * dilation + 1;
+        return span > partition_size ? (span - 1) / partition_size : 0;
+    }
+
+    static inline int numHeadTaps(int kernel_size, int dilation, int partition_size) noexcept
+    {
+        return std::min(kernel_size, (partition_size - 1) / dilation + 1);
+    }
+} // namespace fft_detail
+
+template <typename T>
+int FFTConv1D<T>::choosePartitionSize(int kernel_size, int dilation) noexcept
+{
+    // the head costs partition_size / dilation taps per sample, the FFT
+    // partitions cost roughly log2(partition_size) + span / partition_size
+    const auto span = (kernel_size - 1) * dilation + 1;
+    const auto target = std::max((int)std::sqrt((double)span), 8 * dilation);
+    return std::max(16, fft_detail::nextPowerOf2(target));
+}
+
+template <typename T>
+FFTConv1D<T>::FFTConv1D(int in_size, int out_size, int kernel_size, int dilation, int partition_size_in)
+    : Layer<T>(in_size, out_size)
+    , dilation_rate(dilation)
+    , kernel_size(kernel_size)
+    , partition_size(partition_size_in > 0 ? fft_detail::nextPowerOf2(std::max(partition_size_in, 2))
+                                           : choosePartitionSize(kernel_size, dilation))
+    , num_partitions(fft_detail::numFFTPartitions(kernel_size, dilation, partition_size))
+    , head_taps(fft_detail::numHeadTaps(kernel_size, dilation, partition_size))
+    , fft(2 * partition_size)
+    , num_bins(fft.getNumBins())
+{
+    head_weights.resize((size_t)(out_size * head_taps * in_size), (T)0);
+    bias.resize((size_t)out_size, (T)0);
+
+    const auto spectra_size = (size_t)(num_partitions * num_bins);
+    kernel_re.resize((size_t)(out_size * in_size) * spectra_size, (T)0);
+    kernel_im.resize((size_t)(out_size * in_size) * spectra_size, (T)0);
+    fdl_re.resize((size_t)in_size * spectra_size, (T)0);
+    fdl_im.resize((size_t)in_size * spectra_size, (T)0);
+
+    accum_re.resize((size_t)num_bins, (T)0);
+    accum_im.resize((size_t)num_bins, (T)0);
+    time_buffer.resize((size_t)(2 * partition_size), (T)0);
+
+    input_buffer.resize((size_t)(2 * partition_size * in_size), (T)0);
+    tail_outputs.resize((size_t)(out_size * partition_size), (T)0);
+}
+
+template <typename T>
+void FFTConv1D<T>::reset()
+{
+    std::fill(fdl_re.begin(), fdl_re.end(), (T)0);
+    std::fill(fdl_im.begin(), fdl_im.end(), (T)0);
+    std::fill(input_buffer.begin(), input_buffer.end(), (T)0);
+    std::fill(tail_outputs.begin(), tail_outputs.end(), (T)0);
+    fdl_pos = 0;
+    block_pos = 0;
+}
+
+template <typename T>
+void FFTConv1D<T>::getState(T* stateOut) const noexcept
+{
+    for(const auto* buffer : { &fdl_re, &fdl_im, &input_buffer, &tail_outputs })
+        stateOut = std::copy(buffer->begin(), buffer->end(), stateOut);
+
+    stateOut[0] = (T)fdl_pos;
+    stateOut[1] = (T)block_pos;
+}
+
+template <typename T>
+void FFTConv1D<T>::setState(const T* stateIn) noexcept
+{
+    for(auto* buffer : { &fdl_re, &fdl_im, &input_buffer, &tail_outputs })
+    {
+        std::copy(stateIn, stateIn + buffer->size(), buffer->begin());
+        stateIn += buffer->size();
+    }
+
+    fdl_pos = (int)stateIn[0];
+    block_pos = (int)stateIn[1];
+}
+
+template <typename T>
+void FFTConv1D<T>::setWeights(const std::vector<std::vector<std::vector<T>>>& ws)
+{
+    const auto in_size = Layer<T>::in_size;
+
+    for(int i = 0; i < Layer<T>::out_size; ++i)
+    {
+        for(int k = 0; k < head_taps; ++k)
+            for(int j = 0; j < in_size; ++j)
+                head_weights[(size_t)((i * head_taps + k) * in_size + j)] = ws[i][j][k];
+
+        for(int j = 0; j < in_size; ++j)
+        {
+            // partition p holds the taps with delays in [(p + 1) * partition_size, (p + 2) * partition_size)
+            for(int p = 0; p < num_partitions; ++p)
+            {
+                std::fill(time_buffer.begin(), time_buffer.end(), (T)0);
+                for(int k = head_taps; k < kernel_size; ++k)
+                {
+                    const auto delay = k * dilation_rate - (p + 1) * partition_size;
+                    if(delay >= 0 && delay < partition_size)
+                        time_buffer[(size_t)delay] = ws[i][j][k];
+                }
+
+                const auto offset = (size_t)(((i * in_size + j) * num_partitions + p) * num_bins);
+                fft.forward(time_buffer.data(), kernel_re.data() + offset, kernel_im.data() + offset);
+            }
+        }
+    }
+}
+
+template <typename T>
+void FFTConv1D<T>::setBias(const std::vector<T>& biasVals)
+{
+    for(int i = 0; i < Layer<T>::out_size; ++i)
+        bias[(size_t)i] = biasVals[(size_t)i];
+}
+
+template <typename T>
+void FFTConv1D<T>::processBlock() noexcept
+{
+    const auto in_size = Layer<T>::in_size;
+    const auto spectra_size = num_partitions * num_bins;
+
+    if(num_partitions > 0)
+    {
+        // the newest input spectrum goes one slot behind the previous one
+        fdl_pos = (fdl_pos == 0 ? num_partitions - 1 : fdl_pos - 1);
+
+        for(int j = 0; j < in_size; ++j)
+        {
+            for(int n = 0; n < 2 * partition_size; ++n)
+                time_buffer[(size_t)n] = input_buffer[(size_t)(n * in_size + j)];
+
+            const auto offset = (size_t)(j * spectra_size + fdl_pos * num_bins);
+            fft.forward(time_buffer.data(), fdl_re.data() + offset, fdl_im.data() + offset);
+        }
+
+        for(int i = 0; i < Layer<T>::out_size; ++i)
+        {
+            std::fill(accum_re.begin(), accum_re.end(), (T)0);
+            std::fill(accum_im.begin(), accum_im.end(), (T)0);
+
+            for(int j = 0; j < in_size; ++j)
+            {
+                const T* k_re = kernel_re.data() + (i * in_size + j) * spectra_size;
+                const T* k_im = kernel_im.data() + (i * in_size + j) * spectra_size;
+                const T* x_re = fdl_re.data() + j * spectra_size;
+                const T* x_im = fdl_im.data() + j * spectra_size;
+
+                // partition p is applied to the input spectrum from p blocks ago
+                for(int p = 0; p < num_partitions; ++p)
+                {
+                    const auto slot = fdl_pos + p < num_partitions ? fdl_pos + p : fdl_pos + p - num_partitions;
+                    const T* hr = k_re + p * num_bins;
+                    const T* hi = k_im + p * num_bins;
+                    const T* xr = x_re + slot * num_bins;
+                    const T* xi = x_im + slot * num_bins;
+
+                    for(int b = 0; b < num_bins; ++b)
+                    {
+                        accum_re[(size_t)b] += hr[b] * xr[b] - hi[b] * xi[b];
+                        accum_im[(size_t)b] += hr[b] * xi[b] + hi[b] * xr[b];
+                    }
+                }
+            }
+
+            // overlap-save: the last partition_size samples are valid
+            fft.inverse(accum_re.data(), accum_im.data(), time_buffer.data());
+            std::copy(time_buffer.begin() + partition_size, time_buffer.end(),
+                tail_outputs.begin() + i * partition_size);
+        }
+    }
+
+    // the current block becomes the previous block
+    std::copy(input_buffer.begin() + partition_size * in_size, input_buffer.end(), input_buffer.begin());
+}
+
+} // namespace RTNeural
@@ -0,0 +1,181 @@
+#ifndef RTNEURAL_FFT_H_INCLUDED
+#define RTNEURAL_FFT_H_INCLUDED
+
+#include <cmath>
+#include <utility>
+#include <vector>
+
+namespace RTNeural
+{
+namespace fft_detail
+{
+    /**
+     * Radix-2 FFT for real signals with a power-of-two size (at least 4).
+     *
+     * The signal is packed into a complex FFT of half the size. The
+     * spectrum has size / 2 + 1 bins, stored as separate arrays of
+     * real and imaginary parts.
+     */
+    template <typename T>
+    class RealFFT
+    {
+    public:
+        explicit RealFFT(int fft_size)
+            : size(fft_size)
+            , half(fft_size / 2)
+            , bit_reverse((size_t)half)
+            , twiddle_re((size_t)half / 2)
+            , twiddle_im((size_t)half / 2)
+            , split_re((size_t)half + 1)
+            , split_im((size_t)half + 1)
+            , buffer_re((size_t)half)
+            , buffer_im((size_t)half)
+        {
+            int num_bits = 0;
+            while((1 << num_bits) < half)
+                num_bits++;
+
+            for(int i = 0; i < half; ++i)
+            {
+                int reversed = 0;
+                for(int b = 0; b < num_bits; ++b)
+                    reversed |= ((i >> b) & 1) << (num_bits - 1 - b);
+                bit_reverse[(size_t)i] = reversed;
+            }
+
+            const auto pi = std::acos(-1.0);
+            for(int k = 0; k < half / 2; ++k)
+            {
+                twiddle_re[(size_t)k] = (T)std::cos(2.0 * pi * k / half);
+                twiddle_im[(size_t)k] = (T)-std::sin(2.0 * pi * k / half);
+            }
+
+            for(int k = 0; k <= half; ++k)
+            {
+                split_re[(size_t)k] = (T)std::cos(2.0 * pi * k / size);
+                split_im[(size_t)k] = (T)-std::sin(2.0 * pi * k / size);
+            }
+        }
+
+        int getSize() const noexcept { return size; }
+        int getNumBins() const noexcept { return half + 1; }
+
+        /** Computes the spectrum of `size` real samples. */
+        void forward(const T* input, T* re, T* im) noexcept
+        {
+            for(int k = 0; k < half; ++k)
+            {
+                buffer_re[(size_t)k] = input[2 * k];
+                buffer_im[(size_t)k] = input[2 * k + 1];
+            }
+
+            complexFFT(false);
+
+            // separate the spectra of the even and odd samples, and combine them
+            for(int k = 0; k <= half; ++k)
+            {
+                const auto k1 = k == half ? 0 : k;
+                const auto k2 = k == 0 ? 0 : half - k;
+                const auto z_re = buffer_re[(size_t)k1];
+                const auto z_im = buffer_im[(size_t)k1];
+                const auto zc_re = buffer_re[(size_t)k2];
+                const auto zc_im = -buffer_im[(size_t)k2];
+
+                const auto even_re = (T)0.5 * (z_re + zc_re);
+                const auto even_im = (T)0.5 * (z_im + zc_im);
+                const auto odd_re = (T)0.5 * (z_im - zc_im);
+                const auto odd_im = (T)-0.5 * (z_re - zc_re);
+
+                const auto w_re = split_re[(size_t)k];
+                const auto w_im = split_im[(size_t)k];
+                re[k] = even_re + w_re * odd_re - w_im * odd_im;
+                im[k] = even_im + w_re * odd_im + w_im * odd_re;
+            }
+        }
+
+        /** Computes `size` real samples from a spectrum, including the 1 / size scaling. */
+        void inverse(const T* re, const T* im, T* output) noexcept
+        {
+            for(int k = 0; k < half; ++k)
+            {
+                const auto xc_re = re[half - k];
+                const auto xc_im = -im[half - k];
+
+                const auto even_re = (T)0.5 * (re[k] + xc_re);
+                const auto even_im = (T)0.5 * (im[k] + xc_im);
+                const auto diff_re = (T)0.5 * (re[k] - xc_re);
+                const auto diff_im = (T)0.5 * (im[k] - xc_im);
+
+                // multiply by the conjugate twiddle factor
+                const auto w_re = split_re[(size_t)k];
+                const auto w_im = -split_im[(size_t)k];
+                const auto odd_re = diff_re * w_re - diff_im * w_im;
+                const auto odd_im = diff_re * w_im + diff_im * w_re;
+
+                buffer_re[(size_t)k] = even_re - odd_im;
+                buffer_im[(size_t)k] = even_im + odd_re;
+            }
+
+            complexFFT(true);
+
+            const auto scale = (T)1 / (T)half;
+            for(int k = 0; k < half; ++k)
+            {
+                output[2 * k] = buffer_re[(size_t)k] * scale;
+                output[2 * k + 1] = buffer_im[(size_t)k] * scale;
+            }
+        }
+
+    private:
+        /** In-place iterative complex FFT (unscaled) of the internal buffer. */
+        void complexFFT(bool is_inverse) noexcept
+        {
+            for(int i = 0; i < half; ++i)
+            {
+                const auto j = bit_reverse[(size_t)i];
+                if(i < j)
+                {
+                    std::swap(buffer_re[(size_t)i], buffer_re[(size_t)j]);
+                    std::swap(buffer_im[(size_t)i], buffer_im[(size_t)j]);
+                }
+            }
+
+            auto* x_re = buffer_re.data();
+            auto* x_im = buffer_im.data();
+            const T sign = is_inverse ? (T)-1 : (T)1;
+            for(int len = 2; len <= half; len <<= 1)
+            {
+                const int step = half / len;
+                const int len2 = len / 2;
+                for(int i = 0; i < half; i += len)
+                {
+                    for(int k = 0; k < len2; ++k)
+                    {
+                        const auto w_re = twiddle_re[(size_t)(k * step)];
+                        const auto w_im = sign * twiddle_im[(size_t)(k * step)];
+                        const auto a = i + k;
+                        const auto b = a + len2;
+
+                        const auto t_re = w_re * x_re[b] - w_im * x_im[b];
+                        const auto t_im = w_re * x_im[b] + w_im * x_re[b];
+                        x_re[b] = x_re[a] - t_re;
+                        x_im[b] = x_im[a] - t_im;
+                        x_re[a] += t_re;
+                        x_im[a] += t_im;
+                    }
+                }
+            }
+        }
+
+        const int size;
+        const int half;
+
+        std::vector<int> bit_reverse;
+        std::vector<T> twiddle_re, twiddle_im; // for the half-size complex FFT
+        std::vector<T> split_re, split_im; // for separating the even/odd spectra
+        std::vector<T> buffer_re, buffer_im;
+    };
+} // namespace fft_detail
+} // namespace RTNeural
+
+#endif // RTNEURAL_FFT_H_INCLUDED
@@ -44,6 +44,25 @@ public:
         }
     };
 
+    /** Returns the number of values in a snapshot of the layer state. */
+    int getStateSize() const noexcept override { return receptive_field * Layer<T>::out_size + 1; }
+
+    /** Copies the layer state into a buffer of getStateSize() values. */
+    void getState(T* stateOut) const noexcept override
+    {
+        for(int i = 0; i < receptive_field; ++i)
+            std::copy(state[i].data(), state[i].data() + Layer<T>::out_size, stateOut + i * Layer<T>::out_size);
+        stateOut[receptive_field * Layer<T>::out_size] = (T)state_index;
+    }
+
+    /** Restores the layer state from a buffer written by getState(). */
+    void setState(const T* stateIn) noexcept override
+    {
+        for(int i = 0; i < receptive_field; ++i)
+            std::copy(stateIn + i * Layer<T>::out_size, stateIn + (i + 1) * Layer<T>::out_size, state[i].data());
+        state_index = (int)stateIn[receptive_field * Layer<T>::out_size];
+    }
+
     /** Returns the name of this layer. */
     std::string getName() const noexcept override { return "conv2d"; }
 
@@ -178,6 +197,25 @@ public:
         }
     };
 
+    /** Returns the number of values in a snapshot of the layer state. */
+    static constexpr int getStateSize() noexcept { return receptive_field * out_size + 1; }
+
+    /** Copies the layer state into a buffer of getStateSize() values. */
+    void getState(T* stateOut) const noexcept
+    {
+        for(int i = 0; i < receptive_field; ++i)
+            std::copy(state[i].data(), state[i].data() + out_size, stateOut + i * out_size);
+        stateOut[receptive_field * out_size] = (T)state_index;
+    }
+
+    /** Restores the layer state from a buffer written by getState(). */
+    void setState(const T* stateIn) noexcept
+    {
+        for(int i = 0; i < receptive_field; ++i)
+            std::copy(stateIn + i * out_size, stateIn + (i + 1) * out_size, state[i].data());
+        state_index = (int)stateIn[receptive_field * out_size];
+    }
+
     /** Performs forward propagation for this layer. */
     inline void forward(const input_type_flat& inMatrix) noexcept
     {
@@ -13,52 +13,17 @@
 #include "dense_accelerate.h"
 #else
 #include "../Layer.h"
+#include "../block_sparse.h"
 
 namespace RTNeural
 {
 
-#ifndef DOXYGEN
-/** Single-output dense layer used internally */
-template <typename T>
-class Dense1
-{
-public:
-    explicit Dense1(int in_size)
-        : in_size(in_size)
-    {
-        weights = new T[in_size];
-    }
-
-    ~Dense1() { delete[] weights; }
-
-    inline T forward(const T* input) noexcept
-    {
-        return std::inner_product(weights, weights + in_size, input, (T)0) + bias;
-    }
-
-    void setWeights(const T* newWeights)
-    {
-        for(int i = 0; i < in_size; ++i)
-            weights[i] = newWeights[i];
-    }
-
-    void setBias(T b) { bias = b; }
-
-    T getWeight(int i) const noexcept { return weights[i]; }
-
-    T getBias() const noexcept { return bias; }
-
-private:
-    const int in_size;
-    T bias;
-
-    T* weights;
-};
-#endif // DOXYGEN
-
 /**
  * Dynamic implementation of a fully-connected (dense) layer,
  * with no activation.
+ *
+ * The weights and bias are stored row-major in a single
+ * contiguous block of memory.
  */
 template <typename T>
 class Dense final : public Layer<T>
@@ -67,10 +32,9 @@ public:
     /** Constructs a dense layer for a given input and output size. */
     Dense(int in_size, int out_size)
         : Layer<T>(in_size, out_size)
+        , memory(Arena<T>::alignedSize((size_t)(in_size * out_size)) + Arena<T>::alignedSize((size_t)out_size))
     {
-        subLayers = new Dense1<T>*[out_size];
-        for(int i = 0; i < out_size; ++i)
-            subLayers[i] = new Dense1<T>(in_size);
+        assignMemory();
     }
 
     Dense(std::initializer_list<int> sizes)
@@ -88,22 +52,25 @@ public:
         return *this = Dense(other);
     }
 
-    virtual ~Dense()
-    {
-        for(int i = 0; i < Layer<T>::out_size; ++i)
-            delete subLayers[i];
-
-        delete[] subLayers;
-    }
-
     /** Returns the name of this layer. */
     std::string getName() const noexcept override { return "dense"; }
 
     /** Performs forward propagation for this layer. */
     inline void forward(const T* input, T* out) noexcept override
     {
+        if(!sparseWeights.isEmpty())
+        {
+            sparseWeights.multiply(input, out);
+            for(int i = 0; i < Layer<T>::out_size; ++i)
+                out[i] += bias[i];
+            return;
+        }
+
         for(int i = 0; i < Layer<T>::out_size; ++i)
-            out[i] = subLayers[i]->forward(input);
+        {
+            const T* w = weights + i * Layer<T>::in_size;
+            out[i] = std::inner_product(w, w + Layer<T>::in_size, input, (T)0) + bias[i];
+        }
     }
 
     /**
@@ -115,7 +82,9 @@ public:
     void setWeights(const std::vector<std::vector<T>>& newWeights)
     {
         for(int i = 0; i < Layer<T>::out_size; ++i)
-            subLayers[i]->setWeights(newWeights[i].data());
+            std::copy(newWeights[i].begin(), newWeights[i].begin() + Layer<T>::in_size, weights + i * Layer<T>::in_size);
+
+        updateSparseWeights();
     }
 
     /**
@@ -127,7 +96,9 @@ public:
     void setWeights(T** newWeights)
     {
         for(int i = 0; i < Layer<T>::out_size; ++i)
-            subLayers[i]->setWeights(newWeights[i]);
+            std::copy(newWeights[i], newWeights[i] + Layer<T>::in_size, weights + i * Layer<T>::in_size);
+
+        updateSparseWeights();
     }
 
     /**
@@ -136,21 +107,64 @@ public:
      */
     void setBias(const T* b)
     {
-        for(int i = 0; i < Layer<T>::out_size; ++i)
-            subLayers[i]->setBias(b[i]);
+        std::copy(b, b + Layer<T>::out_size, bias);
     }
 
     /** Returns the weights value at the given indices. */
     T getWeight(int i, int k) const noexcept
     {
-        return subLayers[i]->getWeight(k);
+        return weights[i * Layer<T>::in_size + k];
     }
 
     /** Returns the bias value at the given index. */
-    T getBias(int i) const noexcept { return subLayers[i]->getBias(); }
+    T getBias(int i) const noexcept { return bias[i]; }
+
+    /**
+     * Runs this layer with block-sparse weights (see BlockSparseMatrix) when
+     * at most `max_density` of their blocks contain a non-zero weight, and
+     * returns true if it does. The check is repeated whenever the weights
+     * are set. Pass 0 to go back to the dense weights.
+     */
+    bool useSparseWeights(T max_density)
+    {
+        sparse_max_density = max_density;
+        return updateSparseWeights();
+    }
+
+    /** Returns true if this layer is running with block-sparse weights. */
+    bool hasSparseWeights() const noexcept { return !sparseWeights.isEmpty(); }
+
+    /** Returns the number of values this layer allocates from an arena. */
+    size_t getArenaSize() const noexcept override { return memory.getSize(); }
+
+    /** Moves the weights of this layer into the arena. */
+    void moveToArena(Arena<T>& arena) override
+    {
+        memory.moveTo(arena);
+        assignMemory();
+    }
 
 private:
-    Dense1<T>** subLayers;
+    void assignMemory() noexcept
+    {
+        weights = memory.data();
+        bias = weights + Arena<T>::alignedSize((size_t)(Layer<T>::in_size * Layer<T>::out_size));
+    }
+
+    bool updateSparseWeights()
+    {
+        return sparseWeights.setWeights(Layer<T>::out_size, Layer<T>::in_size, sparse_max_density,
+            [this](int i, int k)
+            { return getWeight(i, k); });
+    }
+
+    LayerMemory<T> memory;
+    T* weights; // [out_size][in_size]
+    T* bias; // [out_size]
+
+    // the non-zero blocks of the weights, which live outside of the arena
+    BlockSparseMatrix<T> sparseWeights;
+    T sparse_max_density = (T)0;
 };
 
 //====================================================
@@ -2,6 +2,7 @@
 #define DENSEEIGEN_H_INCLUDED
 
 #include "../Layer.h"
+#include "../block_sparse.h"
 #include <Eigen/Dense>
 
 namespace RTNeural
@@ -49,11 +50,16 @@ public:
     /** Performs forward propagation for this layer. */
     inline void forward(const T* input, T* out) noexcept override
     {
-        inVec = Eigen::Map<const Eigen::Matrix<T, Eigen::Dynamic, 1>, RTNeuralEigenAlignment>(
-            input, Layer<T>::in_size, 1);
-        outVec.noalias() = weights * inVec + bias;
-
-        std::copy(outVec.data(), outVec.data() + Layer<T>::out_size, out);
+        auto inMap = Eigen::Map<const Eigen::Matrix<T, Eigen::Dynamic, 1>>(input, Layer<T>::in_size, 1);
+        auto outMap = Eigen::Map<Eigen::Matrix<T, Eigen::Dynamic, 1>>(out, Layer<T>::out_size, 1);
+        if(!sparseWeights.isEmpty())
+        {
+            sparseWeights.multiply(input, out);
+            outMap += bias;
+            return;
+        }
+
+        outMap.noalias() = weights * inMap + bias;
     }
 
     /**
@@ -67,6 +73,8 @@ public:
         for(int i = 0; i < Layer<T>::out_size; ++i)
             for(int k = 0; k < Layer<T>::in_size; ++k)
                 weights(i, k) = newWeights[i][k];
+
+        updateSparseWeights();
     }
 
     /**
@@ -80,6 +88,8 @@ public:
         for(int i = 0; i < Layer<T>::out_size; ++i)
             for(int k = 0; k < Layer<T>::in_size; ++k)
                 weights(i, k) = newWeights[i][k];
+
+        updateSparseWeights();
     }
 
     /**
@@ -98,12 +108,37 @@ public:
     /** Returns the bias value at the given index. */
     T getBias(int i) const noexcept { return bias(i, 0); }
 
+    /**
+     * Runs this layer with block-sparse weights (see BlockSparseMatrix) when
+     * at most `max_density` of their blocks contain a non-zero weight, and
+     * returns true if it does. The check is repeated whenever the weights
+     * are set. Pass 0 to go back to the dense weights.
+     */
+    bool useSparseWeights(T max_density)
+    {
+        sparse_max_density = max_density;
+        return updateSparseWeights();
+    }
+
+    /** Returns true if this layer is running with block-sparse weights. */
+    bool hasSparseWeights() const noexcept { return !sparseWeights.isEmpty(); }
+
 private:
+    bool updateSparseWeights()
+    {
+        return sparseWeights.setWeights(Layer<T>::out_size, Layer<T>::in_size, sparse_max_density,
+            [this](int i, int k)
+            { return getWeight(i, k); });
+    }
+
     Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic> weights;
     Eigen::Matrix<T, Eigen::Dynamic, 1> bias;
 
     Eigen::Matrix<T, Eigen::Dynamic, 1> inVec;
     Eigen::Matrix<T, Eigen::Dynamic, 1> outVec;
+
+    BlockSparseMatrix<T> sparseWeights;
+    T sparse_max_density = (T)0;
 };
 
 //====================================================
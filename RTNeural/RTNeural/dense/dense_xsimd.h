@@ -2,6 +2,7 @@
 #define DENSEXSIMD_H_INCLUDED
 
 #include "../Layer.h"
+#include "../block_sparse.h"
 #include <xsimd/xsimd.hpp>
 
 namespace RTNeural
@@ -49,6 +50,15 @@ public:
     /** Performs forward propagation for this layer. */
     inline void forward(const T* input, T* out) noexcept override
     {
+        if(!sparseWeights.isEmpty())
+        {
+            sparseWeights.multiply(input, out);
+            xsimd::transform(out, &out[Layer<T>::out_size], bias.data(), out,
+                [](auto const& a, auto const& b)
+                { return a + b; });
+            return;
+        }
+
         for(int l = 0; l < Layer<T>::out_size; ++l)
         {
             xsimd::transform(input, &input[Layer<T>::in_size], weights[l].data(), prod.data(),
@@ -71,6 +81,8 @@ public:
         for(int i = 0; i < Layer<T>::out_size; ++i)
             for(int k = 0; k < Layer<T>::in_size; ++k)
                 weights[i][k] = newWeights[i][k];
+
+        updateSparseWeights();
     }
 
     /**
@@ -84,6 +96,8 @@ public:
         for(int i = 0; i < Layer<T>::out_size; ++i)
             for(int k = 0; k < Layer<T>::in_size; ++k)
                 weights[i][k] = newWeights[i][k];
+
+        updateSparseWeights();
     }
 
     /**
@@ -102,14 +116,41 @@ public:
     /** Returns the bias value at the given index. */
     T getBias(int i) const noexcept { return bias[i]; }
 
+    /**
+     * Runs this layer with block-sparse weights (see BlockSparseMatrix) when
+     * at most `max_density` of their blocks contain a non-zero weight, and
+     * returns true if it does. The check is repeated whenever the weights
+     * are set. Pass 0 to go back to the dense weights.
+     */
+    bool useSparseWeights(T max_density)
+    {
+        sparse_max_density = max_density;
+        return updateSparseWeights();
+    }
+
+    /** Returns true if this layer is running with block-sparse weights. */
+    bool hasSparseWeights() const noexcept { return !sparseWeights.isEmpty(); }
+
 private:
     using vec_type = std::vector<T, xsimd::aligned_allocator<T>>;
     using vec2_type = std::vector<vec_type>;
 
+    bool updateSparseWeights()
+    {
+        return sparseWeights.setWeights(Layer<T>::out_size, Layer<T>::in_size, sparse_max_density,
+            [this](int i, int k)
+            { return getWeight(i, k); });
+    }
+
+
     vec_type bias;
     vec2_type weights;
     vec_type prod;
     vec_type sums;
+
+    // blocks as tall as a SIMD register
+    BlockSparseMatrix<T> sparseWeights { (int)xsimd::simd_type<T>::size };
+    T sparse_max_density = (T)0;
 };
 
 //====================================================
@@ -0,0 +1,245 @@
+#ifndef DILATED_CONV_STACK_H_INCLUDED
+#define DILATED_CONV_STACK_H_INCLUDED
+
+#include "../common.h"
+#include <array>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+namespace RTNeural
+{
+#ifndef DOXYGEN
+namespace dilated_conv_stack_detail
+{
+    constexpr int sum(std::initializer_list<int> values)
+    {
+        int result = 0;
+        for(auto v : values)
+            result += v;
+        return result;
+    }
+
+    /** y += W * x, with W stored as [cols][rows]. */
+    template <typename T, int rows, int cols>
+    inline void matVecAdd(const T* w, const T* x, T* y) noexcept
+    {
+#if RTNEURAL_USE_EIGEN
+        auto outs = Eigen::Map<Eigen::Matrix<T, rows, 1>>(y);
+        outs.noalias() += Eigen::Map<const Eigen::Matrix<T, rows, cols>>(w) * Eigen::Map<const Eigen::Matrix<T, cols, 1>>(x);
+#else
+        for(int c = 0; c < cols; ++c)
+            for(int r = 0; r < rows; ++r)
+                y[r] += w[c * rows + r] * x[c];
+#endif
+    }
+
+    /** z = tanh(gates[:channels]) * sigmoid(gates[channels:]) */
+    template <typename T, int channels>
+    inline void gatedActivation(const T* gates, T* z) noexcept
+    {
+#if RTNEURAL_USE_EIGEN
+        const auto filter = Eigen::Map<const Eigen::Array<T, channels, 1>>(gates);
+        const auto gate = Eigen::Map<const Eigen::Array<T, channels, 1>>(gates + channels);
+        auto outs = Eigen::Map<Eigen::Array<T, channels, 1>>(z);
+        outs = filter.tanh() * ((T)1 / ((T)1 + (-gate).exp()));
+#elif RTNEURAL_USE_XSIMD
+        alignas(RTNEURAL_DEFAULT_ALIGNMENT) T gate[channels];
+        std::copy(gates + channels, gates + 2 * channels, gate);
+        sigmoid(gate, gate, channels);
+        tanh(gates, z, channels);
+        for(int c = 0; c < channels; ++c)
+            z[c] *= gate[c];
+#else
+        for(int c = 0; c < channels; ++c)
+            z[c] = std::tanh(gates[c]) / ((T)1 + std::exp(-gates[channels + c]));
+#endif
+    }
+} // namespace dilated_conv_stack_detail
+#endif
+
+/**
+ * Static implementation of a WaveNet-style stack of gated, dilated
+ * convolution layers, using the "Fast-WaveNet" caching scheme.
+ *
+ * The layer computes:
+ * ```
+ * x = input_conv(input)                         // 1x1 convolution, in_size -> channels
+ * for each layer l with dilation d:
+ *     a = conv_l(x)                             // kernel_size taps, dilation d, channels -> 2 * channels
+ *     z = tanh(a[:channels]) * sigmoid(a[channels:])
+ *     skip += mix_l(z)                          // 1x1 convolution, channels -> out_size
+ *     x = x + residual_l(z)                     // 1x1 convolution, channels -> channels
+ * output = skip + mix_bias
+ * ```
+ * The output mix is a single 1x1 convolution over the concatenated
+ * gated outputs of every layer. This matches the WaveNet model used
+ * by PedalNetRT, see torch_helpers::loadDilatedConvStack().
+ *
+ * Every layer only keeps a queue of the (kernel_size - 1) * dilation
+ * past inputs that its dilated taps read, and the gated activation,
+ * residual and skip sums are computed in the same pass, so the cost
+ * per sample is fixed. To ensure that the state is initialized to
+ * zero, please make sure to call `reset()` before your first call to
+ * the `forward()` method.
+ *
+ * @param in_sizet: the input size for the layer
+ * @param out_sizet: the output size for the layer
+ * @param channels: the number of residual channels
+ * @param kernel_size: the size of the dilated convolution kernels
+ * @param dilations: the dilation rate of each layer in the stack
+ */
+template <typename T, int in_sizet, int out_sizet, int channels, int kernel_size, int... dilations>
+class DilatedConvStackT
+{
+    static constexpr auto num_layers = (int)sizeof...(dilations);
+    static constexpr auto queue_size = (kernel_size - 1) * dilated_conv_stack_detail::sum({ dilations... }) * channels;
+
+#if RTNEURAL_USE_EIGEN
+    using vec_type = Eigen::Matrix<T, out_sizet, 1>;
+#elif RTNEURAL_USE_XSIMD
+    using v_type = xsimd::simd_type<T>;
+    static constexpr auto v_size = (int)v_type::size;
+    static constexpr auto v_in_size = ceil_div(in_sizet, v_size);
+    static constexpr auto v_out_size = ceil_div(out_sizet, v_size);
+#endif
+
+public:
+    static constexpr auto in_size = in_sizet;
+    static constexpr auto out_size = out_sizet;
+
+    static_assert(num_layers > 0, "DilatedConvStackT needs at least one dilated layer!");
+
+    DilatedConvStackT();
+
+    /** Returns the name of this layer. */
+    std::string getName() const noexcept { return "dilated_conv_stack"; }
+
+    /** Returns false since the convolution stack is not an activation layer. */
+    constexpr bool isActivation() const noexcept { return false; }
+
+    /** Resets the layer state. */
+    void reset();
+
+    /** Returns the number of values in a snapshot of the layer state. */
+    static constexpr int getStateSize() noexcept { return queue_size + num_layers; }
+
+    /** Copies the layer state into a buffer of getStateSize() values. */
+    void getState(T* stateOut) const noexcept;
+
+    /** Restores the layer state from a buffer written by getState(). */
+    void setState(const T* stateIn) noexcept;
+
+#if RTNEURAL_USE_EIGEN
+    /** Performs forward propagation for this layer. */
+    inline void forward(const Eigen::Matrix<T, in_size, 1>& ins) noexcept
+    {
+        process(ins.data(), outs.data());
+    }
+#elif RTNEURAL_USE_XSIMD
+    /** Performs forward propagation for this layer. */
+    inline void forward(const v_type (&ins)[v_in_size]) noexcept
+    {
+        alignas(RTNEURAL_DEFAULT_ALIGNMENT) T ins_internal[v_in_size * v_size];
+        for(int i = 0; i < v_in_size; ++i)
+            xsimd::store_aligned(ins_internal + i * v_size, ins[i]);
+
+        alignas(RTNEURAL_DEFAULT_ALIGNMENT) T outs_internal[v_out_size * v_size] {};
+        process(ins_internal, outs_internal);
+
+        for(int i = 0; i < v_out_size; ++i)
+            outs[i] = xsimd::load_aligned(outs_internal + i * v_size);
+    }
+#else
+    /** Performs forward propagation for this layer. */
+    inline void forward(const T (&ins)[in_size]) noexcept
+    {
+        process(ins, outs);
+    }
+#endif
+
+    /**
+     * Sets the weights of the 1x1 input convolution.
+     *
+     * The weights vector must have size weights[channels][in_size],
+     * and the bias vector must have size bias[channels].
+     */
+    void setInputWeights(const std::vector<std::vector<T>>& weights, const std::vector<T>& bias);
+
+    /**
+     * Sets the weights for one of the dilated layers.
+     *
+     * The convolution weights must have size conv_weights[2 * channels][channels][kernel_size],
+     * in the same order as Conv1D::setWeights(), and the convolution bias must have size
+     * conv_bias[2 * channels]. The residual weights must have size residual_weights[channels][channels],
+     * and the residual bias must have size residual_bias[channels].
+     */
+    void setLayerWeights(int layer,
+        const std::vector<std::vector<std::vector<T>>>& conv_weights,
+        const std::vector<T>& conv_bias,
+        const std::vector<std::vector<T>>& residual_weights,
+        const std::vector<T>& residual_bias);
+
+    /**
+     * Sets the weights of the output mix.
+     *
+     * The weights vector must have size weights[out_size][num_layers * channels],
+     * with the gated outputs of the layers concatenated in order, and the
+     * bias vector must have size bias[out_size].
+     */
+    void setMixWeights(const std::vector<std::vector<T>>& weights, const std::vector<T>& bias);
+
+    /** Returns the number of dilated layers in the stack. */
+    static constexpr int getNumLayers() noexcept { return num_layers; }
+
+    /** Returns the number of residual channels. */
+    static constexpr int getNumChannels() noexcept { return channels; }
+
+    /** Returns the size of the dilated convolution kernels. */
+    static constexpr int getKernelSize() noexcept { return kernel_size; }
+
+    /** Returns the dilation rate of one of the layers. */
+    int getDilationRate(int layer) const noexcept { return dilation_rates[(size_t)layer]; }
+
+#if RTNEURAL_USE_EIGEN
+    Eigen::Map<vec_type, RTNeuralEigenAlignment> outs;
+#elif RTNEURAL_USE_XSIMD
+    v_type outs[v_out_size];
+#else
+    T outs alignas(RTNEURAL_DEFAULT_ALIGNMENT)[out_size];
+#endif
+
+private:
+    /** Runs the whole stack for one input frame. */
+    inline void process(const T* input, T* output) noexcept;
+
+#if RTNEURAL_USE_EIGEN
+    T outs_internal alignas(RTNEURAL_DEFAULT_ALIGNMENT)[out_size];
+#endif
+
+    // all weights are stored [input][output], so the inner loops run over the outputs
+    alignas(RTNEURAL_DEFAULT_ALIGNMENT) T input_weights[in_size][channels];
+    alignas(RTNEURAL_DEFAULT_ALIGNMENT) T input_bias[channels];
+
+    alignas(RTNEURAL_DEFAULT_ALIGNMENT) T conv_weights[num_layers][kernel_size][channels][2 * channels];
+    alignas(RTNEURAL_DEFAULT_ALIGNMENT) T conv_bias[num_layers][2 * channels];
+
+    // the residual and output mix weights are stacked, so both are applied in one product
+    alignas(RTNEURAL_DEFAULT_ALIGNMENT) T residual_mix_weights[num_layers][channels][channels + out_size];
+    alignas(RTNEURAL_DEFAULT_ALIGNMENT) T residual_bias[num_layers][channels];
+    alignas(RTNEURAL_DEFAULT_ALIGNMENT) T mix_bias[out_size];
+
+    std::array<int, num_layers> dilation_rates { { dilations... } };
+
+    /**
+     * Circular queues of past layer inputs: the queue for a layer with
+     * dilation d holds the last (kernel_size - 1) * d inputs to that layer.
+     */
+    alignas(RTNEURAL_DEFAULT_ALIGNMENT) std::array<T, (size_t)queue_size> queues;
+    std::array<int, num_layers> queue_offsets;
+    std::array<int, num_layers> queue_ptrs;
+};
+
+} // namespace RTNeural
+
+#endif // DILATED_CONV_STACK_H_INCLUDED
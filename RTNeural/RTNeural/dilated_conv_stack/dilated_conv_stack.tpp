@@ -0,0 +1,163 @@
+#include "dilated_conv_stack.h"
+
+namespace RTNeural
+{
+
+template <typename T, int in_sizet, int out_sizet, int channels, int kernel_size, int... dilations>
+DilatedConvStackT<T, in_sizet, out_sizet, channels, kernel_size, dilations...>::DilatedConvStackT()
+#if RTNEURAL_USE_EIGEN
+    : outs(outs_internal)
+#endif
+{
+    std::fill(&input_weights[0][0], &input_weights[0][0] + in_size * channels, (T)0);
+    std::fill(std::begin(input_bias), std::end(input_bias), (T)0);
+    std::fill(&conv_weights[0][0][0][0], &conv_weights[0][0][0][0] + num_layers * kernel_size * channels * 2 * channels, (T)0);
+    std::fill(&conv_bias[0][0], &conv_bias[0][0] + num_layers * 2 * channels, (T)0);
+    std::fill(&residual_mix_weights[0][0][0], &residual_mix_weights[0][0][0] + num_layers * channels * (channels + out_size), (T)0);
+    std::fill(&residual_bias[0][0], &residual_bias[0][0] + num_layers * channels, (T)0);
+    std::fill(std::begin(mix_bias), std::end(mix_bias), (T)0);
+
+    int offset = 0;
+    for(int l = 0; l < num_layers; ++l)
+    {
+        queue_offsets[(size_t)l] = offset;
+        offset += (kernel_size - 1) * dilation_rates[(size_t)l] * channels;
+    }
+
+#if RTNEURAL_USE_XSIMD
+    for(int i = 0; i < v_out_size; ++i)
+        outs[i] = v_type((T)0);
+#elif RTNEURAL_USE_EIGEN
+    std::fill(outs_internal, outs_internal + out_size, (T)0);
+#else
+    std::fill(outs, outs + out_size, (T)0);
+#endif
+
+    reset();
+}
+
+template <typename T, int in_sizet, int out_sizet, int channels, int kernel_size, int... dilations>
+void DilatedConvStackT<T, in_sizet, out_sizet, channels, kernel_size, dilations...>::reset()
+{
+    std::fill(queues.begin(), queues.end(), (T)0);
+    std::fill(queue_ptrs.begin(), queue_ptrs.end(), 0);
+}
+
+template <typename T, int in_sizet, int out_sizet, int channels, int kernel_size, int... dilations>
+void DilatedConvStackT<T, in_sizet, out_sizet, channels, kernel_size, dilations...>::getState(T* stateOut) const noexcept
+{
+    std::copy(queues.begin(), queues.end(), stateOut);
+    for(int l = 0; l < num_layers; ++l)
+        stateOut[queue_size + l] = (T)queue_ptrs[(size_t)l];
+}
+
+template <typename T, int in_sizet, int out_sizet, int channels, int kernel_size, int... dilations>
+void DilatedConvStackT<T, in_sizet, out_sizet, channels, kernel_size, dilations...>::setState(const T* stateIn) noexcept
+{
+    std::copy(stateIn, stateIn + queue_size, queues.begin());
+    for(int l = 0; l < num_layers; ++l)
+        queue_ptrs[(size_t)l] = (int)stateIn[queue_size + l];
+}
+
+template <typename T, int in_sizet, int out_sizet, int channels, int kernel_size, int... dilations>
+void DilatedConvStackT<T, in_sizet, out_sizet, channels, kernel_size, dilations...>::process(const T* input, T* output) noexcept
+{
+    // the residual channels, followed by the skip sums
+    alignas(RTNEURAL_DEFAULT_ALIGNMENT) T x[channels + out_size];
+    T* skip = x + channels;
+    alignas(RTNEURAL_DEFAULT_ALIGNMENT) T taps[kernel_size * channels];
+    alignas(RTNEURAL_DEFAULT_ALIGNMENT) T gates[2 * channels];
+    alignas(RTNEURAL_DEFAULT_ALIGNMENT) T z[channels];
+
+    // 1x1 input convolution
+    std::copy(std::begin(input_bias), std::end(input_bias), x);
+    dilated_conv_stack_detail::matVecAdd<T, channels, in_size>(&input_weights[0][0], input, x);
+
+    std::copy(std::begin(mix_bias), std::end(mix_bias), skip);
+
+    for(int l = 0; l < num_layers; ++l)
+    {
+        const auto dilation = dilation_rates[(size_t)l];
+        const auto queue_depth = (kernel_size - 1) * dilation;
+        T* queue = queues.data() + queue_offsets[(size_t)l];
+        auto& queue_ptr = queue_ptrs[(size_t)l];
+
+        // gather the current input and the older taps from the queue, then
+        // compute the dilated convolution as a single matrix-vector product
+        std::copy(x, x + channels, taps);
+        for(int k = 1; k < kernel_size; ++k)
+        {
+            auto tap_idx = queue_ptr - k * dilation;
+            tap_idx = tap_idx < 0 ? tap_idx + queue_depth : tap_idx;
+            std::copy(queue + tap_idx * channels, queue + (tap_idx + 1) * channels, taps + k * channels);
+        }
+
+        if(kernel_size > 1)
+        {
+            std::copy(x, x + channels, queue + queue_ptr * channels);
+            queue_ptr = (queue_ptr == queue_depth - 1 ? 0 : queue_ptr + 1);
+        }
+
+        std::copy(std::begin(conv_bias[l]), std::end(conv_bias[l]), gates);
+        dilated_conv_stack_detail::matVecAdd<T, 2 * channels, kernel_size * channels>(&conv_weights[l][0][0][0], taps, gates);
+
+        dilated_conv_stack_detail::gatedActivation<T, channels>(gates, z);
+
+        // residual and skip sums
+        for(int o = 0; o < channels; ++o)
+            x[o] += residual_bias[l][o];
+        dilated_conv_stack_detail::matVecAdd<T, channels + out_size, channels>(&residual_mix_weights[l][0][0], z, x);
+    }
+
+    std::copy(skip, skip + out_size, output);
+}
+
+template <typename T, int in_sizet, int out_sizet, int channels, int kernel_size, int... dilations>
+void DilatedConvStackT<T, in_sizet, out_sizet, channels, kernel_size, dilations...>::setInputWeights(const std::vector<std::vector<T>>& weights,
+    const std::vector<T>& bias)
+{
+    for(int o = 0; o < channels; ++o)
+    {
+        for(int c = 0; c < in_size; ++c)
+            input_weights[c][o] = weights[(size_t)o][(size_t)c];
+        input_bias[o] = bias[(size_t)o];
+    }
+}
+
+template <typename T, int in_sizet, int out_sizet, int channels, int kernel_size, int... dilations>
+void DilatedConvStackT<T, in_sizet, out_sizet, channels, kernel_size, dilations...>::setLayerWeights(int layer,
+    const std::vector<std::vector<std::vector<T>>>& conv_ws,
+    const std::vector<T>& conv_bs,
+    const std::vector<std::vector<T>>& residual_ws,
+    const std::vector<T>& residual_bs)
+{
+    for(int o = 0; o < 2 * channels; ++o)
+    {
+        for(int c = 0; c < channels; ++c)
+            for(int k = 0; k < kernel_size; ++k)
+                conv_weights[layer][k][c][o] = conv_ws[(size_t)o][(size_t)c][(size_t)k];
+        conv_bias[layer][o] = conv_bs[(size_t)o];
+    }
+
+    for(int o = 0; o < channels; ++o)
+    {
+        for(int c = 0; c < channels; ++c)
+            residual_mix_weights[layer][c][o] = residual_ws[(size_t)o][(size_t)c];
+        residual_bias[layer][o] = residual_bs[(size_t)o];
+    }
+}
+
+template <typename T, int in_sizet, int out_sizet, int channels, int kernel_size, int... dilations>
+void DilatedConvStackT<T, in_sizet, out_sizet, channels, kernel_size, dilations...>::setMixWeights(const std::vector<std::vector<T>>& weights,
+    const std::vector<T>& bias)
+{
+    for(int o = 0; o < out_size; ++o)
+    {
+        for(int l = 0; l < num_layers; ++l)
+            for(int c = 0; c < channels; ++c)
+                residual_mix_weights[l][c][channels + o] = weights[(size_t)o][(size_t)(l * channels + c)];
+        mix_bias[o] = bias[(size_t)o];
+    }
+}
+
+} // namespace RTNeural
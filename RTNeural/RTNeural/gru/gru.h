@@ -14,7 +14,9 @@
 #include "gru_accelerate.tpp"
 #else
 #include "../Layer.h"
+#include "../block_sparse.h"
 #include "../common.h"
+#include "../low_rank.h"
 #include <vector>
 
 namespace RTNeural
@@ -27,6 +29,12 @@ namespace RTNeural
  * To ensure that the recurrent state is initialized to zero,
  * please make sure to call `reset()` before your first call to
  * the `forward()` method.
+ *
+ * The weights and state are stored row-major in a single
+ * contiguous block of memory. The kernel and recurrent weights of
+ * the three gates are stacked into single [3 * out_size x in_size]
+ * and [3 * out_size x out_size] matrices, so that each forward pass
+ * streams the input and the state once.
  */
 template <typename T>
 class GRULayer final : public Layer<T>
@@ -37,26 +45,56 @@ public:
     GRULayer(std::initializer_list<int> sizes);
     GRULayer(const GRULayer& other);
     GRULayer& operator=(const GRULayer& other);
-    virtual ~GRULayer();
 
     /** Resets the state of the GRU. */
     void reset() override { std::fill(ht1, ht1 + Layer<T>::out_size, (T)0); }
 
+    /** Returns the number of values in a snapshot of the layer state. */
+    int getStateSize() const noexcept override { return Layer<T>::out_size; }
+
+    /** Copies the layer state into a buffer of getStateSize() values. */
+    void getState(T* stateOut) const noexcept override { std::copy(ht1, ht1 + Layer<T>::out_size, stateOut); }
+
+    /** Restores the layer state from a buffer written by getState(). */
+    void setState(const T* stateIn) noexcept override { std::copy(stateIn, stateIn + Layer<T>::out_size, ht1); }
+
     /** Returns the name of this layer. */
     std::string getName() const noexcept override { return "gru"; }
 
     /** Performs forward propagation for this layer. */
     inline void forward(const T* input, T* h) noexcept override
     {
-        for(int i = 0; i < Layer<T>::out_size; ++i)
+        const auto in_size = Layer<T>::in_size;
+        const auto out_size = Layer<T>::out_size;
+
+        // stacked [z, r, c] pre-activations of the input and of the recurrent state
+        for(int k = 0; k < 3 * out_size; ++k)
+            xVec[k] = vMult(W + k * in_size, input, in_size) + b[k];
+
+        if(!lowRankU.isEmpty())
+        {
+            lowRankU.multiply(ht1, hVec);
+        }
+        else if(!sparseU.isEmpty())
+        {
+            sparseU.multiply(ht1, hVec);
+        }
+        else
+        {
+            for(int k = 0; k < 3 * out_size; ++k)
+                hVec[k] = vMult(U + k * out_size, ht1, out_size);
+        }
+
+        const T* bh = b + 3 * out_size;
+        for(int i = 0; i < out_size; ++i)
         {
-            zVec[i] = sigmoid(vMult(zWeights.W[i], input, Layer<T>::in_size) + vMult(zWeights.U[i], ht1, Layer<T>::out_size) + zWeights.b[0][i] + zWeights.b[1][i]);
-            rVec[i] = sigmoid(vMult(rWeights.W[i], input, Layer<T>::in_size) + vMult(rWeights.U[i], ht1, Layer<T>::out_size) + rWeights.b[0][i] + rWeights.b[1][i]);
-            cVec[i] = std::tanh(vMult(cWeights.W[i], input, Layer<T>::in_size) + rVec[i] * (vMult(cWeights.U[i], ht1, Layer<T>::out_size) + cWeights.b[1][i]) + cWeights.b[0][i]);
-            h[i] = ((T)1 - zVec[i]) * cVec[i] + zVec[i] * ht1[i];
+            const auto z = sigmoid(xVec[i] + hVec[i] + bh[i]);
+            const auto r = sigmoid(xVec[out_size + i] + hVec[out_size + i] + bh[out_size + i]);
+            const auto c = std::tanh(xVec[2 * out_size + i] + r * (hVec[2 * out_size + i] + bh[2 * out_size + i]));
+            h[i] = ((T)1 - z) * c + z * ht1[i];
         }
 
-        std::copy(h, h + Layer<T>::out_size, ht1);
+        std::copy(h, h + out_size, ht1);
     }
 
     /**
@@ -110,30 +148,68 @@ public:
     /** Returns the bias value for the given indices. */
     T getBVal(int i, int k) const noexcept;
 
-protected:
-    T* ht1;
+    /**
+     * Runs this layer with block-sparse recurrent weights (see BlockSparseMatrix)
+     * when at most `max_density` of their blocks contain a non-zero weight, and
+     * returns true if it does. The check is repeated whenever the recurrent
+     * weights are set. Pass 0 to go back to the dense weights.
+     */
+    bool useSparseWeights(T max_density)
+    {
+        sparse_max_density = max_density;
+        return updateSparseWeights();
+    }
+
+    /** Returns true if this layer is running with block-sparse recurrent weights. */
+    bool hasSparseWeights() const noexcept { return !sparseU.isEmpty(); }
 
-    /** Struct to hold layer weights (used internally) */
-    struct WeightSet
+    /**
+     * Runs this layer with low-rank recurrent weights (see LowRankMatrix), with
+     * the smallest rank whose relative error is at most `tolerance`, and returns
+     * true if that rank makes the recurrent product cheaper. The factorization
+     * is repeated whenever the recurrent weights are set, and takes precedence
+     * over block-sparse weights. Pass 0 to go back to the full-rank weights.
+     */
+    bool useLowRankWeights(T tolerance)
     {
-        WeightSet(int in_size, int out_size);
-        ~WeightSet();
+        low_rank_tolerance = tolerance;
+        return updateLowRankWeights();
+    }
 
-        T** W; // kernel weights
-        T** U; // recurrent weights
-        T** b; // bias
-        const int out_size;
-    };
+    /** Returns the rank of the recurrent weights, or 0 if they are full-rank. */
+    int getLowRank() const noexcept { return lowRankU.getRank(); }
 
-    WeightSet zWeights;
-    WeightSet rWeights;
-    WeightSet cWeights;
+    /** Returns the number of values this layer allocates from an arena. */
+    size_t getArenaSize() const noexcept override { return memory.getSize(); }
 
-    T* zVec;
-    T* rVec;
-    T* cVec;
+    /** Moves the weights and state of this layer into the arena. */
+    void moveToArena(Arena<T>& arena) override;
 
+protected:
     static constexpr int kNumBiasLayers { 2 };
+
+    static size_t getMemorySize(int in_size, int out_size) noexcept;
+    void assignMemory() noexcept;
+    bool updateSparseWeights();
+    bool updateLowRankWeights();
+
+    LayerMemory<T> memory;
+
+    T* W; // kernel weights [3 * out_size][in_size]
+    T* U; // recurrent weights [3 * out_size][out_size]
+    T* b; // bias [kNumBiasLayers][3 * out_size]
+
+    T* ht1;
+    T* xVec; // kernel pre-activations [3 * out_size]
+    T* hVec; // recurrent pre-activations [3 * out_size]
+
+    // the non-zero blocks of the recurrent weights, which live outside of the arena
+    BlockSparseMatrix<T> sparseU;
+    T sparse_max_density = (T)0;
+
+    // the low-rank factors of the recurrent weights, which also live outside of the arena
+    LowRankMatrix<T> lowRankU;
+    T low_rank_tolerance = (T)0;
 };
 
 //====================================================
@@ -144,8 +220,14 @@ protected:
  * To ensure that the recurrent state is initialized to zero,
  * please make sure to call `reset()` before your first call to
  * the `forward()` method.
+ *
+ * The weights of the three gates are stacked, as in GRULayer.
+ * With `rankt > 0`, setUVals() replaces the recurrent weights with a
+ * rank-`rankt` factorization U ~= A * B (see LowRankMatrixT), so that
+ * the recurrent product takes 4 * out_size * rankt operations instead
+ * of 3 * out_size * out_size.
  */
-template <typename T, int in_sizet, int out_sizet, SampleRateCorrectionMode sampleRateCorr = SampleRateCorrectionMode::None>
+template <typename T, int in_sizet, int out_sizet, SampleRateCorrectionMode sampleRateCorr = SampleRateCorrectionMode::None, int rankt = 0>
 class GRULayerT
 {
 public:
@@ -173,51 +255,48 @@ public:
     /** Resets the state of the GRU. */
     void reset();
 
-    /** Performs forward propagation for this layer. */
-    template <int N = in_size>
-    inline typename std::enable_if<(N > 1), void>::type
-    forward(const T (&ins)[in_size]) noexcept
-    {
-        // compute zt
-        recurrent_mat_mul(outs, Uz, zt);
-        kernel_mat_mul(ins, Wz, kernel_outs);
-        for(int i = 0; i < out_size; ++i)
-            zt[i] = sigmoid(zt[i] + bz[i] + kernel_outs[i]);
+    /**
+     * Returns the number of values in a snapshot of the layer state.
+     * With sample rate correction, the short delay line used for the
+     * correction is not part of the snapshot.
+     */
+    static constexpr int getStateSize() noexcept { return out_size; }
 
-        // compute rt
-        recurrent_mat_mul(outs, Ur, rt);
-        kernel_mat_mul(ins, Wr, kernel_outs);
-        for(int i = 0; i < out_size; ++i)
-            rt[i] = sigmoid(rt[i] + br[i] + kernel_outs[i]);
+    /** Copies the layer state into a buffer of getStateSize() values. */
+    void getState(T* stateOut) const noexcept { std::copy(outs, outs + out_size, stateOut); }
 
-        // compute h_hat
-        recurrent_mat_mul(outs, Uh, ct);
-        kernel_mat_mul(ins, Wh, kernel_outs);
-        for(int i = 0; i < out_size; ++i)
-            ht[i] = std::tanh(rt[i] * (ct[i] + bh1[i]) + bh0[i] + kernel_outs[i]);
-
-        computeOutput();
-    }
+    /** Restores the layer state from a buffer written by getState(). */
+    void setState(const T* stateIn) noexcept { std::copy(stateIn, stateIn + out_size, outs); }
 
     /** Performs forward propagation for this layer. */
-    template <int N = in_size>
-    inline typename std::enable_if<N == 1, void>::type
-    forward(const T (&ins)[in_size]) noexcept
+    inline void forward(const T (&ins)[in_size]) noexcept
     {
-        // compute zt
-        recurrent_mat_mul(outs, Uz, zt);
-        for(int i = 0; i < out_size; ++i)
-            zt[i] = sigmoid(zt[i] + bz[i] + (Wz_1[i] * ins[0]));
+        // stacked [z, r, c] pre-activations of the input and of the recurrent state
+        std::copy(bx, bx + 3 * out_size, kernel_outs);
+        for(int i = 0; i < in_size; ++i)
+            for(int k = 0; k < 3 * out_size; ++k)
+                kernel_outs[k] += W[i][k] * ins[i];
 
-        // compute rt
-        recurrent_mat_mul(outs, Ur, rt);
-        for(int i = 0; i < out_size; ++i)
-            rt[i] = sigmoid(rt[i] + br[i] + (Wr_1[i] * ins[0]));
+        if(rankt > 0)
+        {
+            lowRankU.multiply(outs, recurrent_outs);
+            for(int k = 0; k < 3 * out_size; ++k)
+                recurrent_outs[k] += bh[k];
+        }
+        else
+        {
+            std::copy(bh, bh + 3 * out_size, recurrent_outs);
+            for(int i = 0; i < out_size; ++i)
+                for(int k = 0; k < 3 * out_size; ++k)
+                    recurrent_outs[k] += U[i][k] * outs[i];
+        }
 
-        // compute h_hat
-        recurrent_mat_mul(outs, Uh, ct);
         for(int i = 0; i < out_size; ++i)
-            ht[i] = std::tanh(rt[i] * (ct[i] + bh1[i]) + bh0[i] + (Wh_1[i] * ins[0]));
+        {
+            zt[i] = sigmoid(kernel_outs[i] + recurrent_outs[i]);
+            const auto rt = sigmoid(kernel_outs[out_size + i] + recurrent_outs[out_size + i]);
+            ht[i] = std::tanh(kernel_outs[2 * out_size + i] + rt * recurrent_outs[2 * out_size + i]);
+        }
 
         computeOutput();
     }
@@ -243,6 +322,12 @@ public:
      */
     void setBVals(const std::vector<std::vector<T>>& bVals);
 
+    /**
+     * Returns the error of the low-rank recurrent weights, relative to
+     * the norm of the weights passed to setUVals() (0 with full rank).
+     */
+    T getLowRankError() const noexcept { return low_rank_error; }
+
     T outs alignas(RTNEURAL_DEFAULT_ALIGNMENT)[out_size];
 
 private:
@@ -258,83 +343,59 @@ private:
     inline std::enable_if_t<srCorr != SampleRateCorrectionMode::None, void>
     computeOutput() noexcept
     {
+        auto& delayIn = outs_delayed.write();
         for(int i = 0; i < out_size; ++i)
-            outs_delayed[delayWriteIdx][i] = ((T)1.0 - zt[i]) * ht[i] + zt[i] * outs[i];
+            delayIn[i] = ((T)1.0 - zt[i]) * ht[i] + zt[i] * outs[i];
 
-        processDelay(outs_delayed, outs, delayWriteIdx);
+        processDelay(outs_delayed, outs);
     }
 
+    using delay_type = SampleRateCorrectionDelay<std::array<T, out_size>>;
+
     template <SampleRateCorrectionMode srCorr = sampleRateCorr>
     inline std::enable_if_t<srCorr == SampleRateCorrectionMode::NoInterp, void>
-    processDelay(std::vector<std::array<T, out_size>>& delayVec, T (&out)[out_size], int delayWriteIndex) noexcept
+    processDelay(delay_type& delay, T (&out)[out_size]) noexcept
     {
+        const auto& delayed = delay.read(maxDelay);
         for(int i = 0; i < out_size; ++i)
-            out[i] = delayVec[0][i];
+            out[i] = delayed[i];
 
-        for(int j = 0; j < delayWriteIndex; ++j)
-        {
-            for(int i = 0; i < out_size; ++i)
-                delayVec[j][i] = delayVec[j + 1][i];
-        }
+        delay.advance();
     }
 
     template <SampleRateCorrectionMode srCorr = sampleRateCorr>
     inline std::enable_if_t<srCorr == SampleRateCorrectionMode::LinInterp, void>
-    processDelay(std::vector<std::array<T, out_size>>& delayVec, T (&out)[out_size], int delayWriteIndex) noexcept
+    processDelay(delay_type& delay, T (&out)[out_size]) noexcept
     {
+        const auto& older = delay.read(maxDelay);
+        const auto& newer = delay.read(maxDelay - 1);
         for(int i = 0; i < out_size; ++i)
-            out[i] = delayPlus1Mult * delayVec[0][i] + delayMult * delayVec[1][i];
+            out[i] = delayPlus1Mult * older[i] + delayMult * newer[i];
 
-        for(int j = 0; j < delayWriteIndex; ++j)
-        {
-            for(int i = 0; i < out_size; ++i)
-                delayVec[j][i] = delayVec[j + 1][i];
-        }
-    }
-
-    static inline void recurrent_mat_mul(const T (&vec)[out_size], const T (&mat)[out_size][out_size], T (&out)[out_size]) noexcept
-    {
-        for(int j = 0; j < out_size; ++j)
-            out[j] = std::inner_product(mat[j], mat[j] + out_size, vec, (T)0);
+        delay.advance();
     }
 
-    static inline void kernel_mat_mul(const T (&vec)[in_size], const T (&mat)[out_size][in_size], T (&out)[out_size]) noexcept
-    {
-        for(int j = 0; j < out_size; ++j)
-            out[j] = std::inner_product(mat[j], mat[j] + in_size, vec, (T)0);
-    }
-
-    // kernel weights
-    T Wr alignas(RTNEURAL_DEFAULT_ALIGNMENT)[out_size][in_size];
-    T Wz alignas(RTNEURAL_DEFAULT_ALIGNMENT)[out_size][in_size];
-    T Wh alignas(RTNEURAL_DEFAULT_ALIGNMENT)[out_size][in_size];
-    T kernel_outs alignas(RTNEURAL_DEFAULT_ALIGNMENT)[out_size];
-
-    // single-input kernel weights
-    T Wz_1 alignas(RTNEURAL_DEFAULT_ALIGNMENT)[out_size];
-    T Wr_1 alignas(RTNEURAL_DEFAULT_ALIGNMENT)[out_size];
-    T Wh_1 alignas(RTNEURAL_DEFAULT_ALIGNMENT)[out_size];
+    // stacked [z, r, c] kernel and recurrent weights, stored by input column
+    T W alignas(RTNEURAL_DEFAULT_ALIGNMENT)[in_size][3 * out_size];
+    T U alignas(RTNEURAL_DEFAULT_ALIGNMENT)[out_size][3 * out_size];
 
-    // recurrent weights
-    T Uz alignas(RTNEURAL_DEFAULT_ALIGNMENT)[out_size][out_size];
-    T Ur alignas(RTNEURAL_DEFAULT_ALIGNMENT)[out_size][out_size];
-    T Uh alignas(RTNEURAL_DEFAULT_ALIGNMENT)[out_size][out_size];
+    // low-rank recurrent weights
+    LowRankMatrixT<T, 3 * out_size, out_size, rankt> lowRankU;
+    T low_rank_error = (T)0;
 
-    // biases
-    T bz alignas(RTNEURAL_DEFAULT_ALIGNMENT)[out_size];
-    T br alignas(RTNEURAL_DEFAULT_ALIGNMENT)[out_size];
-    T bh0 alignas(RTNEURAL_DEFAULT_ALIGNMENT)[out_size];
-    T bh1 alignas(RTNEURAL_DEFAULT_ALIGNMENT)[out_size];
+    // stacked kernel and recurrent biases
+    T bx alignas(RTNEURAL_DEFAULT_ALIGNMENT)[3 * out_size];
+    T bh alignas(RTNEURAL_DEFAULT_ALIGNMENT)[3 * out_size];
 
     // intermediate vars
+    T kernel_outs alignas(RTNEURAL_DEFAULT_ALIGNMENT)[3 * out_size];
+    T recurrent_outs alignas(RTNEURAL_DEFAULT_ALIGNMENT)[3 * out_size];
     T zt alignas(RTNEURAL_DEFAULT_ALIGNMENT)[out_size];
-    T rt alignas(RTNEURAL_DEFAULT_ALIGNMENT)[out_size];
-    T ct alignas(RTNEURAL_DEFAULT_ALIGNMENT)[out_size];
     T ht alignas(RTNEURAL_DEFAULT_ALIGNMENT)[out_size];
 
     // needed for delays when doing sample rate correction
-    std::vector<std::array<T, out_size>> outs_delayed;
-    int delayWriteIdx = 0;
+    delay_type outs_delayed;
+    int maxDelay = 0;
     T delayMult = (T)1;
     T delayPlus1Mult = (T)0;
 };
@@ -7,14 +7,9 @@ namespace RTNeural
 template <typename T>
 GRULayer<T>::GRULayer(int in_size, int out_size)
     : Layer<T>(in_size, out_size)
-    , zWeights(in_size, out_size)
-    , rWeights(in_size, out_size)
-    , cWeights(in_size, out_size)
+    , memory(getMemorySize(in_size, out_size))
 {
-    ht1 = new T[out_size];
-    zVec = new T[out_size];
-    rVec = new T[out_size];
-    cVec = new T[out_size];
+    assignMemory();
 }
 
 template <typename T>
@@ -38,270 +33,201 @@ GRULayer<T>& GRULayer<T>::operator=(const GRULayer<T>& other)
 }
 
 template <typename T>
-GRULayer<T>::~GRULayer()
+size_t GRULayer<T>::getMemorySize(int in_size, int out_size) noexcept
 {
-    delete[] ht1;
-    delete[] zVec;
-    delete[] rVec;
-    delete[] cVec;
+    return Arena<T>::alignedSize((size_t)(3 * out_size * in_size))
+        + Arena<T>::alignedSize((size_t)(3 * out_size * out_size))
+        + Arena<T>::alignedSize((size_t)(kNumBiasLayers * 3 * out_size))
+        + Arena<T>::alignedSize((size_t)out_size)
+        + 2 * Arena<T>::alignedSize((size_t)(3 * out_size));
 }
 
 template <typename T>
-GRULayer<T>::WeightSet::WeightSet(int in_size, int out_size)
-    : out_size(out_size)
+void GRULayer<T>::assignMemory() noexcept
 {
-    W = new T*[out_size];
-    U = new T*[out_size];
-    b = new T*[kNumBiasLayers];
+    const auto in_size = Layer<T>::in_size;
+    const auto out_size = Layer<T>::out_size;
 
-    for(int i = 0; i < kNumBiasLayers; ++i)
-    {
-        b[i] = new T[out_size];
-    }
-
-    for(int i = 0; i < out_size; ++i)
+    T* ptr = memory.data();
+    auto next = [&ptr](size_t count)
     {
-        W[i] = new T[in_size];
-        U[i] = new T[out_size];
-    }
+        T* result = ptr;
+        ptr += Arena<T>::alignedSize(count);
+        return result;
+    };
+
+    W = next((size_t)(3 * out_size * in_size));
+    U = next((size_t)(3 * out_size * out_size));
+    b = next((size_t)(kNumBiasLayers * 3 * out_size));
+
+    ht1 = next((size_t)out_size);
+    xVec = next((size_t)(3 * out_size));
+    hVec = next((size_t)(3 * out_size));
 }
 
 template <typename T>
-GRULayer<T>::WeightSet::~WeightSet()
+void GRULayer<T>::moveToArena(Arena<T>& arena)
 {
-    for(int i = 0; i < kNumBiasLayers; ++i)
-    {
-        delete[] b[i];
-    }
-
-    for(int i = 0; i < out_size; ++i)
-    {
-        delete[] W[i];
-        delete[] U[i];
-    }
-
-    delete[] b;
-    delete[] W;
-    delete[] U;
+    memory.moveTo(arena);
+    assignMemory();
 }
 
 template <typename T>
 void GRULayer<T>::setWVals(const std::vector<std::vector<T>>& wVals)
 {
+    const auto in_size = Layer<T>::in_size;
     for(int i = 0; i < Layer<T>::in_size; ++i)
-    {
-        for(int k = 0; k < Layer<T>::out_size; ++k)
-        {
-            zWeights.W[k][i] = wVals[i][k];
-            rWeights.W[k][i] = wVals[i][k + Layer<T>::out_size];
-            cWeights.W[k][i] = wVals[i][k + Layer<T>::out_size * 2];
-        }
-    }
+        for(int k = 0; k < 3 * Layer<T>::out_size; ++k)
+            W[k * in_size + i] = wVals[i][k];
 }
 
 template <typename T>
 void GRULayer<T>::setWVals(T** wVals)
 {
+    const auto in_size = Layer<T>::in_size;
     for(int i = 0; i < Layer<T>::in_size; ++i)
-    {
-        for(int k = 0; k < Layer<T>::out_size; ++k)
-        {
-            zWeights.W[k][i] = wVals[i][k];
-            rWeights.W[k][i] = wVals[i][k + Layer<T>::out_size];
-            cWeights.W[k][i] = wVals[i][k + Layer<T>::out_size * 2];
-        }
-    }
+        for(int k = 0; k < 3 * Layer<T>::out_size; ++k)
+            W[k * in_size + i] = wVals[i][k];
 }
 
 template <typename T>
 void GRULayer<T>::setUVals(const std::vector<std::vector<T>>& uVals)
 {
+    const auto out_size = Layer<T>::out_size;
     for(int i = 0; i < Layer<T>::out_size; ++i)
-    {
-        for(int k = 0; k < Layer<T>::out_size; ++k)
-        {
-            zWeights.U[k][i] = uVals[i][k];
-            rWeights.U[k][i] = uVals[i][k + Layer<T>::out_size];
-            cWeights.U[k][i] = uVals[i][k + Layer<T>::out_size * 2];
-        }
-    }
+        for(int k = 0; k < 3 * Layer<T>::out_size; ++k)
+            U[k * out_size + i] = uVals[i][k];
+
+    updateSparseWeights();
+    updateLowRankWeights();
 }
 
 template <typename T>
 void GRULayer<T>::setUVals(T** uVals)
 {
+    const auto out_size = Layer<T>::out_size;
     for(int i = 0; i < Layer<T>::out_size; ++i)
-    {
-        for(int k = 0; k < Layer<T>::out_size; ++k)
-        {
-            zWeights.U[k][i] = uVals[i][k];
-            rWeights.U[k][i] = uVals[i][k + Layer<T>::out_size];
-            cWeights.U[k][i] = uVals[i][k + Layer<T>::out_size * 2];
-        }
-    }
+        for(int k = 0; k < 3 * Layer<T>::out_size; ++k)
+            U[k * out_size + i] = uVals[i][k];
+
+    updateSparseWeights();
+    updateLowRankWeights();
 }
 
 template <typename T>
 void GRULayer<T>::setBVals(const std::vector<std::vector<T>>& bVals)
 {
-    for(int i = 0; i < 2; ++i)
-    {
-        for(int k = 0; k < Layer<T>::out_size; ++k)
-        {
-            zWeights.b[i][k] = bVals[i][k];
-            rWeights.b[i][k] = bVals[i][k + Layer<T>::out_size];
-            cWeights.b[i][k] = bVals[i][k + Layer<T>::out_size * 2];
-        }
-    }
+    const auto out_size = Layer<T>::out_size;
+    for(int i = 0; i < kNumBiasLayers; ++i)
+        for(int k = 0; k < 3 * out_size; ++k)
+            b[i * 3 * out_size + k] = bVals[i][k];
 }
 
 template <typename T>
 void GRULayer<T>::setBVals(T** bVals)
 {
-    for(int i = 0; i < 2; ++i)
-    {
-        for(int k = 0; k < Layer<T>::out_size; ++k)
-        {
-            zWeights.b[i][k] = bVals[i][k];
-            rWeights.b[i][k] = bVals[i][k + Layer<T>::out_size];
-            cWeights.b[i][k] = bVals[i][k + Layer<T>::out_size * 2];
-        }
-    }
+    const auto out_size = Layer<T>::out_size;
+    for(int i = 0; i < kNumBiasLayers; ++i)
+        for(int k = 0; k < 3 * out_size; ++k)
+            b[i * 3 * out_size + k] = bVals[i][k];
 }
 
 template <typename T>
-T GRULayer<T>::getWVal(int i, int k) const noexcept
+bool GRULayer<T>::updateSparseWeights()
 {
-    T** set = zWeights.W;
-    if(k > 2 * Layer<T>::out_size)
-    {
-        k -= 2 * Layer<T>::out_size;
-        set = cWeights.W;
-    }
-    else if(k > Layer<T>::out_size)
-    {
-        k -= Layer<T>::out_size;
-        set = rWeights.W;
-    }
+    const auto out_size = Layer<T>::out_size;
+    return sparseU.setWeights(3 * out_size, out_size, sparse_max_density, [this](int k, int i)
+        { return getUVal(i, k); });
+}
 
-    return set[i][k];
+template <typename T>
+bool GRULayer<T>::updateLowRankWeights()
+{
+    const auto out_size = Layer<T>::out_size;
+    return lowRankU.setWeightsForTolerance(3 * out_size, out_size, low_rank_tolerance, [this](int k, int i)
+        { return getUVal(i, k); });
 }
 
 template <typename T>
-T GRULayer<T>::getUVal(int i, int k) const noexcept
+T GRULayer<T>::getWVal(int i, int k) const noexcept
 {
-    T** set = zWeights.U;
-    if(k > 2 * Layer<T>::out_size)
-    {
-        k -= 2 * Layer<T>::out_size;
-        set = cWeights.U;
-    }
-    else if(k > Layer<T>::out_size)
-    {
-        k -= Layer<T>::out_size;
-        set = rWeights.U;
-    }
+    return W[k * Layer<T>::in_size + i];
+}
 
-    return set[i][k];
+template <typename T>
+T GRULayer<T>::getUVal(int i, int k) const noexcept
+{
+    return U[k * Layer<T>::out_size + i];
 }
 
 template <typename T>
 T GRULayer<T>::getBVal(int i, int k) const noexcept
 {
-    T** set = zWeights.b;
-    if(k > 2 * Layer<T>::out_size)
-    {
-        k -= 2 * Layer<T>::out_size;
-        set = cWeights.b;
-    }
-    else if(k > Layer<T>::out_size)
-    {
-        k -= Layer<T>::out_size;
-        set = rWeights.b;
-    }
-
-    return set[i][k];
+    return b[i * 3 * Layer<T>::out_size + k];
 }
 
 //====================================================
-template <typename T, int in_sizet, int out_sizet, SampleRateCorrectionMode sampleRateCorr>
-GRULayerT<T, in_sizet, out_sizet, sampleRateCorr>::GRULayerT()
+template <typename T, int in_sizet, int out_sizet, SampleRateCorrectionMode sampleRateCorr, int rankt>
+GRULayerT<T, in_sizet, out_sizet, sampleRateCorr, rankt>::GRULayerT()
 {
+    // kernel and recurrent weights
+    for(int i = 0; i < in_size; ++i)
+        std::fill(W[i], W[i] + 3 * out_size, (T)0);
     for(int i = 0; i < out_size; ++i)
-    {
-        // single-input kernel weights
-        Wz_1[i] = (T)0;
-        Wr_1[i] = (T)0;
-        Wh_1[i] = (T)0;
+        std::fill(U[i], U[i] + 3 * out_size, (T)0);
 
+    for(int k = 0; k < 3 * out_size; ++k)
+    {
         // biases
-        bz[i] = (T)0;
-        br[i] = (T)0;
-        bh0[i] = (T)0;
-        bh1[i] = (T)0;
+        bx[k] = (T)0;
+        bh[k] = (T)0;
 
         // intermediate vars
-        zt[i] = (T)0;
-        rt[i] = (T)0;
-        ct[i] = (T)0;
-        ht[i] = (T)0;
+        kernel_outs[k] = (T)0;
+        recurrent_outs[k] = (T)0;
     }
 
     for(int i = 0; i < out_size; ++i)
     {
-        // recurrent weights
-        for(int k = 0; k < out_size; ++k)
-        {
-            Uz[i][k] = (T)0;
-            Ur[i][k] = (T)0;
-            Uh[i][k] = (T)0;
-        }
-
-        // kernel weights
-        for(int k = 0; k < in_size; ++k)
-        {
-            Wz[i][k] = (T)0;
-            Wr[i][k] = (T)0;
-            Wh[i][k] = (T)0;
-        }
+        zt[i] = (T)0;
+        ht[i] = (T)0;
     }
 
     reset();
 }
 
-template <typename T, int in_sizet, int out_sizet, SampleRateCorrectionMode sampleRateCorr>
+template <typename T, int in_sizet, int out_sizet, SampleRateCorrectionMode sampleRateCorr, int rankt>
 template <SampleRateCorrectionMode srCorr>
 std::enable_if_t<srCorr == SampleRateCorrectionMode::NoInterp, void>
-GRULayerT<T, in_sizet, out_sizet, sampleRateCorr>::prepare(int delaySamples)
+GRULayerT<T, in_sizet, out_sizet, sampleRateCorr, rankt>::prepare(int delaySamples)
 {
-    delayWriteIdx = delaySamples - 1;
-    outs_delayed.resize(delayWriteIdx + 1, {});
+    maxDelay = delaySamples - 1;
+    outs_delayed.prepare(maxDelay);
 
     reset();
 }
 
-template <typename T, int in_sizet, int out_sizet, SampleRateCorrectionMode sampleRateCorr>
+template <typename T, int in_sizet, int out_sizet, SampleRateCorrectionMode sampleRateCorr, int rankt>
 template <SampleRateCorrectionMode srCorr>
 std::enable_if_t<srCorr == SampleRateCorrectionMode::LinInterp, void>
-GRULayerT<T, in_sizet, out_sizet, sampleRateCorr>::prepare(T delaySamples)
+GRULayerT<T, in_sizet, out_sizet, sampleRateCorr, rankt>::prepare(T delaySamples)
 {
     const auto delayOffFactor = delaySamples - std::floor(delaySamples);
     delayMult = (T)1 - delayOffFactor;
     delayPlus1Mult = delayOffFactor;
 
-    delayWriteIdx = (int)std::ceil(delaySamples) - (int)std::ceil(delayOffFactor);
-    outs_delayed.resize(delayWriteIdx + 1, {});
+    maxDelay = (int)std::ceil(delaySamples) - (int)std::ceil(delayOffFactor);
+    outs_delayed.prepare(maxDelay);
 
     reset();
 }
 
-template <typename T, int in_sizet, int out_sizet, SampleRateCorrectionMode sampleRateCorr>
-void GRULayerT<T, in_sizet, out_sizet, sampleRateCorr>::reset()
+template <typename T, int in_sizet, int out_sizet, SampleRateCorrectionMode sampleRateCorr, int rankt>
+void GRULayerT<T, in_sizet, out_sizet, sampleRateCorr, rankt>::reset()
 {
     if(sampleRateCorr != SampleRateCorrectionMode::None)
     {
-        for(auto& vec : outs_delayed)
-            std::fill(vec.begin(), vec.end(), T {});
+        outs_delayed.fill({});
     }
 
     // reset output state
@@ -310,52 +236,44 @@ void GRULayerT<T, in_sizet, out_sizet, sampleRateCorr>::reset()
 }
 
 // kernel weights
-template <typename T, int in_sizet, int out_sizet, SampleRateCorrectionMode sampleRateCorr>
-void GRULayerT<T, in_sizet, out_sizet, sampleRateCorr>::setWVals(const std::vector<std::vector<T>>& wVals)
+template <typename T, int in_sizet, int out_sizet, SampleRateCorrectionMode sampleRateCorr, int rankt>
+void GRULayerT<T, in_sizet, out_sizet, sampleRateCorr, rankt>::setWVals(const std::vector<std::vector<T>>& wVals)
 {
     for(int i = 0; i < in_size; ++i)
-    {
-        for(int j = 0; j < out_size; ++j)
-        {
-            Wz[j][i] = wVals[i][j];
-            Wr[j][i] = wVals[i][j + out_size];
-            Wh[j][i] = wVals[i][j + 2 * out_size];
-        }
-    }
-
-    for(int j = 0; j < out_size; ++j)
-    {
-        Wz_1[j] = wVals[0][j];
-        Wr_1[j] = wVals[0][j + out_size];
-        Wh_1[j] = wVals[0][j + 2 * out_size];
-    }
+        for(int k = 0; k < 3 * out_size; ++k)
+            W[i][k] = wVals[i][k];
 }
 
 // recurrent weights
-template <typename T, int in_sizet, int out_sizet, SampleRateCorrectionMode sampleRateCorr>
-void GRULayerT<T, in_sizet, out_sizet, sampleRateCorr>::setUVals(const std::vector<std::vector<T>>& uVals)
+template <typename T, int in_sizet, int out_sizet, SampleRateCorrectionMode sampleRateCorr, int rankt>
+void GRULayerT<T, in_sizet, out_sizet, sampleRateCorr, rankt>::setUVals(const std::vector<std::vector<T>>& uVals)
 {
     for(int i = 0; i < out_size; ++i)
+        for(int k = 0; k < 3 * out_size; ++k)
+            U[i][k] = uVals[i][k];
+
+    if(rankt > 0)
     {
-        for(int j = 0; j < out_size; ++j)
-        {
-            Uz[j][i] = uVals[i][j];
-            Ur[j][i] = uVals[i][j + out_size];
-            Uh[j][i] = uVals[i][j + 2 * out_size];
-        }
+        low_rank_error = lowRankU.setWeights([&uVals](int k, int i)
+            { return uVals[i][k]; });
     }
 }
 
 // biases
-template <typename T, int in_sizet, int out_sizet, SampleRateCorrectionMode sampleRateCorr>
-void GRULayerT<T, in_sizet, out_sizet, sampleRateCorr>::setBVals(const std::vector<std::vector<T>>& bVals)
+template <typename T, int in_sizet, int out_sizet, SampleRateCorrectionMode sampleRateCorr, int rankt>
+void GRULayerT<T, in_sizet, out_sizet, sampleRateCorr, rankt>::setBVals(const std::vector<std::vector<T>>& bVals)
 {
-    for(int k = 0; k < out_size; ++k)
+    // the recurrent biases of z and r don't depend on the reset gate, so they are folded into the kernel biases
+    for(int k = 0; k < 2 * out_size; ++k)
+    {
+        bx[k] = bVals[0][k] + bVals[1][k];
+        bh[k] = (T)0;
+    }
+
+    for(int k = 2 * out_size; k < 3 * out_size; ++k)
     {
-        bz[k] = bVals[0][k] + bVals[1][k];
-        br[k] = bVals[0][k + out_size] + bVals[1][k + out_size];
-        bh0[k] = bVals[0][k + 2 * out_size];
-        bh1[k] = bVals[1][k + 2 * out_size];
+        bx[k] = bVals[0][k];
+        bh[k] = bVals[1][k];
     }
 }
 
@@ -23,6 +23,15 @@ public:
     /** Resets the state of the GRU. */
     void reset() override { std::fill(ht1, ht1 + Layer<T>::out_size, (T)0); }
 
+    /** Returns the number of values in a snapshot of the layer state. */
+    int getStateSize() const noexcept override { return Layer<T>::out_size; }
+
+    /** Copies the layer state into a buffer of getStateSize() values. */
+    void getState(T* stateOut) const noexcept override { std::copy(ht1, ht1 + Layer<T>::out_size, stateOut); }
+
+    /** Restores the layer state from a buffer written by getState(). */
+    void setState(const T* stateIn) noexcept override { std::copy(stateIn, stateIn + Layer<T>::out_size, ht1); }
+
     /** Returns the name of this layer. */
     std::string getName() const noexcept override { return "gru"; }
 
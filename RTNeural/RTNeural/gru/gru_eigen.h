@@ -2,7 +2,9 @@
 #define GRUEIGEN_H_INCLUDED
 
 #include "../Layer.h"
+#include "../block_sparse.h"
 #include "../common.h"
+#include "../low_rank.h"
 
 namespace RTNeural
 {
@@ -14,6 +16,10 @@ namespace RTNeural
  * To ensure that the recurrent state is initialized to zero,
  * please make sure to call `reset()` before your first call to
  * the `forward()` method.
+ *
+ * The kernel and recurrent weights of the three gates are stacked
+ * into single [3 * out_size x in_size] and [3 * out_size x out_size]
+ * matrices, so that each forward pass is two matrix-vector products.
  */
 template <typename T>
 class GRULayer : public Layer<T>
@@ -32,6 +38,15 @@ public:
         std::fill(ht1.data(), ht1.data() + Layer<T>::out_size, (T)0);
     }
 
+    /** Returns the number of values in a snapshot of the layer state. */
+    int getStateSize() const noexcept override { return Layer<T>::out_size; }
+
+    /** Copies the layer state into a buffer of getStateSize() values. */
+    void getState(T* stateOut) const noexcept override { std::copy(ht1.data(), ht1.data() + Layer<T>::out_size, stateOut); }
+
+    /** Restores the layer state from a buffer written by getState(). */
+    void setState(const T* stateIn) noexcept override { std::copy(stateIn, stateIn + Layer<T>::out_size, ht1.data()); }
+
     /** Returns the name of this layer. */
     std::string getName() const noexcept override { return "gru"; }
 
@@ -41,13 +56,30 @@ public:
         inVec = Eigen::Map<const Eigen::Matrix<T, Eigen::Dynamic, 1>, RTNeuralEigenAlignment>(
             input, Layer<T>::in_size, 1);
 
-        zVec.noalias() = wVec_z * inVec + uVec_z * ht1 + bVec_z.col(0) + bVec_z.col(1);
-        rVec.noalias() = wVec_r * inVec + uVec_r * ht1 + bVec_r.col(0) + bVec_r.col(1);
+        // stacked [z, r, c] pre-activations of the input and of the recurrent state
+        xVec.noalias() = wVec * inVec + bVec.col(0);
+        if(!lowRankU.isEmpty())
+        {
+            lowRankU.multiply(ht1.data(), hVec.data());
+            hVec += bVec.col(1);
+        }
+        else if(!sparseU.isEmpty())
+        {
+            sparseU.multiply(ht1.data(), hVec.data());
+            hVec += bVec.col(1);
+        }
+        else
+        {
+            hVec.noalias() = uVec * ht1 + bVec.col(1);
+        }
+
+        const auto out_size = Layer<T>::out_size;
+        zVec = xVec.head(out_size) + hVec.head(out_size);
+        rVec = xVec.segment(out_size, out_size) + hVec.segment(out_size, out_size);
         sigmoid(zVec);
         sigmoid(rVec);
 
-        cVec.noalias() = wVec_c * inVec + rVec.cwiseProduct(uVec_c * ht1 + bVec_c.col(1)) + bVec_c.col(0);
-        cVec = cVec.array().tanh();
+        cVec = (xVec.tail(out_size) + rVec.cwiseProduct(hVec.tail(out_size))).array().tanh();
 
         ht1 = (ones - zVec).cwiseProduct(cVec) + zVec.cwiseProduct(ht1);
         std::copy(ht1.data(), ht1.data() + Layer<T>::out_size, h);
@@ -87,16 +119,47 @@ public:
     T getUVal(int i, int k) const noexcept;
     T getBVal(int i, int k) const noexcept;
 
+    /**
+     * Runs this layer with block-sparse recurrent weights (see BlockSparseMatrix)
+     * when at most `max_density` of their blocks contain a non-zero weight, and
+     * returns true if it does. The check is repeated whenever the recurrent
+     * weights are set. Pass 0 to go back to the dense weights.
+     */
+    bool useSparseWeights(T max_density)
+    {
+        sparse_max_density = max_density;
+        return updateSparseWeights();
+    }
+
+    /** Returns true if this layer is running with block-sparse recurrent weights. */
+    bool hasSparseWeights() const noexcept { return !sparseU.isEmpty(); }
+
+    /**
+     * Runs this layer with low-rank recurrent weights (see LowRankMatrix), with
+     * the smallest rank whose relative error is at most `tolerance`, and returns
+     * true if that rank makes the recurrent product cheaper. The factorization
+     * is repeated whenever the recurrent weights are set, and takes precedence
+     * over block-sparse weights. Pass 0 to go back to the full-rank weights.
+     */
+    bool useLowRankWeights(T tolerance)
+    {
+        low_rank_tolerance = tolerance;
+        return updateLowRankWeights();
+    }
+
+    /** Returns the rank of the recurrent weights, or 0 if they are full-rank. */
+    int getLowRank() const noexcept { return lowRankU.getRank(); }
+
 private:
-    Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic> wVec_z;
-    Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic> wVec_r;
-    Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic> wVec_c;
-    Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic> uVec_z;
-    Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic> uVec_r;
-    Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic> uVec_c;
-    Eigen::Matrix<T, Eigen::Dynamic, 2> bVec_z;
-    Eigen::Matrix<T, Eigen::Dynamic, 2> bVec_r;
-    Eigen::Matrix<T, Eigen::Dynamic, 2> bVec_c;
+    bool updateSparseWeights();
+    bool updateLowRankWeights();
+
+    Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic> wVec; // [3 * out_size x in_size]
+    Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic> uVec; // [3 * out_size x out_size]
+    Eigen::Matrix<T, Eigen::Dynamic, 2> bVec; // [3 * out_size x 2]
+
+    Eigen::Matrix<T, Eigen::Dynamic, 1> xVec;
+    Eigen::Matrix<T, Eigen::Dynamic, 1> hVec;
 
     Eigen::Matrix<T, Eigen::Dynamic, 1> ht1;
     Eigen::Matrix<T, Eigen::Dynamic, 1> zVec;
@@ -105,6 +168,12 @@ private:
 
     Eigen::Matrix<T, Eigen::Dynamic, 1> inVec;
     Eigen::Matrix<T, Eigen::Dynamic, 1> ones;
+
+    BlockSparseMatrix<T> sparseU;
+    T sparse_max_density = (T)0;
+
+    LowRankMatrix<T> lowRankU;
+    T low_rank_tolerance = (T)0;
 };
 
 //====================================================
@@ -115,13 +184,19 @@ private:
  * To ensure that the recurrent state is initialized to zero,
  * please make sure to call `reset()` before your first call to
  * the `forward()` method.
+ *
+ * The weights of the three gates are stacked, as in GRULayer.
+ * With `rankt > 0`, setUVals() replaces the recurrent weights with a
+ * rank-`rankt` factorization U ~= A * B (see LowRankMatrixT), so that
+ * the recurrent product takes 4 * out_size * rankt operations instead
+ * of 3 * out_size * out_size.
  */
-template <typename T, int in_sizet, int out_sizet, SampleRateCorrectionMode sampleRateCorr = SampleRateCorrectionMode::None>
+template <typename T, int in_sizet, int out_sizet, SampleRateCorrectionMode sampleRateCorr = SampleRateCorrectionMode::None, int rankt = 0>
 class GRULayerT
 {
-    using b_type = Eigen::Matrix<T, out_sizet, 1>;
-    using k_type = Eigen::Matrix<T, out_sizet, in_sizet>;
-    using r_type = Eigen::Matrix<T, out_sizet, out_sizet>;
+    using b_type = Eigen::Matrix<T, 3 * out_sizet, 1>;
+    using k_type = Eigen::Matrix<T, 3 * out_sizet, in_sizet>;
+    using r_type = Eigen::Matrix<T, 3 * out_sizet, out_sizet>;
 
     using in_type = Eigen::Matrix<T, in_sizet, 1>;
     using out_type = Eigen::Matrix<T, out_sizet, 1>;
@@ -151,14 +226,37 @@ public:
     /** Resets the state of the GRU. */
     void reset();
 
+    /**
+     * Returns the number of values in a snapshot of the layer state.
+     * With sample rate correction, the short delay line used for the
+     * correction is not part of the snapshot.
+     */
+    static constexpr int getStateSize() noexcept { return out_size; }
+
+    /** Copies the layer state into a buffer of getStateSize() values. */
+    void getState(T* stateOut) const noexcept { std::copy(outs.data(), outs.data() + out_size, stateOut); }
+
+    /** Restores the layer state from a buffer written by getState(). */
+    void setState(const T* stateIn) noexcept { std::copy(stateIn, stateIn + out_size, outs.data()); }
+
     /** Performs forward propagation for this layer. */
     inline void forward(const in_type& ins) noexcept
     {
-        zVec.noalias() = sigmoid(wVec_z * ins + uVec_z * outs + bVec_z);
-        rVec.noalias() = sigmoid(wVec_r * ins + uVec_r * outs + bVec_r);
-
-        cVec.noalias() = wVec_c * ins + rVec.cwiseProduct(uVec_c * outs + bVec_c1) + bVec_c0;
-        cVec = cVec.array().tanh();
+        // stacked [z, r, c] pre-activations of the input and of the recurrent state
+        xVec.noalias() = kernelWeights() * ins + bVec_x;
+        if(rankt > 0)
+        {
+            lowRankU.multiply(outs.data(), hVec.data());
+            hVec += bVec_h;
+        }
+        else
+        {
+            hVec.noalias() = recurrentWeights() * outs + bVec_h;
+        }
+
+        zVec = sigmoid(xVec.template head<out_size>() + hVec.template head<out_size>());
+        rVec = sigmoid(xVec.template segment<out_size>(out_size) + hVec.template segment<out_size>(out_size));
+        cVec = (xVec.template tail<out_size>() + rVec.cwiseProduct(hVec.template tail<out_size>())).array().tanh();
 
         computeOutput();
     }
@@ -184,6 +282,12 @@ public:
      */
     void setBVals(const std::vector<std::vector<T>>& bVals);
 
+    /**
+     * Returns the error of the low-rank recurrent weights, relative to
+     * the norm of the weights passed to setUVals() (0 with full rank).
+     */
+    T getLowRankError() const noexcept { return low_rank_error; }
+
     Eigen::Map<out_type, RTNeuralEigenAlignment> outs;
 
 private:
@@ -200,29 +304,27 @@ private:
     inline std::enable_if_t<srCorr != SampleRateCorrectionMode::None, void>
     computeOutput() noexcept
     {
-        outs_delayed[delayWriteIdx] = (out_type::Ones() - zVec).cwiseProduct(cVec) + zVec.cwiseProduct(outs);
+        outs_delayed.write() = (out_type::Ones() - zVec).cwiseProduct(cVec) + zVec.cwiseProduct(outs);
 
-        processDelay(outs_delayed, outs, delayWriteIdx);
+        processDelay(outs_delayed, outs);
     }
 
+    using delay_type = SampleRateCorrectionDelay<out_type, Eigen::aligned_allocator<out_type>>;
+
     template <typename OutVec, SampleRateCorrectionMode srCorr = sampleRateCorr>
     inline std::enable_if_t<srCorr == SampleRateCorrectionMode::NoInterp, void>
-    processDelay(std::vector<out_type>& delayVec, OutVec& out, int delayWriteIndex) noexcept
+    processDelay(delay_type& delay, OutVec& out) noexcept
     {
-        out = delayVec[0];
-
-        for(int j = 0; j < delayWriteIndex; ++j)
-            delayVec[j] = delayVec[j + 1];
+        out = delay.read(maxDelay);
+        delay.advance();
     }
 
     template <typename OutVec, SampleRateCorrectionMode srCorr = sampleRateCorr>
     inline std::enable_if_t<srCorr == SampleRateCorrectionMode::LinInterp, void>
-    processDelay(std::vector<out_type>& delayVec, OutVec& out, int delayWriteIndex) noexcept
+    processDelay(delay_type& delay, OutVec& out) noexcept
     {
-        out = delayPlus1Mult * delayVec[0] + delayMult * delayVec[1];
-
-        for(int j = 0; j < delayWriteIndex; ++j)
-            delayVec[j] = delayVec[j + 1];
+        out = delayPlus1Mult * delay.read(maxDelay) + delayMult * delay.read(maxDelay - 1);
+        delay.advance();
     }
 
     static inline out_type sigmoid(const out_type& x) noexcept
@@ -230,29 +332,34 @@ private:
         return (T)1 / (((T)-1 * x.array()).array().exp() + (T)1);
     }
 
-    // kernel weights
-    k_type wVec_z;
-    k_type wVec_r;
-    k_type wVec_c;
+    using k_map_type = Eigen::Map<k_type, RTNeuralEigenAlignment>;
+    using r_map_type = Eigen::Map<r_type, RTNeuralEigenAlignment>;
+    k_map_type kernelWeights() noexcept { return k_map_type(wVec_internal); }
+    r_map_type recurrentWeights() noexcept { return r_map_type(uVec_internal); }
+
+    // stacked [z, r, c] kernel and recurrent weights, stored column-major (the
+    // stacked matrices can be larger than Eigen allows for a fixed-size matrix)
+    T wVec_internal alignas(RTNEURAL_DEFAULT_ALIGNMENT)[3 * out_size * in_size];
+    T uVec_internal alignas(RTNEURAL_DEFAULT_ALIGNMENT)[3 * out_size * out_size];
+
+    // low-rank recurrent weights
+    LowRankMatrixT<T, 3 * out_sizet, out_sizet, rankt> lowRankU;
+    T low_rank_error = (T)0;
 
-    // recurrent weights
-    r_type uVec_z;
-    r_type uVec_r;
-    r_type uVec_c;
+    // stacked kernel and recurrent biases
+    b_type bVec_x;
+    b_type bVec_h;
 
-    // biases
-    b_type bVec_z;
-    b_type bVec_r;
-    b_type bVec_c0;
-    b_type bVec_c1;
+    b_type xVec;
+    b_type hVec;
 
     out_type zVec;
     out_type rVec;
     out_type cVec;
 
     // needed for delays when doing sample rate correction
-    std::vector<out_type> outs_delayed;
-    int delayWriteIdx = 0;
+    delay_type outs_delayed;
+    int maxDelay = 0;
     T delayMult = (T)1;
     T delayPlus1Mult = (T)0;
 };
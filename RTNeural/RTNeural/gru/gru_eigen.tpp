@@ -9,15 +9,12 @@ template <typename T>
 GRULayer<T>::GRULayer(int in_size, int out_size)
     : Layer<T>(in_size, out_size)
 {
-    wVec_z = Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>::Zero(out_size, in_size);
-    wVec_r = Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>::Zero(out_size, in_size);
-    wVec_c = Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>::Zero(out_size, in_size);
-    uVec_z = Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>::Zero(out_size, out_size);
-    uVec_r = Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>::Zero(out_size, out_size);
-    uVec_c = Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>::Zero(out_size, out_size);
-    bVec_z = Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>::Zero(out_size, 2);
-    bVec_r = Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>::Zero(out_size, 2);
-    bVec_c = Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>::Zero(out_size, 2);
+    wVec = Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>::Zero(3 * out_size, in_size);
+    uVec = Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>::Zero(3 * out_size, out_size);
+    bVec = Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>::Zero(3 * out_size, 2);
+
+    xVec = Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>::Zero(3 * out_size, 1);
+    hVec = Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>::Zero(3 * out_size, 1);
 
     ht1 = Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>::Zero(out_size, 1);
     zVec = Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>::Zero(out_size, 1);
@@ -50,176 +47,134 @@ template <typename T>
 void GRULayer<T>::setWVals(const std::vector<std::vector<T>>& wVals)
 {
     for(int i = 0; i < Layer<T>::in_size; ++i)
-    {
-        for(int k = 0; k < Layer<T>::out_size; ++k)
-        {
-            wVec_z(k, i) = wVals[i][k];
-            wVec_r(k, i) = wVals[i][k + Layer<T>::out_size];
-            wVec_c(k, i) = wVals[i][k + Layer<T>::out_size * 2];
-        }
-    }
+        for(int k = 0; k < 3 * Layer<T>::out_size; ++k)
+            wVec(k, i) = wVals[i][k];
 }
 
 template <typename T>
 void GRULayer<T>::setWVals(T** wVals)
 {
     for(int i = 0; i < Layer<T>::in_size; ++i)
-    {
-        for(int k = 0; k < Layer<T>::out_size; ++k)
-        {
-            wVec_z(k, i) = wVals[i][k];
-            wVec_r(k, i) = wVals[i][k + Layer<T>::out_size];
-            wVec_c(k, i) = wVals[i][k + Layer<T>::out_size * 2];
-        }
-    }
+        for(int k = 0; k < 3 * Layer<T>::out_size; ++k)
+            wVec(k, i) = wVals[i][k];
 }
 
 template <typename T>
 void GRULayer<T>::setUVals(const std::vector<std::vector<T>>& uVals)
 {
     for(int i = 0; i < Layer<T>::out_size; ++i)
-    {
-        for(int k = 0; k < Layer<T>::out_size; ++k)
-        {
-            uVec_z(k, i) = uVals[i][k];
-            uVec_r(k, i) = uVals[i][k + Layer<T>::out_size];
-            uVec_c(k, i) = uVals[i][k + Layer<T>::out_size * 2];
-        }
-    }
+        for(int k = 0; k < 3 * Layer<T>::out_size; ++k)
+            uVec(k, i) = uVals[i][k];
+
+    updateSparseWeights();
+    updateLowRankWeights();
 }
 
 template <typename T>
 void GRULayer<T>::setUVals(T** uVals)
 {
     for(int i = 0; i < Layer<T>::out_size; ++i)
-    {
-        for(int k = 0; k < Layer<T>::out_size; ++k)
-        {
-            uVec_z(k, i) = uVals[i][k];
-            uVec_r(k, i) = uVals[i][k + Layer<T>::out_size];
-            uVec_c(k, i) = uVals[i][k + Layer<T>::out_size * 2];
-        }
-    }
+        for(int k = 0; k < 3 * Layer<T>::out_size; ++k)
+            uVec(k, i) = uVals[i][k];
+
+    updateSparseWeights();
+    updateLowRankWeights();
 }
 
 template <typename T>
 void GRULayer<T>::setBVals(const std::vector<std::vector<T>>& bVals)
 {
     for(int i = 0; i < 2; ++i)
-    {
-        for(int k = 0; k < Layer<T>::out_size; ++k)
-        {
-            bVec_z(k, i) = bVals[i][k];
-            bVec_r(k, i) = bVals[i][k + Layer<T>::out_size];
-            bVec_c(k, i) = bVals[i][k + Layer<T>::out_size * 2];
-        }
-    }
+        for(int k = 0; k < 3 * Layer<T>::out_size; ++k)
+            bVec(k, i) = bVals[i][k];
 }
 
 template <typename T>
 void GRULayer<T>::setBVals(T** bVals)
 {
     for(int i = 0; i < 2; ++i)
-    {
-        for(int k = 0; k < Layer<T>::out_size; ++k)
-        {
-            bVec_z(k, i) = bVals[i][k];
-            bVec_r(k, i) = bVals[i][k + Layer<T>::out_size];
-            bVec_c(k, i) = bVals[i][k + Layer<T>::out_size * 2];
-        }
-    }
+        for(int k = 0; k < 3 * Layer<T>::out_size; ++k)
+            bVec(k, i) = bVals[i][k];
 }
 
 template <typename T>
-T GRULayer<T>::getWVal(int i, int k) const noexcept
+bool GRULayer<T>::updateSparseWeights()
 {
-    Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic> set = wVec_z;
-    if(k > 2 * Layer<T>::out_size)
-        set = wVec_c;
-    else if(k > Layer<T>::out_size)
-        set = wVec_r;
+    return sparseU.setWeights(3 * Layer<T>::out_size, Layer<T>::out_size, sparse_max_density, [this](int k, int i)
+        { return uVec(k, i); });
+}
 
-    return set(k % Layer<T>::out_size, i);
+template <typename T>
+bool GRULayer<T>::updateLowRankWeights()
+{
+    return lowRankU.setWeightsForTolerance(3 * Layer<T>::out_size, Layer<T>::out_size, low_rank_tolerance, [this](int k, int i)
+        { return uVec(k, i); });
 }
 
 template <typename T>
-T GRULayer<T>::getUVal(int i, int k) const noexcept
+T GRULayer<T>::getWVal(int i, int k) const noexcept
 {
-    Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic> set = uVec_z;
-    if(k > 2 * Layer<T>::out_size)
-        set = uVec_c;
-    else if(k > Layer<T>::out_size)
-        set = uVec_r;
+    return wVec(k, i);
+}
 
-    return set(k % Layer<T>::out_size, i);
+template <typename T>
+T GRULayer<T>::getUVal(int i, int k) const noexcept
+{
+    return uVec(k, i);
 }
 
 template <typename T>
 T GRULayer<T>::getBVal(int i, int k) const noexcept
 {
-    Eigen::Matrix<T, Eigen::Dynamic, 2> set = bVec_z;
-    if(k > 2 * Layer<T>::out_size)
-        set = bVec_c;
-    else if(k > Layer<T>::out_size)
-        set = bVec_r;
-
-    return set(k % Layer<T>::out_size, i);
+    return bVec(k, i);
 }
 
 //====================================================
-template <typename T, int in_sizet, int out_sizet, SampleRateCorrectionMode sampleRateCorr>
-GRULayerT<T, in_sizet, out_sizet, sampleRateCorr>::GRULayerT()
+template <typename T, int in_sizet, int out_sizet, SampleRateCorrectionMode sampleRateCorr, int rankt>
+GRULayerT<T, in_sizet, out_sizet, sampleRateCorr, rankt>::GRULayerT()
     : outs(outs_internal)
 {
-    wVec_z = k_type::Zero();
-    wVec_r = k_type::Zero();
-    wVec_c = k_type::Zero();
-
-    uVec_z = r_type::Zero();
-    uVec_r = r_type::Zero();
-    uVec_c = r_type::Zero();
+    kernelWeights().setZero();
+    recurrentWeights().setZero();
 
-    bVec_z = b_type::Zero();
-    bVec_r = b_type::Zero();
-    bVec_c0 = b_type::Zero();
-    bVec_c1 = b_type::Zero();
+    bVec_x = b_type::Zero();
+    bVec_h = b_type::Zero();
 
     reset();
 }
 
-template <typename T, int in_sizet, int out_sizet, SampleRateCorrectionMode sampleRateCorr>
+template <typename T, int in_sizet, int out_sizet, SampleRateCorrectionMode sampleRateCorr, int rankt>
 template <SampleRateCorrectionMode srCorr>
 std::enable_if_t<srCorr == SampleRateCorrectionMode::NoInterp, void>
-GRULayerT<T, in_sizet, out_sizet, sampleRateCorr>::prepare(int delaySamples)
+GRULayerT<T, in_sizet, out_sizet, sampleRateCorr, rankt>::prepare(int delaySamples)
 {
-    delayWriteIdx = delaySamples - 1;
-    outs_delayed.resize(delayWriteIdx + 1, {});
+    maxDelay = delaySamples - 1;
+    outs_delayed.prepare(maxDelay);
 
     reset();
 }
 
-template <typename T, int in_sizet, int out_sizet, SampleRateCorrectionMode sampleRateCorr>
+template <typename T, int in_sizet, int out_sizet, SampleRateCorrectionMode sampleRateCorr, int rankt>
 template <SampleRateCorrectionMode srCorr>
 std::enable_if_t<srCorr == SampleRateCorrectionMode::LinInterp, void>
-GRULayerT<T, in_sizet, out_sizet, sampleRateCorr>::prepare(T delaySamples)
+GRULayerT<T, in_sizet, out_sizet, sampleRateCorr, rankt>::prepare(T delaySamples)
 {
     const auto delayOffFactor = delaySamples - std::floor(delaySamples);
     delayMult = (T)1 - delayOffFactor;
     delayPlus1Mult = delayOffFactor;
 
-    delayWriteIdx = (int)std::ceil(delaySamples) - (int)std::ceil(delayOffFactor);
-    outs_delayed.resize(delayWriteIdx + 1, {});
+    maxDelay = (int)std::ceil(delaySamples) - (int)std::ceil(delayOffFactor);
+    outs_delayed.prepare(maxDelay);
 
     reset();
 }
 
-template <typename T, int in_sizet, int out_sizet, SampleRateCorrectionMode sampleRateCorr>
-void GRULayerT<T, in_sizet, out_sizet, sampleRateCorr>::reset()
+template <typename T, int in_sizet, int out_sizet, SampleRateCorrectionMode sampleRateCorr, int rankt>
+void GRULayerT<T, in_sizet, out_sizet, sampleRateCorr, rankt>::reset()
 {
     if(sampleRateCorr != SampleRateCorrectionMode::None)
     {
-        for(auto& vec : outs_delayed)
-            vec = out_type::Zero();
+        outs_delayed.fill(out_type::Zero());
     }
 
     // reset output state
@@ -227,45 +182,44 @@ void GRULayerT<T, in_sizet, out_sizet, sampleRateCorr>::reset()
 }
 
 // kernel weights
-template <typename T, int in_sizet, int out_sizet, SampleRateCorrectionMode sampleRateCorr>
-void GRULayerT<T, in_sizet, out_sizet, sampleRateCorr>::setWVals(const std::vector<std::vector<T>>& wVals)
+template <typename T, int in_sizet, int out_sizet, SampleRateCorrectionMode sampleRateCorr, int rankt>
+void GRULayerT<T, in_sizet, out_sizet, sampleRateCorr, rankt>::setWVals(const std::vector<std::vector<T>>& wVals)
 {
     for(int i = 0; i < in_size; ++i)
-    {
-        for(int k = 0; k < out_size; ++k)
-        {
-            wVec_z(k, i) = wVals[i][k];
-            wVec_r(k, i) = wVals[i][k + out_size];
-            wVec_c(k, i) = wVals[i][k + out_size * 2];
-        }
-    }
+        for(int k = 0; k < 3 * out_size; ++k)
+            kernelWeights()(k, i) = wVals[i][k];
 }
 
 // recurrent weights
-template <typename T, int in_sizet, int out_sizet, SampleRateCorrectionMode sampleRateCorr>
-void GRULayerT<T, in_sizet, out_sizet, sampleRateCorr>::setUVals(const std::vector<std::vector<T>>& uVals)
+template <typename T, int in_sizet, int out_sizet, SampleRateCorrectionMode sampleRateCorr, int rankt>
+void GRULayerT<T, in_sizet, out_sizet, sampleRateCorr, rankt>::setUVals(const std::vector<std::vector<T>>& uVals)
 {
     for(int i = 0; i < out_size; ++i)
+        for(int k = 0; k < 3 * out_size; ++k)
+            recurrentWeights()(k, i) = uVals[i][k];
+
+    if(rankt > 0)
     {
-        for(int k = 0; k < out_size; ++k)
-        {
-            uVec_z(k, i) = uVals[i][k];
-            uVec_r(k, i) = uVals[i][k + out_size];
-            uVec_c(k, i) = uVals[i][k + out_size * 2];
-        }
+        low_rank_error = lowRankU.setWeights([&uVals](int k, int i)
+            { return uVals[i][k]; });
     }
 }
 
 // biases
-template <typename T, int in_sizet, int out_sizet, SampleRateCorrectionMode sampleRateCorr>
-void GRULayerT<T, in_sizet, out_sizet, sampleRateCorr>::setBVals(const std::vector<std::vector<T>>& bVals)
+template <typename T, int in_sizet, int out_sizet, SampleRateCorrectionMode sampleRateCorr, int rankt>
+void GRULayerT<T, in_sizet, out_sizet, sampleRateCorr, rankt>::setBVals(const std::vector<std::vector<T>>& bVals)
 {
-    for(int k = 0; k < out_size; ++k)
+    // the recurrent biases of z and r don't depend on the reset gate, so they are folded into the kernel biases
+    for(int k = 0; k < 2 * out_size; ++k)
+    {
+        bVec_x(k) = bVals[0][k] + bVals[1][k];
+        bVec_h(k) = (T)0;
+    }
+
+    for(int k = 2 * out_size; k < 3 * out_size; ++k)
     {
-        bVec_z(k) = bVals[0][k] + bVals[1][k];
-        bVec_r(k) = bVals[0][k + out_size] + bVals[1][k + out_size];
-        bVec_c0(k) = bVals[0][k + 2 * out_size];
-        bVec_c1(k) = bVals[1][k + 2 * out_size];
+        bVec_x(k) = bVals[0][k];
+        bVec_h(k) = bVals[1][k];
     }
 }
 
@@ -2,7 +2,9 @@
 #define GRUXSIMD_H_INCLUDED
 
 #include "../Layer.h"
+#include "../block_sparse.h"
 #include "../common.h"
+#include "../low_rank.h"
 #include <vector>
 namespace RTNeural
 {
@@ -14,6 +16,11 @@ namespace RTNeural
  * To ensure that the recurrent state is initialized to zero,
  * please make sure to call `reset()` before your first call to
  * the `forward()` method.
+ *
+ * The kernel and recurrent weights of the three gates are stacked
+ * into single [3 * out_size x in_size] and [3 * out_size x out_size]
+ * matrices, so that each forward pass streams the input and the
+ * state once.
  */
 template <typename T>
 class GRULayer : public Layer<T>
@@ -29,33 +36,53 @@ public:
     /** Resets the state of the GRU. */
     void reset() override { std::fill(ht1.begin(), ht1.end(), (T)0); }
 
+    /** Returns the number of values in a snapshot of the layer state. */
+    int getStateSize() const noexcept override { return Layer<T>::out_size; }
+
+    /** Copies the layer state into a buffer of getStateSize() values. */
+    void getState(T* stateOut) const noexcept override { std::copy(ht1.data(), ht1.data() + Layer<T>::out_size, stateOut); }
+
+    /** Restores the layer state from a buffer written by getState(). */
+    void setState(const T* stateIn) noexcept override { std::copy(stateIn, stateIn + Layer<T>::out_size, ht1.data()); }
+
     /** Returns the name of this layer. */
     std::string getName() const noexcept override { return "gru"; }
 
     /** Performs forward propagation for this layer. */
     inline void forward(const T* input, T* h) noexcept override
     {
-        for(int i = 0; i < Layer<T>::out_size; ++i)
+        const auto out_size = Layer<T>::out_size;
+
+        // stacked [z, r, c] pre-activations of the input and of the recurrent state
+        for(int k = 0; k < 3 * out_size; ++k)
+            xVec[k] = vMult(W[k].data(), input, prod_in.data(), Layer<T>::in_size);
+
+        if(!lowRankU.isEmpty())
+        {
+            lowRankU.multiply(ht1.data(), hVec.data());
+        }
+        else if(!sparseU.isEmpty())
         {
-            zVec[i] = vMult(zWeights.W[i].data(), input, prod_in.data(), Layer<T>::in_size) + vMult(zWeights.U[i].data(), ht1.data(), prod_out.data(), Layer<T>::out_size);
-            rVec[i] = vMult(rWeights.W[i].data(), input, prod_in.data(), Layer<T>::in_size) + vMult(rWeights.U[i].data(), ht1.data(), prod_out.data(), Layer<T>::out_size);
-            cVec[i] = vMult(cWeights.W[i].data(), input, prod_in.data(), Layer<T>::in_size);
-            cTmp[i] = vMult(cWeights.U[i].data(), ht1.data(), prod_out.data(), Layer<T>::out_size);
+            sparseU.multiply(ht1.data(), hVec.data());
         }
+        else
+        {
+            for(int k = 0; k < 3 * out_size; ++k)
+                hVec[k] = vMult(U[k].data(), ht1.data(), prod_out.data(), out_size);
+        }
+
+        vAdd(xVec.data(), b[0].data(), xVec.data(), 3 * out_size);
+        vAdd(hVec.data(), b[1].data(), hVec.data(), 3 * out_size);
 
-        vAdd(zVec.data(), zWeights.b[0].data(), zVec.data(), Layer<T>::out_size);
-        vAdd(zVec.data(), zWeights.b[1].data(), zVec.data(), Layer<T>::out_size);
-        sigmoid(zVec.data(), zVec.data(), Layer<T>::out_size);
+        vAdd(xVec.data(), hVec.data(), zVec.data(), out_size);
+        sigmoid(zVec.data(), zVec.data(), out_size);
 
-        vAdd(rVec.data(), rWeights.b[0].data(), rVec.data(), Layer<T>::out_size);
-        vAdd(rVec.data(), rWeights.b[1].data(), rVec.data(), Layer<T>::out_size);
-        sigmoid(rVec.data(), rVec.data(), Layer<T>::out_size);
+        vAdd(xVec.data() + out_size, hVec.data() + out_size, rVec.data(), out_size);
+        sigmoid(rVec.data(), rVec.data(), out_size);
 
-        vAdd(cTmp.data(), cWeights.b[1].data(), cTmp.data(), Layer<T>::out_size);
-        vProd(cTmp.data(), rVec.data(), cTmp.data(), Layer<T>::out_size);
-        vAdd(cTmp.data(), cVec.data(), cVec.data(), Layer<T>::out_size);
-        vAdd(cVec.data(), cWeights.b[0].data(), cVec.data(), Layer<T>::out_size);
-        tanh(cVec.data(), cVec.data(), Layer<T>::out_size);
+        vProd(rVec.data(), hVec.data() + 2 * out_size, cVec.data(), out_size);
+        vAdd(cVec.data(), xVec.data() + 2 * out_size, cVec.data(), out_size);
+        tanh(cVec.data(), cVec.data(), out_size);
 
         vSub(ones.data(), zVec.data(), h, Layer<T>::out_size);
         vProd(h, cVec.data(), h, Layer<T>::out_size);
@@ -116,35 +143,67 @@ public:
     /** Returns the bias value for the given indices. */
     T getBVal(int i, int k) const noexcept;
 
+    /**
+     * Runs this layer with block-sparse recurrent weights (see BlockSparseMatrix)
+     * when at most `max_density` of their blocks contain a non-zero weight, and
+     * returns true if it does. The check is repeated whenever the recurrent
+     * weights are set. Pass 0 to go back to the dense weights.
+     */
+    bool useSparseWeights(T max_density)
+    {
+        sparse_max_density = max_density;
+        return updateSparseWeights();
+    }
+
+    /** Returns true if this layer is running with block-sparse recurrent weights. */
+    bool hasSparseWeights() const noexcept { return !sparseU.isEmpty(); }
+
+    /**
+     * Runs this layer with low-rank recurrent weights (see LowRankMatrix), with
+     * the smallest rank whose relative error is at most `tolerance`, and returns
+     * true if that rank makes the recurrent product cheaper. The factorization
+     * is repeated whenever the recurrent weights are set, and takes precedence
+     * over block-sparse weights. Pass 0 to go back to the full-rank weights.
+     */
+    bool useLowRankWeights(T tolerance)
+    {
+        low_rank_tolerance = tolerance;
+        return updateLowRankWeights();
+    }
+
+    /** Returns the rank of the recurrent weights, or 0 if they are full-rank. */
+    int getLowRank() const noexcept { return lowRankU.getRank(); }
+
 protected:
     using vec_type = std::vector<T, xsimd::aligned_allocator<T>>;
     using vec2_type = std::vector<vec_type>;
 
-    vec_type ht1;
+    bool updateSparseWeights();
+    bool updateLowRankWeights();
 
-    struct WeightSet
-    {
-        WeightSet(int in_size, int out_size);
-        ~WeightSet();
+    vec_type ht1;
 
-        vec2_type W; // kernel weights
-        vec2_type U; // recurrent weights
-        vec_type b[2]; // bias
-        const int out_size;
-    };
+    vec2_type W; // kernel weights [3 * out_size][in_size]
+    vec2_type U; // recurrent weights [3 * out_size][out_size]
+    vec_type b[2]; // bias [2][3 * out_size]
 
-    WeightSet zWeights;
-    WeightSet rWeights;
-    WeightSet cWeights;
+    vec_type xVec; // kernel pre-activations [3 * out_size]
+    vec_type hVec; // recurrent pre-activations [3 * out_size]
 
     vec_type zVec;
     vec_type rVec;
     vec_type cVec;
-    vec_type cTmp;
 
     vec_type prod_in;
     vec_type prod_out;
     vec_type ones;
+
+    // blocks as tall as a SIMD register
+    BlockSparseMatrix<T> sparseU { (int)xsimd::simd_type<T>::size };
+    T sparse_max_density = (T)0;
+
+    LowRankMatrix<T> lowRankU;
+    T low_rank_tolerance = (T)0;
 };
 
 //====================================================
@@ -155,14 +214,22 @@ protected:
  * To ensure that the recurrent state is initialized to zero,
  * please make sure to call `reset()` before your first call to
  * the `forward()` method.
+ *
+ * The weights of the three gates are stacked, as in GRULayer, with
+ * each gate padded to a whole number of SIMD registers.
+ * With `rankt > 0`, setUVals() replaces the recurrent weights with a
+ * rank-`rankt` factorization U ~= A * B (see LowRankMatrixT), so that
+ * the recurrent product takes 4 * out_size * rankt operations instead
+ * of 3 * out_size * out_size.
  */
-template <typename T, int in_sizet, int out_sizet, SampleRateCorrectionMode sampleRateCorr = SampleRateCorrectionMode::None>
+template <typename T, int in_sizet, int out_sizet, SampleRateCorrectionMode sampleRateCorr = SampleRateCorrectionMode::None, int rankt = 0>
 class GRULayerT
 {
     using v_type = xsimd::simd_type<T>;
     static constexpr auto v_size = (int)v_type::size;
     static constexpr auto v_in_size = ceil_div(in_sizet, v_size);
     static constexpr auto v_out_size = ceil_div(out_sizet, v_size);
+    static constexpr auto v_gates_size = 3 * v_out_size;
 
 public:
     static constexpr auto in_size = in_sizet;
@@ -189,51 +256,43 @@ public:
     /** Resets the state of the GRU. */
     void reset();
 
-    /** Performs forward propagation for this layer. */
-    template <int N = in_size>
-    inline typename std::enable_if<(N > 1), void>::type
-    forward(const v_type (&ins)[v_in_size]) noexcept
-    {
-        // compute zt
-        recurrent_mat_mul(outs, Uz, zt);
-        kernel_mat_mul(ins, Wz, kernel_outs);
-        for(int i = 0; i < v_out_size; ++i)
-            zt[i] = sigmoid(zt[i] + bz[i] + kernel_outs[i]);
+    /**
+     * Returns the number of values in a snapshot of the layer state.
+     * With sample rate correction, the short delay line used for the
+     * correction is not part of the snapshot.
+     */
+    static constexpr int getStateSize() noexcept { return v_out_size * v_size; }
 
-        // compute rt
-        recurrent_mat_mul(outs, Ur, rt);
-        kernel_mat_mul(ins, Wr, kernel_outs);
+    /** Copies the layer state into a buffer of getStateSize() values. */
+    void getState(T* stateOut) const noexcept
+    {
         for(int i = 0; i < v_out_size; ++i)
-            rt[i] = sigmoid(rt[i] + br[i] + kernel_outs[i]);
+            outs[i].store_unaligned(stateOut + i * v_size);
+    }
 
-        // compute h_hat
-        recurrent_mat_mul(outs, Uh, ct);
-        kernel_mat_mul(ins, Wh, kernel_outs);
+    /** Restores the layer state from a buffer written by getState(). */
+    void setState(const T* stateIn) noexcept
+    {
         for(int i = 0; i < v_out_size; ++i)
-            ht[i] = xsimd::tanh(xsimd::fma(rt[i], ct[i] + bh1[i], bh0[i] + kernel_outs[i]));
-
-        computeOutput();
+            outs[i] = xsimd::load_unaligned(stateIn + i * v_size);
     }
 
     /** Performs forward propagation for this layer. */
-    template <int N = in_size>
-    inline typename std::enable_if<N == 1, void>::type
-    forward(const v_type (&ins)[v_in_size]) noexcept
+    inline void forward(const v_type (&ins)[v_in_size]) noexcept
     {
-        // compute zt
-        recurrent_mat_mul(outs, Uz, zt);
-        for(int i = 0; i < v_out_size; ++i)
-            zt[i] = sigmoid(xsimd::fma(Wz_1[i], ins[0], zt[i] + bz[i]));
-
-        // compute rt
-        recurrent_mat_mul(outs, Ur, rt);
-        for(int i = 0; i < v_out_size; ++i)
-            rt[i] = sigmoid(xsimd::fma(Wr_1[i], ins[0], rt[i] + br[i]));
+        // stacked [z, r, c] pre-activations of the input and of the recurrent state
+        kernel_mat_mul(ins, W, bx, kernel_outs);
+        if(rankt > 0)
+            low_rank_mat_mul();
+        else
+            recurrent_mat_mul(outs, U, bh, recurrent_outs);
 
-        // compute h_hat
-        recurrent_mat_mul(outs, Uh, ct);
         for(int i = 0; i < v_out_size; ++i)
-            ht[i] = xsimd::tanh(xsimd::fma(rt[i], ct[i] + bh1[i], xsimd::fma(Wh_1[i], ins[0], bh0[i])));
+        {
+            zt[i] = sigmoid(kernel_outs[i] + recurrent_outs[i]);
+            const auto rt = sigmoid(kernel_outs[v_out_size + i] + recurrent_outs[v_out_size + i]);
+            ht[i] = xsimd::tanh(xsimd::fma(rt, recurrent_outs[2 * v_out_size + i], kernel_outs[2 * v_out_size + i]));
+        }
 
         computeOutput();
     }
@@ -259,6 +318,12 @@ public:
      */
     void setBVals(const std::vector<std::vector<T>>& bVals);
 
+    /**
+     * Returns the error of the low-rank recurrent weights, relative to
+     * the norm of the weights passed to setUVals() (0 with full rank).
+     */
+    T getLowRankError() const noexcept { return low_rank_error; }
+
     v_type outs[v_out_size];
 
 private:
@@ -274,72 +339,75 @@ private:
     inline std::enable_if_t<srCorr != SampleRateCorrectionMode::None, void>
     computeOutput() noexcept
     {
+        auto& delayIn = outs_delayed.write();
         for(int i = 0; i < v_out_size; ++i)
-            outs_delayed[delayWriteIdx][i] = xsimd::fma((v_type((T)1.0) - zt[i]), ht[i], zt[i] * outs[i]);
+            delayIn[i] = xsimd::fma((v_type((T)1.0) - zt[i]), ht[i], zt[i] * outs[i]);
 
-        processDelay(outs_delayed, outs, delayWriteIdx);
+        processDelay(outs_delayed, outs);
     }
 
+    using delay_type = SampleRateCorrectionDelay<std::array<v_type, v_out_size>, xsimd::aligned_allocator<std::array<v_type, v_out_size>>>;
+
     template <SampleRateCorrectionMode srCorr = sampleRateCorr>
     inline std::enable_if_t<srCorr == SampleRateCorrectionMode::NoInterp, void>
-    processDelay(std::vector<std::array<v_type, v_out_size>>& delayVec, v_type (&out)[v_out_size], int delayWriteIndex) noexcept
+    processDelay(delay_type& delay, v_type (&out)[v_out_size]) noexcept
     {
+        const auto& delayed = delay.read(maxDelay);
         for(int i = 0; i < v_out_size; ++i)
-            out[i] = delayVec[0][i];
+            out[i] = delayed[i];
 
-        for(int j = 0; j < delayWriteIndex; ++j)
-        {
-            for(int i = 0; i < v_out_size; ++i)
-                delayVec[j][i] = delayVec[j + 1][i];
-        }
+        delay.advance();
     }
 
     template <SampleRateCorrectionMode srCorr = sampleRateCorr>
     inline std::enable_if_t<srCorr == SampleRateCorrectionMode::LinInterp, void>
-    processDelay(std::vector<std::array<v_type, v_out_size>>& delayVec, v_type (&out)[v_out_size], int delayWriteIndex) noexcept
+    processDelay(delay_type& delay, v_type (&out)[v_out_size]) noexcept
     {
+        const auto& older = delay.read(maxDelay);
+        const auto& newer = delay.read(maxDelay - 1);
         for(int i = 0; i < v_out_size; ++i)
-            out[i] = delayPlus1Mult * delayVec[0][i] + delayMult * delayVec[1][i];
+            out[i] = delayPlus1Mult * older[i] + delayMult * newer[i];
 
-        for(int j = 0; j < delayWriteIndex; ++j)
-        {
-            for(int i = 0; i < v_out_size; ++i)
-                delayVec[j][i] = delayVec[j + 1][i];
-        }
+        delay.advance();
     }
 
-    static inline void recurrent_mat_mul(const v_type (&vec)[v_out_size], const v_type (&mat)[out_size][v_out_size], v_type (&out)[v_out_size]) noexcept
+    static inline void recurrent_mat_mul(const v_type (&vec)[v_out_size], const v_type (&mat)[out_size][v_gates_size], const v_type (&bias)[v_gates_size], v_type (&out)[v_gates_size]) noexcept
     {
-        for(int i = 0; i < v_out_size; ++i)
-            out[i] = v_type(0);
+        for(int i = 0; i < v_gates_size; ++i)
+            out[i] = bias[i];
 
-        T scalar_in alignas(RTNEURAL_DEFAULT_ALIGNMENT)[v_size] { (T)0 };
+        T scalar_in alignas(RTNEURAL_DEFAULT_ALIGNMENT)[v_out_size * v_size] { (T)0 };
         for(int k = 0; k < v_out_size; ++k)
-        {
-            vec[k].store_aligned(scalar_in);
-            for(int i = 0; i < v_out_size; ++i)
-            {
-                for(int j = 0; j < v_size; ++j)
-                    out[i] += scalar_in[j] * mat[k * v_size + j][i];
-            }
-        }
+            vec[k].store_aligned(scalar_in + k * v_size);
+
+        for(int k = 0; k < out_size; ++k)
+            for(int i = 0; i < v_gates_size; ++i)
+                out[i] = xsimd::fma(v_type(scalar_in[k]), mat[k][i], out[i]);
     }
 
-    static inline void kernel_mat_mul(const v_type (&vec)[v_in_size], const v_type (&mat)[in_size][v_out_size], v_type (&out)[v_out_size]) noexcept
+    /** Computes the stacked recurrent pre-activations with the low-rank weights. */
+    inline void low_rank_mat_mul() noexcept
     {
-        for(int i = 0; i < v_out_size; ++i)
-            out[i] = v_type(0);
+        for(int k = 0; k < v_out_size; ++k)
+            outs[k].store_aligned(scalar_outs + k * v_size);
 
-        T scalar_in alignas(RTNEURAL_DEFAULT_ALIGNMENT)[v_size] { (T)0 };
+        lowRankU.multiply(scalar_outs, scalar_gates);
+        for(int i = 0; i < v_gates_size; ++i)
+            recurrent_outs[i] = xsimd::load_aligned(scalar_gates + i * v_size) + bh[i];
+    }
+
+    static inline void kernel_mat_mul(const v_type (&vec)[v_in_size], const v_type (&mat)[in_size][v_gates_size], const v_type (&bias)[v_gates_size], v_type (&out)[v_gates_size]) noexcept
+    {
+        for(int i = 0; i < v_gates_size; ++i)
+            out[i] = bias[i];
+
+        T scalar_in alignas(RTNEURAL_DEFAULT_ALIGNMENT)[v_in_size * v_size] { (T)0 };
         for(int k = 0; k < v_in_size; ++k)
-        {
-            vec[k].store_aligned(scalar_in);
-            for(int i = 0; i < v_out_size; ++i)
-            {
-                for(int j = 0; j < v_size; ++j)
-                    out[i] += scalar_in[j] * mat[k * v_size + j][i];
-            }
-        }
+            vec[k].store_aligned(scalar_in + k * v_size);
+
+        for(int k = 0; k < in_size; ++k)
+            for(int i = 0; i < v_gates_size; ++i)
+                out[i] = xsimd::fma(v_type(scalar_in[k]), mat[k][i], out[i]);
     }
 
     static inline v_type sigmoid(v_type x) noexcept
@@ -347,37 +415,29 @@ private:
         return (T)1.0 / ((T)1.0 + xsimd::exp(-x));
     }
 
-    // kernel weights
-    v_type Wz[in_size][v_out_size];
-    v_type Wr[in_size][v_out_size];
-    v_type Wh[in_size][v_out_size];
-    v_type kernel_outs[v_out_size];
-
-    // single-input kernel weights
-    v_type Wz_1[v_out_size];
-    v_type Wr_1[v_out_size];
-    v_type Wh_1[v_out_size];
+    // stacked [z, r, c] kernel and recurrent weights
+    v_type W[in_size][v_gates_size];
+    v_type U[out_size][v_gates_size];
 
-    // recurrent weights
-    v_type Uz[out_size][v_out_size];
-    v_type Ur[out_size][v_out_size];
-    v_type Uh[out_size][v_out_size];
+    // low-rank recurrent weights, with the same padding as U
+    LowRankMatrixT<T, v_gates_size * v_size, out_size, rankt> lowRankU;
+    T scalar_outs alignas(RTNEURAL_DEFAULT_ALIGNMENT)[v_out_size * v_size];
+    T scalar_gates alignas(RTNEURAL_DEFAULT_ALIGNMENT)[v_gates_size * v_size];
+    T low_rank_error = (T)0;
 
-    // biases
-    v_type bz[v_out_size];
-    v_type br[v_out_size];
-    v_type bh0[v_out_size];
-    v_type bh1[v_out_size];
+    // stacked kernel and recurrent biases
+    v_type bx[v_gates_size];
+    v_type bh[v_gates_size];
 
     // intermediate vars
+    v_type kernel_outs[v_gates_size];
+    v_type recurrent_outs[v_gates_size];
     v_type zt[v_out_size];
-    v_type rt[v_out_size];
-    v_type ct[v_out_size];
     v_type ht[v_out_size];
 
     // needed for delays when doing sample rate correction
-    std::vector<std::array<v_type, v_out_size>> outs_delayed;
-    int delayWriteIdx = 0;
+    delay_type outs_delayed;
+    int maxDelay = 0;
     v_type delayMult = (T)1;
     v_type delayPlus1Mult = (T)0;
 };
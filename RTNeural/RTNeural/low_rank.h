@@ -0,0 +1,401 @@
+#ifndef LOW_RANK_H_INCLUDED
+#define LOW_RANK_H_INCLUDED
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <numeric>
+#include <vector>
+
+#include "common.h"
+
+namespace RTNeural
+{
+
+namespace low_rank_detail
+{
+    /**
+     * Thin singular value decomposition W = U * diag(s) * V^T of a [rows x cols]
+     * matrix, with the singular values sorted from largest to smallest.
+     */
+    struct SVD
+    {
+        int rows = 0;
+        int cols = 0;
+        int size = 0; // min(rows, cols)
+        std::vector<double> u; // [size][rows] left singular vectors
+        std::vector<double> s; // [size] singular values
+        std::vector<double> v; // [size][cols] right singular vectors
+    };
+
+#if !RTNEURAL_USE_EIGEN
+    /**
+     * One-sided Jacobi SVD of a column-major [rows x cols] matrix with rows >= cols.
+     * Orthogonalises the columns of the matrix with plane rotations, which are
+     * accumulated into V, so that the column norms are the singular values.
+     */
+    inline void jacobiSVD(std::vector<double>& a, int rows, int cols, std::vector<double>& v, std::vector<double>& s)
+    {
+        constexpr int max_sweeps = 60;
+        constexpr double epsilon = 1.0e-15;
+
+        v.assign((size_t)(cols * cols), 0.0);
+        for(int k = 0; k < cols; ++k)
+            v[(size_t)(k * cols + k)] = 1.0;
+
+        const auto column = [](std::vector<double>& m, int length, int k)
+        { return m.data() + (size_t)k * (size_t)length; };
+
+        for(int sweep = 0; sweep < max_sweeps; ++sweep)
+        {
+            bool rotated = false;
+            for(int p = 0; p < cols - 1; ++p)
+            {
+                for(int q = p + 1; q < cols; ++q)
+                {
+                    auto* ap = column(a, rows, p);
+                    auto* aq = column(a, rows, q);
+                    const auto alpha = std::inner_product(ap, ap + rows, ap, 0.0);
+                    const auto beta = std::inner_product(aq, aq + rows, aq, 0.0);
+                    const auto gamma = std::inner_product(ap, ap + rows, aq, 0.0);
+                    if(std::abs(gamma) <= epsilon * std::sqrt(alpha * beta))
+                        continue;
+
+                    rotated = true;
+                    const auto zeta = (beta - alpha) / (2.0 * gamma);
+                    const auto t = (zeta >= 0.0 ? 1.0 : -1.0) / (std::abs(zeta) + std::sqrt(1.0 + zeta * zeta));
+                    const auto c = 1.0 / std::sqrt(1.0 + t * t);
+                    const auto sn = c * t;
+
+                    const auto rotate = [c, sn](double* x, double* y, int length)
+                    {
+                        for(int i = 0; i < length; ++i)
+                        {
+                            const auto xi = x[i];
+                            x[i] = c * xi - sn * y[i];
+                            y[i] = sn * xi + c * y[i];
+                        }
+                    };
+                    rotate(ap, aq, rows);
+                    rotate(column(v, cols, p), column(v, cols, q), cols);
+                }
+            }
+
+            if(!rotated)
+                break;
+        }
+
+        s.resize((size_t)cols);
+        for(int k = 0; k < cols; ++k)
+        {
+            auto* ak = column(a, rows, k);
+            s[(size_t)k] = std::sqrt(std::inner_product(ak, ak + rows, ak, 0.0));
+            if(s[(size_t)k] > 0.0)
+                std::transform(ak, ak + rows, ak, [&s, k](double x)
+                    { return x / s[(size_t)k]; });
+        }
+    }
+#endif
+
+    /** Computes the thin SVD of a [rows x cols] matrix, where `weight(i, k)` returns the weight in row i and column k. */
+    template <typename WeightFunc>
+    SVD computeSVD(int rows, int cols, WeightFunc&& weight)
+    {
+        SVD svd;
+        svd.rows = rows;
+        svd.cols = cols;
+        svd.size = std::min(rows, cols);
+
+#if RTNEURAL_USE_EIGEN
+        Eigen::MatrixXd matrix(rows, cols);
+        for(int i = 0; i < rows; ++i)
+            for(int k = 0; k < cols; ++k)
+                matrix(i, k) = (double)weight(i, k);
+
+        Eigen::BDCSVD<Eigen::MatrixXd> decomposition(matrix, Eigen::ComputeThinU | Eigen::ComputeThinV);
+        const auto& u = decomposition.matrixU();
+        const auto& v = decomposition.matrixV();
+        svd.s.assign(decomposition.singularValues().data(), decomposition.singularValues().data() + svd.size);
+        svd.u.resize((size_t)(svd.size * rows));
+        svd.v.resize((size_t)(svd.size * cols));
+        for(int j = 0; j < svd.size; ++j)
+        {
+            for(int i = 0; i < rows; ++i)
+                svd.u[(size_t)(j * rows + i)] = u(i, j);
+            for(int k = 0; k < cols; ++k)
+                svd.v[(size_t)(j * cols + k)] = v(k, j);
+        }
+#else
+        // the Jacobi SVD needs at least as many rows as columns, so wide matrices are transposed
+        const bool transposed = rows < cols;
+        const auto m = transposed ? cols : rows;
+        const auto n = transposed ? rows : cols;
+        std::vector<double> a((size_t)(m * n));
+        for(int i = 0; i < rows; ++i)
+            for(int k = 0; k < cols; ++k)
+                a[transposed ? (size_t)(i * cols + k) : (size_t)(k * rows + i)] = (double)weight(i, k);
+
+        std::vector<double> v;
+        std::vector<double> s;
+        jacobiSVD(a, m, n, v, s);
+
+        std::vector<int> order((size_t)n);
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&s](int x, int y)
+            { return s[(size_t)x] > s[(size_t)y]; });
+
+        auto& left = transposed ? svd.v : svd.u;
+        auto& right = transposed ? svd.u : svd.v;
+        left.resize((size_t)(n * m));
+        right.resize((size_t)(n * n));
+        svd.s.resize((size_t)n);
+        for(int j = 0; j < n; ++j)
+        {
+            const auto k = order[(size_t)j];
+            svd.s[(size_t)j] = s[(size_t)k];
+            std::copy(a.begin() + k * m, a.begin() + (k + 1) * m, left.begin() + j * m);
+            std::copy(v.begin() + k * n, v.begin() + (k + 1) * n, right.begin() + j * n);
+        }
+#endif
+
+        return svd;
+    }
+} // namespace low_rank_detail
+
+/**
+ * Low-rank factorization W ~= A * B of a [rows x cols] weight matrix,
+ * where A is [rows x rank] and B is [rank x cols], computed from the
+ * truncated singular value decomposition of W. Multiplying by the two
+ * factors takes rank * (rows + cols) operations instead of rows * cols.
+ *
+ * Both factors are stored by column (A as [rank][rows], B as [cols][rank]),
+ * so that each product accumulates whole columns into the output.
+ */
+template <typename T>
+class LowRankMatrix
+{
+public:
+    LowRankMatrix() = default;
+
+    /**
+     * Returns the singular values of a [rows x cols] matrix, from largest to
+     * smallest, where `weight(i, k)` returns the weight in row i and column k.
+     */
+    template <typename WeightFunc>
+    static std::vector<T> getSingularValues(int rows, int cols, WeightFunc&& weight)
+    {
+        const auto svd = low_rank_detail::computeSVD(rows, cols, weight);
+        return std::vector<T>(svd.s.begin(), svd.s.end());
+    }
+
+    /**
+     * Returns the error of keeping the largest `rank` singular values,
+     * relative to the (Frobenius) norm of the matrix.
+     */
+    static T getError(const std::vector<T>& singular_values, int rank)
+    {
+        T total = (T)0;
+        T dropped = (T)0;
+        for(size_t j = 0; j < singular_values.size(); ++j)
+        {
+            const auto s2 = singular_values[j] * singular_values[j];
+            total += s2;
+            if((int)j >= rank)
+                dropped += s2;
+        }
+
+        return total > (T)0 ? std::sqrt(dropped / total) : (T)0;
+    }
+
+    /** Returns the smallest rank with at most the given relative error (see getError()). */
+    static int getRankForTolerance(const std::vector<T>& singular_values, T tolerance)
+    {
+        for(int rank = 0; rank < (int)singular_values.size(); ++rank)
+            if(getError(singular_values, rank) <= tolerance)
+                return rank;
+
+        return (int)singular_values.size();
+    }
+
+    /**
+     * Factorizes a [rows x cols] matrix to the given rank, where `weight(i, k)`
+     * returns the weight in row i and column k. A rank of 0 clears the matrix.
+     */
+    template <typename WeightFunc>
+    void setWeights(int rows, int cols, int rank, WeightFunc&& weight)
+    {
+        clear();
+        if(rank <= 0)
+            return;
+
+        setFactors(low_rank_detail::computeSVD(rows, cols, weight), rank);
+    }
+
+    /**
+     * Factorizes a [rows x cols] matrix to the smallest rank with at most
+     * `tolerance` relative error (see getError()), and returns true, if the
+     * factors take fewer operations than the matrix itself. Otherwise the
+     * matrix is left empty, and this returns false.
+     */
+    template <typename WeightFunc>
+    bool setWeightsForTolerance(int rows, int cols, T tolerance, WeightFunc&& weight)
+    {
+        clear();
+        if(tolerance <= (T)0)
+            return false;
+
+        const auto svd = low_rank_detail::computeSVD(rows, cols, weight);
+        const auto rank = getRankForTolerance(std::vector<T>(svd.s.begin(), svd.s.end()), tolerance);
+        if(rank == 0 || rank * (rows + cols) >= rows * cols)
+            return false;
+
+        setFactors(svd, rank);
+        return true;
+    }
+
+    /** Releases the stored factors. */
+    void clear()
+    {
+        num_rows = 0;
+        num_cols = 0;
+        num_rank = 0;
+        a.clear();
+        b.clear();
+        proj.clear();
+    }
+
+    /** Returns true if no factors are stored. */
+    bool isEmpty() const noexcept { return num_rank == 0; }
+
+    /** Returns the rank of the stored factors (0 if empty). */
+    int getRank() const noexcept { return num_rank; }
+
+    /** Computes out = A * (B * in), where `in` has `cols` values and `out` has `rows` values. */
+    inline void multiply(const T* in, T* out) noexcept
+    {
+#if RTNEURAL_USE_EIGEN
+        using matrix_type = Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>;
+        using vector_type = Eigen::Matrix<T, Eigen::Dynamic, 1>;
+        Eigen::Map<vector_type> projVec(proj.data(), num_rank);
+        projVec.noalias() = Eigen::Map<const matrix_type>(b.data(), num_rank, num_cols) * Eigen::Map<const vector_type>(in, num_cols);
+        Eigen::Map<vector_type>(out, num_rows).noalias() = Eigen::Map<const matrix_type>(a.data(), num_rows, num_rank) * projVec;
+#else
+        std::fill(proj.begin(), proj.end(), (T)0);
+        for(int k = 0; k < num_cols; ++k)
+            for(int j = 0; j < num_rank; ++j)
+                proj[(size_t)j] += b[(size_t)(k * num_rank + j)] * in[k];
+
+        std::fill(out, out + num_rows, (T)0);
+        for(int j = 0; j < num_rank; ++j)
+            for(int i = 0; i < num_rows; ++i)
+                out[i] += a[(size_t)(j * num_rows + i)] * proj[(size_t)j];
+#endif
+    }
+
+private:
+    void setFactors(const low_rank_detail::SVD& svd, int rank)
+    {
+        num_rows = svd.rows;
+        num_cols = svd.cols;
+        num_rank = std::min(rank, svd.size);
+        a.resize((size_t)(num_rank * num_rows));
+        b.resize((size_t)(num_cols * num_rank));
+        proj.resize((size_t)num_rank);
+        for(int j = 0; j < num_rank; ++j)
+        {
+            for(int i = 0; i < num_rows; ++i)
+                a[(size_t)(j * num_rows + i)] = (T)(svd.u[(size_t)(j * num_rows + i)] * svd.s[(size_t)j]);
+            for(int k = 0; k < num_cols; ++k)
+                b[(size_t)(k * num_rank + j)] = (T)svd.v[(size_t)(j * num_cols + k)];
+        }
+    }
+
+    int num_rows = 0;
+    int num_cols = 0;
+    int num_rank = 0;
+
+    std::vector<T> a; // [rank][rows]
+    std::vector<T> b; // [cols][rank]
+    std::vector<T> proj; // [rank]
+};
+
+/**
+ * Static implementation of LowRankMatrix, with the sizes and rank
+ * known at compile time. With a rank of 0 this is an empty stand-in,
+ * for layers that keep their full-rank weights.
+ */
+template <typename T, int rows, int cols, int rank>
+class LowRankMatrixT
+{
+    static_assert(rank > 0 && rank <= rows && rank <= cols, "The rank must be between 1 and the smaller matrix dimension!");
+
+public:
+    LowRankMatrixT()
+    {
+        std::fill(&a[0][0], &a[0][0] + rank * rows, (T)0);
+        std::fill(&b[0][0], &b[0][0] + cols * rank, (T)0);
+        std::fill(proj, proj + rank, (T)0);
+    }
+
+    /**
+     * Factorizes a [rows x cols] matrix, where `weight(i, k)` returns
+     * the weight in row i and column k, and returns the error of the
+     * factorization relative to the norm of the matrix.
+     */
+    template <typename WeightFunc>
+    T setWeights(WeightFunc&& weight)
+    {
+        const auto svd = low_rank_detail::computeSVD(rows, cols, weight);
+        for(int j = 0; j < rank; ++j)
+        {
+            for(int i = 0; i < rows; ++i)
+                a[j][i] = (T)(svd.u[(size_t)(j * rows + i)] * svd.s[(size_t)j]);
+            for(int k = 0; k < cols; ++k)
+                b[k][j] = (T)svd.v[(size_t)(j * cols + k)];
+        }
+
+        return LowRankMatrix<T>::getError(std::vector<T>(svd.s.begin(), svd.s.end()), rank);
+    }
+
+    /** Computes out = A * (B * in). */
+    inline void multiply(const T* in, T* out) noexcept
+    {
+#if RTNEURAL_USE_EIGEN
+        using a_type = Eigen::Matrix<T, rows, rank>;
+        using b_type = Eigen::Matrix<T, rank, cols>;
+        using proj_type = Eigen::Matrix<T, rank, 1>;
+        Eigen::Map<proj_type, RTNeuralEigenAlignment> projVec(proj);
+        projVec.noalias() = Eigen::Map<const b_type, RTNeuralEigenAlignment>(&b[0][0]) * Eigen::Map<const Eigen::Matrix<T, cols, 1>>(in);
+        Eigen::Map<Eigen::Matrix<T, rows, 1>>(out).noalias() = Eigen::Map<const a_type, RTNeuralEigenAlignment>(&a[0][0]) * projVec;
+#else
+        std::fill(proj, proj + rank, (T)0);
+        for(int k = 0; k < cols; ++k)
+            for(int j = 0; j < rank; ++j)
+                proj[j] += b[k][j] * in[k];
+
+        std::fill(out, out + rows, (T)0);
+        for(int j = 0; j < rank; ++j)
+            for(int i = 0; i < rows; ++i)
+                out[i] += a[j][i] * proj[j];
+#endif
+    }
+
+private:
+    T a alignas(RTNEURAL_DEFAULT_ALIGNMENT)[rank][rows];
+    T b alignas(RTNEURAL_DEFAULT_ALIGNMENT)[cols][rank];
+    T proj alignas(RTNEURAL_DEFAULT_ALIGNMENT)[rank];
+};
+
+template <typename T, int rows, int cols>
+class LowRankMatrixT<T, rows, cols, 0>
+{
+public:
+    template <typename WeightFunc>
+    T setWeights(WeightFunc&&) { return (T)0; }
+
+    inline void multiply(const T*, T*) noexcept { }
+};
+
+} // namespace RTNeural
+
+#endif // LOW_RANK_H_INCLUDED
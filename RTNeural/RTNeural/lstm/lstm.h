@@ -12,7 +12,9 @@
 #include "lstm_accelerate.tpp"
 #else
 #include "../Layer.h"
+#include "../block_sparse.h"
 #include "../common.h"
+#include "../low_rank.h"
 #include <vector>
 
 namespace RTNeural
@@ -25,6 +27,9 @@ namespace RTNeural
  * To ensure that the recurrent state is initialized to zero,
  * please make sure to call `reset()` before your first call to
  * the `forward()` method.
+ *
+ * The weights and state are stored row-major in a single
+ * contiguous block of memory.
  */
 template <typename T>
 class LSTMLayer final : public Layer<T>
@@ -35,23 +40,45 @@ public:
     LSTMLayer(std::initializer_list<int> sizes);
     LSTMLayer(const LSTMLayer& other);
     LSTMLayer& operator=(const LSTMLayer& other);
-    virtual ~LSTMLayer();
 
     /** Resets the state of the LSTM. */
     void reset() override;
 
+    /** Returns the number of values in a snapshot of the layer state. */
+    int getStateSize() const noexcept override { return 2 * Layer<T>::out_size; }
+
+    /** Copies the layer state into a buffer of getStateSize() values. */
+    void getState(T* stateOut) const noexcept override
+    {
+        std::copy(ht1, ht1 + Layer<T>::out_size, stateOut);
+        std::copy(ct1, ct1 + Layer<T>::out_size, stateOut + Layer<T>::out_size);
+    }
+
+    /** Restores the layer state from a buffer written by getState(). */
+    void setState(const T* stateIn) noexcept override
+    {
+        std::copy(stateIn, stateIn + Layer<T>::out_size, ht1);
+        std::copy(stateIn + Layer<T>::out_size, stateIn + 2 * Layer<T>::out_size, ct1);
+    }
+
     /** Returns the name of this layer. */
     std::string getName() const noexcept override { return "lstm"; }
 
     /** Performs forward propagation for this layer. */
     inline void forward(const T* input, T* h) noexcept override
     {
+        if(!lowRankU.isEmpty() || !sparseU.isEmpty())
+        {
+            forwardStacked(input, h);
+            return;
+        }
+
         for(int i = 0; i < Layer<T>::out_size; ++i)
         {
-            fVec[i] = sigmoid(vMult(fWeights.W[i], input, Layer<T>::in_size) + vMult(fWeights.U[i], ht1, Layer<T>::out_size) + fWeights.b[i]);
-            iVec[i] = sigmoid(vMult(iWeights.W[i], input, Layer<T>::in_size) + vMult(iWeights.U[i], ht1, Layer<T>::out_size) + iWeights.b[i]);
-            oVec[i] = sigmoid(vMult(oWeights.W[i], input, Layer<T>::in_size) + vMult(oWeights.U[i], ht1, Layer<T>::out_size) + oWeights.b[i]);
-            ctVec[i] = std::tanh(vMult(cWeights.W[i], input, Layer<T>::in_size) + vMult(cWeights.U[i], ht1, Layer<T>::out_size) + cWeights.b[i]);
+            fVec[i] = sigmoid(vMult(fWeights.W + i * Layer<T>::in_size, input, Layer<T>::in_size) + vMult(fWeights.U + i * Layer<T>::out_size, ht1, Layer<T>::out_size) + fWeights.b[i]);
+            iVec[i] = sigmoid(vMult(iWeights.W + i * Layer<T>::in_size, input, Layer<T>::in_size) + vMult(iWeights.U + i * Layer<T>::out_size, ht1, Layer<T>::out_size) + iWeights.b[i]);
+            oVec[i] = sigmoid(vMult(oWeights.W + i * Layer<T>::in_size, input, Layer<T>::in_size) + vMult(oWeights.U + i * Layer<T>::out_size, ht1, Layer<T>::out_size) + oWeights.b[i]);
+            ctVec[i] = std::tanh(vMult(cWeights.W + i * Layer<T>::in_size, input, Layer<T>::in_size) + vMult(cWeights.U + i * Layer<T>::out_size, ht1, Layer<T>::out_size) + cWeights.b[i]);
             cVec[i] = fVec[i] * ct1[i] + iVec[i] * ctVec[i];
             h[i] = oVec[i] * std::tanh(cVec[i]);
         }
@@ -81,22 +108,86 @@ public:
      */
     void setBVals(const std::vector<T>& bVals);
 
-protected:
-    T* ht1;
-    T* ct1;
+    /**
+     * Runs this layer with block-sparse recurrent weights (see BlockSparseMatrix)
+     * when at most `max_density` of their blocks contain a non-zero weight, and
+     * returns true if it does. The check is repeated whenever the recurrent
+     * weights are set. Pass 0 to go back to the dense weights.
+     */
+    bool useSparseWeights(T max_density)
+    {
+        sparse_max_density = max_density;
+        return updateSparseWeights();
+    }
+
+    /** Returns true if this layer is running with block-sparse recurrent weights. */
+    bool hasSparseWeights() const noexcept { return !sparseU.isEmpty(); }
+
+    /**
+     * Runs this layer with low-rank recurrent weights (see LowRankMatrix), with
+     * the smallest rank whose relative error is at most `tolerance`, and returns
+     * true if that rank makes the recurrent product cheaper. The factorization
+     * is repeated whenever the recurrent weights are set, and takes precedence
+     * over block-sparse weights. Pass 0 to go back to the full-rank weights.
+     */
+    bool useLowRankWeights(T tolerance)
+    {
+        low_rank_tolerance = tolerance;
+        return updateLowRankWeights();
+    }
+
+    /** Returns the rank of the recurrent weights, or 0 if they are full-rank. */
+    int getLowRank() const noexcept { return lowRankU.getRank(); }
 
+    /** Returns the number of values this layer allocates from an arena. */
+    size_t getArenaSize() const noexcept override { return memory.getSize(); }
+
+    /** Moves the weights and state of this layer into the arena. */
+    void moveToArena(Arena<T>& arena) override;
+
+protected:
     /** Struct to hold layer weights (used internally) */
     struct WeightSet
     {
-        WeightSet(int in_size, int out_size);
-        ~WeightSet();
-
-        T** W; // kernel weights
-        T** U; // recurrent weights
-        T* b; // bias
-        const int out_size;
+        T* W; // kernel weights [out_size][in_size]
+        T* U; // recurrent weights [out_size][out_size]
+        T* b; // bias [out_size]
     };
 
+    static size_t getMemorySize(int in_size, int out_size) noexcept;
+    void assignMemory() noexcept;
+    bool updateSparseWeights();
+    bool updateLowRankWeights();
+
+    inline void forwardStacked(const T* input, T* h) noexcept
+    {
+        const auto in_size = Layer<T>::in_size;
+        const auto out_size = Layer<T>::out_size;
+
+        // stacked [i, f, c, o] recurrent pre-activations
+        if(!lowRankU.isEmpty())
+            lowRankU.multiply(ht1, uGates);
+        else
+            sparseU.multiply(ht1, uGates);
+        for(int i = 0; i < out_size; ++i)
+        {
+            iVec[i] = sigmoid(vMult(iWeights.W + i * in_size, input, in_size) + uGates[i] + iWeights.b[i]);
+            fVec[i] = sigmoid(vMult(fWeights.W + i * in_size, input, in_size) + uGates[out_size + i] + fWeights.b[i]);
+            ctVec[i] = std::tanh(vMult(cWeights.W + i * in_size, input, in_size) + uGates[2 * out_size + i] + cWeights.b[i]);
+            oVec[i] = sigmoid(vMult(oWeights.W + i * in_size, input, in_size) + uGates[3 * out_size + i] + oWeights.b[i]);
+            cVec[i] = fVec[i] * ct1[i] + iVec[i] * ctVec[i];
+            h[i] = oVec[i] * std::tanh(cVec[i]);
+        }
+
+        std::copy(cVec, cVec + out_size, ct1);
+        std::copy(h, h + out_size, ht1);
+    }
+
+    LayerMemory<T> memory;
+
+    T* ht1;
+    T* ct1;
+
     WeightSet fWeights;
     WeightSet iWeights;
     WeightSet oWeights;
@@ -107,6 +198,13 @@ protected:
     T* oVec;
     T* ctVec;
     T* cVec;
+    T* uGates; // [4 * out_size]
+
+    BlockSparseMatrix<T> sparseU; // stacked [i, f, c, o] recurrent weights
+    T sparse_max_density = (T)0;
+
+    LowRankMatrix<T> lowRankU; // stacked [i, f, c, o] recurrent weights
+    T low_rank_tolerance = (T)0;
 };
 
 //====================================================
@@ -117,8 +215,13 @@ protected:
  * To ensure that the recurrent state is initialized to zero,
  * please make sure to call `reset()` before your first call to
  * the `forward()` method.
+ *
+ * With `rankt > 0`, setUVals() replaces the recurrent weights of the
+ * four gates with a rank-`rankt` factorization U ~= A * B (see
+ * LowRankMatrixT), so that the recurrent product takes
+ * 5 * out_size * rankt operations instead of 4 * out_size * out_size.
  */
-template <typename T, int in_sizet, int out_sizet, SampleRateCorrectionMode sampleRateCorr = SampleRateCorrectionMode::None>
+template <typename T, int in_sizet, int out_sizet, SampleRateCorrectionMode sampleRateCorr = SampleRateCorrectionMode::None, int rankt = 0>
 class LSTMLayerT
 {
 public:
@@ -146,25 +249,45 @@ public:
     /** Resets the state of the LSTM. */
     void reset();
 
+    /**
+     * Returns the number of values in a snapshot of the layer state.
+     * With sample rate correction, the short delay line used for the
+     * correction is not part of the snapshot.
+     */
+    static constexpr int getStateSize() noexcept { return 2 * out_size; }
+
+    /** Copies the layer state into a buffer of getStateSize() values. */
+    void getState(T* stateOut) const noexcept
+    {
+        std::copy(outs, outs + out_size, stateOut);
+        std::copy(ct, ct + out_size, stateOut + out_size);
+    }
+
+    /** Restores the layer state from a buffer written by getState(). */
+    void setState(const T* stateIn) noexcept
+    {
+        std::copy(stateIn, stateIn + out_size, outs);
+        std::copy(stateIn + out_size, stateIn + 2 * out_size, ct);
+    }
+
     /** Performs forward propagation for this layer. */
     template <int N = in_size>
     inline typename std::enable_if<(N > 1), void>::type
     forward(const T (&ins)[in_size]) noexcept
     {
+        recurrent_gates();
+
         // compute ft
-        recurrent_mat_mul(outs, Uf, ft);
         kernel_mat_mul(ins, Wf, kernel_outs);
         for(int i = 0; i < out_size; ++i)
             ft[i] = sigmoid(ft[i] + bf[i] + kernel_outs[i]);
 
         // compute it
-        recurrent_mat_mul(outs, Ui, it);
         kernel_mat_mul(ins, Wi, kernel_outs);
         for(int i = 0; i < out_size; ++i)
             it[i] = sigmoid(it[i] + bi[i] + kernel_outs[i]);
 
         // compute ot
-        recurrent_mat_mul(outs, Uo, ot);
         kernel_mat_mul(ins, Wo, kernel_outs);
         for(int i = 0; i < out_size; ++i)
             ot[i] = sigmoid(ot[i] + bo[i] + kernel_outs[i]);
@@ -177,18 +300,17 @@ public:
     inline typename std::enable_if<N == 1, void>::type
     forward(const T (&ins)[in_size]) noexcept
     {
+        recurrent_gates();
+
         // compute ft
-        recurrent_mat_mul(outs, Uf, ft);
         for(int i = 0; i < out_size; ++i)
             ft[i] = sigmoid(ft[i] + bf[i] + (Wf_1[i] * ins[0]));
 
         // compute it
-        recurrent_mat_mul(outs, Ui, it);
         for(int i = 0; i < out_size; ++i)
             it[i] = sigmoid(it[i] + bi[i] + (Wi_1[i] * ins[0]));
 
         // compute ot
-        recurrent_mat_mul(outs, Uo, ot);
         for(int i = 0; i < out_size; ++i)
             ot[i] = sigmoid(ot[i] + bo[i] + (Wo_1[i] * ins[0]));
 
@@ -216,6 +338,12 @@ public:
      */
     void setBVals(const std::vector<T>& bVals);
 
+    /**
+     * Returns the error of the low-rank recurrent weights, relative to
+     * the norm of the weights passed to setUVals() (0 with full rank).
+     */
+    T getLowRankError() const noexcept { return low_rank_error; }
+
     T outs alignas(RTNEURAL_DEFAULT_ALIGNMENT)[out_size];
 
 private:
@@ -230,10 +358,10 @@ private:
     inline std::enable_if_t<srCorr != SampleRateCorrectionMode::None, void>
     computeOutputs(const T (&ins)[in_size]) noexcept
     {
-        computeOutputsInternal(ins, ct_delayed[delayWriteIdx], outs_delayed[delayWriteIdx]);
+        computeOutputsInternal(ins, ct_delayed.write(), outs_delayed.write());
 
-        processDelay(ct_delayed, ct, delayWriteIdx);
-        processDelay(outs_delayed, outs, delayWriteIdx);
+        processDelay(ct_delayed, ct);
+        processDelay(outs_delayed, outs);
     }
 
     template <typename VecType, int N = in_size>
@@ -241,7 +369,6 @@ private:
     computeOutputsInternal(const T (&ins)[in_size], VecType& ctVec, VecType& outsVec) noexcept
     {
         // compute ct
-        recurrent_mat_mul(outs, Uc, ht);
         kernel_mat_mul(ins, Wc, kernel_outs);
         for(int i = 0; i < out_size; ++i)
             ctVec[i] = it[i] * std::tanh(ht[i] + bc[i] + kernel_outs[i]) + ft[i] * ct[i];
@@ -256,7 +383,6 @@ private:
     computeOutputsInternal(const T (&ins)[in_size], VecType& ctVec, VecType& outsVec) noexcept
     {
         // compute ct
-        recurrent_mat_mul(outs, Uc, ht);
         for(int i = 0; i < out_size; ++i)
             ctVec[i] = it[i] * std::tanh(ht[i] + bc[i] + (Wc_1[i] * ins[0])) + ft[i] * ct[i];
 
@@ -265,32 +391,49 @@ private:
             outsVec[i] = ot[i] * std::tanh(ctVec[i]);
     }
 
+    using delay_type = SampleRateCorrectionDelay<std::array<T, out_size>>;
+
     template <SampleRateCorrectionMode srCorr = sampleRateCorr>
     inline std::enable_if_t<srCorr == SampleRateCorrectionMode::NoInterp, void>
-    processDelay(std::vector<std::array<T, out_size>>& delayVec, T (&out)[out_size], int delayWriteIndex) noexcept
+    processDelay(delay_type& delay, T (&out)[out_size]) noexcept
     {
+        const auto& delayed = delay.read(maxDelay);
         for(int i = 0; i < out_size; ++i)
-            out[i] = delayVec[0][i];
+            out[i] = delayed[i];
 
-        for(int j = 0; j < delayWriteIndex; ++j)
-        {
-            for(int i = 0; i < out_size; ++i)
-                delayVec[j][i] = delayVec[j + 1][i];
-        }
+        delay.advance();
     }
 
     template <SampleRateCorrectionMode srCorr = sampleRateCorr>
     inline std::enable_if_t<srCorr == SampleRateCorrectionMode::LinInterp, void>
-    processDelay(std::vector<std::array<T, out_size>>& delayVec, T (&out)[out_size], int delayWriteIndex) noexcept
+    processDelay(delay_type& delay, T (&out)[out_size]) noexcept
     {
+        const auto& older = delay.read(maxDelay);
+        const auto& newer = delay.read(maxDelay - 1);
         for(int i = 0; i < out_size; ++i)
-            out[i] = delayPlus1Mult * delayVec[0][i] + delayMult * delayVec[1][i];
+            out[i] = delayPlus1Mult * older[i] + delayMult * newer[i];
+
+        delay.advance();
+    }
 
-        for(int j = 0; j < delayWriteIndex; ++j)
+    /** Computes the recurrent parts of ft, it, ot, and ht. */
+    inline void recurrent_gates() noexcept
+    {
+        if(rankt > 0)
         {
-            for(int i = 0; i < out_size; ++i)
-                delayVec[j][i] = delayVec[j + 1][i];
+            // stacked [i, f, c, o] recurrent pre-activations
+            lowRankU.multiply(outs, recurrent_outs);
+            std::copy(recurrent_outs, recurrent_outs + out_size, it);
+            std::copy(recurrent_outs + out_size, recurrent_outs + 2 * out_size, ft);
+            std::copy(recurrent_outs + 2 * out_size, recurrent_outs + 3 * out_size, ht);
+            std::copy(recurrent_outs + 3 * out_size, recurrent_outs + 4 * out_size, ot);
+            return;
         }
+
+        recurrent_mat_mul(outs, Uf, ft);
+        recurrent_mat_mul(outs, Ui, it);
+        recurrent_mat_mul(outs, Uo, ot);
+        recurrent_mat_mul(outs, Uc, ht);
     }
 
     static inline void recurrent_mat_mul(const T (&vec)[out_size], const T (&mat)[out_size][out_size], T (&out)[out_size]) noexcept
@@ -324,6 +467,11 @@ private:
     T Uo alignas(RTNEURAL_DEFAULT_ALIGNMENT)[out_size][out_size];
     T Uc alignas(RTNEURAL_DEFAULT_ALIGNMENT)[out_size][out_size];
 
+    // low-rank recurrent weights
+    LowRankMatrixT<T, 4 * out_size, out_size, rankt> lowRankU;
+    T recurrent_outs alignas(RTNEURAL_DEFAULT_ALIGNMENT)[4 * out_size];
+    T low_rank_error = (T)0;
+
     // biases
     T bf alignas(RTNEURAL_DEFAULT_ALIGNMENT)[out_size];
     T bi alignas(RTNEURAL_DEFAULT_ALIGNMENT)[out_size];
@@ -338,9 +486,9 @@ private:
     T ct alignas(RTNEURAL_DEFAULT_ALIGNMENT)[out_size];
 
     // needed for delays when doing sample rate correction
-    std::vector<std::array<T, out_size>> ct_delayed;
-    std::vector<std::array<T, out_size>> outs_delayed;
-    int delayWriteIdx = 0;
+    delay_type ct_delayed;
+    delay_type outs_delayed;
+    int maxDelay = 0;
     T delayMult = (T)1;
     T delayPlus1Mult = (T)0;
 };
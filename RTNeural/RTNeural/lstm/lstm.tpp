@@ -8,19 +8,9 @@ namespace RTNeural
 template <typename T>
 LSTMLayer<T>::LSTMLayer(int in_size, int out_size)
     : Layer<T>(in_size, out_size)
-    , fWeights(in_size, out_size)
-    , iWeights(in_size, out_size)
-    , oWeights(in_size, out_size)
-    , cWeights(in_size, out_size)
+    , memory(getMemorySize(in_size, out_size))
 {
-    ht1 = new T[out_size];
-    ct1 = new T[out_size];
-
-    fVec = new T[out_size];
-    iVec = new T[out_size];
-    oVec = new T[out_size];
-    ctVec = new T[out_size];
-    cVec = new T[out_size];
+    assignMemory();
 }
 
 template <typename T>
@@ -44,66 +34,74 @@ LSTMLayer<T>& LSTMLayer<T>::operator=(const LSTMLayer<T>& other)
 }
 
 template <typename T>
-LSTMLayer<T>::~LSTMLayer()
+size_t LSTMLayer<T>::getMemorySize(int in_size, int out_size) noexcept
 {
-    delete[] ht1;
-    delete[] ct1;
-
-    delete[] fVec;
-    delete[] iVec;
-    delete[] oVec;
-    delete[] ctVec;
-    delete[] cVec;
-}
+    const auto weight_set_size = Arena<T>::alignedSize((size_t)(out_size * in_size))
+        + Arena<T>::alignedSize((size_t)(out_size * out_size))
+        + Arena<T>::alignedSize((size_t)out_size);
 
-template <typename T>
-void LSTMLayer<T>::reset()
-{
-    std::fill(ht1, ht1 + Layer<T>::out_size, (T)0);
-    std::fill(ct1, ct1 + Layer<T>::out_size, (T)0);
+    return 4 * weight_set_size + 7 * Arena<T>::alignedSize((size_t)out_size)
+        + Arena<T>::alignedSize((size_t)(4 * out_size));
 }
 
 template <typename T>
-LSTMLayer<T>::WeightSet::WeightSet(int in_size, int out_size)
-    : out_size(out_size)
+void LSTMLayer<T>::assignMemory() noexcept
 {
-    W = new T*[out_size];
-    U = new T*[out_size];
-    b = new T[out_size];
+    const auto in_size = Layer<T>::in_size;
+    const auto out_size = Layer<T>::out_size;
 
-    for(int i = 0; i < out_size; ++i)
+    T* ptr = memory.data();
+    auto next = [&ptr](size_t count)
+    {
+        T* result = ptr;
+        ptr += Arena<T>::alignedSize(count);
+        return result;
+    };
+
+    for(auto* set : { &fWeights, &iWeights, &oWeights, &cWeights })
     {
-        W[i] = new T[in_size];
-        U[i] = new T[out_size];
+        set->W = next((size_t)(out_size * in_size));
+        set->U = next((size_t)(out_size * out_size));
+        set->b = next((size_t)out_size);
     }
+
+    ht1 = next((size_t)out_size);
+    ct1 = next((size_t)out_size);
+
+    fVec = next((size_t)out_size);
+    iVec = next((size_t)out_size);
+    oVec = next((size_t)out_size);
+    ctVec = next((size_t)out_size);
+    cVec = next((size_t)out_size);
+    uGates = next((size_t)(4 * out_size));
 }
 
 template <typename T>
-LSTMLayer<T>::WeightSet::~WeightSet()
+void LSTMLayer<T>::moveToArena(Arena<T>& arena)
 {
-    delete[] b;
-
-    for(int i = 0; i < out_size; ++i)
-    {
-        delete[] W[i];
-        delete[] U[i];
-    }
+    memory.moveTo(arena);
+    assignMemory();
+}
 
-    delete[] W;
-    delete[] U;
+template <typename T>
+void LSTMLayer<T>::reset()
+{
+    std::fill(ht1, ht1 + Layer<T>::out_size, (T)0);
+    std::fill(ct1, ct1 + Layer<T>::out_size, (T)0);
 }
 
 template <typename T>
 void LSTMLayer<T>::setWVals(const std::vector<std::vector<T>>& wVals)
 {
+    const auto in_size = Layer<T>::in_size;
     for(int i = 0; i < Layer<T>::in_size; ++i)
     {
         for(int k = 0; k < Layer<T>::out_size; ++k)
         {
-            iWeights.W[k][i] = wVals[i][k];
-            fWeights.W[k][i] = wVals[i][k + Layer<T>::out_size];
-            cWeights.W[k][i] = wVals[i][k + Layer<T>::out_size * 2];
-            oWeights.W[k][i] = wVals[i][k + Layer<T>::out_size * 3];
+            iWeights.W[k * in_size + i] = wVals[i][k];
+            fWeights.W[k * in_size + i] = wVals[i][k + Layer<T>::out_size];
+            cWeights.W[k * in_size + i] = wVals[i][k + Layer<T>::out_size * 2];
+            oWeights.W[k * in_size + i] = wVals[i][k + Layer<T>::out_size * 3];
         }
     }
 }
@@ -111,16 +109,38 @@ void LSTMLayer<T>::setWVals(const std::vector<std::vector<T>>& wVals)
 template <typename T>
 void LSTMLayer<T>::setUVals(const std::vector<std::vector<T>>& uVals)
 {
+    const auto out_size = Layer<T>::out_size;
     for(int i = 0; i < Layer<T>::out_size; ++i)
     {
         for(int k = 0; k < Layer<T>::out_size; ++k)
         {
-            iWeights.U[k][i] = uVals[i][k];
-            fWeights.U[k][i] = uVals[i][k + Layer<T>::out_size];
-            cWeights.U[k][i] = uVals[i][k + Layer<T>::out_size * 2];
-            oWeights.U[k][i] = uVals[i][k + Layer<T>::out_size * 3];
+            iWeights.U[k * out_size + i] = uVals[i][k];
+            fWeights.U[k * out_size + i] = uVals[i][k + Layer<T>::out_size];
+            cWeights.U[k * out_size + i] = uVals[i][k + Layer<T>::out_size * 2];
+            oWeights.U[k * out_size + i] = uVals[i][k + Layer<T>::out_size * 3];
         }
     }
+
+    updateSparseWeights();
+    updateLowRankWeights();
+}
+
+template <typename T>
+bool LSTMLayer<T>::updateSparseWeights()
+{
+    const auto out_size = Layer<T>::out_size;
+    const WeightSet* sets[] = { &iWeights, &fWeights, &cWeights, &oWeights };
+    return sparseU.setWeights(4 * out_size, out_size, sparse_max_density, [&](int k, int i)
+        { return sets[k / out_size]->U[(k % out_size) * out_size + i]; });
+}
+
+template <typename T>
+bool LSTMLayer<T>::updateLowRankWeights()
+{
+    const auto out_size = Layer<T>::out_size;
+    const WeightSet* sets[] = { &iWeights, &fWeights, &cWeights, &oWeights };
+    return lowRankU.setWeightsForTolerance(4 * out_size, out_size, low_rank_tolerance, [&](int k, int i)
+        { return sets[k / out_size]->U[(k % out_size) * out_size + i]; });
 }
 
 template <typename T>
@@ -136,8 +156,8 @@ void LSTMLayer<T>::setBVals(const std::vector<T>& bVals)
 }
 
 //====================================================
-template <typename T, int in_sizet, int out_sizet, SampleRateCorrectionMode sampleRateCorr>
-LSTMLayerT<T, in_sizet, out_sizet, sampleRateCorr>::LSTMLayerT()
+template <typename T, int in_sizet, int out_sizet, SampleRateCorrectionMode sampleRateCorr, int rankt>
+LSTMLayerT<T, in_sizet, out_sizet, sampleRateCorr, rankt>::LSTMLayerT()
 {
     for(int i = 0; i < out_size; ++i)
     {
@@ -160,6 +180,8 @@ LSTMLayerT<T, in_sizet, out_sizet, sampleRateCorr>::LSTMLayerT()
         ht[i] = (T)0;
     }
 
+    std::fill(recurrent_outs, recurrent_outs + 4 * out_size, (T)0);
+
     for(int i = 0; i < out_size; ++i)
     {
         // recurrent weights
@@ -184,44 +206,41 @@ LSTMLayerT<T, in_sizet, out_sizet, sampleRateCorr>::LSTMLayerT()
     reset();
 }
 
-template <typename T, int in_sizet, int out_sizet, SampleRateCorrectionMode sampleRateCorr>
+template <typename T, int in_sizet, int out_sizet, SampleRateCorrectionMode sampleRateCorr, int rankt>
 template <SampleRateCorrectionMode srCorr>
 std::enable_if_t<srCorr == SampleRateCorrectionMode::NoInterp, void>
-LSTMLayerT<T, in_sizet, out_sizet, sampleRateCorr>::prepare(int delaySamples)
+LSTMLayerT<T, in_sizet, out_sizet, sampleRateCorr, rankt>::prepare(int delaySamples)
 {
-    delayWriteIdx = delaySamples - 1;
-    ct_delayed.resize(delayWriteIdx + 1, {});
-    outs_delayed.resize(delayWriteIdx + 1, {});
+    maxDelay = delaySamples - 1;
+    ct_delayed.prepare(maxDelay);
+    outs_delayed.prepare(maxDelay);
 
     reset();
 }
 
-template <typename T, int in_sizet, int out_sizet, SampleRateCorrectionMode sampleRateCorr>
+template <typename T, int in_sizet, int out_sizet, SampleRateCorrectionMode sampleRateCorr, int rankt>
 template <SampleRateCorrectionMode srCorr>
 std::enable_if_t<srCorr == SampleRateCorrectionMode::LinInterp, void>
-LSTMLayerT<T, in_sizet, out_sizet, sampleRateCorr>::prepare(T delaySamples)
+LSTMLayerT<T, in_sizet, out_sizet, sampleRateCorr, rankt>::prepare(T delaySamples)
 {
     const auto delayOffFactor = delaySamples - std::floor(delaySamples);
     delayMult = (T)1 - delayOffFactor;
     delayPlus1Mult = delayOffFactor;
 
-    delayWriteIdx = (int)std::ceil(delaySamples) - (int)std::ceil(delayOffFactor);
-    ct_delayed.resize(delayWriteIdx + 1, {});
-    outs_delayed.resize(delayWriteIdx + 1, {});
+    maxDelay = (int)std::ceil(delaySamples) - (int)std::ceil(delayOffFactor);
+    ct_delayed.prepare(maxDelay);
+    outs_delayed.prepare(maxDelay);
 
     reset();
 }
 
-template <typename T, int in_sizet, int out_sizet, SampleRateCorrectionMode sampleRateCorr>
-void LSTMLayerT<T, in_sizet, out_sizet, sampleRateCorr>::reset()
+template <typename T, int in_sizet, int out_sizet, SampleRateCorrectionMode sampleRateCorr, int rankt>
+void LSTMLayerT<T, in_sizet, out_sizet, sampleRateCorr, rankt>::reset()
 {
     if(sampleRateCorr != SampleRateCorrectionMode::None)
     {
-        for(auto& x : ct_delayed)
-            std::fill(x.begin(), x.end(), T {});
-
-        for(auto& x : outs_delayed)
-            std::fill(x.begin(), x.end(), T {});
+        ct_delayed.fill({});
+        outs_delayed.fill({});
     }
 
     // reset output state
@@ -232,8 +251,8 @@ void LSTMLayerT<T, in_sizet, out_sizet, sampleRateCorr>::reset()
     }
 }
 
-template <typename T, int in_sizet, int out_sizet, SampleRateCorrectionMode sampleRateCorr>
-void LSTMLayerT<T, in_sizet, out_sizet, sampleRateCorr>::setWVals(const std::vector<std::vector<T>>& wVals)
+template <typename T, int in_sizet, int out_sizet, SampleRateCorrectionMode sampleRateCorr, int rankt>
+void LSTMLayerT<T, in_sizet, out_sizet, sampleRateCorr, rankt>::setWVals(const std::vector<std::vector<T>>& wVals)
 {
     for(int i = 0; i < in_size; ++i)
     {
@@ -255,8 +274,8 @@ void LSTMLayerT<T, in_sizet, out_sizet, sampleRateCorr>::setWVals(const std::vec
     }
 }
 
-template <typename T, int in_sizet, int out_sizet, SampleRateCorrectionMode sampleRateCorr>
-void LSTMLayerT<T, in_sizet, out_sizet, sampleRateCorr>::setUVals(const std::vector<std::vector<T>>& uVals)
+template <typename T, int in_sizet, int out_sizet, SampleRateCorrectionMode sampleRateCorr, int rankt>
+void LSTMLayerT<T, in_sizet, out_sizet, sampleRateCorr, rankt>::setUVals(const std::vector<std::vector<T>>& uVals)
 {
     for(int i = 0; i < out_size; ++i)
     {
@@ -268,10 +287,16 @@ void LSTMLayerT<T, in_sizet, out_sizet, sampleRateCorr>::setUVals(const std::vec
             Uo[j][i] = uVals[i][j + 3 * out_size];
         }
     }
+
+    if(rankt > 0)
+    {
+        low_rank_error = lowRankU.setWeights([&uVals](int k, int i)
+            { return uVals[i][k]; });
+    }
 }
 
-template <typename T, int in_sizet, int out_sizet, SampleRateCorrectionMode sampleRateCorr>
-void LSTMLayerT<T, in_sizet, out_sizet, sampleRateCorr>::setBVals(const std::vector<T>& bVals)
+template <typename T, int in_sizet, int out_sizet, SampleRateCorrectionMode sampleRateCorr, int rankt>
+void LSTMLayerT<T, in_sizet, out_sizet, sampleRateCorr, rankt>::setBVals(const std::vector<T>& bVals)
 {
     for(int k = 0; k < out_size; ++k)
     {
@@ -21,6 +21,23 @@ public:
     /** Resets the state of the LSTM. */
     void reset() override;
 
+    /** Returns the number of values in a snapshot of the layer state. */
+    int getStateSize() const noexcept override { return 2 * Layer<T>::out_size; }
+
+    /** Copies the layer state into a buffer of getStateSize() values. */
+    void getState(T* stateOut) const noexcept override
+    {
+        std::copy(ht1, ht1 + Layer<T>::out_size, stateOut);
+        std::copy(ct1, ct1 + Layer<T>::out_size, stateOut + Layer<T>::out_size);
+    }
+
+    /** Restores the layer state from a buffer written by getState(). */
+    void setState(const T* stateIn) noexcept override
+    {
+        std::copy(stateIn, stateIn + Layer<T>::out_size, ht1);
+        std::copy(stateIn + Layer<T>::out_size, stateIn + 2 * Layer<T>::out_size, ct1);
+    }
+
     /** Returns the name of this layer. */
     std::string getName() const noexcept override { return "lstm"; }
 
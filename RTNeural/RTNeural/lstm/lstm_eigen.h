@@ -2,7 +2,9 @@
 #define LSTM_EIGEN_INCLUDED
 
 #include "../Layer.h"
+#include "../block_sparse.h"
 #include "../common.h"
+#include "../low_rank.h"
 
 namespace RTNeural
 {
@@ -32,17 +34,49 @@ public:
     /** Resets the state of the LSTM. */
     void reset() override;
 
+    /** Returns the number of values in a snapshot of the layer state. */
+    int getStateSize() const noexcept override { return 2 * Layer<T>::out_size; }
+
+    /** Copies the layer state into a buffer of getStateSize() values. */
+    void getState(T* stateOut) const noexcept override
+    {
+        std::copy(ht1.data(), ht1.data() + Layer<T>::out_size, stateOut);
+        std::copy(ct1.data(), ct1.data() + Layer<T>::out_size, stateOut + Layer<T>::out_size);
+    }
+
+    /** Restores the layer state from a buffer written by getState(). */
+    void setState(const T* stateIn) noexcept override
+    {
+        std::copy(stateIn, stateIn + Layer<T>::out_size, ht1.data());
+        std::copy(stateIn + Layer<T>::out_size, stateIn + 2 * Layer<T>::out_size, ct1.data());
+    }
+
     /** Performs forward propagation for this layer. */
     inline void forward(const T* input, T* h) noexcept override
     {
         inVec = Eigen::Map<const Eigen::Matrix<T, Eigen::Dynamic, 1>, RTNeuralEigenAlignment>(
             input, Layer<T>::in_size, 1);
 
-        fVec.noalias() = Wf * inVec + Uf * ht1 + bf;
-        iVec.noalias() = Wi * inVec + Ui * ht1 + bi;
-        oVec.noalias() = Wo * inVec + Uo * ht1 + bo;
-
-        ctVec.noalias() = Wc * inVec + Uc * ht1 + bc;
+        if(lowRankU.isEmpty() && sparseU.isEmpty())
+        {
+            fVec.noalias() = Wf * inVec + Uf * ht1 + bf;
+            iVec.noalias() = Wi * inVec + Ui * ht1 + bi;
+            oVec.noalias() = Wo * inVec + Uo * ht1 + bo;
+            ctVec.noalias() = Wc * inVec + Uc * ht1 + bc;
+        }
+        else
+        {
+            // stacked [i, f, c, o] recurrent pre-activations
+            const auto out_size = Layer<T>::out_size;
+            if(!lowRankU.isEmpty())
+                lowRankU.multiply(ht1.data(), uGates.data());
+            else
+                sparseU.multiply(ht1.data(), uGates.data());
+            iVec.noalias() = Wi * inVec + uGates.segment(0, out_size) + bi;
+            fVec.noalias() = Wf * inVec + uGates.segment(out_size, out_size) + bf;
+            ctVec.noalias() = Wc * inVec + uGates.segment(2 * out_size, out_size) + bc;
+            oVec.noalias() = Wo * inVec + uGates.segment(3 * out_size, out_size) + bo;
+        }
         ctVec = ctVec.array().tanh();
 
         sigmoid(fVec);
@@ -78,7 +112,41 @@ public:
      */
     void setBVals(const std::vector<T>& bVals);
 
+    /**
+     * Runs this layer with block-sparse recurrent weights (see BlockSparseMatrix)
+     * when at most `max_density` of their blocks contain a non-zero weight, and
+     * returns true if it does. The check is repeated whenever the recurrent
+     * weights are set. Pass 0 to go back to the dense weights.
+     */
+    bool useSparseWeights(T max_density)
+    {
+        sparse_max_density = max_density;
+        return updateSparseWeights();
+    }
+
+    /** Returns true if this layer is running with block-sparse recurrent weights. */
+    bool hasSparseWeights() const noexcept { return !sparseU.isEmpty(); }
+
+    /**
+     * Runs this layer with low-rank recurrent weights (see LowRankMatrix), with
+     * the smallest rank whose relative error is at most `tolerance`, and returns
+     * true if that rank makes the recurrent product cheaper. The factorization
+     * is repeated whenever the recurrent weights are set, and takes precedence
+     * over block-sparse weights. Pass 0 to go back to the full-rank weights.
+     */
+    bool useLowRankWeights(T tolerance)
+    {
+        low_rank_tolerance = tolerance;
+        return updateLowRankWeights();
+    }
+
+    /** Returns the rank of the recurrent weights, or 0 if they are full-rank. */
+    int getLowRank() const noexcept { return lowRankU.getRank(); }
+
 private:
+    bool updateSparseWeights();
+    bool updateLowRankWeights();
+
     Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic> Wf;
     Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic> Wi;
     Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic> Wo;
@@ -101,6 +169,13 @@ private:
     Eigen::Matrix<T, Eigen::Dynamic, 1> inVec;
     Eigen::Matrix<T, Eigen::Dynamic, 1> ht1;
     Eigen::Matrix<T, Eigen::Dynamic, 1> ct1;
+
+    BlockSparseMatrix<T> sparseU; // stacked [i, f, c, o] recurrent weights
+    Eigen::Matrix<T, Eigen::Dynamic, 1> uGates; // [4 * out_size]
+    T sparse_max_density = (T)0;
+
+    LowRankMatrix<T> lowRankU; // stacked [i, f, c, o] recurrent weights
+    T low_rank_tolerance = (T)0;
 };
 
 //====================================================
@@ -111,8 +186,13 @@ private:
  * To ensure that the recurrent state is initialized to zero,
  * please make sure to call `reset()` before your first call to
  * the `forward()` method.
+ *
+ * With `rankt > 0`, setUVals() replaces the recurrent weights of the
+ * four gates with a rank-`rankt` factorization U ~= A * B (see
+ * LowRankMatrixT), so that the recurrent product takes
+ * 5 * out_size * rankt operations instead of 4 * out_size * out_size.
  */
-template <typename T, int in_sizet, int out_sizet, SampleRateCorrectionMode sampleRateCorr = SampleRateCorrectionMode::None>
+template <typename T, int in_sizet, int out_sizet, SampleRateCorrectionMode sampleRateCorr = SampleRateCorrectionMode::None, int rankt = 0>
 class LSTMLayerT
 {
     using b_type = Eigen::Matrix<T, out_sizet, 1>;
@@ -147,19 +227,50 @@ public:
     /** Resets the state of the LSTM. */
     void reset();
 
+    /**
+     * Returns the number of values in a snapshot of the layer state.
+     * With sample rate correction, the short delay line used for the
+     * correction is not part of the snapshot.
+     */
+    static constexpr int getStateSize() noexcept { return 2 * out_size; }
+
+    /** Copies the layer state into a buffer of getStateSize() values. */
+    void getState(T* stateOut) const noexcept
+    {
+        std::copy(outs.data(), outs.data() + out_size, stateOut);
+        std::copy(cVec.data(), cVec.data() + out_size, stateOut + out_size);
+    }
+
+    /** Restores the layer state from a buffer written by getState(). */
+    void setState(const T* stateIn) noexcept
+    {
+        std::copy(stateIn, stateIn + out_size, outs.data());
+        std::copy(stateIn + out_size, stateIn + 2 * out_size, cVec.data());
+    }
+
     /** Performs forward propagation for this layer. */
     inline void forward(const in_type& ins) noexcept
     {
         fVec.noalias() = bf;
-        fVec.noalias() += Uf * outs;
-        fVec.noalias() += Wf * ins;
-
         iVec.noalias() = bi;
-        iVec.noalias() += Ui * outs;
-        iVec.noalias() += Wi * ins;
-
         oVec.noalias() = bo;
-        oVec.noalias() += Uo * outs;
+        if(rankt > 0)
+        {
+            // stacked [i, f, c, o] recurrent pre-activations
+            lowRankU.multiply(outs.data(), recurrent_outs.data());
+            iVec.noalias() += recurrent_outs.segment(0, out_size);
+            fVec.noalias() += recurrent_outs.segment(out_size, out_size);
+            oVec.noalias() += recurrent_outs.segment(3 * out_size, out_size);
+        }
+        else
+        {
+            fVec.noalias() += Uf * outs;
+            iVec.noalias() += Ui * outs;
+            oVec.noalias() += Uo * outs;
+        }
+
+        fVec.noalias() += Wf * ins;
+        iVec.noalias() += Wi * ins;
         oVec.noalias() += Wo * ins;
 
         fVec = sigmoid(fVec);
@@ -190,6 +301,12 @@ public:
      */
     void setBVals(const std::vector<T>& bVals);
 
+    /**
+     * Returns the error of the low-rank recurrent weights, relative to
+     * the norm of the weights passed to setUVals() (0 with full rank).
+     */
+    T getLowRankError() const noexcept { return low_rank_error; }
+
     Eigen::Map<out_type, RTNeuralEigenAlignment> outs;
 
 private:
@@ -206,17 +323,20 @@ private:
     inline std::enable_if_t<srCorr != SampleRateCorrectionMode::None, void>
     computeOutputs(const in_type& ins) noexcept
     {
-        computeOutputsInternal(ins, ct_delayed[delayWriteIdx], outs_delayed[delayWriteIdx]);
+        computeOutputsInternal(ins, ct_delayed.write(), outs_delayed.write());
 
-        processDelay(ct_delayed, cVec, delayWriteIdx);
-        processDelay(outs_delayed, outs, delayWriteIdx);
+        processDelay(ct_delayed, cVec);
+        processDelay(outs_delayed, outs);
     }
 
     template <typename VecType1, typename VecType2>
     inline void computeOutputsInternal(const in_type& ins, VecType1& cVecLocal, VecType2& outsVec) noexcept
     {
         ctVec.noalias() = bc;
-        ctVec.noalias() += Uc * outs;
+        if(rankt > 0)
+            ctVec.noalias() += recurrent_outs.segment(2 * out_size, out_size);
+        else
+            ctVec.noalias() += Uc * outs;
         ctVec.noalias() += Wc * ins;
 
         ctVec = ctVec.array().tanh();
@@ -227,24 +347,22 @@ private:
         outsVec = oVec.cwiseProduct(outsVec);
     }
 
+    using delay_type = SampleRateCorrectionDelay<out_type, Eigen::aligned_allocator<out_type>>;
+
     template <typename OutVec, SampleRateCorrectionMode srCorr = sampleRateCorr>
     inline std::enable_if_t<srCorr == SampleRateCorrectionMode::NoInterp, void>
-    processDelay(std::vector<out_type>& delayVec, OutVec& out, int delayWriteIndex) noexcept
+    processDelay(delay_type& delay, OutVec& out) noexcept
     {
-        out = delayVec[0];
-
-        for(int j = 0; j < delayWriteIndex; ++j)
-            delayVec[j] = delayVec[j + 1];
+        out = delay.read(maxDelay);
+        delay.advance();
     }
 
     template <typename OutVec, SampleRateCorrectionMode srCorr = sampleRateCorr>
     inline std::enable_if_t<srCorr == SampleRateCorrectionMode::LinInterp, void>
-    processDelay(std::vector<out_type>& delayVec, OutVec& out, int delayWriteIndex) noexcept
+    processDelay(delay_type& delay, OutVec& out) noexcept
     {
-        out = delayPlus1Mult * delayVec[0] + delayMult * delayVec[1];
-
-        for(int j = 0; j < delayWriteIndex; ++j)
-            delayVec[j] = delayVec[j + 1];
+        out = delayPlus1Mult * delay.read(maxDelay) + delayMult * delay.read(maxDelay - 1);
+        delay.advance();
     }
 
     static inline out_type sigmoid(const out_type& x) noexcept
@@ -264,6 +382,11 @@ private:
     r_type Uo;
     r_type Uc;
 
+    // low-rank recurrent weights
+    LowRankMatrixT<T, 4 * out_sizet, out_sizet, rankt> lowRankU;
+    Eigen::Matrix<T, 4 * out_sizet, 1> recurrent_outs;
+    T low_rank_error = (T)0;
+
     // biases
     b_type bf;
     b_type bi;
@@ -278,9 +401,9 @@ private:
     out_type cVec;
 
     // needed for delays when doing sample rate correction
-    std::vector<out_type> ct_delayed;
-    std::vector<out_type> outs_delayed;
-    int delayWriteIdx = 0;
+    delay_type ct_delayed;
+    delay_type outs_delayed;
+    int maxDelay = 0;
     T delayMult = (T)1;
     T delayPlus1Mult = (T)0;
 };
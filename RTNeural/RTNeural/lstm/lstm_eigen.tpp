@@ -31,6 +31,8 @@ LSTMLayer<T>::LSTMLayer(int in_size, int out_size)
     inVec = Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>::Zero(out_size, 1);
     ht1 = Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>::Zero(out_size, 1);
     ct1 = Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>::Zero(out_size, 1);
+
+    uGates = Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>::Zero(4 * out_size, 1);
 }
 
 template <typename T>
@@ -86,6 +88,27 @@ void LSTMLayer<T>::setUVals(const std::vector<std::vector<T>>& uVals)
             Uo(k, i) = uVals[i][k + Layer<T>::out_size * 3];
         }
     }
+
+    updateSparseWeights();
+    updateLowRankWeights();
+}
+
+template <typename T>
+bool LSTMLayer<T>::updateSparseWeights()
+{
+    const auto out_size = Layer<T>::out_size;
+    const Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>* gates[] = { &Ui, &Uf, &Uc, &Uo };
+    return sparseU.setWeights(4 * out_size, out_size, sparse_max_density, [&](int k, int i)
+        { return (*gates[k / out_size])(k % out_size, i); });
+}
+
+template <typename T>
+bool LSTMLayer<T>::updateLowRankWeights()
+{
+    const auto out_size = Layer<T>::out_size;
+    const Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>* gates[] = { &Ui, &Uf, &Uc, &Uo };
+    return lowRankU.setWeightsForTolerance(4 * out_size, out_size, low_rank_tolerance, [&](int k, int i)
+        { return (*gates[k / out_size])(k % out_size, i); });
 }
 
 template <typename T>
@@ -101,8 +124,8 @@ void LSTMLayer<T>::setBVals(const std::vector<T>& bVals)
 }
 
 //====================================================
-template <typename T, int in_sizet, int out_sizet, SampleRateCorrectionMode sampleRateCorr>
-LSTMLayerT<T, in_sizet, out_sizet, sampleRateCorr>::LSTMLayerT()
+template <typename T, int in_sizet, int out_sizet, SampleRateCorrectionMode sampleRateCorr, int rankt>
+LSTMLayerT<T, in_sizet, out_sizet, sampleRateCorr, rankt>::LSTMLayerT()
     : outs(outs_internal)
 {
     Wf = k_type::Zero();
@@ -120,47 +143,46 @@ LSTMLayerT<T, in_sizet, out_sizet, sampleRateCorr>::LSTMLayerT()
     bo = b_type::Zero();
     bc = b_type::Zero();
 
+    recurrent_outs.setZero();
+
     reset();
 }
 
-template <typename T, int in_sizet, int out_sizet, SampleRateCorrectionMode sampleRateCorr>
+template <typename T, int in_sizet, int out_sizet, SampleRateCorrectionMode sampleRateCorr, int rankt>
 template <SampleRateCorrectionMode srCorr>
 std::enable_if_t<srCorr == SampleRateCorrectionMode::NoInterp, void>
-LSTMLayerT<T, in_sizet, out_sizet, sampleRateCorr>::prepare(int delaySamples)
+LSTMLayerT<T, in_sizet, out_sizet, sampleRateCorr, rankt>::prepare(int delaySamples)
 {
-    delayWriteIdx = delaySamples - 1;
-    ct_delayed.resize(delayWriteIdx + 1, {});
-    outs_delayed.resize(delayWriteIdx + 1, {});
+    maxDelay = delaySamples - 1;
+    ct_delayed.prepare(maxDelay);
+    outs_delayed.prepare(maxDelay);
 
     reset();
 }
 
-template <typename T, int in_sizet, int out_sizet, SampleRateCorrectionMode sampleRateCorr>
+template <typename T, int in_sizet, int out_sizet, SampleRateCorrectionMode sampleRateCorr, int rankt>
 template <SampleRateCorrectionMode srCorr>
 std::enable_if_t<srCorr == SampleRateCorrectionMode::LinInterp, void>
-LSTMLayerT<T, in_sizet, out_sizet, sampleRateCorr>::prepare(T delaySamples)
+LSTMLayerT<T, in_sizet, out_sizet, sampleRateCorr, rankt>::prepare(T delaySamples)
 {
     const auto delayOffFactor = delaySamples - std::floor(delaySamples);
     delayMult = (T)1 - delayOffFactor;
     delayPlus1Mult = delayOffFactor;
 
-    delayWriteIdx = (int)std::ceil(delaySamples) - (int)std::ceil(delayOffFactor);
-    ct_delayed.resize(delayWriteIdx + 1, {});
-    outs_delayed.resize(delayWriteIdx + 1, {});
+    maxDelay = (int)std::ceil(delaySamples) - (int)std::ceil(delayOffFactor);
+    ct_delayed.prepare(maxDelay);
+    outs_delayed.prepare(maxDelay);
 
     reset();
 }
 
-template <typename T, int in_sizet, int out_sizet, SampleRateCorrectionMode sampleRateCorr>
-void LSTMLayerT<T, in_sizet, out_sizet, sampleRateCorr>::reset()
+template <typename T, int in_sizet, int out_sizet, SampleRateCorrectionMode sampleRateCorr, int rankt>
+void LSTMLayerT<T, in_sizet, out_sizet, sampleRateCorr, rankt>::reset()
 {
     if(sampleRateCorr != SampleRateCorrectionMode::None)
     {
-        for(auto& x : ct_delayed)
-            x = out_type::Zero();
-
-        for(auto& x : outs_delayed)
-            x = out_type::Zero();
+        ct_delayed.fill(out_type::Zero());
+        outs_delayed.fill(out_type::Zero());
     }
 
     // reset output state
@@ -169,8 +191,8 @@ void LSTMLayerT<T, in_sizet, out_sizet, sampleRateCorr>::reset()
 }
 
 // kernel weights
-template <typename T, int in_sizet, int out_sizet, SampleRateCorrectionMode sampleRateCorr>
-void LSTMLayerT<T, in_sizet, out_sizet, sampleRateCorr>::setWVals(const std::vector<std::vector<T>>& wVals)
+template <typename T, int in_sizet, int out_sizet, SampleRateCorrectionMode sampleRateCorr, int rankt>
+void LSTMLayerT<T, in_sizet, out_sizet, sampleRateCorr, rankt>::setWVals(const std::vector<std::vector<T>>& wVals)
 {
     for(int i = 0; i < in_size; ++i)
     {
@@ -185,8 +207,8 @@ void LSTMLayerT<T, in_sizet, out_sizet, sampleRateCorr>::setWVals(const std::vec
 }
 
 // recurrent weights
-template <typename T, int in_sizet, int out_sizet, SampleRateCorrectionMode sampleRateCorr>
-void LSTMLayerT<T, in_sizet, out_sizet, sampleRateCorr>::setUVals(const std::vector<std::vector<T>>& uVals)
+template <typename T, int in_sizet, int out_sizet, SampleRateCorrectionMode sampleRateCorr, int rankt>
+void LSTMLayerT<T, in_sizet, out_sizet, sampleRateCorr, rankt>::setUVals(const std::vector<std::vector<T>>& uVals)
 {
     for(int i = 0; i < out_size; ++i)
     {
@@ -198,11 +220,17 @@ void LSTMLayerT<T, in_sizet, out_sizet, sampleRateCorr>::setUVals(const std::vec
             Uo(k, i) = uVals[i][k + out_size * 3];
         }
     }
+
+    if(rankt > 0)
+    {
+        low_rank_error = lowRankU.setWeights([&uVals](int k, int i)
+            { return uVals[i][k]; });
+    }
 }
 
 // biases
-template <typename T, int in_sizet, int out_sizet, SampleRateCorrectionMode sampleRateCorr>
-void LSTMLayerT<T, in_sizet, out_sizet, sampleRateCorr>::setBVals(const std::vector<T>& bVals)
+template <typename T, int in_sizet, int out_sizet, SampleRateCorrectionMode sampleRateCorr, int rankt>
+void LSTMLayerT<T, in_sizet, out_sizet, sampleRateCorr, rankt>::setBVals(const std::vector<T>& bVals)
 {
     for(int k = 0; k < out_size; ++k)
     {
@@ -2,7 +2,9 @@
 #define LSTM_XSIMD_H_INCLUDED
 
 #include "../Layer.h"
+#include "../block_sparse.h"
 #include "../common.h"
+#include "../low_rank.h"
 #include <vector>
 
 namespace RTNeural
@@ -30,18 +32,54 @@ public:
     /** Resets the state of the LSTM. */
     void reset() override;
 
+    /** Returns the number of values in a snapshot of the layer state. */
+    int getStateSize() const noexcept override { return 2 * Layer<T>::out_size; }
+
+    /** Copies the layer state into a buffer of getStateSize() values. */
+    void getState(T* stateOut) const noexcept override
+    {
+        std::copy(ht1.data(), ht1.data() + Layer<T>::out_size, stateOut);
+        std::copy(ct1.data(), ct1.data() + Layer<T>::out_size, stateOut + Layer<T>::out_size);
+    }
+
+    /** Restores the layer state from a buffer written by getState(). */
+    void setState(const T* stateIn) noexcept override
+    {
+        std::copy(stateIn, stateIn + Layer<T>::out_size, ht1.data());
+        std::copy(stateIn + Layer<T>::out_size, stateIn + 2 * Layer<T>::out_size, ct1.data());
+    }
+
     /** Returns the name of this layer. */
     std::string getName() const noexcept override { return "lstm"; }
 
     /** Performs forward propagation for this layer. */
     inline void forward(const T* input, T* h) noexcept override
     {
-        for(int i = 0; i < Layer<T>::out_size; ++i)
+        if(lowRankU.isEmpty() && sparseU.isEmpty())
         {
-            fVec[i] = vMult(fWeights.W[i].data(), input, prod_in.data(), Layer<T>::in_size) + vMult(fWeights.U[i].data(), ht1.data(), prod_out.data(), Layer<T>::out_size);
-            iVec[i] = vMult(iWeights.W[i].data(), input, prod_in.data(), Layer<T>::in_size) + vMult(iWeights.U[i].data(), ht1.data(), prod_out.data(), Layer<T>::out_size);
-            oVec[i] = vMult(oWeights.W[i].data(), input, prod_in.data(), Layer<T>::in_size) + vMult(oWeights.U[i].data(), ht1.data(), prod_out.data(), Layer<T>::out_size);
-            ctVec[i] = vMult(cWeights.W[i].data(), input, prod_in.data(), Layer<T>::in_size) + vMult(cWeights.U[i].data(), ht1.data(), prod_out.data(), Layer<T>::out_size);
+            for(int i = 0; i < Layer<T>::out_size; ++i)
+            {
+                fVec[i] = vMult(fWeights.W[i].data(), input, prod_in.data(), Layer<T>::in_size) + vMult(fWeights.U[i].data(), ht1.data(), prod_out.data(), Layer<T>::out_size);
+                iVec[i] = vMult(iWeights.W[i].data(), input, prod_in.data(), Layer<T>::in_size) + vMult(iWeights.U[i].data(), ht1.data(), prod_out.data(), Layer<T>::out_size);
+                oVec[i] = vMult(oWeights.W[i].data(), input, prod_in.data(), Layer<T>::in_size) + vMult(oWeights.U[i].data(), ht1.data(), prod_out.data(), Layer<T>::out_size);
+                ctVec[i] = vMult(cWeights.W[i].data(), input, prod_in.data(), Layer<T>::in_size) + vMult(cWeights.U[i].data(), ht1.data(), prod_out.data(), Layer<T>::out_size);
+            }
+        }
+        else
+        {
+            // stacked [i, f, c, o] recurrent pre-activations
+            const auto out_size = Layer<T>::out_size;
+            if(!lowRankU.isEmpty())
+                lowRankU.multiply(ht1.data(), uGates.data());
+            else
+                sparseU.multiply(ht1.data(), uGates.data());
+            for(int i = 0; i < out_size; ++i)
+            {
+                iVec[i] = vMult(iWeights.W[i].data(), input, prod_in.data(), Layer<T>::in_size) + uGates[i];
+                fVec[i] = vMult(fWeights.W[i].data(), input, prod_in.data(), Layer<T>::in_size) + uGates[out_size + i];
+                ctVec[i] = vMult(cWeights.W[i].data(), input, prod_in.data(), Layer<T>::in_size) + uGates[2 * out_size + i];
+                oVec[i] = vMult(oWeights.W[i].data(), input, prod_in.data(), Layer<T>::in_size) + uGates[3 * out_size + i];
+            }
         }
 
         vAdd(fVec.data(), fWeights.b.data(), fVec.data(), Layer<T>::out_size);
@@ -88,6 +126,37 @@ public:
      */
     void setBVals(const std::vector<T>& bVals);
 
+    /**
+     * Runs this layer with block-sparse recurrent weights (see BlockSparseMatrix)
+     * when at most `max_density` of their blocks contain a non-zero weight, and
+     * returns true if it does. The check is repeated whenever the recurrent
+     * weights are set. Pass 0 to go back to the dense weights.
+     */
+    bool useSparseWeights(T max_density)
+    {
+        sparse_max_density = max_density;
+        return updateSparseWeights();
+    }
+
+    /** Returns true if this layer is running with block-sparse recurrent weights. */
+    bool hasSparseWeights() const noexcept { return !sparseU.isEmpty(); }
+
+    /**
+     * Runs this layer with low-rank recurrent weights (see LowRankMatrix), with
+     * the smallest rank whose relative error is at most `tolerance`, and returns
+     * true if that rank makes the recurrent product cheaper. The factorization
+     * is repeated whenever the recurrent weights are set, and takes precedence
+     * over block-sparse weights. Pass 0 to go back to the full-rank weights.
+     */
+    bool useLowRankWeights(T tolerance)
+    {
+        low_rank_tolerance = tolerance;
+        return updateLowRankWeights();
+    }
+
+    /** Returns the rank of the recurrent weights, or 0 if they are full-rank. */
+    int getLowRank() const noexcept { return lowRankU.getRank(); }
+
 protected:
     using vec_type = std::vector<T, xsimd::aligned_allocator<T>>;
     using vec2_type = std::vector<vec_type>;
@@ -119,6 +188,16 @@ protected:
 
     vec_type prod_in;
     vec_type prod_out;
+
+    bool updateSparseWeights();
+    bool updateLowRankWeights();
+
+    BlockSparseMatrix<T> sparseU { (int)xsimd::simd_type<T>::size }; // stacked [i, f, c, o] recurrent weights
+    vec_type uGates; // [4 * out_size]
+    T sparse_max_density = (T)0;
+
+    LowRankMatrix<T> lowRankU; // stacked [i, f, c, o] recurrent weights
+    T low_rank_tolerance = (T)0;
 };
 
 //====================================================
@@ -129,8 +208,13 @@ protected:
  * To ensure that the recurrent state is initialized to zero,
  * please make sure to call `reset()` before your first call to
  * the `forward()` method.
+ *
+ * With `rankt > 0`, setUVals() replaces the recurrent weights of the
+ * four gates with a rank-`rankt` factorization U ~= A * B (see
+ * LowRankMatrixT), so that the recurrent product takes
+ * 5 * out_size * rankt operations instead of 4 * out_size * out_size.
  */
-template <typename T, int in_sizet, int out_sizet, SampleRateCorrectionMode sampleRateCorr = SampleRateCorrectionMode::None>
+template <typename T, int in_sizet, int out_sizet, SampleRateCorrectionMode sampleRateCorr = SampleRateCorrectionMode::None, int rankt = 0>
 class LSTMLayerT
 {
     using v_type = xsimd::simd_type<T>;
@@ -163,25 +247,51 @@ public:
     /** Resets the state of the LSTM. */
     void reset();
 
+    /**
+     * Returns the number of values in a snapshot of the layer state.
+     * With sample rate correction, the short delay line used for the
+     * correction is not part of the snapshot.
+     */
+    static constexpr int getStateSize() noexcept { return 2 * v_out_size * v_size; }
+
+    /** Copies the layer state into a buffer of getStateSize() values. */
+    void getState(T* stateOut) const noexcept
+    {
+        for(int i = 0; i < v_out_size; ++i)
+        {
+            outs[i].store_unaligned(stateOut + i * v_size);
+            ct[i].store_unaligned(stateOut + (v_out_size + i) * v_size);
+        }
+    }
+
+    /** Restores the layer state from a buffer written by getState(). */
+    void setState(const T* stateIn) noexcept
+    {
+        for(int i = 0; i < v_out_size; ++i)
+        {
+            outs[i] = xsimd::load_unaligned(stateIn + i * v_size);
+            ct[i] = xsimd::load_unaligned(stateIn + (v_out_size + i) * v_size);
+        }
+    }
+
     /** Performs forward propagation for this layer. */
     template <int N = in_size>
     inline typename std::enable_if<(N > 1), void>::type
     forward(const v_type (&ins)[v_in_size]) noexcept
     {
+        recurrent_gates();
+
         // compute ft
-        recurrent_mat_mul(outs, Uf, ft);
         kernel_mat_mul(ins, Wf, kernel_outs);
         for(int i = 0; i < v_out_size; ++i)
             ft[i] = sigmoid(ft[i] + bf[i] + kernel_outs[i]);
 
         // compute it
-        recurrent_mat_mul(outs, Ui, it);
         kernel_mat_mul(ins, Wi, kernel_outs);
         for(int i = 0; i < v_out_size; ++i)
             it[i] = sigmoid(it[i] + bi[i] + kernel_outs[i]);
 
         // compute ot
-        recurrent_mat_mul(outs, Uo, ot);
         kernel_mat_mul(ins, Wo, kernel_outs);
         for(int i = 0; i < v_out_size; ++i)
             ot[i] = sigmoid(ot[i] + bo[i] + kernel_outs[i]);
@@ -194,18 +304,17 @@ public:
     inline typename std::enable_if<N == 1, void>::type
     forward(const v_type (&ins)[v_in_size]) noexcept
     {
+        recurrent_gates();
+
         // compute ft
-        recurrent_mat_mul(outs, Uf, ft);
         for(int i = 0; i < v_out_size; ++i)
             ft[i] = sigmoid(xsimd::fma(Wf_1[i], ins[0], ft[i] + bf[i]));
 
         // compute it
-        recurrent_mat_mul(outs, Ui, it);
         for(int i = 0; i < v_out_size; ++i)
             it[i] = sigmoid(xsimd::fma(Wi_1[i], ins[0], it[i] + bi[i]));
 
         // compute ot
-        recurrent_mat_mul(outs, Uo, ot);
         for(int i = 0; i < v_out_size; ++i)
             ot[i] = sigmoid(xsimd::fma(Wo_1[i], ins[0], ot[i] + bo[i]));
 
@@ -233,6 +342,12 @@ public:
      */
     void setBVals(const std::vector<T>& bVals);
 
+    /**
+     * Returns the error of the low-rank recurrent weights, relative to
+     * the norm of the weights passed to setUVals() (0 with full rank).
+     */
+    T getLowRankError() const noexcept { return low_rank_error; }
+
     v_type outs[v_out_size];
 
 private:
@@ -247,10 +362,10 @@ private:
     inline std::enable_if_t<srCorr != SampleRateCorrectionMode::None, void>
     computeOutputs(const v_type (&ins)[v_in_size]) noexcept
     {
-        computeOutputsInternal(ins, ct_delayed[delayWriteIdx], outs_delayed[delayWriteIdx]);
+        computeOutputsInternal(ins, ct_delayed.write(), outs_delayed.write());
 
-        processDelay(ct_delayed, ct, delayWriteIdx);
-        processDelay(outs_delayed, outs, delayWriteIdx);
+        processDelay(ct_delayed, ct);
+        processDelay(outs_delayed, outs);
     }
 
     template <typename VecType, int N = in_size>
@@ -258,7 +373,6 @@ private:
     computeOutputsInternal(const v_type (&ins)[v_in_size], VecType& ctVec, VecType& outsVec) noexcept
     {
         // compute ct
-        recurrent_mat_mul(outs, Uc, ht);
         kernel_mat_mul(ins, Wc, kernel_outs);
         for(int i = 0; i < v_out_size; ++i)
             ctVec[i] = xsimd::fma(it[i], xsimd::tanh(ht[i] + bc[i] + kernel_outs[i]), ft[i] * ct[i]);
@@ -273,7 +387,6 @@ private:
     computeOutputsInternal(const v_type (&ins)[v_in_size], VecType& ctVec, VecType& outsVec) noexcept
     {
         // compute ct
-        recurrent_mat_mul(outs, Uc, ht);
         for(int i = 0; i < v_out_size; ++i)
             ctVec[i] = xsimd::fma(it[i], xsimd::tanh(xsimd::fma(Wc_1[i], ins[0], ht[i] + bc[i])), ft[i] * ct[i]);
 
@@ -282,32 +395,55 @@ private:
             outsVec[i] = ot[i] * xsimd::tanh(ctVec[i]);
     }
 
+    using delay_type = SampleRateCorrectionDelay<std::array<v_type, v_out_size>, xsimd::aligned_allocator<std::array<v_type, v_out_size>>>;
+
     template <SampleRateCorrectionMode srCorr = sampleRateCorr>
     inline std::enable_if_t<srCorr == SampleRateCorrectionMode::NoInterp, void>
-    processDelay(std::vector<std::array<v_type, v_out_size>>& delayVec, v_type (&out)[v_out_size], int delayWriteIndex) noexcept
+    processDelay(delay_type& delay, v_type (&out)[v_out_size]) noexcept
     {
+        const auto& delayed = delay.read(maxDelay);
         for(int i = 0; i < v_out_size; ++i)
-            out[i] = delayVec[0][i];
+            out[i] = delayed[i];
 
-        for(int j = 0; j < delayWriteIndex; ++j)
-        {
-            for(int i = 0; i < v_out_size; ++i)
-                delayVec[j][i] = delayVec[j + 1][i];
-        }
+        delay.advance();
     }
 
     template <SampleRateCorrectionMode srCorr = sampleRateCorr>
     inline std::enable_if_t<srCorr == SampleRateCorrectionMode::LinInterp, void>
-    processDelay(std::vector<std::array<v_type, v_out_size>>& delayVec, v_type (&out)[v_out_size], int delayWriteIndex) noexcept
+    processDelay(delay_type& delay, v_type (&out)[v_out_size]) noexcept
     {
+        const auto& older = delay.read(maxDelay);
+        const auto& newer = delay.read(maxDelay - 1);
         for(int i = 0; i < v_out_size; ++i)
-            out[i] = delayPlus1Mult * delayVec[0][i] + delayMult * delayVec[1][i];
+            out[i] = delayPlus1Mult * older[i] + delayMult * newer[i];
 
-        for(int j = 0; j < delayWriteIndex; ++j)
+        delay.advance();
+    }
+
+    /** Computes the recurrent parts of ft, it, ot, and ht. */
+    inline void recurrent_gates() noexcept
+    {
+        if(rankt > 0)
         {
             for(int i = 0; i < v_out_size; ++i)
-                delayVec[j][i] = delayVec[j + 1][i];
+                outs[i].store_aligned(scalar_outs + i * v_size);
+
+            // stacked [i, f, c, o] recurrent pre-activations, with each gate padded like the state
+            lowRankU.multiply(scalar_outs, &scalar_gates[0][0]);
+            for(int i = 0; i < v_out_size; ++i)
+            {
+                it[i] = xsimd::load_aligned(scalar_gates[0] + i * v_size);
+                ft[i] = xsimd::load_aligned(scalar_gates[1] + i * v_size);
+                ht[i] = xsimd::load_aligned(scalar_gates[2] + i * v_size);
+                ot[i] = xsimd::load_aligned(scalar_gates[3] + i * v_size);
+            }
+            return;
         }
+
+        recurrent_mat_mul(outs, Uf, ft);
+        recurrent_mat_mul(outs, Ui, it);
+        recurrent_mat_mul(outs, Uo, ot);
+        recurrent_mat_mul(outs, Uc, ht);
     }
 
     static inline void recurrent_mat_mul(const v_type (&vec)[v_out_size], const v_type (&mat)[out_size][v_out_size], v_type (&out)[v_out_size]) noexcept
@@ -368,6 +504,12 @@ private:
     v_type Uo[out_size][v_out_size];
     v_type Uc[out_size][v_out_size];
 
+    // low-rank recurrent weights
+    LowRankMatrixT<T, 4 * v_out_size * v_size, out_size, rankt> lowRankU;
+    T scalar_outs alignas(RTNEURAL_DEFAULT_ALIGNMENT)[v_out_size * v_size];
+    T scalar_gates alignas(RTNEURAL_DEFAULT_ALIGNMENT)[4][v_out_size * v_size];
+    T low_rank_error = (T)0;
+
     // biases
     v_type bf[v_out_size];
     v_type bi[v_out_size];
@@ -382,9 +524,9 @@ private:
     v_type ct[v_out_size];
 
     // needed for delays when doing sample rate correction
-    std::vector<std::array<v_type, v_out_size>> ct_delayed;
-    std::vector<std::array<v_type, v_out_size>> outs_delayed;
-    int delayWriteIdx = 0;
+    delay_type ct_delayed;
+    delay_type outs_delayed;
+    int maxDelay = 0;
     v_type delayMult = (T)1;
     v_type delayPlus1Mult = (T)0;
 };
@@ -22,6 +22,7 @@ LSTMLayer<T>::LSTMLayer(int in_size, int out_size)
 
     prod_in.resize(in_size, (T)0);
     prod_out.resize(out_size, (T)0);
+    uGates.resize(4 * out_size, (T)0);
 }
 
 template <typename T>
@@ -92,6 +93,27 @@ void LSTMLayer<T>::setUVals(const std::vector<std::vector<T>>& uVals)
             oWeights.U[k][i] = uVals[i][k + Layer<T>::out_size * 3];
         }
     }
+
+    updateSparseWeights();
+    updateLowRankWeights();
+}
+
+template <typename T>
+bool LSTMLayer<T>::updateSparseWeights()
+{
+    const auto out_size = Layer<T>::out_size;
+    const WeightSet* sets[] = { &iWeights, &fWeights, &cWeights, &oWeights };
+    return sparseU.setWeights(4 * out_size, out_size, sparse_max_density, [&](int k, int i)
+        { return sets[k / out_size]->U[(size_t)(k % out_size)][(size_t)i]; });
+}
+
+template <typename T>
+bool LSTMLayer<T>::updateLowRankWeights()
+{
+    const auto out_size = Layer<T>::out_size;
+    const WeightSet* sets[] = { &iWeights, &fWeights, &cWeights, &oWeights };
+    return lowRankU.setWeightsForTolerance(4 * out_size, out_size, low_rank_tolerance, [&](int k, int i)
+        { return sets[k / out_size]->U[(size_t)(k % out_size)][(size_t)i]; });
 }
 
 template <typename T>
@@ -107,8 +129,8 @@ void LSTMLayer<T>::setBVals(const std::vector<T>& bVals)
 }
 
 //====================================================
-template <typename T, int in_sizet, int out_sizet, SampleRateCorrectionMode sampleRateCorr>
-LSTMLayerT<T, in_sizet, out_sizet, sampleRateCorr>::LSTMLayerT()
+template <typename T, int in_sizet, int out_sizet, SampleRateCorrectionMode sampleRateCorr, int rankt>
+LSTMLayerT<T, in_sizet, out_sizet, sampleRateCorr, rankt>::LSTMLayerT()
 {
     for(int i = 0; i < v_out_size; ++i)
     {
@@ -155,47 +177,50 @@ LSTMLayerT<T, in_sizet, out_sizet, sampleRateCorr>::LSTMLayerT()
         }
     }
 
+    // low-rank scratch buffers
+    std::fill(scalar_outs, scalar_outs + v_out_size * v_size, (T)0);
+    std::fill(&scalar_gates[0][0], &scalar_gates[0][0] + 4 * v_out_size * v_size, (T)0);
+
     reset();
 }
 
-template <typename T, int in_sizet, int out_sizet, SampleRateCorrectionMode sampleRateCorr>
+template <typename T, int in_sizet, int out_sizet, SampleRateCorrectionMode sampleRateCorr, int rankt>
 template <SampleRateCorrectionMode srCorr>
 std::enable_if_t<srCorr == SampleRateCorrectionMode::NoInterp, void>
-LSTMLayerT<T, in_sizet, out_sizet, sampleRateCorr>::prepare(int delaySamples)
+LSTMLayerT<T, in_sizet, out_sizet, sampleRateCorr, rankt>::prepare(int delaySamples)
 {
-    delayWriteIdx = delaySamples - 1;
-    ct_delayed.resize(delayWriteIdx + 1, {});
-    outs_delayed.resize(delayWriteIdx + 1, {});
+    maxDelay = delaySamples - 1;
+    ct_delayed.prepare(maxDelay);
+    outs_delayed.prepare(maxDelay);
 
     reset();
 }
 
-template <typename T, int in_sizet, int out_sizet, SampleRateCorrectionMode sampleRateCorr>
+template <typename T, int in_sizet, int out_sizet, SampleRateCorrectionMode sampleRateCorr, int rankt>
 template <SampleRateCorrectionMode srCorr>
 std::enable_if_t<srCorr == SampleRateCorrectionMode::LinInterp, void>
-LSTMLayerT<T, in_sizet, out_sizet, sampleRateCorr>::prepare(T delaySamples)
+LSTMLayerT<T, in_sizet, out_sizet, sampleRateCorr, rankt>::prepare(T delaySamples)
 {
     const auto delayOffFactor = delaySamples - std::floor(delaySamples);
     delayMult = (T)1 - delayOffFactor;
     delayPlus1Mult = delayOffFactor;
 
-    delayWriteIdx = (int)std::ceil(delaySamples) - (int)std::ceil(delayOffFactor);
-    ct_delayed.resize(delayWriteIdx + 1, {});
-    outs_delayed.resize(delayWriteIdx + 1, {});
+    maxDelay = (int)std::ceil(delaySamples) - (int)std::ceil(delayOffFactor);
+    ct_delayed.prepare(maxDelay);
+    outs_delayed.prepare(maxDelay);
 
     reset();
 }
 
-template <typename T, int in_sizet, int out_sizet, SampleRateCorrectionMode sampleRateCorr>
-void LSTMLayerT<T, in_sizet, out_sizet, sampleRateCorr>::reset()
+template <typename T, int in_sizet, int out_sizet, SampleRateCorrectionMode sampleRateCorr, int rankt>
+void LSTMLayerT<T, in_sizet, out_sizet, sampleRateCorr, rankt>::reset()
 {
     if(sampleRateCorr != SampleRateCorrectionMode::None)
     {
-        for(auto& x : ct_delayed)
-            std::fill(x.begin(), x.end(), v_type {});
-
-        for(auto& x : outs_delayed)
-            std::fill(x.begin(), x.end(), v_type {});
+        std::array<v_type, v_out_size> zeros;
+        zeros.fill(v_type((T)0));
+        ct_delayed.fill(zeros);
+        outs_delayed.fill(zeros);
     }
 
     // reset output state
@@ -206,8 +231,8 @@ void LSTMLayerT<T, in_sizet, out_sizet, sampleRateCorr>::reset()
     }
 }
 
-template <typename T, int in_sizet, int out_sizet, SampleRateCorrectionMode sampleRateCorr>
-void LSTMLayerT<T, in_sizet, out_sizet, sampleRateCorr>::setWVals(const std::vector<std::vector<T>>& wVals)
+template <typename T, int in_sizet, int out_sizet, SampleRateCorrectionMode sampleRateCorr, int rankt>
+void LSTMLayerT<T, in_sizet, out_sizet, sampleRateCorr, rankt>::setWVals(const std::vector<std::vector<T>>& wVals)
 {
     for(int i = 0; i < out_size; ++i)
     {
@@ -229,8 +254,8 @@ void LSTMLayerT<T, in_sizet, out_sizet, sampleRateCorr>::setWVals(const std::vec
     }
 }
 
-template <typename T, int in_sizet, int out_sizet, SampleRateCorrectionMode sampleRateCorr>
-void LSTMLayerT<T, in_sizet, out_sizet, sampleRateCorr>::setUVals(const std::vector<std::vector<T>>& uVals)
+template <typename T, int in_sizet, int out_sizet, SampleRateCorrectionMode sampleRateCorr, int rankt>
+void LSTMLayerT<T, in_sizet, out_sizet, sampleRateCorr, rankt>::setUVals(const std::vector<std::vector<T>>& uVals)
 {
     for(int i = 0; i < out_size; ++i)
     {
@@ -242,10 +267,20 @@ void LSTMLayerT<T, in_sizet, out_sizet, sampleRateCorr>::setUVals(const std::vec
             Uo[k][i / v_size] = set_value(Uo[k][i / v_size], i % v_size, uVals[k][i + 3 * out_size]);
         }
     }
+
+    if(rankt > 0)
+    {
+        // the padding rows of each gate are zero, so they don't change the factorization
+        low_rank_error = lowRankU.setWeights([&uVals](int k, int i)
+            {
+                const auto gate_row = k % (v_out_size * v_size);
+                return gate_row < out_size ? uVals[i][(k / (v_out_size * v_size)) * out_size + gate_row] : (T)0;
+            });
+    }
 }
 
-template <typename T, int in_sizet, int out_sizet, SampleRateCorrectionMode sampleRateCorr>
-void LSTMLayerT<T, in_sizet, out_sizet, sampleRateCorr>::setBVals(const std::vector<T>& bVals)
+template <typename T, int in_sizet, int out_sizet, SampleRateCorrectionMode sampleRateCorr, int rankt>
+void LSTMLayerT<T, in_sizet, out_sizet, sampleRateCorr, rankt>::setBVals(const std::vector<T>& bVals)
 {
     for(int k = 0; k < out_size; ++k)
     {
@@ -16,6 +16,41 @@
 #define RTNEURAL_MAYBE_UNUSED
 #endif
 
+/**
+ * Conv1D layers with at least this many kernel taps are loaded
+ * as FFTConv1D (partitioned FFT convolution) by parseJson().
+ * Define as 0 to always use direct convolution.
+ */
+#ifndef RTNEURAL_FFT_CONV1D_THRESHOLD
+#define RTNEURAL_FFT_CONV1D_THRESHOLD 128
+#endif
+
+/**
+ * Dense, GRU, and LSTM layers whose (recurrent) weights have at most
+ * this fraction of non-zero blocks are run with block-sparse weights
+ * by parseJson(). The SIMD backends multiply dense weights much faster
+ * than the STL backend, so they need sparser weights to benefit.
+ * Define as 0 to always use dense weights.
+ */
+#ifndef RTNEURAL_SPARSE_DENSITY_THRESHOLD
+#if RTNEURAL_USE_EIGEN || RTNEURAL_USE_XSIMD
+#define RTNEURAL_SPARSE_DENSITY_THRESHOLD 0.25
+#else
+#define RTNEURAL_SPARSE_DENSITY_THRESHOLD 0.5
+#endif
+#endif
+
+/**
+ * With a positive tolerance, parseJson() replaces the recurrent weights
+ * of GRU and LSTM layers with the lowest-rank factorization whose error,
+ * relative to the norm of the weights, is at most this tolerance (see
+ * LowRankMatrix), when that rank is cheaper to multiply. Since this
+ * changes the output of the model, it is off (0) by default.
+ */
+#ifndef RTNEURAL_LOW_RANK_TOLERANCE
+#define RTNEURAL_LOW_RANK_TOLERANCE 0
+#endif
+
 namespace RTNeural
 {
 /** Utility functions for loading model weights from their json representation. */
@@ -176,6 +211,16 @@ namespace json_parser
         return std::move(conv);
     }
 
+    /** Creates an FFTConv1D layer from a json representation of Conv1D layer weights. */
+    template <typename T>
+    std::unique_ptr<FFTConv1D<T>> createFFTConv1D(int in_size, int out_size,
+        int kernel_size, int dilation, const nlohmann::json& weights)
+    {
+        auto conv = std::make_unique<FFTConv1D<T>>(in_size, out_size, kernel_size, dilation);
+        loadConv1D<T>(*conv.get(), kernel_size, dilation, weights);
+        return std::move(conv);
+    }
+
     /** Checks that a Conv1D (or Conv1DT) layer has the given dimensions. */
     template <typename T, typename Conv1DType>
     bool checkConv1D(const Conv1DType& conv, const std::string& type, int layerDims,
@@ -486,6 +531,67 @@ namespace json_parser
         return std::move(batch_norm);
     }
 
+    /**
+     * Folds a batch-norm layer into the json representation of the dense or conv1d
+     * layer before it, so that the layer's outputs are scaled and shifted by its own
+     * weights and biases. Returns false, and leaves the layer unchanged, if the
+     * batch-norm can't be folded (e.g. if the layer has an activation).
+     */
+    template <typename T>
+    bool foldBatchNorm(nlohmann::json& layer, const nlohmann::json& batch_norm)
+    {
+        const auto type = layer.at("type").get<std::string>();
+        const bool is_dense = type == "dense" || type == "time-distributed-dense";
+        if(!is_dense && type != "conv1d")
+            return false;
+
+        if(layer.contains("activation") && !layer.at("activation").get<std::string>().empty())
+            return false;
+
+        if(batch_norm.at("type").get<std::string>() != "batchnorm")
+            return false;
+
+        const auto& bn_weights = batch_norm.at("weights");
+        const bool affine = bn_weights.size() == 4;
+        const auto running_mean = bn_weights.at(affine ? 2 : 0).get<std::vector<T>>();
+        const auto running_var = bn_weights.at(affine ? 3 : 1).get<std::vector<T>>();
+        const auto epsilon = batch_norm.at("epsilon").get<T>();
+
+        auto& weights = layer.at("weights");
+        auto bias = weights.at(1).get<std::vector<T>>();
+        if(bias.size() != running_mean.size())
+            return false;
+
+        std::vector<T> scale(bias.size());
+        for(size_t i = 0; i < bias.size(); ++i)
+        {
+            const auto gamma = affine ? bn_weights.at(0).at(i).get<T>() : (T)1;
+            const auto beta = affine ? bn_weights.at(1).at(i).get<T>() : (T)0;
+            scale[i] = gamma / std::sqrt(running_var[i] + epsilon);
+            bias[i] = scale[i] * bias[i] + beta - scale[i] * running_mean[i];
+        }
+
+        // the output channel is the innermost dimension of both the dense [in][out]
+        // and the conv1d [kernel][in][out] weights
+        auto scaleChannels = [&scale](nlohmann::json& w)
+        {
+            for(size_t i = 0; i < scale.size(); ++i)
+                w.at(i) = scale[i] * w.at(i).get<T>();
+        };
+
+        for(auto& w : weights.at(0))
+        {
+            if(is_dense)
+                scaleChannels(w);
+            else
+                for(auto& w_in : w)
+                    scaleChannels(w_in);
+        }
+
+        weights.at(1) = bias;
+        return true;
+    }
+
     /** Checks that a BatchNorm1DLayer (or BatchNorm1DT) has the given dimensions. */
     template <typename T, typename BatchNormType>
     bool checkBatchNorm(const BatchNormType& batch_norm, const std::string& type, int layerDims, const nlohmann::json& weights, const bool debug)
@@ -595,6 +701,38 @@ namespace json_parser
         return true;
     }
 
+    /**
+     * Switches a Dense, GRU, or LSTM layer to block-sparse weights,
+     * if they are sparse enough (see RTNEURAL_SPARSE_DENSITY_THRESHOLD).
+     */
+    template <typename T, typename LayerType>
+    void useSparseWeights(LayerType& layer, const bool debug)
+    {
+#if RTNEURAL_USE_ACCELERATE
+        (void)layer;
+        (void)debug;
+#else
+        if(layer.useSparseWeights((T)RTNEURAL_SPARSE_DENSITY_THRESHOLD))
+            debug_print("  Using block-sparse weights", debug);
+#endif
+    }
+
+    /**
+     * Switches a GRU or LSTM layer to low-rank recurrent weights,
+     * if they are cheaper within RTNEURAL_LOW_RANK_TOLERANCE.
+     */
+    template <typename T, typename LayerType>
+    void useLowRankWeights(LayerType& layer, const bool debug)
+    {
+#if RTNEURAL_USE_ACCELERATE
+        (void)layer;
+        (void)debug;
+#else
+        if(RTNEURAL_LOW_RANK_TOLERANCE > 0 && layer.useLowRankWeights((T)RTNEURAL_LOW_RANK_TOLERANCE))
+            debug_print("  Using rank-" + std::to_string(layer.getLowRank()) + " recurrent weights", debug);
+#endif
+    }
+
     /** Creates a neural network model from a json stream. */
     template <typename T>
     std::unique_ptr<Model<T>> parseJson(const nlohmann::json& parent, const bool debug = false)
@@ -642,6 +780,7 @@ namespace json_parser
             if(type == "dense" || type == "time-distributed-dense")
             {
                 auto dense = createDense<T>(model->getNextInSize(), layerDims, weights);
+                useSparseWeights<T>(*dense, debug);
                 model->addLayer(dense.release());
                 add_activation(model, l);
             }
@@ -650,8 +789,17 @@ namespace json_parser
                 const auto kernel_size = l.at("kernel_size").back().get<int>();
                 const auto dilation = l.at("dilation").back().get<int>();
 
-                auto conv = createConv1D<T>(model->getNextInSize(), layerDims, kernel_size, dilation, weights);
-                model->addLayer(conv.release());
+                if(RTNEURAL_FFT_CONV1D_THRESHOLD > 0 && kernel_size >= RTNEURAL_FFT_CONV1D_THRESHOLD)
+                {
+                    debug_print("  Using FFT convolution for kernel size: " + std::to_string(kernel_size), debug);
+                    auto conv = createFFTConv1D<T>(model->getNextInSize(), layerDims, kernel_size, dilation, weights);
+                    model->addLayer(conv.release());
+                }
+                else
+                {
+                    auto conv = createConv1D<T>(model->getNextInSize(), layerDims, kernel_size, dilation, weights);
+                    model->addLayer(conv.release());
+                }
                 add_activation(model, l);
             }
             else if(type == "conv2d")
@@ -677,11 +825,15 @@ namespace json_parser
             else if(type == "gru")
             {
                 auto gru = createGRU<T>(model->getNextInSize(), layerDims, weights);
+                useSparseWeights<T>(*gru, debug);
+                useLowRankWeights<T>(*gru, debug);
                 model->addLayer(gru.release());
             }
             else if(type == "lstm")
             {
                 auto lstm = createLSTM<T>(model->getNextInSize(), layerDims, weights);
+                useSparseWeights<T>(*lstm, debug);
+                useLowRankWeights<T>(*lstm, debug);
                 model->addLayer(lstm.release());
             }
             else if(type == "prelu")
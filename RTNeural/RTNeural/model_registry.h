@@ -0,0 +1,386 @@
+#pragma once
+
+#include "ModelT.h"
+#include <typeinfo>
+
+namespace RTNeural
+{
+
+/**
+ * A type-erased handle to a sequential model, that may be
+ * backed by either a static ModelT or a dynamic Model.
+ *
+ * The handle processes a whole block of frames with one
+ * virtual call, so the static models keep their inlined
+ * per-sample code.
+ */
+template <typename T>
+class ModelHandle
+{
+public:
+    virtual ~ModelHandle() = default;
+
+    /** Resets the state of the model. */
+    virtual void reset() = 0;
+
+    /**
+     * Processes a block of frames.
+     *
+     * The input must hold `num_samples` frames of `getInSize()` values,
+     * and the output must have space for `num_samples` frames of
+     * `getOutSize()` values.
+     */
+    virtual void process(const T* input, T* output, int num_samples) noexcept = 0;
+
+    /** Returns the input size of the model. */
+    virtual int getInSize() const noexcept = 0;
+
+    /** Returns the output size of the model. */
+    virtual int getOutSize() const noexcept = 0;
+
+    /** Returns true if the handle is backed by a static model. */
+    virtual bool isStatic() const noexcept = 0;
+
+    /** Returns the number of values in a snapshot of the model state. */
+    virtual int getStateSize() const noexcept = 0;
+
+    /** Copies the model state into a buffer of getStateSize() values. */
+    virtual void getState(T* state) const noexcept = 0;
+
+    /** Restores the model state from a buffer written by getState(). */
+    virtual void setState(const T* state) noexcept = 0;
+};
+
+/** A ModelHandle backed by a dynamic Model. */
+template <typename T>
+class DynamicModelHandle final : public ModelHandle<T>
+{
+public:
+    explicit DynamicModelHandle(std::unique_ptr<Model<T>> modelToUse)
+        : model(std::move(modelToUse))
+    {
+    }
+
+    void reset() override { model->reset(); }
+
+    void process(const T* input, T* output, int num_samples) noexcept override
+    {
+        const auto in_size = model->getInSize();
+        const auto out_size = model->getOutSize();
+        for(int n = 0; n < num_samples; ++n)
+        {
+            model->forward(input + n * in_size);
+            std::copy(model->getOutputs(), model->getOutputs() + out_size, output + n * out_size);
+        }
+    }
+
+    int getInSize() const noexcept override { return model->getInSize(); }
+    int getOutSize() const noexcept override { return model->getOutSize(); }
+    bool isStatic() const noexcept override { return false; }
+    int getStateSize() const noexcept override { return model->getStateSize(); }
+    void getState(T* state) const noexcept override { model->getState(state); }
+    void setState(const T* state) noexcept override { model->setState(state); }
+
+    /** Returns the underlying model. */
+    Model<T>& getModel() noexcept { return *model; }
+
+private:
+    std::unique_ptr<Model<T>> model;
+};
+
+#if MODELT_AVAILABLE
+
+/** A ModelHandle backed by a static ModelT. */
+template <typename T, typename ModelType>
+class StaticModelHandle final : public ModelHandle<T>
+{
+    static constexpr auto in_size = ModelType::input_size;
+    static constexpr auto out_size = ModelType::output_size;
+
+public:
+    void reset() override { model.reset(); }
+
+    void process(const T* input, T* output, int num_samples) noexcept override
+    {
+        // the static models may need an aligned input frame
+        alignas(RTNEURAL_DEFAULT_ALIGNMENT) T frame[in_size];
+        for(int n = 0; n < num_samples; ++n)
+        {
+            std::copy(input + n * in_size, input + (n + 1) * in_size, frame);
+            model.forward(frame);
+            std::copy(model.getOutputs(), model.getOutputs() + out_size, output + n * out_size);
+        }
+    }
+
+    int getInSize() const noexcept override { return in_size; }
+    int getOutSize() const noexcept override { return out_size; }
+    bool isStatic() const noexcept override { return true; }
+    int getStateSize() const noexcept override { return ModelType::state_size; }
+    void getState(T* state) const noexcept override { model.getState(state); }
+    void setState(const T* state) noexcept override { model.setState(state); }
+
+    /** Returns the underlying model. */
+    ModelType& getModel() noexcept { return model; }
+
+private:
+    ModelType model;
+};
+
+#ifndef DOXYGEN
+namespace model_registry_detail
+{
+    /** Layer types without a dynamic equivalent never match. */
+    template <typename LayerType>
+    struct LayerMatcher
+    {
+        template <typename T>
+        static bool matches(const Layer<T>&) noexcept { return false; }
+    };
+
+    /** Matches a dynamic layer with the given type and dimensions. */
+    template <typename DynamicLayerType, int in_size, int out_size>
+    struct TypeMatcher
+    {
+        template <typename T>
+        static bool matches(const Layer<T>& layer) noexcept
+        {
+            return typeid(layer) == typeid(DynamicLayerType) && layer.in_size == in_size && layer.out_size == out_size;
+        }
+    };
+
+    template <typename T, int in_size, int out_size>
+    struct LayerMatcher<DenseT<T, in_size, out_size>> : TypeMatcher<Dense<T>, in_size, out_size>
+    {
+    };
+
+    template <typename T, int in_size, int out_size, SampleRateCorrectionMode mode, int rank>
+    struct LayerMatcher<GRULayerT<T, in_size, out_size, mode, rank>> : TypeMatcher<GRULayer<T>, in_size, out_size>
+    {
+    };
+
+    template <typename T, int in_size, int out_size, SampleRateCorrectionMode mode, int rank>
+    struct LayerMatcher<LSTMLayerT<T, in_size, out_size, mode, rank>> : TypeMatcher<LSTMLayer<T>, in_size, out_size>
+    {
+    };
+
+    template <typename T, int size>
+    struct LayerMatcher<TanhActivationT<T, size>> : TypeMatcher<TanhActivation<T>, size, size>
+    {
+    };
+
+    template <typename T, int size>
+    struct LayerMatcher<FastTanhT<T, size>> : TypeMatcher<FastTanh<T>, size, size>
+    {
+    };
+
+    template <typename T, int size>
+    struct LayerMatcher<ReLuActivationT<T, size>> : TypeMatcher<ReLuActivation<T>, size, size>
+    {
+    };
+
+    template <typename T, int size>
+    struct LayerMatcher<SigmoidActivationT<T, size>> : TypeMatcher<SigmoidActivation<T>, size, size>
+    {
+    };
+
+    template <typename T, int size>
+    struct LayerMatcher<SoftmaxActivationT<T, size>> : TypeMatcher<SoftmaxActivation<T>, size, size>
+    {
+    };
+
+    template <typename T, int size, int alpha_num, int alpha_den>
+    struct LayerMatcher<ELuActivationT<T, size, alpha_num, alpha_den>> : TypeMatcher<ELuActivation<T>, size, size>
+    {
+    };
+
+    template <typename T, int size>
+    struct LayerMatcher<PReLUActivationT<T, size>> : TypeMatcher<PReLUActivation<T>, size, size>
+    {
+    };
+
+    template <typename T, int size, bool affine>
+    struct LayerMatcher<BatchNorm1DT<T, size, affine>> : TypeMatcher<BatchNorm1DLayer<T>, size, size>
+    {
+    };
+
+    template <typename T, int num_filters, int num_features, bool affine>
+    struct LayerMatcher<BatchNorm2DT<T, num_filters, num_features, affine>>
+        : TypeMatcher<BatchNorm2DLayer<T>, num_filters * num_features, num_filters * num_features>
+    {
+    };
+
+    template <typename T, int in_size, int out_size, int kernel_size, int dilation_rate, bool dynamic_state>
+    struct LayerMatcher<Conv1DT<T, in_size, out_size, kernel_size, dilation_rate, dynamic_state>>
+    {
+        static bool matches(const Layer<T>& layer) noexcept
+        {
+            if(layer.in_size != in_size || layer.out_size != out_size)
+                return false;
+
+            // long kernels may have been loaded as FFT convolutions
+            if(auto* conv = dynamic_cast<const Conv1D<T>*>(&layer))
+                return conv->getKernelSize() == kernel_size && conv->getDilationRate() == dilation_rate;
+            if(auto* conv = dynamic_cast<const FFTConv1D<T>*>(&layer))
+                return conv->getKernelSize() == kernel_size && conv->getDilationRate() == dilation_rate;
+
+            return false;
+        }
+    };
+
+    template <typename T, int num_filters_in, int num_filters_out, int num_features_in, int kernel_size_time,
+        int kernel_size_feature, int dilation_rate, int stride, bool valid_pad>
+    struct LayerMatcher<Conv2DT<T, num_filters_in, num_filters_out, num_features_in, kernel_size_time,
+        kernel_size_feature, dilation_rate, stride, valid_pad>>
+    {
+        using LayerType = Conv2DT<T, num_filters_in, num_filters_out, num_features_in, kernel_size_time,
+            kernel_size_feature, dilation_rate, stride, valid_pad>;
+
+        static bool matches(const Layer<T>& layer) noexcept
+        {
+            auto* conv = dynamic_cast<const Conv2D<T>*>(&layer);
+            return conv != nullptr && layer.in_size == LayerType::in_size && layer.out_size == LayerType::out_size
+                && conv->getKernelSizeTime() == kernel_size_time && conv->getKernelSizeFeature() == kernel_size_feature
+                && conv->getDilationRate() == dilation_rate && conv->getStride() == stride;
+        }
+    };
+
+    /** Checks if a dynamic model has the same topology as a static model. */
+    template <typename ModelType>
+    struct TopologyMatcher;
+
+    template <typename T, int in_size, int out_size, typename... Layers>
+    struct TopologyMatcher<ModelT<T, in_size, out_size, Layers...>>
+    {
+        static bool matches(const Model<T>& model) noexcept
+        {
+            if(model.layers.size() != sizeof...(Layers) || model.getInSize() != in_size || model.getOutSize() != out_size)
+                return false;
+
+            return matchesLayers(model, std::index_sequence_for<Layers...> {});
+        }
+
+    private:
+        template <size_t... Ix>
+        static bool matchesLayers(const Model<T>& model, std::index_sequence<Ix...>) noexcept
+        {
+            bool result = true;
+            (void)std::initializer_list<int> { (result = result && LayerMatcher<Layers>::matches(*model.layers[Ix]), 0)... };
+            return result;
+        }
+    };
+
+    template <typename T, typename... ModelTypes>
+    struct StaticModelFactory
+    {
+        template <typename Loader>
+        static std::unique_ptr<ModelHandle<T>> create(const Model<T>&, Loader&)
+        {
+            return {};
+        }
+
+        static int findModel(const Model<T>&, int) noexcept { return -1; }
+    };
+
+    template <typename T, typename ModelType, typename... Rest>
+    struct StaticModelFactory<T, ModelType, Rest...>
+    {
+        template <typename Loader>
+        static std::unique_ptr<ModelHandle<T>> create(const Model<T>& model, Loader& loadWeights)
+        {
+            if(!TopologyMatcher<ModelType>::matches(model))
+                return StaticModelFactory<T, Rest...>::create(model, loadWeights);
+
+            auto handle = std::make_unique<StaticModelHandle<T, ModelType>>();
+            loadWeights(handle->getModel());
+            handle->reset();
+            return std::move(handle);
+        }
+
+        static int findModel(const Model<T>& model, int index) noexcept
+        {
+            if(TopologyMatcher<ModelType>::matches(model))
+                return index;
+
+            return StaticModelFactory<T, Rest...>::findModel(model, index + 1);
+        }
+    };
+} // namespace model_registry_detail
+#endif // DOXYGEN
+
+/**
+ * A registry of static model architectures, that can be chosen at run-time.
+ *
+ * The registry instantiates a ModelT for each of the given architectures.
+ * When a model is loaded, its topology (the layer types and dimensions) is
+ * compared with each architecture in order, and the first match is used.
+ * If none of the architectures match, the handle falls back to the dynamic
+ * Model.
+ * ```
+ * using Registry = ModelRegistry<float,
+ *     ModelT<float, 1, 1, LSTMLayerT<float, 1, 16>, DenseT<float, 16, 1>>,
+ *     ModelT<float, 1, 1, LSTMLayerT<float, 1, 32>, DenseT<float, 32, 1>>>;
+ *
+ * auto model = Registry::create(modelJson);
+ * model->reset();
+ * model->process(input, output, num_samples);
+ * ```
+ */
+template <typename T, typename... ModelTypes>
+class ModelRegistry
+{
+    using Factory = model_registry_detail::StaticModelFactory<T, ModelTypes...>;
+
+public:
+    /** Returns the number of static architectures in the registry. */
+    static constexpr int getNumModels() noexcept { return (int)sizeof...(ModelTypes); }
+
+    /**
+     * Returns the index of the first static architecture matching
+     * the topology of a dynamic model, or -1 if none of them match.
+     */
+    static int findModel(const Model<T>& model) noexcept
+    {
+        return Factory::findModel(model, 0);
+    }
+
+    /**
+     * Creates a model handle for a dynamic model.
+     *
+     * If the topology of the model matches one of the static architectures,
+     * the static model is created, and `loadWeights(staticModel)` is called
+     * to load its weights (so `loadWeights` must be callable with each of the
+     * registered ModelT types). Otherwise, the dynamic model is used.
+     */
+    template <typename Loader>
+    static std::unique_ptr<ModelHandle<T>> create(std::unique_ptr<Model<T>> model, Loader&& loadWeights)
+    {
+        if(model == nullptr)
+            return {};
+
+        if(auto handle = Factory::create(*model, loadWeights))
+            return handle;
+
+        model->reset();
+        return std::make_unique<DynamicModelHandle<T>>(std::move(model));
+    }
+
+    /** Creates a model handle from a json object, in the format used by json_parser::parseJson(). */
+    static std::unique_ptr<ModelHandle<T>> create(const nlohmann::json& parent, const bool debug = false)
+    {
+        return create(json_parser::parseJson<T>(parent, debug),
+            [&parent, debug](auto& staticModel)
+            { staticModel.parseJson(parent, debug); });
+    }
+
+    /** Creates a model handle from a json stream, in the format used by json_parser::parseJson(). */
+    static std::unique_ptr<ModelHandle<T>> create(std::ifstream& jsonStream, const bool debug = false)
+    {
+        nlohmann::json parent;
+        jsonStream >> parent;
+        return create(parent, debug);
+    }
+};
+
+#endif // MODELT_AVAILABLE
+
+} // namespace RTNeural
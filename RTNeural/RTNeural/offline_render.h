@@ -0,0 +1,392 @@
+#pragma once
+
+#include "Model.h"
+#include "model_registry.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace RTNeural
+{
+
+/** Settings for renderChunked(). */
+struct ChunkedRenderSettings
+{
+    /** Number of worker threads (0 = std::thread::hardware_concurrency()). */
+    int num_threads = 0;
+
+    /** Number of frames in each chunk (0 = split the input evenly between the threads). */
+    int chunk_size = 0;
+
+    /**
+     * Number of frames from before the start of each chunk that are run
+     * through the model (and discarded) so that its state can converge.
+     * Should be at least the receptive field of any convolutional layers.
+     */
+    int warmup_frames = 8192;
+
+    /**
+     * Number of frames at the end of each chunk that are also rendered
+     * by the following chunk's model, and cross-faded into it.
+     */
+    int crossfade_frames = 0;
+
+    /** If true, also renders the input on a single thread, and measures the deviation from it. */
+    bool verify = false;
+};
+
+/** Result of renderChunked(). */
+struct ChunkedRenderResult
+{
+    int num_chunks = 0;
+    int num_threads = 0;
+
+    // only set in verify mode
+    double max_deviation = 0.0; // largest absolute difference from the single-threaded render
+    double rms_deviation = 0.0;
+    int max_deviation_frame = -1;
+};
+
+#ifndef DOXYGEN
+namespace offline_render_detail
+{
+    /** Processes a block of frames with a model that has forward() and getOutputs() methods. */
+    template <typename T, typename ModelType>
+    void processFrames(ModelType& model, const T* input, T* output, int num_frames, int in_size, int out_size)
+    {
+        // the static models may need an aligned input frame
+        std::vector<T> frame_data((size_t)in_size + RTNEURAL_DEFAULT_ALIGNMENT / sizeof(T) + 1);
+        void* frame_ptr = frame_data.data();
+        auto space = frame_data.size() * sizeof(T);
+        T* frame = static_cast<T*>(std::align(RTNEURAL_DEFAULT_ALIGNMENT, (size_t)in_size * sizeof(T), frame_ptr, space));
+
+        for(int n = 0; n < num_frames; ++n)
+        {
+            std::copy(input + n * in_size, input + (n + 1) * in_size, frame);
+            model.forward(frame);
+            if(output != nullptr)
+                std::copy(model.getOutputs(), model.getOutputs() + out_size, output + n * out_size);
+        }
+    }
+
+    template <typename T>
+    void processFrames(ModelHandle<T>& model, const T* input, T* output, int num_frames, int, int out_size)
+    {
+        if(output != nullptr)
+        {
+            model.process(input, output, num_frames);
+            return;
+        }
+
+        std::vector<T> scratch((size_t)out_size * 256);
+        for(int n = 0; n < num_frames; n += 256)
+        {
+            const auto block_size = std::min(256, num_frames - n);
+            model.process(input + n * model.getInSize(), scratch.data(), block_size);
+        }
+    }
+} // namespace offline_render_detail
+#endif // DOXYGEN
+
+/**
+ * Renders a long input offline, by splitting it into chunks that are
+ * processed in parallel, each on a different model instance.
+ *
+ * Recurrent models are inherently sequential, so every chunk (after
+ * the first) is preceded by a warm-up pre-roll of `warmup_frames`
+ * input frames, which lets the state of the chunk's model converge
+ * towards the state a single model would have at that point. With
+ * `crossfade_frames > 0`, the end of each chunk is cross-faded into
+ * the start of the next one, to hide any remaining discontinuity.
+ *
+ * The first chunk starts from the same state as a single-threaded
+ * render, so its output is identical. For models without recurrent
+ * layers, the whole output is identical as long as the pre-roll
+ * covers the receptive field of the model.
+ *
+ * `makeModel` is called once per worker thread, from the calling
+ * thread, and must return a (smart) pointer to a model that has been
+ * reset (or set to the desired initial state). The model may be a
+ * Model, a ModelT, or a ModelHandle.
+ *
+ * `input` holds `num_frames` frames of `in_size` values, and `output`
+ * must have space for `num_frames` frames of `out_size` values.
+ */
+template <typename T, typename ModelFactory>
+ChunkedRenderResult renderChunked(ModelFactory&& makeModel, const T* input, T* output, int num_frames,
+    int in_size, int out_size, const ChunkedRenderSettings& settings = {})
+{
+    ChunkedRenderResult result;
+    if(num_frames <= 0)
+        return result;
+
+    auto num_threads = settings.num_threads > 0 ? settings.num_threads : (int)std::thread::hardware_concurrency();
+    num_threads = std::max(num_threads, 1);
+
+    const auto chunk_size = settings.chunk_size > 0 ? settings.chunk_size : (num_frames + num_threads - 1) / num_threads;
+    const auto num_chunks = (num_frames + chunk_size - 1) / chunk_size;
+    num_threads = std::min(num_threads, num_chunks);
+    result.num_chunks = num_chunks;
+    result.num_threads = num_threads;
+
+    const auto warmup_frames = std::max(settings.warmup_frames, 0);
+    const auto crossfade_frames = std::max(0, std::min(settings.crossfade_frames, chunk_size));
+
+    // each chunk after the first renders the overlap with the previous chunk here,
+    // so that it can be cross-faded once every chunk is done
+    std::vector<T> overlaps((size_t)num_chunks * (size_t)crossfade_frames * (size_t)out_size);
+
+    using ModelPtr = std::decay_t<decltype(makeModel())>;
+    std::vector<ModelPtr> models;
+    for(int i = 0; i < num_threads; ++i)
+        models.push_back(makeModel());
+
+    // the models start from the state given by the factory
+    const auto state_size = models[0]->getStateSize();
+    std::vector<T> initial_state((size_t)state_size);
+    models[0]->getState(initial_state.data());
+
+    std::atomic<int> next_chunk { 0 };
+    const auto renderChunks = [&](int thread_idx)
+    {
+        auto& model = *models[(size_t)thread_idx];
+        bool first_chunk_on_thread = true;
+        for(int chunk = next_chunk++; chunk < num_chunks; chunk = next_chunk++)
+        {
+            const auto start = chunk * chunk_size;
+            const auto end = std::min(start + chunk_size, num_frames);
+
+            if(!first_chunk_on_thread)
+                model.setState(initial_state.data());
+            first_chunk_on_thread = false;
+
+            auto render_start = start;
+            if(chunk > 0)
+            {
+                const auto overlap_start = std::max(start - crossfade_frames, 0);
+                const auto warmup_start = std::max(overlap_start - warmup_frames, 0);
+                offline_render_detail::processFrames<T>(model, input + warmup_start * in_size, nullptr, overlap_start - warmup_start, in_size, out_size);
+
+                auto* overlap = overlaps.data() + (size_t)chunk * (size_t)crossfade_frames * (size_t)out_size;
+                offline_render_detail::processFrames<T>(model, input + overlap_start * in_size, overlap, start - overlap_start, in_size, out_size);
+            }
+
+            offline_render_detail::processFrames<T>(model, input + render_start * in_size, output + render_start * out_size, end - render_start, in_size, out_size);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for(int i = 1; i < num_threads; ++i)
+        threads.emplace_back(renderChunks, i);
+    renderChunks(0);
+    for(auto& thread : threads)
+        thread.join();
+
+    // cross-fade from the end of each chunk into the warmed-up start of the next one
+    for(int chunk = 1; chunk < num_chunks; ++chunk)
+    {
+        const auto start = chunk * chunk_size;
+        const auto overlap_start = std::max(start - crossfade_frames, 0);
+        const auto num_overlap = start - overlap_start;
+        const auto* overlap = overlaps.data() + (size_t)chunk * (size_t)crossfade_frames * (size_t)out_size;
+        for(int n = 0; n < num_overlap; ++n)
+        {
+            const auto gain = (T)(n + 1) / (T)(num_overlap + 1);
+            auto* out = output + (overlap_start + n) * out_size;
+            for(int i = 0; i < out_size; ++i)
+                out[i] += gain * (overlap[n * out_size + i] - out[i]);
+        }
+    }
+
+    if(settings.verify)
+    {
+        auto reference_model = makeModel();
+        std::vector<T> reference((size_t)num_frames * (size_t)out_size);
+        offline_render_detail::processFrames<T>(*reference_model, input, reference.data(), num_frames, in_size, out_size);
+
+        double sum_squares = 0.0;
+        for(size_t i = 0; i < reference.size(); ++i)
+        {
+            const auto deviation = std::abs((double)output[i] - (double)reference[i]);
+            sum_squares += deviation * deviation;
+            if(deviation > result.max_deviation)
+            {
+                result.max_deviation = deviation;
+                result.max_deviation_frame = (int)(i / (size_t)out_size);
+            }
+        }
+        result.rms_deviation = std::sqrt(sum_squares / (double)reference.size());
+    }
+
+    return result;
+}
+
+/** One sequence for runBatch(). */
+template <typename T>
+struct BatchSequence
+{
+    const T* input = nullptr; // num_frames frames of in_size values
+    T* output = nullptr; // space for num_frames frames of out_size values
+    int num_frames = 0;
+};
+
+/** Settings for runBatch(). */
+struct BatchRunSettings
+{
+    /** Number of worker threads (0 = std::thread::hardware_concurrency()). */
+    int num_threads = 0;
+};
+
+/** Result of runBatch(). */
+struct BatchRunResult
+{
+    int num_threads = 0;
+    int num_steals = 0; // number of times a worker took sequences from another worker's queue
+};
+
+#ifndef DOXYGEN
+namespace offline_render_detail
+{
+    /**
+     * The sequences of one worker. The worker takes them from the front,
+     * and the other workers steal half of the remaining ones from the back.
+     */
+    struct WorkQueue
+    {
+        std::mutex mutex;
+        std::vector<int> items;
+        int begin = 0;
+        int end = 0;
+
+        int pop()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            return begin < end ? items[(size_t)begin++] : -1;
+        }
+
+        bool stealInto(WorkQueue& thief)
+        {
+            std::vector<int> stolen;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                const auto num_stolen = (end - begin + 1) / 2;
+                if(num_stolen == 0)
+                    return false;
+
+                stolen.assign(items.begin() + (end - num_stolen), items.begin() + end);
+                end -= num_stolen;
+            }
+
+            std::lock_guard<std::mutex> lock(thief.mutex);
+            thief.items = std::move(stolen);
+            thief.begin = 0;
+            thief.end = (int)thief.items.size();
+            return true;
+        }
+    };
+} // namespace offline_render_detail
+#endif // DOXYGEN
+
+/**
+ * Runs many independent sequences (e.g. the fragments of a dataset)
+ * through a model, in parallel, on a work-stealing pool of threads.
+ *
+ * Every sequence starts from the initial state of the model, so the
+ * output of each sequence is identical to running it on its own, freshly
+ * reset model. The sequences are dealt out to the workers, longest first,
+ * and a worker that runs out of sequences steals half of the remaining
+ * sequences of another worker, so the load stays balanced when the
+ * sequence lengths differ.
+ *
+ * `makeModel` is called once per worker thread, from the calling
+ * thread, and must return a (smart) pointer to a model that has been
+ * reset (or set to the desired initial state). The model may be a
+ * Model, a ModelT, or a ModelHandle.
+ *
+ * The outputs are written to the (preallocated) output buffers of the
+ * sequences, so no memory is allocated while the sequences are running.
+ */
+template <typename T, typename ModelFactory>
+BatchRunResult runBatch(ModelFactory&& makeModel, const BatchSequence<T>* sequences, int num_sequences,
+    int in_size, int out_size, const BatchRunSettings& settings = {})
+{
+    BatchRunResult result;
+    if(num_sequences <= 0)
+        return result;
+
+    auto num_threads = settings.num_threads > 0 ? settings.num_threads : (int)std::thread::hardware_concurrency();
+    num_threads = std::max(1, std::min(num_threads, num_sequences));
+    result.num_threads = num_threads;
+
+    // deal the sequences out round-robin, longest first
+    std::vector<int> order((size_t)num_sequences);
+    for(int i = 0; i < num_sequences; ++i)
+        order[(size_t)i] = i;
+    std::stable_sort(order.begin(), order.end(), [sequences](int a, int b)
+        { return sequences[a].num_frames > sequences[b].num_frames; });
+
+    std::vector<offline_render_detail::WorkQueue> queues((size_t)num_threads);
+    for(int i = 0; i < num_sequences; ++i)
+        queues[(size_t)(i % num_threads)].items.push_back(order[(size_t)i]);
+    for(auto& queue : queues)
+        queue.end = (int)queue.items.size();
+
+    using ModelPtr = std::decay_t<decltype(makeModel())>;
+    std::vector<ModelPtr> models;
+    for(int i = 0; i < num_threads; ++i)
+        models.push_back(makeModel());
+
+    // every sequence starts from the state given by the factory
+    const auto state_size = models[0]->getStateSize();
+    std::vector<T> initial_state((size_t)state_size);
+    models[0]->getState(initial_state.data());
+
+    std::atomic<int> num_steals { 0 };
+    const auto runSequences = [&](int thread_idx)
+    {
+        auto& model = *models[(size_t)thread_idx];
+        auto& queue = queues[(size_t)thread_idx];
+        bool first_sequence_on_thread = true;
+        while(true)
+        {
+            auto idx = queue.pop();
+            if(idx < 0)
+            {
+                // every sequence has been queued from the start, so once
+                // none of the queues has any left, the worker is done
+                bool stolen = false;
+                for(int i = 1; i < num_threads && !stolen; ++i)
+                    stolen = queues[(size_t)((thread_idx + i) % num_threads)].stealInto(queue);
+
+                if(!stolen)
+                    return;
+
+                num_steals++;
+                continue;
+            }
+
+            if(!first_sequence_on_thread)
+                model.setState(initial_state.data());
+            first_sequence_on_thread = false;
+
+            const auto& sequence = sequences[idx];
+            offline_render_detail::processFrames<T>(model, sequence.input, sequence.output, sequence.num_frames, in_size, out_size);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for(int i = 1; i < num_threads; ++i)
+        threads.emplace_back(runSequences, i);
+    runSequences(0);
+    for(auto& thread : threads)
+        thread.join();
+
+    result.num_steals = num_steals.load();
+    return result;
+}
+
+} // namespace RTNeural
@@ -0,0 +1,122 @@
+#pragma once
+
+/**
+ * Optional per-layer timing instrumentation for Model<T> and ModelT.
+ *
+ * Define RTNEURAL_ENABLE_LAYER_TIMING=1 (or configure CMake with
+ * -DRTNEURAL_LAYER_TIMING=ON) to have the models accumulate the time
+ * spent in every layer's forward() call. When the flag is not set,
+ * none of this code is compiled into the models' forward paths.
+ */
+#ifndef RTNEURAL_ENABLE_LAYER_TIMING
+#define RTNEURAL_ENABLE_LAYER_TIMING 0
+#endif
+
+#if RTNEURAL_ENABLE_LAYER_TIMING
+
+#include <array>
+#include <cstdint>
+#include <iomanip>
+#include <ostream>
+#include <string>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define RTNEURAL_TIMING_USE_RDTSC 1
+#elif(defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#define RTNEURAL_TIMING_USE_RDTSC 1
+#else
+#include <chrono>
+#define RTNEURAL_TIMING_USE_RDTSC 0
+#endif
+
+namespace RTNeural
+{
+namespace profiling
+{
+    /**
+     * Reads the current timestamp: CPU cycles (rdtsc) on x86,
+     * or std::chrono::steady_clock nanoseconds elsewhere.
+     */
+    inline uint64_t readTicks() noexcept
+    {
+#if RTNEURAL_TIMING_USE_RDTSC
+        return (uint64_t)__rdtsc();
+#else
+        return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+    }
+
+    /** Returns the unit of the values returned by readTicks(). */
+    inline const char* tickUnit() noexcept
+    {
+#if RTNEURAL_TIMING_USE_RDTSC
+        return "cycles";
+#else
+        return "ns";
+#endif
+    }
+
+    /** Accumulated timing for a single layer. */
+    struct LayerTiming
+    {
+        uint64_t ticks = 0;
+        uint64_t calls = 0;
+
+        /** Adds the time elapsed since `start_ticks` as one call. */
+        inline void record(uint64_t start_ticks) noexcept
+        {
+            ticks += readTicks() - start_ticks;
+            calls++;
+        }
+
+        /** Clears the accumulated values. */
+        void reset() noexcept
+        {
+            ticks = 0;
+            calls = 0;
+        }
+
+        /** Returns the average number of ticks per call. */
+        double ticksPerCall() const noexcept
+        {
+            return calls > 0 ? (double)ticks / (double)calls : 0.0;
+        }
+    };
+
+    /**
+     * Prints a per-layer breakdown of the given timings.
+     * `getName(i)` should return the name of layer `i`.
+     */
+    template <typename NameFn>
+    void printLayerTimings(std::ostream& os, const LayerTiming* timings, size_t num_layers, NameFn&& getName)
+    {
+        uint64_t total_ticks = 0;
+        for(size_t i = 0; i < num_layers; ++i)
+            total_ticks += timings[i].ticks;
+
+        const auto old_flags = os.flags();
+        const auto old_precision = os.precision();
+
+        os << "Layer timings (" << tickUnit() << "):" << std::endl;
+        for(size_t i = 0; i < num_layers; ++i)
+        {
+            const auto& t = timings[i];
+            const auto share = total_ticks > 0 ? 100.0 * (double)t.ticks / (double)total_ticks : 0.0;
+
+            os << "  [" << i << "] " << std::left << std::setw(18) << getName(i) << std::right
+               << " calls: " << std::setw(10) << t.calls
+               << "  total: " << std::setw(14) << t.ticks
+               << "  per call: " << std::setw(10) << std::fixed << std::setprecision(1) << t.ticksPerCall()
+               << "  share: " << std::setw(5) << share << "%" << std::endl;
+        }
+        os << "  total: " << total_ticks << " " << tickUnit() << std::endl;
+
+        os.flags(old_flags);
+        os.precision(old_precision);
+    }
+} // namespace profiling
+} // namespace RTNeural
+
+#endif // RTNEURAL_ENABLE_LAYER_TIMING
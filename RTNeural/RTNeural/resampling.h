@@ -0,0 +1,783 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+namespace RTNeural
+{
+
+#ifndef DOXYGEN
+namespace resampling_detail
+{
+    /** Zeroth-order modified Bessel function of the first kind, used by the Kaiser window. */
+    inline double besselI0(double x)
+    {
+        double sum = 1.0;
+        double term = 1.0;
+        for(int k = 1; k < 64; ++k)
+        {
+            const auto factor = x / (2.0 * (double)k);
+            term *= factor * factor;
+            sum += term;
+            if(term < sum * 1.0e-15)
+                break;
+        }
+        return sum;
+    }
+
+    /**
+     * Designs a Kaiser-windowed sinc lowpass filter, with unity gain at DC.
+     * The cutoff is relative to the sample rate (0.5 = Nyquist).
+     */
+    inline std::vector<double> designLowpass(int num_taps, double cutoff, double beta)
+    {
+        constexpr double pi = 3.14159265358979323846;
+
+        std::vector<double> h((size_t)num_taps);
+        const auto centre = 0.5 * (double)(num_taps - 1);
+        const auto window_norm = besselI0(beta);
+
+        double sum = 0.0;
+        for(int n = 0; n < num_taps; ++n)
+        {
+            const auto t = (double)n - centre;
+            const auto sinc = t == 0.0 ? 2.0 * cutoff : std::sin(2.0 * pi * cutoff * t) / (pi * t);
+            const auto r = centre > 0.0 ? t / centre : 0.0;
+            const auto window = besselI0(beta * std::sqrt(std::max(0.0, 1.0 - r * r))) / window_norm;
+            h[(size_t)n] = sinc * window;
+            sum += h[(size_t)n];
+        }
+
+        for(auto& coeff : h)
+            coeff /= sum;
+
+        return h;
+    }
+
+    inline int greatestCommonDivisor(int a, int b)
+    {
+        while(b != 0)
+        {
+            const auto r = a % b;
+            a = b;
+            b = r;
+        }
+        return a;
+    }
+
+    /**
+     * The most recent `length` samples of a signal.
+     * The samples are stored twice, so that they can always
+     * be read as one contiguous block (oldest sample first).
+     */
+    template <typename T>
+    class HistoryBuffer
+    {
+    public:
+        void prepare(int length)
+        {
+            size = std::max(length, 1);
+            data.assign(2 * (size_t)size, (T)0);
+            pos = 0;
+        }
+
+        void reset()
+        {
+            std::fill(data.begin(), data.end(), (T)0);
+            pos = 0;
+        }
+
+        inline void push(T x) noexcept
+        {
+            data[(size_t)pos] = x;
+            data[(size_t)(pos + size)] = x;
+            pos = pos + 1 == size ? 0 : pos + 1;
+        }
+
+        /** Returns the stored samples, oldest first. */
+        inline const T* get() const noexcept { return data.data() + pos; }
+
+    private:
+        std::vector<T> data = std::vector<T>(2);
+        int size = 1;
+        int pos = 0;
+    };
+
+    template <typename T>
+    inline T dot(const T* a, const T* b, int n) noexcept
+    {
+        T sum = (T)0;
+        for(int i = 0; i < n; ++i)
+            sum += a[i] * b[i];
+        return sum;
+    }
+} // namespace resampling_detail
+#endif // DOXYGEN
+
+/**
+ * A halfband lowpass filter that decimates its input by 2.
+ *
+ * Every other tap of a halfband filter is zero (apart from the centre
+ * tap), so the polyphase implementation only needs `2 * half_length + 1`
+ * multiplies per output sample, for a filter with `4 * half_length - 1` taps.
+ * Each tap is applied to the whole block at once, so the inner loop is a
+ * multiply-add over contiguous samples, that the compiler can vectorise.
+ */
+template <typename T>
+class HalfbandDecimator
+{
+public:
+    explicit HalfbandDecimator(int half_length = 16, double beta = 8.0)
+        : half_length(half_length)
+    {
+        const auto h = resampling_detail::designLowpass(4 * half_length - 1, 0.25, beta);
+
+        // the even taps make up one polyphase branch, the other branch is only the centre tap
+        coeffs.resize(2 * (size_t)half_length);
+        for(int j = 0; j < 2 * half_length; ++j)
+            coeffs[(size_t)(2 * half_length - 1 - j)] = (T)h[(size_t)(2 * j)];
+
+        prepare(256);
+    }
+
+    /**
+     * Allocates the buffers for blocks of up to `max_block_size` input
+     * samples (longer blocks are split up). Must not be called on the audio thread.
+     */
+    void prepare(int max_block_size)
+    {
+        max_block = std::max(max_block_size, 2);
+        even.assign((size_t)(2 * half_length - 1 + max_block / 2 + 2), (T)0);
+        odd.assign((size_t)(half_length + max_block / 2 + 2), (T)0);
+        num_even = 0;
+    }
+
+    /** Clears the filter state. */
+    void reset()
+    {
+        std::fill(even.begin(), even.end(), (T)0);
+        std::fill(odd.begin(), odd.end(), (T)0);
+        num_even = 0;
+    }
+
+    /**
+     * Filters and decimates a block of samples, and returns the number of
+     * output samples. Odd-length blocks are handled by carrying the extra
+     * input sample over to the next block.
+     */
+    int process(const T* input, T* output, int num_samples) noexcept
+    {
+        int num_out = 0;
+        for(int start = 0; start < num_samples; start += max_block)
+            num_out += processBlock(input + start, output + num_out, std::min(max_block, num_samples - start));
+        return num_out;
+    }
+
+    /** Returns the maximum number of output samples for a block of input samples. */
+    static int getMaxOutputSize(int num_samples) noexcept { return num_samples / 2 + 1; }
+
+    /** Returns the group delay of the filter, in input samples. */
+    int getLatency() const noexcept { return 2 * half_length - 1; }
+
+private:
+    int processBlock(const T* input, T* output, int num_samples) noexcept
+    {
+        // both branches keep their history at the start of the buffer, followed by the new samples
+        const auto even_history = 2 * half_length - 1;
+        auto* new_even = even.data() + even_history;
+        auto* new_odd = odd.data() + half_length;
+
+        int num_odd = 0;
+        for(int n = 0; n < num_samples; ++n)
+        {
+            if(num_even == num_odd)
+                new_even[num_even++] = input[n];
+            else
+                new_odd[num_odd++] = input[n];
+        }
+
+        const auto num_out = num_odd;
+        for(int j = 0; j < num_out; ++j)
+            output[j] = (T)0.5 * odd[(size_t)j];
+
+        for(int i = 0; i < 2 * half_length; ++i)
+        {
+            const auto coeff = coeffs[(size_t)i];
+            const auto* x = even.data() + i;
+            for(int j = 0; j < num_out; ++j)
+                output[j] += coeff * x[j];
+        }
+
+        // keep the history, and an even sample that is still waiting for its odd sample
+        std::copy(even.begin() + num_out, even.begin() + even_history + num_even, even.begin());
+        std::copy(odd.begin() + num_out, odd.begin() + half_length + num_odd, odd.begin());
+        num_even -= num_out;
+
+        return num_out;
+    }
+
+    int half_length;
+    std::vector<T> coeffs;
+
+    int max_block = 2;
+    std::vector<T> even;
+    std::vector<T> odd;
+    int num_even = 0;
+};
+
+/**
+ * A halfband lowpass filter that interpolates its input by 2.
+ * The counterpart of HalfbandDecimator.
+ */
+template <typename T>
+class HalfbandInterpolator
+{
+public:
+    explicit HalfbandInterpolator(int half_length = 16, double beta = 8.0)
+        : half_length(half_length)
+    {
+        const auto h = resampling_detail::designLowpass(4 * half_length - 1, 0.25, beta);
+
+        // gain of 2 to make up for the zero-stuffing
+        coeffs.resize(2 * (size_t)half_length);
+        for(int j = 0; j < 2 * half_length; ++j)
+            coeffs[(size_t)(2 * half_length - 1 - j)] = (T)(2.0 * h[(size_t)(2 * j)]);
+
+        prepare(256);
+    }
+
+    /**
+     * Allocates the buffers for blocks of up to `max_block_size` input
+     * samples (longer blocks are split up). Must not be called on the audio thread.
+     */
+    void prepare(int max_block_size)
+    {
+        max_block = std::max(max_block_size, 1);
+        history.assign((size_t)(2 * half_length - 1 + max_block), (T)0);
+        even_out.assign((size_t)max_block, (T)0);
+    }
+
+    /** Clears the filter state. */
+    void reset()
+    {
+        std::fill(history.begin(), history.end(), (T)0);
+    }
+
+    /** Filters and interpolates a block of samples, into `2 * num_samples` output samples. */
+    int process(const T* input, T* output, int num_samples) noexcept
+    {
+        for(int start = 0; start < num_samples; start += max_block)
+            processBlock(input + start, output + 2 * start, std::min(max_block, num_samples - start));
+        return 2 * num_samples;
+    }
+
+    /** Returns the maximum number of output samples for a block of input samples. */
+    static int getMaxOutputSize(int num_samples) noexcept { return 2 * num_samples; }
+
+    /** Returns the group delay of the filter, in output samples. */
+    int getLatency() const noexcept { return 2 * half_length - 1; }
+
+private:
+    void processBlock(const T* input, T* output, int num_samples) noexcept
+    {
+        const auto num_history = 2 * half_length - 1;
+        std::copy(input, input + num_samples, history.data() + num_history);
+
+        std::fill(even_out.begin(), even_out.begin() + num_samples, (T)0);
+        for(int i = 0; i < 2 * half_length; ++i)
+        {
+            const auto coeff = coeffs[(size_t)i];
+            const auto* x = history.data() + i;
+            for(int j = 0; j < num_samples; ++j)
+                even_out[(size_t)j] += coeff * x[j];
+        }
+
+        // the odd outputs only use the centre tap
+        for(int j = 0; j < num_samples; ++j)
+        {
+            output[2 * j] = even_out[(size_t)j];
+            output[2 * j + 1] = history[(size_t)(j + half_length)];
+        }
+
+        std::copy(history.begin() + num_samples, history.begin() + num_samples + num_history, history.begin());
+    }
+
+    int half_length;
+    std::vector<T> coeffs;
+
+    int max_block = 1;
+    std::vector<T> history;
+    std::vector<T> even_out;
+};
+
+/**
+ * A polyphase FIR resampler, for a rational ratio between two sample rates.
+ *
+ * The rates are rounded to whole Hz (or to 100 Hz, if the ratio would
+ * need more than `max_phases` filter phases), so that a resampler and its
+ * inverse consume and produce exactly the same number of samples over time.
+ */
+template <typename T>
+class PolyphaseResampler
+{
+public:
+    static constexpr int max_phases = 1024;
+
+    /**
+     * Prepares the resampler, with `taps_per_phase` multiplies per output
+     * sample. The passband extends to `passband` times the lower of the two
+     * Nyquist frequencies. Allocates memory, so it must not be called on the
+     * audio thread.
+     */
+    void prepare(double in_rate, double out_rate, int taps_per_phase = 64, double passband = 0.9, double beta = 8.0)
+    {
+        auto in_hz = (int)std::lround(in_rate);
+        auto out_hz = (int)std::lround(out_rate);
+        if(out_hz / resampling_detail::greatestCommonDivisor(in_hz, out_hz) > max_phases)
+        {
+            in_hz = std::max(1, (int)std::lround(in_rate / 100.0));
+            out_hz = std::max(1, (int)std::lround(out_rate / 100.0));
+        }
+
+        const auto divisor = resampling_detail::greatestCommonDivisor(in_hz, out_hz);
+        up = out_hz / divisor;
+        down = in_hz / divisor;
+        num_taps = taps_per_phase;
+
+        // the prototype filter runs at `up` times the input rate
+        const auto cutoff = 0.5 * passband / (double)std::max(up, down);
+        const auto h = resampling_detail::designLowpass(up * num_taps, cutoff, beta);
+
+        // each phase is stored in reverse, to match the oldest-first history
+        coeffs.resize((size_t)(up * num_taps));
+        for(int phase = 0; phase < up; ++phase)
+            for(int k = 0; k < num_taps; ++k)
+                coeffs[(size_t)(phase * num_taps + num_taps - 1 - k)] = (T)((double)up * h[(size_t)(k * up + phase)]);
+
+        history.prepare(num_taps);
+        reset();
+    }
+
+    /** Clears the filter state. */
+    void reset()
+    {
+        history.reset();
+        phase = 0;
+        samples_needed = 1;
+    }
+
+    /** Resamples a block of samples, and returns the number of output samples. */
+    int process(const T* input, T* output, int num_samples) noexcept
+    {
+        int num_out = 0;
+        for(int n = 0; n < num_samples; ++n)
+        {
+            history.push(input[n]);
+            if(--samples_needed > 0)
+                continue;
+
+            // output sample k uses the input up to floor(k * down / up), with phase (k * down) % up
+            while(samples_needed == 0)
+            {
+                output[num_out++] = resampling_detail::dot(history.get(), coeffs.data() + phase * num_taps, num_taps);
+                phase += down;
+                samples_needed = phase / up;
+                phase %= up;
+            }
+        }
+
+        return num_out;
+    }
+
+    /** Returns the maximum number of output samples for a block of input samples. */
+    int getMaxOutputSize(int num_samples) const noexcept
+    {
+        return (int)(((int64_t)num_samples * up + down - 1) / down) + 1;
+    }
+
+    /** Returns the group delay of the filter, in input samples. */
+    double getLatency() const noexcept { return (double)(up * num_taps - 1) / (2.0 * (double)up); }
+
+    /** Returns the interpolation factor of the rational ratio. */
+    int getUpFactor() const noexcept { return up; }
+
+    /** Returns the decimation factor of the rational ratio. */
+    int getDownFactor() const noexcept { return down; }
+
+private:
+    int up = 1;
+    int down = 1;
+    int num_taps = 1;
+    std::vector<T> coeffs = std::vector<T>(1, (T)1);
+    resampling_detail::HistoryBuffer<T> history;
+
+    int phase = 0;
+    int samples_needed = 1;
+};
+
+/**
+ * Runs a mono processor (e.g. a model) at the sample rate it was trained
+ * at, from a host running at a different sample rate.
+ *
+ * The host signal is down-converted with a cascade of halfband decimators
+ * (for each factor of 2 between the two rates) and a polyphase resampler
+ * (for the remaining ratio), then processed, then up-converted back with
+ * the inverse cascade. A short FIFO at the host rate absorbs the block-size
+ * jitter of the conversion, so that every call returns exactly the number
+ * of samples it was given. The total delay is reported by getLatencySamples().
+ *
+ * If the two rates are equal, the processor runs directly on the host signal.
+ */
+template <typename T>
+class ModelResampler
+{
+public:
+    static constexpr int max_halfband_stages = 3;
+
+    /**
+     * Prepares the resampler for blocks of up to `max_block_size` host samples.
+     * Allocates memory, so it must not be called on the audio thread.
+     */
+    void prepare(double new_host_rate, double new_model_rate, int max_block_size)
+    {
+        host_rate = new_host_rate;
+        model_rate = new_model_rate;
+        max_host_block = std::max(max_block_size, 1);
+
+        decimators.clear();
+        interpolators.clear();
+        bypassed = std::lround(host_rate) == std::lround(model_rate);
+        if(bypassed)
+        {
+            latency = 0.0;
+            return;
+        }
+
+        auto intermediate_rate = host_rate;
+        int num_halfbands = 0;
+        while(num_halfbands < max_halfband_stages && intermediate_rate * 0.5 >= model_rate - 0.5)
+        {
+            ++num_halfbands;
+            intermediate_rate *= 0.5;
+        }
+
+        // the stages next to the model rate have the sharpest filters,
+        // the others only need to reject images far above the audio band
+        for(int i = 0; i < num_halfbands; ++i)
+        {
+            decimators.emplace_back(i == num_halfbands - 1 ? 16 : 8);
+            interpolators.emplace_back(i == 0 ? 16 : 8);
+        }
+
+        use_polyphase = std::lround(intermediate_rate) != std::lround(model_rate);
+        if(use_polyphase)
+        {
+            downsampler.prepare(intermediate_rate, model_rate);
+            upsampler.prepare(model_rate, intermediate_rate);
+        }
+
+        // work out the largest block at each stage of the cascade
+        auto block_size = max_host_block;
+        auto max_size = block_size;
+        for(auto& decimator : decimators)
+        {
+            decimator.prepare(block_size);
+            block_size = HalfbandDecimator<T>::getMaxOutputSize(block_size);
+        }
+        if(use_polyphase)
+            block_size = downsampler.getMaxOutputSize(block_size);
+        max_model_block = block_size;
+        max_size = std::max(max_size, block_size);
+        if(use_polyphase)
+            block_size = upsampler.getMaxOutputSize(block_size);
+        for(auto& interpolator : interpolators)
+        {
+            interpolator.prepare(block_size);
+            block_size = HalfbandInterpolator<T>::getMaxOutputSize(block_size);
+        }
+        max_size = std::max(max_size, block_size);
+
+        // every stage may hold back up to one of its input samples
+        const auto rate_ratio = (int)std::ceil(host_rate / model_rate);
+        fifo_prefill = (2 << decimators.size()) + 2 * rate_ratio + 2;
+
+        buffers[0].assign((size_t)max_size, (T)0);
+        buffers[1].assign((size_t)max_size, (T)0);
+        fifo.assign((size_t)(max_size + 2 * fifo_prefill), (T)0);
+
+        // the latency of each stage, converted to seconds
+        double latency_seconds = 0.0;
+        auto stage_rate = host_rate;
+        for(auto& decimator : decimators)
+        {
+            latency_seconds += (double)decimator.getLatency() / stage_rate;
+            stage_rate *= 0.5;
+        }
+        if(use_polyphase)
+        {
+            latency_seconds += downsampler.getLatency() / intermediate_rate;
+            latency_seconds += upsampler.getLatency() / model_rate;
+        }
+        for(auto& interpolator : interpolators)
+        {
+            stage_rate *= 2.0;
+            latency_seconds += (double)interpolator.getLatency() / stage_rate;
+        }
+        latency = latency_seconds * host_rate + (double)fifo_prefill;
+
+        reset();
+    }
+
+    /** Clears the state of the filters. */
+    void reset()
+    {
+        for(auto& decimator : decimators)
+            decimator.reset();
+        for(auto& interpolator : interpolators)
+            interpolator.reset();
+        downsampler.reset();
+        upsampler.reset();
+
+        std::fill(fifo.begin(), fifo.end(), (T)0);
+        fifo_count = fifo_prefill;
+    }
+
+    /**
+     * Processes a block of host samples in place.
+     *
+     * `process_at_model_rate(T* buffer, int num_samples)` is called with the
+     * down-converted block (of up to getMaxModelBlockSize() samples), and must
+     * process it in place.
+     */
+    template <typename Callback>
+    void process(T* buffer, int num_samples, Callback&& process_at_model_rate) noexcept
+    {
+        if(bypassed)
+        {
+            process_at_model_rate(buffer, num_samples);
+            return;
+        }
+
+        for(int start = 0; start < num_samples; start += max_host_block)
+            processBlock(buffer + start, std::min(max_host_block, num_samples - start), process_at_model_rate);
+    }
+
+    /** Returns the delay added by the conversion, in host samples. */
+    double getLatency() const noexcept { return latency; }
+
+    /** Returns the delay added by the conversion, rounded to whole host samples. */
+    int getLatencySamples() const noexcept { return (int)std::lround(latency); }
+
+    /** Returns the largest block that is passed to the processor. */
+    int getMaxModelBlockSize() const noexcept { return bypassed ? max_host_block : max_model_block; }
+
+    /** Returns true if the host and model rates are equal, so nothing is converted. */
+    bool isBypassed() const noexcept { return bypassed; }
+
+    /** Returns the number of halfband stages in each direction. */
+    int getNumHalfbandStages() const noexcept { return (int)decimators.size(); }
+
+private:
+    template <typename Callback>
+    void processBlock(T* buffer, int num_samples, Callback& process_at_model_rate) noexcept
+    {
+        int buffer_idx = 0;
+        const T* in = buffer;
+        auto size = num_samples;
+
+        for(auto& decimator : decimators)
+        {
+            size = decimator.process(in, buffers[buffer_idx].data(), size);
+            in = buffers[buffer_idx].data();
+            buffer_idx ^= 1;
+        }
+
+        if(use_polyphase)
+        {
+            size = downsampler.process(in, buffers[buffer_idx].data(), size);
+            in = buffers[buffer_idx].data();
+            buffer_idx ^= 1;
+        }
+
+        // `in` points to one of the scratch buffers by now, since the rates are different
+        auto* model_block = buffers[buffer_idx ^ 1].data();
+        process_at_model_rate(model_block, size);
+
+        if(use_polyphase)
+        {
+            size = upsampler.process(in, buffers[buffer_idx].data(), size);
+            in = buffers[buffer_idx].data();
+            buffer_idx ^= 1;
+        }
+
+        for(auto& interpolator : interpolators)
+        {
+            size = interpolator.process(in, buffers[buffer_idx].data(), size);
+            in = buffers[buffer_idx].data();
+            buffer_idx ^= 1;
+        }
+
+        size = std::min(size, (int)fifo.size() - fifo_count);
+        std::copy(in, in + size, fifo.data() + fifo_count);
+        fifo_count += size;
+
+        const auto num_available = std::min(fifo_count, num_samples);
+        std::copy(fifo.data(), fifo.data() + num_available, buffer);
+        std::fill(buffer + num_available, buffer + num_samples, (T)0);
+        std::copy(fifo.data() + num_available, fifo.data() + fifo_count, fifo.data());
+        fifo_count -= num_available;
+    }
+
+    double host_rate = 48000.0;
+    double model_rate = 48000.0;
+    bool bypassed = true;
+    bool use_polyphase = false;
+
+    std::vector<HalfbandDecimator<T>> decimators;
+    std::vector<HalfbandInterpolator<T>> interpolators;
+    PolyphaseResampler<T> downsampler;
+    PolyphaseResampler<T> upsampler;
+
+    int max_host_block = 1;
+    int max_model_block = 1;
+    std::vector<T> buffers[2];
+
+    std::vector<T> fifo;
+    int fifo_count = 0;
+    int fifo_prefill = 0;
+
+    double latency = 0.0;
+};
+
+/**
+ * Runs a processor (e.g. a distortion model) at 2, 4 or 8 times the host
+ * sample rate, to reduce the aliasing of the harmonics that it generates.
+ *
+ * The signal is interpolated with a cascade of halfband filters, processed,
+ * and decimated back with the inverse cascade, so every call returns exactly
+ * the number of samples it was given, delayed by getLatency(). The stage next
+ * to the host rate has the sharpest filters, while the later stages only need
+ * to reject images far above the audio band, so they use shorter ones.
+ *
+ * A model with recurrent layers should be prepared for the oversampling
+ * factor with `SampleRateCorrectionMode`, so that it behaves as it did at the
+ * rate it was trained at.
+ */
+template <typename T>
+class Oversampler
+{
+public:
+    static constexpr int max_factor = 8;
+
+    /**
+     * Prepares the oversampler for a factor of 1 (no oversampling), 2, 4 or 8
+     * (other factors are rounded down), and blocks of up to `max_block_size`
+     * host samples. Allocates memory, so it must not be called on the audio thread.
+     */
+    void prepare(int new_factor, int max_block_size)
+    {
+        max_host_block = std::max(max_block_size, 1);
+
+        interpolators.clear();
+        decimators.clear();
+        factor = 1;
+        while(2 * factor <= std::min(new_factor, max_factor))
+        {
+            const auto half_length = factor == 1 ? 16 : 8;
+            interpolators.emplace_back(half_length);
+            decimators.emplace_back(half_length);
+            factor *= 2;
+        }
+
+        // stage i converts between `2^i` and `2^(i + 1)` times the host rate
+        latency = 0.0;
+        for(size_t i = 0; i < interpolators.size(); ++i)
+        {
+            interpolators[i].prepare(max_host_block << i);
+            decimators[i].prepare(max_host_block << (i + 1));
+            latency += (double)(interpolators[i].getLatency() + decimators[i].getLatency()) / (double)(2 << i);
+        }
+
+        buffers[0].assign((size_t)(max_host_block * factor), (T)0);
+        buffers[1].assign((size_t)(max_host_block * factor), (T)0);
+        reset();
+    }
+
+    /** Clears the state of the filters. */
+    void reset()
+    {
+        for(auto& interpolator : interpolators)
+            interpolator.reset();
+        for(auto& decimator : decimators)
+            decimator.reset();
+    }
+
+    /**
+     * Processes a block of host samples in place.
+     *
+     * `process_oversampled(T* buffer, int num_samples)` is called with the
+     * oversampled block (of up to getFactor() times the prepared block size),
+     * and must process it in place.
+     */
+    template <typename Callback>
+    void process(T* buffer, int num_samples, Callback&& process_oversampled) noexcept
+    {
+        if(factor == 1)
+        {
+            process_oversampled(buffer, num_samples);
+            return;
+        }
+
+        for(int start = 0; start < num_samples; start += max_host_block)
+            processBlock(buffer + start, std::min(max_host_block, num_samples - start), process_oversampled);
+    }
+
+    /** Returns the oversampling factor. */
+    int getFactor() const noexcept { return factor; }
+
+    /** Returns the delay added by the filters, in host samples. */
+    double getLatency() const noexcept { return latency; }
+
+    /** Returns the delay added by the filters, rounded to whole host samples. */
+    int getLatencySamples() const noexcept { return (int)std::lround(latency); }
+
+private:
+    template <typename Callback>
+    void processBlock(T* buffer, int num_samples, Callback& process_oversampled) noexcept
+    {
+        int buffer_idx = 0;
+        const T* in = buffer;
+        auto size = num_samples;
+
+        for(auto& interpolator : interpolators)
+        {
+            size = interpolator.process(in, buffers[buffer_idx].data(), size);
+            in = buffers[buffer_idx].data();
+            buffer_idx ^= 1;
+        }
+
+        process_oversampled(buffers[buffer_idx ^ 1].data(), size);
+
+        // the last decimator writes straight back into the host buffer
+        for(int i = (int)decimators.size() - 1; i >= 0; --i)
+        {
+            auto* out = i == 0 ? buffer : buffers[buffer_idx].data();
+            size = decimators[(size_t)i].process(in, out, size);
+            in = out;
+            buffer_idx ^= 1;
+        }
+    }
+
+    int factor = 1;
+    int max_host_block = 1;
+
+    std::vector<HalfbandInterpolator<T>> interpolators;
+    std::vector<HalfbandDecimator<T>> decimators;
+    std::vector<T> buffers[2];
+
+    double latency = 0.0;
+};
+
+} // namespace RTNeural
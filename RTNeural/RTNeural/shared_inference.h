@@ -0,0 +1,703 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "common.h"
+
+namespace RTNeural
+{
+
+/**
+ * An LSTM layer followed by a Dense layer, that runs one frame of many
+ * independent streams at once.
+ *
+ * The streams share the weights, and every product is a matrix-matrix
+ * product with one column per stream, so the weights are loaded once
+ * per frame for all of the streams, instead of once per stream.
+ *
+ * The weights of `lstm` and `dense` are set with the same methods as
+ * LSTMLayer and Dense, so `torch_helpers::loadLSTM()` and
+ * `torch_helpers::loadDense()` can be used on them. The weights must
+ * not change while the model is in use.
+ */
+template <typename T>
+class BatchedLSTMDense
+{
+public:
+    /**
+     * The weights of the LSTM layer. The kernel and recurrent weights of
+     * each gate are stored side by side, so that they can be applied to
+     * the input and the state with a single product.
+     */
+    struct LSTMWeights
+    {
+        LSTMWeights(int in_size, int out_size)
+            : in_size(in_size)
+            , out_size(out_size)
+            , W((size_t)(4 * out_size * (in_size + out_size)), (T)0)
+            , b((size_t)(4 * out_size), (T)0)
+        {
+        }
+
+        /** Sets the kernel weights, with dimensions [in_size][4 * out_size] (gates i, f, c, o). */
+        void setWVals(const std::vector<std::vector<T>>& wVals)
+        {
+            for(int i = 0; i < in_size; ++i)
+                for(int k = 0; k < 4 * out_size; ++k)
+                    W[(size_t)(k * (in_size + out_size) + i)] = wVals[(size_t)i][(size_t)k];
+        }
+
+        /** Sets the recurrent weights, with dimensions [out_size][4 * out_size]. */
+        void setUVals(const std::vector<std::vector<T>>& uVals)
+        {
+            for(int i = 0; i < out_size; ++i)
+                for(int k = 0; k < 4 * out_size; ++k)
+                    W[(size_t)(k * (in_size + out_size) + in_size + i)] = uVals[(size_t)i][(size_t)k];
+        }
+
+        /** Sets the biases, with dimensions [4 * out_size]. */
+        void setBVals(const std::vector<T>& bVals)
+        {
+            std::copy(bVals.begin(), bVals.begin() + 4 * out_size, b.begin());
+        }
+
+        const int in_size;
+        const int out_size;
+        std::vector<T> W; // [4 * out_size x (in_size + out_size)]
+        std::vector<T> b;
+    };
+
+    /** The weights of the Dense layer. */
+    struct DenseWeights
+    {
+        DenseWeights(int in_size, int out_size)
+            : in_size(in_size)
+            , out_size(out_size)
+            , W((size_t)(out_size * in_size), (T)0)
+            , b((size_t)out_size, (T)0)
+        {
+        }
+
+        /** Sets the weights, with dimensions [out_size][in_size]. */
+        void setWeights(const std::vector<std::vector<T>>& newWeights)
+        {
+            for(int i = 0; i < out_size; ++i)
+                std::copy(newWeights[(size_t)i].begin(), newWeights[(size_t)i].begin() + in_size, W.begin() + i * in_size);
+        }
+
+        /** Sets the biases, with dimensions [out_size]. */
+        void setBias(const T* newBias)
+        {
+            std::copy(newBias, newBias + out_size, b.begin());
+        }
+
+        const int in_size;
+        const int out_size;
+        std::vector<T> W; // [out_size x in_size]
+        std::vector<T> b;
+    };
+
+    BatchedLSTMDense(int in_size, int hidden_size, int out_size = 1)
+        : lstm(in_size, hidden_size)
+        , dense(hidden_size, out_size)
+    {
+    }
+
+    int getInSize() const noexcept { return lstm.in_size; }
+    int getHiddenSize() const noexcept { return lstm.out_size; }
+    int getOutSize() const noexcept { return dense.out_size; }
+
+    /** Returns the number of values of scratch memory that forward() needs for `num_streams` streams. */
+    int getScratchSize(int num_streams) const noexcept { return (5 * lstm.out_size + lstm.in_size) * num_streams; }
+
+    /**
+     * Runs one frame of `num_streams` streams.
+     *
+     * Every matrix holds row `i` of all of the streams contiguously, at
+     * `i * num_streams`: `input` is [in_size x num_streams], `h` and `c`
+     * hold the [hidden_size x num_streams] state, which is updated in
+     * place, and `output` is [out_size x num_streams].
+     */
+    void forward(const T* input, T* h, T* c, T* output, int num_streams, T* scratch) const noexcept
+    {
+        const auto N = num_streams;
+        const auto in_size = lstm.in_size;
+        const auto hidden_size = lstm.out_size;
+        const auto out_size = dense.out_size;
+        T* gates = scratch;
+
+        // the input and the state are stacked, so one product applies all of the LSTM weights
+        T* xh = gates + 4 * hidden_size * N;
+        std::copy(input, input + in_size * N, xh);
+        std::copy(h, h + hidden_size * N, xh + in_size * N);
+
+#if RTNEURAL_USE_EIGEN
+        using matrix_type = Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+        using vector_type = Eigen::Matrix<T, Eigen::Dynamic, 1>;
+        Eigen::Map<matrix_type> gates_mat(gates, 4 * hidden_size, N);
+        gates_mat.noalias() = Eigen::Map<const matrix_type>(lstm.W.data(), 4 * hidden_size, in_size + hidden_size)
+            * Eigen::Map<const matrix_type>(xh, in_size + hidden_size, N);
+        gates_mat.colwise() += Eigen::Map<const vector_type>(lstm.b.data(), 4 * hidden_size);
+#else
+        for(int k = 0; k < 4 * hidden_size; ++k)
+        {
+            T* row = gates + k * N;
+            std::fill(row, row + N, lstm.b[(size_t)k]);
+            for(int i = 0; i < in_size + hidden_size; ++i)
+                multiplyAdd(lstm.W[(size_t)(k * (in_size + hidden_size) + i)], xh + i * N, row, N);
+        }
+#endif
+
+#if RTNEURAL_USE_EIGEN
+        // the rows of each gate are contiguous, so the activations run over whole gates
+        using array_type = Eigen::Array<T, Eigen::Dynamic, 1>;
+        const auto size = hidden_size * N;
+        const auto sigmoid_gate = [gates, size](int gate)
+        { return (T)1 / ((T)1 + (-Eigen::Map<const array_type>(gates + gate * size, size)).exp()); };
+
+        Eigen::Map<array_type> c_vec(c, size);
+        c_vec = sigmoid_gate(1) * c_vec + sigmoid_gate(0) * Eigen::Map<const array_type>(gates + 2 * size, size).tanh();
+        Eigen::Map<array_type>(h, size) = sigmoid_gate(3) * c_vec.tanh();
+#else
+        for(int k = 0; k < hidden_size; ++k)
+        {
+            const T* i_row = gates + k * N;
+            const T* f_row = gates + (hidden_size + k) * N;
+            const T* c_row = gates + (2 * hidden_size + k) * N;
+            const T* o_row = gates + (3 * hidden_size + k) * N;
+            for(int n = 0; n < N; ++n)
+            {
+                const auto idx = k * N + n;
+                c[idx] = sigmoid(f_row[n]) * c[idx] + sigmoid(i_row[n]) * std::tanh(c_row[n]);
+                h[idx] = sigmoid(o_row[n]) * std::tanh(c[idx]);
+            }
+        }
+#endif
+
+#if RTNEURAL_USE_EIGEN
+        Eigen::Map<matrix_type> out_mat(output, out_size, N);
+        out_mat.noalias() = Eigen::Map<const matrix_type>(dense.W.data(), out_size, hidden_size)
+            * Eigen::Map<const matrix_type>(h, hidden_size, N);
+        out_mat.colwise() += Eigen::Map<const vector_type>(dense.b.data(), out_size);
+#else
+        for(int k = 0; k < out_size; ++k)
+        {
+            T* row = output + k * N;
+            std::fill(row, row + N, dense.b[(size_t)k]);
+            for(int i = 0; i < hidden_size; ++i)
+                multiplyAdd(dense.W[(size_t)(k * hidden_size + i)], h + i * N, row, N);
+        }
+#endif
+    }
+
+    LSTMWeights lstm;
+    DenseWeights dense;
+
+private:
+#if !RTNEURAL_USE_EIGEN
+    static inline T sigmoid(T x) noexcept
+    {
+        return (T)1 / ((T)1 + std::exp(-x));
+    }
+
+    static inline void multiplyAdd(T weight, const T* in, T* out, int N) noexcept
+    {
+        for(int n = 0; n < N; ++n)
+            out[n] += weight * in[n];
+    }
+#endif
+};
+
+/**
+ * Single-producer, single-consumer queue of frames, with `frame_size`
+ * values per frame. Reading and writing are wait-free.
+ */
+template <typename T>
+class FrameFifo
+{
+public:
+    /** Allocates the queue for at least `min_capacity` frames, and empties it. */
+    void prepare(int new_frame_size, int min_capacity)
+    {
+        frame_size = new_frame_size;
+        capacity = 1;
+        while(capacity < (size_t)std::max(min_capacity, 1))
+            capacity *= 2;
+
+        buffer.assign(capacity * (size_t)frame_size, (T)0);
+        reset();
+    }
+
+    /** Empties the queue (not while either side is in use). */
+    void reset() noexcept
+    {
+        read_pos.store(0, std::memory_order_relaxed);
+        write_pos.store(0, std::memory_order_relaxed);
+    }
+
+    /** Returns the number of frames that can be read. */
+    int getNumReady() const noexcept
+    {
+        return (int)(write_pos.load(std::memory_order_acquire) - read_pos.load(std::memory_order_acquire));
+    }
+
+    /** Returns the number of frames that can be written. */
+    int getNumFree() const noexcept
+    {
+        return (int)capacity - getNumReady();
+    }
+
+    /** Writes up to `num_frames` frames (silence if `frames` is nullptr), and returns the number that were written. */
+    int write(const T* frames, int num_frames) noexcept
+    {
+        const auto pos = write_pos.load(std::memory_order_relaxed);
+        num_frames = std::min(num_frames, (int)(capacity - (pos - read_pos.load(std::memory_order_acquire))));
+        for(int n = 0; n < num_frames; ++n)
+        {
+            T* frame = buffer.data() + ((pos + (size_t)n) & (capacity - 1)) * (size_t)frame_size;
+            if(frames != nullptr)
+                std::copy(frames + n * frame_size, frames + (n + 1) * frame_size, frame);
+            else
+                std::fill(frame, frame + frame_size, (T)0);
+        }
+
+        write_pos.store(pos + (size_t)num_frames, std::memory_order_release);
+        return num_frames;
+    }
+
+    /** Reads up to `num_frames` frames (or drops them if `frames` is nullptr), and returns the number that were read. */
+    int read(T* frames, int num_frames) noexcept
+    {
+        const auto pos = read_pos.load(std::memory_order_relaxed);
+        num_frames = std::min(num_frames, (int)(write_pos.load(std::memory_order_acquire) - pos));
+        if(frames != nullptr)
+        {
+            for(int n = 0; n < num_frames; ++n)
+            {
+                const T* frame = buffer.data() + ((pos + (size_t)n) & (capacity - 1)) * (size_t)frame_size;
+                std::copy(frame, frame + frame_size, frames + n * frame_size);
+            }
+        }
+
+        read_pos.store(pos + (size_t)num_frames, std::memory_order_release);
+        return num_frames;
+    }
+
+private:
+    std::vector<T> buffer;
+    size_t capacity = 0;
+    int frame_size = 1;
+
+    std::atomic<size_t> read_pos { 0 };
+    std::atomic<size_t> write_pos { 0 };
+};
+
+/** Settings for SharedInferenceService. */
+struct SharedInferenceSettings
+{
+    /** Number of frames of each stream that are processed per batch. */
+    int batch_size = 32;
+
+    /** Largest number of streams that can be registered at once. */
+    int max_streams = 128;
+
+    /** Number of streams that are batched together, and processed by one worker at a time. */
+    int group_size = 16;
+
+    /** Number of worker threads (0 = no threads, the batches only run in processPending()). */
+    int num_workers = 1;
+
+    /**
+     * Longest time (in milliseconds) that the frames of a stream wait for
+     * the other streams of its group before being processed without them.
+     * It should be well below the duration of one block of the host, so
+     * that a stream that stops (e.g. a bypassed plugin) only delays the
+     * others by this much, instead of making them miss their deadline.
+     */
+    double max_wait_ms = 1.0;
+};
+
+/**
+ * Runs a BatchedLSTMDense model for many streams (e.g. every channel
+ * of every instance of a plugin that uses the same model), as one
+ * batch, on a pool of worker threads.
+ *
+ * Each stream hands its input frames over to the service, and takes
+ * back the output of earlier frames, through wait-free queues, so
+ * process() never blocks, and is safe to call from an audio thread.
+ * The workers wait until every stream of a group has queued a batch
+ * of frames (or until the oldest one has waited for `max_wait_ms`),
+ * and then process all of them together.
+ *
+ * Since the frames of a block are processed after process() returns,
+ * the output is delayed by getLatency() frames (at least one block),
+ * and the batches are expected to be done by the next call to process().
+ * When they are not, the missing output is replaced by silence (and
+ * counted by getNumUnderruns()), and the late output is dropped when
+ * it arrives, so that the latency stays the same.
+ */
+template <typename T>
+class SharedInferenceService
+{
+public:
+    SharedInferenceService(BatchedLSTMDense<T> batchedModel, const SharedInferenceSettings& serviceSettings = {})
+        : model(std::move(batchedModel))
+        , settings(serviceSettings)
+    {
+        settings.batch_size = std::max(settings.batch_size, 1);
+        settings.group_size = std::max(settings.group_size, 1);
+        settings.max_streams = std::max(settings.max_streams, 1);
+        settings.num_workers = std::max(settings.num_workers, 0);
+        max_wait_ticks = (int64_t)(settings.max_wait_ms * 1.0e6);
+
+        const auto num_groups = (settings.max_streams + settings.group_size - 1) / settings.group_size;
+        for(int i = 0; i < settings.max_streams; ++i)
+            streams.emplace_back(new Stream);
+        for(int i = 0; i < num_groups; ++i)
+            groups.emplace_back(new Group(model, settings));
+
+        running = true;
+        for(int i = 0; i < settings.num_workers; ++i)
+            workers.emplace_back(&SharedInferenceService::workerLoop, this);
+    }
+
+    ~SharedInferenceService()
+    {
+        {
+            std::lock_guard<std::mutex> lock(wake_mutex);
+            running = false;
+        }
+
+        wake_condition.notify_all();
+        for(auto& worker : workers)
+            worker.join();
+    }
+
+    SharedInferenceService(const SharedInferenceService&) = delete;
+    SharedInferenceService& operator=(const SharedInferenceService&) = delete;
+
+    const BatchedLSTMDense<T>& getModel() const noexcept { return model; }
+    const SharedInferenceSettings& getSettings() const noexcept { return settings; }
+
+    /**
+     * Registers a stream that calls process() with blocks of up to
+     * `max_block_size` frames, with its model state reset, and returns
+     * its index (or -1 if `max_streams` streams are registered already).
+     * Allocates memory, so it must not be called on the audio thread.
+     */
+    int registerStream(int max_block_size)
+    {
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        int idx = 0;
+        while(idx < (int)streams.size() && streams[(size_t)idx]->active.load(std::memory_order_acquire))
+            ++idx;
+        if(idx == (int)streams.size())
+            return -1;
+
+        // the frames of a block are only processed after process() returns, so
+        // the output needs one block, and the part of a batch that was not full
+        // at the end of the previous block
+        const auto batch_size = settings.batch_size;
+        max_block_size = std::max(max_block_size, 1);
+        const auto latency = max_block_size % batch_size == 0 ? max_block_size : max_block_size + batch_size - 1;
+
+        auto& group = claimGroup(idx);
+        auto& stream = *streams[(size_t)idx];
+        stream.input.prepare(model.getInSize(), 2 * latency + batch_size);
+        stream.output.prepare(model.getOutSize(), 2 * latency + batch_size);
+        stream.output.write(nullptr, latency);
+        stream.latency = latency;
+        stream.alignment = 0;
+        stream.ready_time.store(0, std::memory_order_relaxed);
+        stream.underruns.store(0, std::memory_order_relaxed);
+
+        const auto slot = idx % settings.group_size;
+        for(int k = 0; k < model.getHiddenSize(); ++k)
+        {
+            group.h[(size_t)(k * settings.group_size + slot)] = (T)0;
+            group.c[(size_t)(k * settings.group_size + slot)] = (T)0;
+        }
+
+        stream.active.store(true, std::memory_order_release);
+        group.busy.clear(std::memory_order_release);
+        return idx;
+    }
+
+    /**
+     * Unregisters a stream, after waiting for any batch that it is part of.
+     * process() must not be called for the stream during or after this call.
+     */
+    void unregisterStream(int stream_idx)
+    {
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        auto& group = claimGroup(stream_idx);
+        streams[(size_t)stream_idx]->active.store(false, std::memory_order_release);
+        group.busy.clear(std::memory_order_release);
+    }
+
+    /** Returns the number of frames that the output of a stream is delayed by. */
+    int getLatency(int stream_idx) const noexcept { return streams[(size_t)stream_idx]->latency; }
+
+    /**
+     * Returns the number of output frames of a stream that are ready. When
+     * rendering offline, a stream can wait for its output (calling
+     * processPending() in the meantime), instead of getting silence.
+     */
+    int getNumOutputFrames(int stream_idx) const noexcept
+    {
+        return streams[(size_t)stream_idx]->output.getNumReady();
+    }
+
+    /** Returns the number of output frames of a stream that were replaced by silence, because they were not ready in time. */
+    int getNumUnderruns(int stream_idx) const noexcept
+    {
+        return streams[(size_t)stream_idx]->underruns.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Hands `num_frames` input frames (with `in_size` values each) of a
+     * stream over to the workers, and fills `output` with `num_frames`
+     * output frames (with `out_size` values each), delayed by getLatency().
+     * Wait-free, apart from waking a worker.
+     */
+    void process(int stream_idx, const T* input, T* output, int num_frames) noexcept
+    {
+        auto& stream = *streams[(size_t)stream_idx];
+        assert(stream.active.load(std::memory_order_relaxed) && "Stream is not registered!");
+
+        const auto batch_size = settings.batch_size;
+        // the time is set before the frames are visible to the workers
+        const auto num_queued = stream.input.getNumReady();
+        if(num_queued < batch_size && num_queued + std::min(num_frames, stream.input.getNumFree()) >= batch_size)
+            stream.ready_time.store(now(), std::memory_order_release);
+        const auto num_written = stream.input.write(input, num_frames);
+
+        // the output of frames that did not fit in the queue never arrives
+        stream.alignment -= num_frames - num_written;
+
+        if(num_queued + num_written >= batch_size)
+        {
+            pending.fetch_add(1, std::memory_order_release);
+            if(settings.num_workers > 0)
+                wake_condition.notify_one();
+        }
+
+        const auto out_size = model.getOutSize();
+        if(stream.alignment > 0)
+            stream.alignment -= stream.output.read(nullptr, stream.alignment);
+
+        int num_read = 0;
+        if(stream.alignment < 0)
+        {
+            num_read = std::min(-stream.alignment, num_frames);
+            std::fill(output, output + num_read * out_size, (T)0);
+            stream.alignment += num_read;
+        }
+
+        num_read += stream.output.read(output + num_read * out_size, num_frames - num_read);
+        if(num_read < num_frames)
+        {
+            std::fill(output + num_read * out_size, output + num_frames * out_size, (T)0);
+            stream.alignment += num_frames - num_read;
+            stream.underruns.fetch_add(num_frames - num_read, std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * Runs every batch that is ready, on the calling thread, and returns
+     * the number of batches that were run. Without worker threads, this
+     * is the only place where the batches run.
+     */
+    int processPending()
+    {
+        int num_batches = 0;
+        for(int i = 0; i < (int)groups.size(); ++i)
+            num_batches += processGroup(*groups[(size_t)i], i);
+        return num_batches;
+    }
+
+private:
+    struct Stream
+    {
+        FrameFifo<T> input;
+        FrameFifo<T> output;
+        std::atomic<bool> active { false };
+        std::atomic<int64_t> ready_time { 0 }; // when the input queue last reached a full batch
+        std::atomic<int> underruns { 0 };
+        int latency = 0;
+        int alignment = 0; // audio thread only: output frames to drop (> 0) or to replace by silence (< 0)
+    };
+
+    /** The state and the scratch memory of a group of streams, which are only used by the thread that claimed it. */
+    struct Group
+    {
+        Group(const BatchedLSTMDense<T>& model, const SharedInferenceSettings& settings)
+            : h((size_t)(model.getHiddenSize() * settings.group_size), (T)0)
+            , c(h.size(), (T)0)
+            , batch_h(h.size())
+            , batch_c(h.size())
+            , batch_in((size_t)(settings.batch_size * model.getInSize() * settings.group_size))
+            , batch_out((size_t)(settings.batch_size * model.getOutSize() * settings.group_size))
+            , frames((size_t)(settings.batch_size * std::max(model.getInSize(), model.getOutSize())))
+            , scratch((size_t)model.getScratchSize(settings.group_size))
+        {
+            ready.reserve((size_t)settings.group_size);
+        }
+
+        std::atomic_flag busy = ATOMIC_FLAG_INIT;
+        std::vector<T> h, c; // [hidden_size x group_size]
+        std::vector<T> batch_h, batch_c; // [hidden_size x num_ready]
+        std::vector<T> batch_in, batch_out; // [batch_size][in_size/out_size x num_ready]
+        std::vector<T> frames;
+        std::vector<T> scratch;
+        std::vector<int> ready;
+    };
+
+    static int64_t now() noexcept
+    {
+        return (int64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    Group& claimGroup(int stream_idx)
+    {
+        auto& group = *groups[(size_t)(stream_idx / settings.group_size)];
+        while(group.busy.test_and_set(std::memory_order_acquire))
+            std::this_thread::yield();
+        return group;
+    }
+
+    int processGroup(Group& group, int group_idx)
+    {
+        if(group.busy.test_and_set(std::memory_order_acquire))
+            return 0;
+
+        int num_batches = 0;
+        while(runBatch(group, group_idx))
+        {
+            // another worker can take the next group in the meantime
+            if(num_batches++ == 0 && settings.num_workers > 1)
+                wake_condition.notify_one();
+        }
+
+        group.busy.clear(std::memory_order_release);
+        return num_batches;
+    }
+
+    bool runBatch(Group& group, int group_idx)
+    {
+        const auto batch_size = settings.batch_size;
+        const auto group_size = settings.group_size;
+        const auto first_stream = group_idx * group_size;
+        const auto last_stream = std::min(first_stream + group_size, (int)streams.size());
+
+        // the group runs when every active stream is ready, or when one has waited for too long
+        int num_active = 0;
+        int64_t oldest_ready_time = std::numeric_limits<int64_t>::max();
+        group.ready.clear();
+        for(int idx = first_stream; idx < last_stream; ++idx)
+        {
+            auto& stream = *streams[(size_t)idx];
+            if(!stream.active.load(std::memory_order_acquire))
+                continue;
+
+            ++num_active;
+            if(stream.input.getNumReady() >= batch_size && stream.output.getNumFree() >= batch_size)
+            {
+                group.ready.push_back(idx - first_stream);
+                oldest_ready_time = std::min(oldest_ready_time, stream.ready_time.load(std::memory_order_acquire));
+            }
+        }
+
+        if(group.ready.empty())
+            return false;
+
+        if((int)group.ready.size() < num_active && now() - oldest_ready_time < max_wait_ticks)
+            return false;
+
+        const auto N = (int)group.ready.size();
+        const auto in_size = model.getInSize();
+        const auto out_size = model.getOutSize();
+        const auto hidden_size = model.getHiddenSize();
+        for(int n = 0; n < N; ++n)
+        {
+            const auto slot = group.ready[(size_t)n];
+            streams[(size_t)(first_stream + slot)]->input.read(group.frames.data(), batch_size);
+            for(int t = 0; t < batch_size; ++t)
+                for(int i = 0; i < in_size; ++i)
+                    group.batch_in[(size_t)((t * in_size + i) * N + n)] = group.frames[(size_t)(t * in_size + i)];
+
+            for(int k = 0; k < hidden_size; ++k)
+            {
+                group.batch_h[(size_t)(k * N + n)] = group.h[(size_t)(k * group_size + slot)];
+                group.batch_c[(size_t)(k * N + n)] = group.c[(size_t)(k * group_size + slot)];
+            }
+        }
+
+        for(int t = 0; t < batch_size; ++t)
+        {
+            model.forward(group.batch_in.data() + t * in_size * N, group.batch_h.data(), group.batch_c.data(),
+                group.batch_out.data() + t * out_size * N, N, group.scratch.data());
+        }
+
+        for(int n = 0; n < N; ++n)
+        {
+            const auto slot = group.ready[(size_t)n];
+            for(int k = 0; k < hidden_size; ++k)
+            {
+                group.h[(size_t)(k * group_size + slot)] = group.batch_h[(size_t)(k * N + n)];
+                group.c[(size_t)(k * group_size + slot)] = group.batch_c[(size_t)(k * N + n)];
+            }
+
+            for(int t = 0; t < batch_size; ++t)
+                for(int i = 0; i < out_size; ++i)
+                    group.frames[(size_t)(t * out_size + i)] = group.batch_out[(size_t)((t * out_size + i) * N + n)];
+            streams[(size_t)(first_stream + slot)]->output.write(group.frames.data(), batch_size);
+        }
+
+        return true;
+    }
+
+    void workerLoop()
+    {
+        // the audio threads don't hold the mutex when they wake a worker, so a
+        // wake-up can be missed, in which case the worker waits for the time-out
+        const auto timeout = std::chrono::microseconds(std::max((int64_t)100, max_wait_ticks / 2000));
+        while(running.load(std::memory_order_acquire))
+        {
+            const auto seen = pending.load(std::memory_order_acquire);
+            if(processPending() > 0)
+                continue;
+
+            std::unique_lock<std::mutex> lock(wake_mutex);
+            wake_condition.wait_for(lock, timeout, [this, seen]
+                { return !running.load(std::memory_order_acquire) || pending.load(std::memory_order_acquire) != seen; });
+        }
+    }
+
+    const BatchedLSTMDense<T> model;
+    SharedInferenceSettings settings;
+    int64_t max_wait_ticks = 0;
+
+    std::vector<std::unique_ptr<Stream>> streams;
+    std::vector<std::unique_ptr<Group>> groups;
+    std::mutex registry_mutex;
+
+    std::vector<std::thread> workers;
+    std::atomic<bool> running { false };
+    std::atomic<uint32_t> pending { 0 };
+    std::mutex wake_mutex;
+    std::condition_variable wake_condition;
+};
+
+} // namespace RTNeural
@@ -147,5 +147,49 @@ namespace torch_helpers
             lstm.setBVals(lstm_bias_hh);
         }
     }
+
+    /**
+     * Loads a DilatedConvStackT layer from a JSON object containing a PyTorch state_dict.
+     *
+     * The state_dict should use the layer names from the PedalNetRT WaveNet model:
+     * `input_layer` (1x1 Conv1d), `hidden.<n>` (dilated Conv1d with 2 * channels outputs),
+     * `residuals.<n>` (1x1 Conv1d), and `linear_mix` (1x1 Conv1d over the concatenated
+     * gated outputs of every hidden layer).
+     */
+    template <typename T, typename DilatedConvStackType>
+    void loadDilatedConvStack(const nlohmann::json& modelJson, const std::string& layerPrefix, DilatedConvStackType& stack)
+    {
+        // 1x1 convolutions are stored as [out][in][1]
+        const auto load1x1 = [&modelJson, &layerPrefix](const std::string& name)
+        {
+            const std::vector<std::vector<std::vector<T>>> conv_weights = modelJson.at(layerPrefix + name + ".weight");
+            std::vector<std::vector<T>> weights;
+            for(const auto& w : conv_weights)
+            {
+                weights.emplace_back();
+                for(const auto& w_in : w)
+                    weights.back().push_back(w_in.at(0));
+            }
+            return weights;
+        };
+
+        const std::vector<T> input_bias = modelJson.at(layerPrefix + "input_layer.bias");
+        stack.setInputWeights(load1x1("input_layer"), input_bias);
+
+        for(int l = 0; l < stack.getNumLayers(); ++l)
+        {
+            const auto hidden = layerPrefix + "hidden." + std::to_string(l);
+            const auto residual = "residuals." + std::to_string(l);
+
+            std::vector<std::vector<std::vector<T>>> conv_weights = modelJson.at(hidden + ".weight");
+            detail::reverseKernels(conv_weights);
+            const std::vector<T> conv_bias = modelJson.at(hidden + ".bias");
+            const std::vector<T> residual_bias = modelJson.at(layerPrefix + residual + ".bias");
+            stack.setLayerWeights(l, conv_weights, conv_bias, load1x1(residual), residual_bias);
+        }
+
+        const std::vector<T> mix_bias = modelJson.at(layerPrefix + "linear_mix.bias");
+        stack.setMixWeights(load1x1("linear_mix"), mix_bias);
+    }
 }
 }
@@ -0,0 +1,214 @@
+#pragma once
+
+#include "bench_stats.hpp"
+#include <memory>
+
+namespace bench
+{
+/**
+ * Settings for the cold-cache benchmarks.
+ *
+ * In a DAW, many plugin instances run one after the other in every audio
+ * callback, so each instance usually starts its block with its weights and
+ * state evicted from the cache by the instances that ran before it.
+ */
+struct ColdConfig
+{
+    int instances = 50; // instances processed round-robin, one block each
+    std::vector<int> block_sizes { 64, 128, 512 };
+    int blocks = 200; // timed blocks per measurement
+    size_t evict_bytes = (size_t)64 << 20; // written between blocks to flush the caches
+};
+
+/**
+ * One instance of the model under test: processes `num_frames` frames
+ * (every `stride` values) and returns the first output.
+ */
+template <typename T>
+using BlockProcessor = std::function<T(const T* frames, int stride, int num_frames)>;
+
+/** Creates a new instance of the model under test, with its own allocations. */
+template <typename T>
+using InstanceFactory = std::function<BlockProcessor<T>()>;
+
+/** Result of one cold-cache benchmark (all times are per block). */
+struct ColdResult
+{
+    std::string name;
+    int block_size = 0;
+    int instances = 0;
+    double steady_ns = 0.0; // one instance, processing blocks back to back
+    double interleaved_ns = 0.0; // `instances` instances, processed round-robin
+    double evicted_ns = 0.0; // one instance, with the caches flushed before every block
+    double evicted_p99_ns = 0.0;
+    double evicted_first_frame_ns = 0.0; // the first frame of an evicted block, where the cache misses happen
+
+    double interleavedRatio() const noexcept { return steady_ns > 0.0 ? interleaved_ns / steady_ns : 0.0; }
+    double evictedRatio() const noexcept { return steady_ns > 0.0 ? evicted_ns / steady_ns : 0.0; }
+    double firstFrameRatio() const noexcept { return steady_ns > 0.0 ? evicted_first_frame_ns * block_size / steady_ns : 0.0; }
+};
+
+/** Writes to every cache line of a buffer larger than the last level cache. */
+class CacheEvictor
+{
+public:
+    explicit CacheEvictor(size_t num_bytes)
+        : buffer(num_bytes, 0)
+    {
+    }
+
+    void evict() noexcept
+    {
+        for(size_t i = 0; i < buffer.size(); i += 64)
+            buffer[i] = (char)(buffer[i] + 1);
+
+        volatile char sink = buffer[buffer.size() / 2];
+        (void)sink;
+    }
+
+private:
+    std::vector<char> buffer;
+};
+
+/**
+ * Measures the per-block cost of a model when its block starts with a
+ * cold cache, compared to the steady state of a single instance
+ * running in a hot loop.
+ */
+template <typename T>
+ColdResult runColdBenchmark(const ColdConfig& config, int block_size, int in_size, const InstanceFactory<T>& factory, CacheEvictor& evictor)
+{
+    using clock_t = std::chrono::steady_clock;
+    using ns_t = std::chrono::duration<double, std::nano>;
+
+    constexpr int num_signal_blocks = 16;
+    const auto stride = alignedStride<T>(in_size);
+    const auto signal = generateSignal<T>((size_t)(block_size * num_signal_blocks), in_size, stride);
+    const auto block = [&](int b)
+    { return signal.data() + (size_t)((b % num_signal_blocks) * block_size * stride); };
+
+    double sink = 0.0;
+    const auto timeBlock = [&](BlockProcessor<T>& process, int b)
+    {
+        const auto start = clock_t::now();
+        sink += (double)process(block(b), stride, block_size);
+        return ns_t(clock_t::now() - start).count();
+    };
+
+    ColdResult result;
+    result.block_size = block_size;
+    result.instances = config.instances;
+
+    // steady state: one instance in a hot loop
+    {
+        auto process = factory();
+        for(int b = 0; b < num_signal_blocks; ++b)
+            timeBlock(process, b);
+
+        std::vector<double> block_ns;
+        for(int b = 0; b < config.blocks; ++b)
+            block_ns.push_back(timeBlock(process, b));
+        result.steady_ns = computeStats(block_ns).median;
+    }
+
+    // many instances, each processing one block in turn
+    {
+        std::vector<BlockProcessor<T>> instances;
+        for(int i = 0; i < config.instances; ++i)
+            instances.push_back(factory());
+
+        for(auto& process : instances)
+            timeBlock(process, 0);
+
+        std::vector<double> block_ns;
+        const auto num_rounds = std::max(1, config.blocks / std::max(1, config.instances));
+        for(int round = 1; round <= num_rounds; ++round)
+            for(auto& process : instances)
+                block_ns.push_back(timeBlock(process, round));
+        result.interleaved_ns = computeStats(block_ns).median;
+    }
+
+    // one instance, with the caches flushed before every block
+    {
+        auto process = factory();
+        timeBlock(process, 0);
+
+        std::vector<double> block_ns;
+        std::vector<double> first_frame_ns;
+        const auto num_blocks = std::max(1, config.blocks / 4);
+        for(int b = 1; b <= num_blocks; ++b)
+        {
+            evictor.evict();
+            const auto start = clock_t::now();
+            sink += (double)process(block(b), stride, 1);
+            const auto first_frame_end = clock_t::now();
+            sink += (double)process(block(b) + stride, stride, block_size - 1);
+            const auto end = clock_t::now();
+
+            first_frame_ns.push_back(ns_t(first_frame_end - start).count());
+            block_ns.push_back(ns_t(end - start).count());
+        }
+        result.evicted_ns = computeStats(block_ns).median;
+        result.evicted_p99_ns = percentile(block_ns, 0.99);
+        result.evicted_first_frame_ns = computeStats(first_frame_ns).median;
+    }
+
+    volatile double sink_out = sink;
+    (void)sink_out;
+
+    return result;
+}
+
+inline void printColdHeader(std::ostream& os, int instances)
+{
+    os << std::left << std::setw(40) << "benchmark" << std::right
+       << std::setw(8) << "block"
+       << std::setw(14) << "steady ns"
+       << std::setw(16) << ("x" + std::to_string(instances) + " ns")
+       << std::setw(8) << "ratio"
+       << std::setw(14) << "evicted ns"
+       << std::setw(8) << "ratio"
+       << std::setw(14) << "evict p99"
+       << std::setw(14) << "1st frame ns"
+       << std::setw(8) << "ratio" << std::endl;
+}
+
+inline void printColdResult(std::ostream& os, const ColdResult& r)
+{
+    const auto flags = os.flags();
+    const auto precision = os.precision();
+
+    os << std::left << std::setw(40) << r.name << std::right << std::fixed << std::setprecision(0)
+       << std::setw(8) << r.block_size
+       << std::setw(14) << r.steady_ns
+       << std::setw(16) << r.interleaved_ns
+       << std::setw(8) << std::setprecision(2) << r.interleavedRatio()
+       << std::setw(14) << std::setprecision(0) << r.evicted_ns
+       << std::setw(8) << std::setprecision(2) << r.evictedRatio()
+       << std::setw(14) << std::setprecision(0) << r.evicted_p99_ns
+       << std::setw(14) << r.evicted_first_frame_ns
+       << std::setw(8) << std::setprecision(2) << r.firstFrameRatio() << std::endl;
+
+    os.flags(flags);
+    os.precision(precision);
+}
+
+inline bool writeColdCsv(const std::string& path, const std::string& backend, const std::vector<ColdResult>& results)
+{
+    std::ofstream file(path);
+    if(!file.is_open())
+        return false;
+
+    file << "name,backend,block_size,instances,steady_ns_per_block,interleaved_ns_per_block,interleaved_ratio,"
+            "evicted_ns_per_block,evicted_ratio,evicted_p99_ns_per_block,evicted_first_frame_ns,first_frame_ratio\n";
+    for(const auto& r : results)
+    {
+        file << r.name << ',' << backend << ',' << r.block_size << ',' << r.instances << ','
+             << r.steady_ns << ',' << r.interleaved_ns << ',' << r.interleavedRatio() << ','
+             << r.evicted_ns << ',' << r.evictedRatio() << ',' << r.evicted_p99_ns << ','
+             << r.evicted_first_frame_ns << ',' << r.firstFrameRatio() << '\n';
+    }
+
+    return true;
+}
+} // namespace bench
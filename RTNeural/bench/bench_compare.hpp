@@ -0,0 +1,112 @@
+#pragma once
+
+#include "bench_stats.hpp"
+#include <map>
+
+namespace bench
+{
+struct CompareConfig
+{
+    double threshold = 0.05; // relative slowdown that counts as a regression
+    double noise_sigmas = 2.0; // the slowdown must also exceed this many standard deviations
+};
+
+/**
+ * Compares the results of a run against a baseline file written with --json.
+ * Prints a line per benchmark and returns the number of regressions, or -1 if
+ * the baseline can't be read.
+ */
+inline int compareToBaseline(const std::string& baseline_file, const std::vector<Result>& results,
+    const CompareConfig& config, std::ostream& os)
+{
+    std::ifstream file(baseline_file);
+    if(!file.is_open())
+    {
+        os << "Unable to open baseline file: " << baseline_file << std::endl;
+        return -1;
+    }
+
+    nlohmann::json baseline;
+    try
+    {
+        file >> baseline;
+    }
+    catch(const nlohmann::json::exception& e)
+    {
+        os << "Unable to parse baseline file: " << e.what() << std::endl;
+        return -1;
+    }
+
+    if(!baseline.contains("benchmarks") || !baseline["benchmarks"].is_array())
+    {
+        os << "Baseline file has no benchmarks!" << std::endl;
+        return -1;
+    }
+
+    const auto baseline_backend = baseline["context"].value("backend", std::string {});
+    if(baseline_backend != backendName())
+        os << "Warning: baseline was recorded with the " << baseline_backend
+           << " backend, this run uses " << backendName() << std::endl;
+
+    std::map<std::string, nlohmann::json> baseline_results;
+    for(const auto& b : baseline["benchmarks"])
+        baseline_results[b["name"].get<std::string>()] = b;
+
+    const auto flags = os.flags();
+    const auto precision = os.precision();
+
+    os << std::endl
+       << "Comparing against " << baseline_file << " (threshold " << config.threshold * 100.0
+       << "%, noise " << config.noise_sigmas << " sigma)" << std::endl;
+    os << std::left << std::setw(40) << "benchmark" << std::right
+       << std::setw(14) << "baseline ns" << std::setw(14) << "current ns" << std::setw(10) << "change" << "  status" << std::endl;
+
+    int num_regressions = 0;
+    for(const auto& r : results)
+    {
+        const auto base_iter = baseline_results.find(r.name);
+        if(base_iter == baseline_results.end())
+        {
+            os << std::left << std::setw(40) << r.name << std::right << "  (not in baseline)" << std::endl;
+            continue;
+        }
+
+        const auto& base = base_iter->second;
+        const auto base_median = base["median_ns_per_sample"].get<double>();
+        const auto base_stddev = base["stddev_ns_per_sample"].get<double>();
+        const auto current_median = r.ns_per_sample.median;
+
+        const auto change = base_median > 0.0 ? (current_median - base_median) / base_median : 0.0;
+        const auto noise = config.noise_sigmas * (base_stddev + r.ns_per_sample.stddev);
+        const auto diff = current_median - base_median;
+
+        std::string status = "ok";
+        if(change > config.threshold && diff > noise)
+        {
+            status = "REGRESSION";
+            num_regressions++;
+        }
+        else if(change < -config.threshold && -diff > noise)
+        {
+            status = "improved";
+        }
+
+        os << std::left << std::setw(40) << r.name << std::right << std::fixed << std::setprecision(2)
+           << std::setw(14) << base_median
+           << std::setw(14) << current_median
+           << std::setw(9) << std::showpos << change * 100.0 << std::noshowpos << "%"
+           << "  " << status << std::endl;
+
+        baseline_results.erase(base_iter);
+    }
+
+    os.flags(flags);
+    os.precision(precision);
+
+    if(!baseline_results.empty())
+        os << baseline_results.size() << " baseline benchmarks were not run" << std::endl;
+
+    os << num_regressions << " regression(s) found" << std::endl;
+    return num_regressions;
+}
+} // namespace bench
@@ -0,0 +1,440 @@
+#pragma once
+
+#include <RTNeural.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define RTNEURAL_BENCH_USE_RDTSC 1
+#elif(defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#define RTNEURAL_BENCH_USE_RDTSC 1
+#else
+#define RTNEURAL_BENCH_USE_RDTSC 0
+#endif
+
+#if RTNEURAL_USE_XSIMD
+#include <xsimd/xsimd.hpp>
+template <typename T>
+using bench_vec = std::vector<T, xsimd::aligned_allocator<T>>;
+#elif RTNEURAL_USE_EIGEN
+#include <Eigen/Dense>
+template <typename T>
+using bench_vec = std::vector<T, Eigen::aligned_allocator<T>>;
+#else
+template <typename T>
+using bench_vec = std::vector<T>;
+#endif
+
+namespace bench
+{
+/** Name of the backend this benchmark binary was compiled with. */
+inline std::string backendName()
+{
+#if RTNEURAL_USE_XSIMD
+    return "xsimd";
+#elif RTNEURAL_USE_EIGEN
+    return "eigen";
+#elif RTNEURAL_USE_ACCELERATE
+    return "accelerate";
+#else
+    return "stl";
+#endif
+}
+
+/** CPU cycles on x86, steady_clock nanoseconds elsewhere. */
+inline uint64_t readTicks() noexcept
+{
+#if RTNEURAL_BENCH_USE_RDTSC
+    return (uint64_t)__rdtsc();
+#else
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+inline const char* tickUnit() noexcept
+{
+#if RTNEURAL_BENCH_USE_RDTSC
+    return "cycles";
+#else
+    return "ns";
+#endif
+}
+
+/** How the benchmark drives the model. */
+enum class Mode
+{
+    Block, // processBlock-style loop, timed per block of `block_size` samples
+    Sample, // every forward() call timed on its own
+};
+
+inline std::string modeName(Mode mode)
+{
+    return mode == Mode::Block ? "block" : "sample";
+}
+
+struct Config
+{
+    int repetitions = 5;
+    int warmup = 1;
+    double seconds = 1.0; // signal length per repetition
+    double sample_rate = 48000.0;
+    int block_size = 512;
+    std::vector<Mode> modes { Mode::Block, Mode::Sample };
+};
+
+struct Stats
+{
+    double mean = 0.0;
+    double median = 0.0;
+    double stddev = 0.0;
+    double min = 0.0;
+    double max = 0.0;
+};
+
+/** Returns the p-th percentile (0 <= p <= 1) of the values. Sorts the vector. */
+inline double percentile(std::vector<double>& values, double p)
+{
+    if(values.empty())
+        return 0.0;
+
+    std::sort(values.begin(), values.end());
+    const auto idx = std::min(values.size() - 1, (size_t)((double)values.size() * p));
+    return values[idx];
+}
+
+inline Stats computeStats(std::vector<double> values)
+{
+    Stats stats;
+    if(values.empty())
+        return stats;
+
+    std::sort(values.begin(), values.end());
+    const auto n = values.size();
+
+    double sum = 0.0;
+    for(auto v : values)
+        sum += v;
+    stats.mean = sum / (double)n;
+
+    double sq_sum = 0.0;
+    for(auto v : values)
+        sq_sum += (v - stats.mean) * (v - stats.mean);
+    stats.stddev = n > 1 ? std::sqrt(sq_sum / (double)(n - 1)) : 0.0;
+
+    stats.median = n % 2 == 1 ? values[n / 2] : 0.5 * (values[n / 2 - 1] + values[n / 2]);
+    stats.min = values.front();
+    stats.max = values.back();
+
+    return stats;
+}
+
+/** Result of one benchmark (all times are per sample). */
+struct Result
+{
+    std::string name;
+    std::string layer;
+    std::string impl;
+    std::string mode;
+    int in_size = 0;
+    int out_size = 0;
+    size_t samples = 0; // samples per repetition
+    int repetitions = 0;
+    Stats ns_per_sample;
+    double p99_ns_per_sample = 0.0; // over blocks (block mode) or calls (sample mode)
+    double ticks_per_sample = 0.0; // median over repetitions
+    double realtime_factor = 0.0; // based on the median
+};
+
+/** Generates a random signal with each frame starting at an aligned offset. */
+template <typename T>
+bench_vec<T> generateSignal(size_t n_samples, int in_size, int stride)
+{
+    bench_vec<T> signal(n_samples * (size_t)stride, (T)0);
+
+    std::default_random_engine generator;
+    std::uniform_real_distribution<double> distribution(-1.0, 1.0);
+
+    for(size_t i = 0; i < n_samples; ++i)
+        for(int k = 0; k < in_size; ++k)
+            signal[i * (size_t)stride + (size_t)k] = (T)distribution(generator);
+
+    return signal;
+}
+
+/** Number of elements between frames so that every frame stays aligned. */
+template <typename T>
+constexpr int alignedStride(int in_size)
+{
+    constexpr int align = RTNEURAL_DEFAULT_ALIGNMENT / (int)sizeof(T);
+    return ((in_size + align - 1) / align) * align;
+}
+
+/**
+ * Runs `process(const T* frame)` over a random signal, with warm-up and repetitions,
+ * and returns the timing statistics. `process` should return the first output of the
+ * model, which is accumulated so that the compiler can't drop the computation.
+ */
+template <typename T, typename ProcessFn>
+Result runBenchmark(const Config& config, Mode mode, int in_size, ProcessFn&& process)
+{
+    using clock_t = std::chrono::steady_clock;
+    using ns_t = std::chrono::duration<double, std::nano>;
+
+    const auto n_samples = std::max((size_t)1, (size_t)(config.sample_rate * config.seconds));
+    const auto stride = alignedStride<T>(in_size);
+    const auto signal = generateSignal<T>(n_samples, in_size, stride);
+
+    std::vector<double> rep_ns_per_sample;
+    std::vector<double> rep_ticks_per_sample;
+    std::vector<double> chunk_ns_per_sample; // per block or per call, over all repetitions
+
+    if(mode == Mode::Sample)
+        chunk_ns_per_sample.reserve(n_samples * (size_t)config.repetitions);
+
+    std::vector<uint64_t> call_ticks(mode == Mode::Sample ? n_samples : 0);
+    const auto block_size = (size_t)std::max(1, config.block_size);
+    double sink = 0.0;
+
+    for(int rep = 0; rep < config.warmup + config.repetitions; ++rep)
+    {
+        std::vector<double> block_ns;
+        const auto start = clock_t::now();
+        const auto start_ticks = readTicks();
+
+        if(mode == Mode::Block)
+        {
+            for(size_t b = 0; b < n_samples; b += block_size)
+            {
+                const auto block_end = std::min(n_samples, b + block_size);
+                const auto block_start = clock_t::now();
+                for(size_t i = b; i < block_end; ++i)
+                    sink += (double)process(signal.data() + i * (size_t)stride);
+                block_ns.push_back(ns_t(clock_t::now() - block_start).count() / (double)(block_end - b));
+            }
+        }
+        else
+        {
+            for(size_t i = 0; i < n_samples; ++i)
+            {
+                const auto call_start = readTicks();
+                sink += (double)process(signal.data() + i * (size_t)stride);
+                call_ticks[i] = readTicks() - call_start;
+            }
+        }
+
+        const auto rep_ticks = (double)(readTicks() - start_ticks);
+        const auto rep_ns = ns_t(clock_t::now() - start).count();
+
+        if(rep < config.warmup)
+            continue;
+
+        rep_ns_per_sample.push_back(rep_ns / (double)n_samples);
+        rep_ticks_per_sample.push_back(rep_ticks / (double)n_samples);
+
+        if(mode == Mode::Block)
+        {
+            chunk_ns_per_sample.insert(chunk_ns_per_sample.end(), block_ns.begin(), block_ns.end());
+        }
+        else
+        {
+            const auto ns_per_tick = rep_ticks > 0.0 ? rep_ns / rep_ticks : 0.0;
+            for(auto t : call_ticks)
+                chunk_ns_per_sample.push_back((double)t * ns_per_tick);
+        }
+    }
+
+    volatile double sink_out = sink;
+    (void)sink_out;
+
+    Result result;
+    result.mode = modeName(mode);
+    result.in_size = in_size;
+    result.samples = n_samples;
+    result.repetitions = config.repetitions;
+    result.ns_per_sample = computeStats(rep_ns_per_sample);
+    result.p99_ns_per_sample = percentile(chunk_ns_per_sample, 0.99);
+    result.ticks_per_sample = computeStats(rep_ticks_per_sample).median;
+    result.realtime_factor = result.ns_per_sample.median > 0.0 ? 1.0e9 / (config.sample_rate * result.ns_per_sample.median) : 0.0;
+
+    return result;
+}
+
+/**
+ * Runs `process(const T* frames, int num_frames)` over a random signal, one block of
+ * `block_size` contiguous frames at a time, with warm-up and repetitions, and returns
+ * the timing statistics. `process` should return the first output of the block.
+ */
+template <typename T, typename ProcessFn>
+Result runBlockBenchmark(const Config& config, int in_size, int block_size, ProcessFn&& process)
+{
+    using clock_t = std::chrono::steady_clock;
+    using ns_t = std::chrono::duration<double, std::nano>;
+
+    const auto n_samples = std::max((size_t)1, (size_t)(config.sample_rate * config.seconds));
+    const auto signal = generateSignal<T>(n_samples, in_size, in_size);
+
+    std::vector<double> rep_ns_per_sample;
+    std::vector<double> rep_ticks_per_sample;
+    std::vector<double> block_ns_per_sample;
+    double sink = 0.0;
+
+    for(int rep = 0; rep < config.warmup + config.repetitions; ++rep)
+    {
+        std::vector<double> block_ns;
+        const auto start = clock_t::now();
+        const auto start_ticks = readTicks();
+
+        for(size_t b = 0; b < n_samples; b += (size_t)block_size)
+        {
+            const auto num_frames = (int)std::min((size_t)block_size, n_samples - b);
+            const auto block_start = clock_t::now();
+            sink += (double)process(signal.data() + b * (size_t)in_size, num_frames);
+            block_ns.push_back(ns_t(clock_t::now() - block_start).count() / (double)num_frames);
+        }
+
+        const auto rep_ticks = (double)(readTicks() - start_ticks);
+        const auto rep_ns = ns_t(clock_t::now() - start).count();
+
+        if(rep < config.warmup)
+            continue;
+
+        rep_ns_per_sample.push_back(rep_ns / (double)n_samples);
+        rep_ticks_per_sample.push_back(rep_ticks / (double)n_samples);
+        block_ns_per_sample.insert(block_ns_per_sample.end(), block_ns.begin(), block_ns.end());
+    }
+
+    volatile double sink_out = sink;
+    (void)sink_out;
+
+    Result result;
+    result.mode = modeName(Mode::Block);
+    result.in_size = in_size;
+    result.samples = n_samples;
+    result.repetitions = config.repetitions;
+    result.ns_per_sample = computeStats(rep_ns_per_sample);
+    result.p99_ns_per_sample = percentile(block_ns_per_sample, 0.99);
+    result.ticks_per_sample = computeStats(rep_ticks_per_sample).median;
+    result.realtime_factor = result.ns_per_sample.median > 0.0 ? 1.0e9 / (config.sample_rate * result.ns_per_sample.median) : 0.0;
+
+    return result;
+}
+
+/** A registered benchmark: runs itself in the given mode. */
+struct Benchmark
+{
+    std::string layer;
+    std::string impl;
+    int in_size;
+    int out_size;
+    std::function<Result(const Config&, Mode)> run;
+    bool block_only = false; // only meaningful in block mode
+
+    std::string name() const
+    {
+        return layer + "/" + std::to_string(in_size) + "x" + std::to_string(out_size) + "/" + impl;
+    }
+};
+
+inline void printHeader(std::ostream& os)
+{
+    os << std::left << std::setw(40) << "benchmark" << std::right
+       << std::setw(12) << "median ns" << std::setw(12) << "mean ns" << std::setw(10) << "stddev"
+       << std::setw(12) << "p99 ns" << std::setw(12) << tickUnit() << std::setw(12) << "x realtime" << std::endl;
+}
+
+inline void printResult(std::ostream& os, const Result& r)
+{
+    const auto flags = os.flags();
+    const auto precision = os.precision();
+
+    os << std::left << std::setw(40) << r.name << std::right << std::fixed << std::setprecision(2)
+       << std::setw(12) << r.ns_per_sample.median
+       << std::setw(12) << r.ns_per_sample.mean
+       << std::setw(10) << r.ns_per_sample.stddev
+       << std::setw(12) << r.p99_ns_per_sample
+       << std::setw(12) << r.ticks_per_sample
+       << std::setw(12) << std::setprecision(1) << r.realtime_factor << std::endl;
+
+    os.flags(flags);
+    os.precision(precision);
+}
+
+inline nlohmann::json toJson(const Result& r)
+{
+    nlohmann::json j;
+    j["name"] = r.name;
+    j["layer"] = r.layer;
+    j["impl"] = r.impl;
+    j["mode"] = r.mode;
+    j["in_size"] = r.in_size;
+    j["out_size"] = r.out_size;
+    j["samples"] = r.samples;
+    j["repetitions"] = r.repetitions;
+    j["median_ns_per_sample"] = r.ns_per_sample.median;
+    j["mean_ns_per_sample"] = r.ns_per_sample.mean;
+    j["stddev_ns_per_sample"] = r.ns_per_sample.stddev;
+    j["min_ns_per_sample"] = r.ns_per_sample.min;
+    j["max_ns_per_sample"] = r.ns_per_sample.max;
+    j["p99_ns_per_sample"] = r.p99_ns_per_sample;
+    j["ticks_per_sample"] = r.ticks_per_sample;
+    j["realtime_factor"] = r.realtime_factor;
+    return j;
+}
+
+inline bool writeJson(const std::string& path, const Config& config, const std::vector<Result>& results)
+{
+    std::ofstream file(path);
+    if(!file.is_open())
+        return false;
+
+    nlohmann::json j;
+    j["context"] = {
+        { "backend", backendName() },
+        { "tick_unit", tickUnit() },
+        { "repetitions", config.repetitions },
+        { "warmup", config.warmup },
+        { "seconds", config.seconds },
+        { "sample_rate", config.sample_rate },
+        { "block_size", config.block_size },
+    };
+
+    j["benchmarks"] = nlohmann::json::array();
+    for(const auto& r : results)
+        j["benchmarks"].push_back(toJson(r));
+
+    file << std::setw(2) << j << std::endl;
+    return true;
+}
+
+inline bool writeCsv(const std::string& path, const std::vector<Result>& results)
+{
+    std::ofstream file(path);
+    if(!file.is_open())
+        return false;
+
+    file << "backend,name,layer,impl,mode,in_size,out_size,samples,repetitions,"
+         << "median_ns_per_sample,mean_ns_per_sample,stddev_ns_per_sample,min_ns_per_sample,max_ns_per_sample,"
+         << "p99_ns_per_sample,ticks_per_sample,realtime_factor" << std::endl;
+
+    for(const auto& r : results)
+    {
+        file << backendName() << ',' << r.name << ',' << r.layer << ',' << r.impl << ',' << r.mode << ','
+             << r.in_size << ',' << r.out_size << ',' << r.samples << ',' << r.repetitions << ','
+             << r.ns_per_sample.median << ',' << r.ns_per_sample.mean << ',' << r.ns_per_sample.stddev << ','
+             << r.ns_per_sample.min << ',' << r.ns_per_sample.max << ','
+             << r.p99_ns_per_sample << ',' << r.ticks_per_sample << ',' << r.realtime_factor << std::endl;
+    }
+
+    return true;
+}
+} // namespace bench
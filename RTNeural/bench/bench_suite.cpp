@@ -0,0 +1,420 @@
+#include "bench_compare.hpp"
+#include "bench_stats.hpp"
+#include "bench_system.hpp"
+#include "layer_creator.hpp"
+#include <RTNeural.h>
+#include <iostream>
+
+namespace
+{
+using namespace RTNeural;
+
+/** Sizes used for the layer grid (square layers, in_size == out_size). */
+using LayerSizes = std::integer_sequence<int, 4, 8, 16, 32>;
+
+template <typename Fn, int... Sizes>
+void forEachSize(Fn&& fn, std::integer_sequence<int, Sizes...>)
+{
+    (void)std::initializer_list<int> { (fn(std::integral_constant<int, Sizes> {}), 0)... };
+}
+
+bench::Benchmark dynamicLayerBenchmark(const std::string& layer_type, int in_size, int out_size)
+{
+    return { layer_type, "dynamic", in_size, out_size, [=](const bench::Config& config, bench::Mode mode)
+        {
+            auto layer = create_layer(layer_type, (size_t)in_size, (size_t)out_size);
+            std::vector<double> output((size_t)out_size);
+            return bench::runBenchmark<double>(config, mode, in_size, [&](const double* x)
+                {
+                    layer->forward(x, output.data());
+                    return output[0];
+                });
+        } };
+}
+
+#if MODELT_AVAILABLE
+template <typename T, typename ModelType, typename InitFn>
+bench::Benchmark templatedBenchmark(const std::string& layer_type, InitFn&& init)
+{
+    return { layer_type, "templated", ModelType::input_size, ModelType::output_size, [=](const bench::Config& config, bench::Mode mode)
+        {
+            ModelType model;
+            init(model);
+            return bench::runBenchmark<T>(config, mode, ModelType::input_size, [&](const T* x)
+                { return model.forward(x); });
+        } };
+}
+
+template <typename T, typename ModelType>
+bench::Benchmark templatedBenchmark(const std::string& layer_type)
+{
+    return templatedBenchmark<T, ModelType>(layer_type, [](ModelType&) {});
+}
+#endif
+
+void addLayerBenchmarks(std::vector<bench::Benchmark>& benchmarks)
+{
+    static const std::vector<std::string> layer_types {
+        "dense", "conv1d", "gru", "lstm", "tanh", "fast_tanh", "relu", "sigmoid", "softmax"
+    };
+
+    for(const auto& type : layer_types)
+    {
+        forEachSize([&](auto size)
+            { benchmarks.push_back(dynamicLayerBenchmark(type, decltype(size)::value, decltype(size)::value)); },
+            LayerSizes {});
+    }
+
+#if MODELT_AVAILABLE
+    forEachSize([&](auto size)
+        {
+            constexpr int N = decltype(size)::value;
+            constexpr int kernel_size = N - 1; // matches create_layer()
+
+            benchmarks.push_back(templatedBenchmark<double, ModelT<double, N, N, DenseT<double, N, N>>>("dense", [](auto& m)
+                { randomise_dense(m.template get<0>()); }));
+            benchmarks.push_back(templatedBenchmark<double, ModelT<double, N, N, Conv1DT<double, N, N, kernel_size, 1>>>("conv1d", [](auto& m)
+                { randomise_conv1d(m.template get<0>(), kernel_size); }));
+            benchmarks.push_back(templatedBenchmark<double, ModelT<double, N, N, GRULayerT<double, N, N>>>("gru", [](auto& m)
+                { randomise_gru(m.template get<0>()); }));
+            benchmarks.push_back(templatedBenchmark<double, ModelT<double, N, N, LSTMLayerT<double, N, N>>>("lstm", [](auto& m)
+                { randomise_lstm(m.template get<0>()); }));
+            benchmarks.push_back(templatedBenchmark<double, ModelT<double, N, N, TanhActivationT<double, N>>>("tanh"));
+            benchmarks.push_back(templatedBenchmark<double, ModelT<double, N, N, FastTanhT<double, N>>>("fast_tanh"));
+            benchmarks.push_back(templatedBenchmark<double, ModelT<double, N, N, ReLuActivationT<double, N>>>("relu"));
+            benchmarks.push_back(templatedBenchmark<double, ModelT<double, N, N, SigmoidActivationT<double, N>>>("sigmoid"));
+            benchmarks.push_back(templatedBenchmark<double, ModelT<double, N, N, SoftmaxActivationT<double, N>>>("softmax"));
+        },
+        LayerSizes {});
+#endif
+}
+
+/**
+ * Compares Conv1D::forwardBlock() at block sizes from 32 to 4096 samples
+ * against calling forward() for every frame.
+ */
+void addConv1DBlockBenchmarks(std::vector<bench::Benchmark>& benchmarks)
+{
+    struct Conv1DConfig
+    {
+        int in_size;
+        int out_size;
+        int kernel_size;
+        int dilation;
+    };
+
+    static const Conv1DConfig configs[] = {
+        { 1, 8, 5, 1 },
+        { 4, 4, 3, 64 },
+        { 8, 8, 3, 4 },
+        { 32, 32, 3, 16 },
+    };
+
+    for(const auto& c : configs)
+    {
+        const auto layer = "conv1d_k" + std::to_string(c.kernel_size) + "_d" + std::to_string(c.dilation);
+        const auto makeConv = [c]
+        {
+            auto conv = std::make_unique<Conv1D<double>>(c.in_size, c.out_size, c.kernel_size, c.dilation);
+            randomise_conv1d(*conv, (size_t)c.kernel_size);
+            conv->reset();
+            return conv;
+        };
+
+        benchmarks.push_back({ layer, "forward", c.in_size, c.out_size, [=](const bench::Config& config, bench::Mode)
+            {
+                auto conv = makeConv();
+                std::vector<double> output((size_t)c.out_size);
+                return bench::runBenchmark<double>(config, bench::Mode::Block, c.in_size, [&](const double* x)
+                    {
+                        conv->forward(x, output.data());
+                        return output[0];
+                    });
+            },
+            true });
+
+        for(int block_size = 32; block_size <= 4096; block_size *= 2)
+        {
+            benchmarks.push_back({ layer, "block" + std::to_string(block_size), c.in_size, c.out_size, [=](const bench::Config& config, bench::Mode)
+                {
+                    auto conv = makeConv();
+                    std::vector<double> output((size_t)(block_size * c.out_size));
+                    return bench::runBlockBenchmark<double>(config, c.in_size, block_size, [&](const double* x, int num_frames)
+                        {
+                            conv->forwardBlock(x, output.data(), num_frames);
+                            return output[0];
+                        });
+                },
+                true });
+        }
+    }
+}
+
+/** Compares direct Conv1D against FFTConv1D for long convolution kernels. */
+void addConv1DFFTBenchmarks(std::vector<bench::Benchmark>& benchmarks)
+{
+    struct Conv1DConfig
+    {
+        int in_size;
+        int out_size;
+        int kernel_size;
+    };
+
+    static const Conv1DConfig configs[] = {
+        { 1, 1, 128 },
+        { 1, 1, 1024 },
+        { 1, 1, 4096 },
+        { 4, 4, 512 },
+    };
+
+    for(const auto& c : configs)
+    {
+        const auto layer = "conv1d_k" + std::to_string(c.kernel_size);
+        const auto addBenchmark = [&](const std::string& impl, auto makeConv)
+        {
+            benchmarks.push_back({ layer, impl, c.in_size, c.out_size, [=](const bench::Config& config, bench::Mode)
+                {
+                    auto conv = makeConv();
+                    randomise_conv1d(*conv, (size_t)c.kernel_size);
+                    conv->reset();
+
+                    std::vector<double> output((size_t)c.out_size);
+                    return bench::runBenchmark<double>(config, bench::Mode::Block, c.in_size, [&](const double* x)
+                        {
+                            conv->forward(x, output.data());
+                            return output[0];
+                        });
+                },
+                true });
+        };
+
+        addBenchmark("direct", [c]
+            { return std::make_unique<Conv1D<double>>(c.in_size, c.out_size, c.kernel_size, 1); });
+        addBenchmark("fft", [c]
+            { return std::make_unique<FFTConv1D<double>>(c.in_size, c.out_size, c.kernel_size, 1); });
+    }
+}
+
+void addModelBenchmarks(std::vector<bench::Benchmark>& benchmarks)
+{
+    // The model used by the MagicKnob plugin: (sample, knob) -> LSTM(16) -> Dense(1)
+    benchmarks.push_back({ "magicknob", "dynamic", 2, 1, [](const bench::Config& config, bench::Mode mode)
+        {
+            Model<float> model(2);
+            auto lstm = new LSTMLayer<float>(2, 16);
+            auto dense = new Dense<float>(16, 1);
+            randomise_lstm<float>(*lstm);
+            randomise_dense<float>(*dense);
+            model.addLayer(lstm);
+            model.addLayer(dense);
+
+            return bench::runBenchmark<float>(config, mode, 2, [&](const float* x)
+                { return model.forward(x); });
+        } });
+
+#if MODELT_AVAILABLE
+    using MagicKnobModelType = ModelT<float, 2, 1, LSTMLayerT<float, 2, 16>, DenseT<float, 16, 1>>;
+    benchmarks.push_back(templatedBenchmark<float, MagicKnobModelType>("magicknob", [](auto& m)
+        {
+            randomise_lstm<float>(m.template get<0>());
+            randomise_dense<float>(m.template get<1>());
+        }));
+#endif
+
+#if MODELT_AVAILABLE
+    // A PedalNetRT-style WaveNet: 10 gated layers with 8 channels
+    using WaveNetModelType = ModelT<float, 1, 1, DilatedConvStackT<float, 1, 1, 8, 3, 1, 2, 4, 8, 16, 32, 64, 128, 256, 512>>;
+    benchmarks.push_back(templatedBenchmark<float, WaveNetModelType>("wavenet", [](auto& m)
+        { randomise_dilated_conv_stack<float>(m.template get<0>()); }));
+#endif
+
+    // The model from model_bench, loaded from json (only if run from the RTNeural directory)
+    static const std::string model_file = "models/full_model.json";
+    if(!std::ifstream(model_file).good())
+    {
+        std::cout << "Skipping full_model benchmarks (" << model_file << " not found)" << std::endl;
+        return;
+    }
+
+    benchmarks.push_back({ "full_model", "dynamic", 1, 1, [](const bench::Config& config, bench::Mode mode)
+        {
+            std::ifstream jsonStream(model_file, std::ifstream::binary);
+            auto model = json_parser::parseJson<double>(jsonStream);
+            return bench::runBenchmark<double>(config, mode, 1, [&](const double* x)
+                { return model->forward(x); });
+        } });
+
+#if MODELT_AVAILABLE
+    using FullModelType = ModelT<double, 1, 1,
+        DenseT<double, 1, 8>,
+        TanhActivationT<double, 8>,
+        Conv1DT<double, 8, 4, 3, 2>,
+        TanhActivationT<double, 4>,
+        GRULayerT<double, 4, 8>,
+        DenseT<double, 8, 1>>;
+    benchmarks.push_back(templatedBenchmark<double, FullModelType>("full_model", [](auto& m)
+        {
+            std::ifstream jsonStream(model_file, std::ifstream::binary);
+            m.parseJson(jsonStream);
+        }));
+#endif
+}
+
+void help()
+{
+    std::cout << "RTNeural benchmark suite:" << std::endl;
+    std::cout << "Usage: rtneural_bench_suite [options]" << std::endl;
+    std::cout << "    --reps <n>          Number of timed repetitions (default 5)" << std::endl;
+    std::cout << "    --warmup <n>        Number of untimed warm-up repetitions (default 1)" << std::endl;
+    std::cout << "    --seconds <s>       Signal length per repetition, at 48 kHz (default 1)" << std::endl;
+    std::cout << "    --block-size <n>    Block size for the block mode (default 512)" << std::endl;
+    std::cout << "    --mode <m>          block, sample, or all (default all)" << std::endl;
+    std::cout << "    --filter <str>      Only run benchmarks whose name contains <str>" << std::endl;
+    std::cout << "    --json <file>       Write the results as JSON" << std::endl;
+    std::cout << "    --csv <file>        Write the results as CSV" << std::endl;
+    std::cout << "    --list              List the benchmarks and exit" << std::endl;
+    std::cout << "    --cpu <n>           Pin the benchmarks to CPU core <n> (Linux only)" << std::endl;
+    std::cout << "    --compare <file>    Compare against a baseline written with --json" << std::endl;
+    std::cout << "    --threshold <pct>   Slowdown that counts as a regression (default 5)" << std::endl;
+    std::cout << "    --noise <sigmas>    Slowdowns within this many standard deviations are ignored (default 2)" << std::endl;
+    std::cout << "When comparing, the exit code is 2 if any benchmark regressed." << std::endl;
+    std::cout << "Run from the RTNeural directory to include the json model benchmarks." << std::endl;
+}
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    bench::Config config;
+    std::string filter;
+    std::string json_file;
+    std::string csv_file;
+    std::string baseline_file;
+    bench::CompareConfig compare_config;
+    int cpu = -1;
+    bool list_only = false;
+
+    for(int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        const bool has_value = i + 1 < argc;
+
+        if(arg == "--help" || arg == "-h")
+        {
+            help();
+            return 0;
+        }
+        else if(arg == "--list")
+            list_only = true;
+        else if(arg == "--reps" && has_value)
+            config.repetitions = std::max(1, std::atoi(argv[++i]));
+        else if(arg == "--warmup" && has_value)
+            config.warmup = std::max(0, std::atoi(argv[++i]));
+        else if(arg == "--seconds" && has_value)
+            config.seconds = std::atof(argv[++i]);
+        else if(arg == "--block-size" && has_value)
+            config.block_size = std::max(1, std::atoi(argv[++i]));
+        else if(arg == "--filter" && has_value)
+            filter = argv[++i];
+        else if(arg == "--json" && has_value)
+            json_file = argv[++i];
+        else if(arg == "--csv" && has_value)
+            csv_file = argv[++i];
+        else if(arg == "--cpu" && has_value)
+            cpu = std::atoi(argv[++i]);
+        else if(arg == "--compare" && has_value)
+            baseline_file = argv[++i];
+        else if(arg == "--threshold" && has_value)
+            compare_config.threshold = std::atof(argv[++i]) / 100.0;
+        else if(arg == "--noise" && has_value)
+            compare_config.noise_sigmas = std::atof(argv[++i]);
+        else if(arg == "--mode" && has_value)
+        {
+            const std::string mode = argv[++i];
+            if(mode == "block")
+                config.modes = { bench::Mode::Block };
+            else if(mode == "sample")
+                config.modes = { bench::Mode::Sample };
+            else if(mode != "all")
+            {
+                std::cout << "Unknown mode: " << mode << std::endl;
+                return 1;
+            }
+        }
+        else
+        {
+            std::cout << "Unknown argument: " << arg << std::endl;
+            help();
+            return 1;
+        }
+    }
+
+    if(cpu >= 0 && !bench::pinToCpu(cpu))
+        std::cout << "Unable to pin the benchmarks to CPU " << cpu << std::endl;
+
+    if(!list_only)
+        bench::printSystemHints(cpu, std::cout);
+
+    std::vector<bench::Benchmark> benchmarks;
+    addLayerBenchmarks(benchmarks);
+    addConv1DBlockBenchmarks(benchmarks);
+    addConv1DFFTBenchmarks(benchmarks);
+    addModelBenchmarks(benchmarks);
+
+    std::cout << "RTNeural benchmark suite (" << bench::backendName() << " backend, "
+              << config.repetitions << " repetitions, " << config.warmup << " warm-up, "
+              << config.seconds << " s per repetition)" << std::endl;
+
+    std::vector<bench::Result> results;
+    if(!list_only)
+        bench::printHeader(std::cout);
+
+    for(const auto& b : benchmarks)
+    {
+        for(auto mode : config.modes)
+        {
+            if(b.block_only && mode != bench::Mode::Block)
+                continue;
+
+            const auto name = b.name() + "/" + bench::modeName(mode);
+            if(!filter.empty() && name.find(filter) == std::string::npos)
+                continue;
+
+            if(list_only)
+            {
+                std::cout << name << std::endl;
+                continue;
+            }
+
+            auto result = b.run(config, mode);
+            result.name = name;
+            result.layer = b.layer;
+            result.impl = b.impl;
+            result.out_size = b.out_size;
+            bench::printResult(std::cout, result);
+            results.push_back(result);
+        }
+    }
+
+    if(!json_file.empty() && !bench::writeJson(json_file, config, results))
+    {
+        std::cout << "Unable to write " << json_file << std::endl;
+        return 1;
+    }
+
+    if(!csv_file.empty() && !bench::writeCsv(csv_file, results))
+    {
+        std::cout << "Unable to write " << csv_file << std::endl;
+        return 1;
+    }
+
+    if(!baseline_file.empty() && !list_only)
+    {
+        const auto num_regressions = bench::compareToBaseline(baseline_file, results, compare_config, std::cout);
+        if(num_regressions < 0)
+            return 1;
+        if(num_regressions > 0)
+            return 2;
+    }
+
+    return 0;
+}
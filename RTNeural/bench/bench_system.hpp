@@ -0,0 +1,68 @@
+#pragma once
+
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#if defined(__linux__)
+#include <sched.h>
+#endif
+
+namespace bench
+{
+/** Pins the benchmark thread to one CPU core. Only supported on Linux. */
+inline bool pinToCpu(int cpu)
+{
+#if defined(__linux__)
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    CPU_SET(cpu, &cpu_set);
+    return sched_setaffinity(0, sizeof(cpu_set), &cpu_set) == 0;
+#else
+    (void)cpu;
+    return false;
+#endif
+}
+
+inline std::string readFirstLine(const std::string& path)
+{
+    std::ifstream file(path);
+    std::string line;
+    if(file.is_open())
+        std::getline(file, line);
+    return line;
+}
+
+/**
+ * Prints warnings for system settings that make the results noisy:
+ * a frequency governor other than "performance", and turbo boost.
+ * `cpu` is the core the benchmark runs on (or -1 for core 0).
+ */
+inline void printSystemHints(int cpu, std::ostream& os)
+{
+#if defined(__linux__)
+    const auto cpu_dir = "/sys/devices/system/cpu/cpu" + std::to_string(cpu < 0 ? 0 : cpu) + "/cpufreq/";
+
+    const auto governor = readFirstLine(cpu_dir + "scaling_governor");
+    if(!governor.empty() && governor != "performance")
+        os << "Warning: CPU frequency governor is \"" << governor << "\", results may be noisy."
+           << " Try: sudo cpupower frequency-set -g performance" << std::endl;
+
+    const auto no_turbo = readFirstLine("/sys/devices/system/cpu/intel_pstate/no_turbo");
+    if(no_turbo == "0")
+        os << "Warning: turbo boost is enabled, results may be noisy."
+           << " Try: echo 1 | sudo tee /sys/devices/system/cpu/intel_pstate/no_turbo" << std::endl;
+
+    const auto boost = readFirstLine("/sys/devices/system/cpu/cpufreq/boost");
+    if(boost == "1")
+        os << "Warning: CPU boost is enabled, results may be noisy."
+           << " Try: echo 0 | sudo tee /sys/devices/system/cpu/cpufreq/boost" << std::endl;
+
+    if(cpu < 0)
+        os << "Hint: use --cpu <n> to pin the benchmarks to a single (isolated) core." << std::endl;
+#else
+    (void)cpu;
+    (void)os;
+#endif
+}
+} // namespace bench
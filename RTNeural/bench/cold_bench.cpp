@@ -0,0 +1,276 @@
+#include "bench_cold.hpp"
+#include "bench_system.hpp"
+#include "layer_creator.hpp"
+#include <RTNeural.h>
+#include <iostream>
+
+namespace
+{
+using namespace RTNeural;
+
+struct ColdBenchmark
+{
+    std::string name;
+    int in_size;
+    std::function<bench::ColdResult(const bench::ColdConfig&, int, bench::CacheEvictor&)> run;
+};
+
+/** Wraps a model with a `forward(const T*)` method as a block processor. */
+template <typename T, typename ModelType>
+bench::BlockProcessor<T> makeProcessor(std::shared_ptr<ModelType> model)
+{
+    return [model](const T* frames, int stride, int num_frames)
+    {
+        T out {};
+        for(int i = 0; i < num_frames; ++i)
+            out = model->forward(frames + i * stride);
+        return out;
+    };
+}
+
+template <typename T>
+ColdBenchmark makeBenchmark(const std::string& name, int in_size, bench::InstanceFactory<T> factory)
+{
+    return { name, in_size, [=](const bench::ColdConfig& config, int block_size, bench::CacheEvictor& evictor)
+        {
+            auto result = bench::runColdBenchmark<T>(config, block_size, in_size, factory, evictor);
+            result.name = name;
+            return result;
+        } };
+}
+
+/** A dynamic layer, run as a single-layer Model (so it uses the model's arena). */
+ColdBenchmark dynamicLayerBenchmark(const std::string& layer_type, int size)
+{
+    const auto name = layer_type + "/" + std::to_string(size) + "x" + std::to_string(size) + "/dynamic";
+    return makeBenchmark<double>(name, size, [=]
+        {
+            auto model = std::make_shared<Model<double>>(size);
+            model->addLayer(create_layer(layer_type, (size_t)size, (size_t)size).release());
+            model->reset();
+            return makeProcessor<double>(model);
+        });
+}
+
+#if MODELT_AVAILABLE
+template <typename T, typename ModelType, typename InitFn>
+ColdBenchmark templatedBenchmark(const std::string& name, InitFn&& init)
+{
+    return makeBenchmark<T>(name, ModelType::input_size, [=]
+        {
+            auto model = std::make_shared<ModelType>();
+            init(*model);
+            model->reset();
+            return makeProcessor<T>(model);
+        });
+}
+
+template <typename T, typename ModelType, typename InitFn>
+ColdBenchmark templatedLayerBenchmark(const std::string& layer_type, InitFn&& init)
+{
+    const auto name = layer_type + "/" + std::to_string(ModelType::input_size) + "x" + std::to_string(ModelType::output_size) + "/templated";
+    return templatedBenchmark<T, ModelType>(name, std::forward<InitFn>(init));
+}
+#endif
+
+/** Sizes used for the layer grid (square layers, in_size == out_size). */
+using LayerSizes = std::integer_sequence<int, 8, 16, 32>;
+
+template <typename Fn, int... Sizes>
+void forEachSize(Fn&& fn, std::integer_sequence<int, Sizes...>)
+{
+    (void)std::initializer_list<int> { (fn(std::integral_constant<int, Sizes> {}), 0)... };
+}
+
+void addLayerBenchmarks(std::vector<ColdBenchmark>& benchmarks)
+{
+    for(const auto& type : { "dense", "conv1d", "gru", "lstm" })
+    {
+        forEachSize([&](auto size)
+            { benchmarks.push_back(dynamicLayerBenchmark(type, decltype(size)::value)); },
+            LayerSizes {});
+    }
+
+#if MODELT_AVAILABLE
+    forEachSize([&](auto size)
+        {
+            constexpr int N = decltype(size)::value;
+            constexpr int kernel_size = N - 1; // matches create_layer()
+
+            benchmarks.push_back(templatedLayerBenchmark<double, ModelT<double, N, N, DenseT<double, N, N>>>("dense", [](auto& m)
+                { randomise_dense(m.template get<0>()); }));
+            benchmarks.push_back(templatedLayerBenchmark<double, ModelT<double, N, N, Conv1DT<double, N, N, kernel_size, 1>>>("conv1d", [](auto& m)
+                { randomise_conv1d(m.template get<0>(), kernel_size); }));
+            benchmarks.push_back(templatedLayerBenchmark<double, ModelT<double, N, N, GRULayerT<double, N, N>>>("gru", [](auto& m)
+                { randomise_gru(m.template get<0>()); }));
+            benchmarks.push_back(templatedLayerBenchmark<double, ModelT<double, N, N, LSTMLayerT<double, N, N>>>("lstm", [](auto& m)
+                { randomise_lstm(m.template get<0>()); }));
+        },
+        LayerSizes {});
+#endif
+}
+
+void addModelBenchmarks(std::vector<ColdBenchmark>& benchmarks)
+{
+    // The model used by the MagicKnob plugin: (sample, knob) -> LSTM(16) -> Dense(1)
+    benchmarks.push_back(makeBenchmark<float>("magicknob/2x1/dynamic", 2, []
+        {
+            auto model = std::make_shared<Model<float>>(2);
+            auto lstm = new LSTMLayer<float>(2, 16);
+            auto dense = new Dense<float>(16, 1);
+            randomise_lstm<float>(*lstm);
+            randomise_dense<float>(*dense);
+            model->addLayer(lstm);
+            model->addLayer(dense);
+            model->reset();
+            return makeProcessor<float>(model);
+        }));
+
+#if MODELT_AVAILABLE
+    using MagicKnobModelType = ModelT<float, 2, 1, LSTMLayerT<float, 2, 16>, DenseT<float, 16, 1>>;
+    benchmarks.push_back(templatedBenchmark<float, MagicKnobModelType>("magicknob/2x1/templated", [](auto& m)
+        {
+            randomise_lstm<float>(m.template get<0>());
+            randomise_dense<float>(m.template get<1>());
+        }));
+#endif
+
+    // The model from model_bench, loaded from json (only if run from the RTNeural directory)
+    static const std::string model_file = "models/full_model.json";
+    if(!std::ifstream(model_file).good())
+    {
+        std::cout << "Skipping full_model benchmarks (" << model_file << " not found)" << std::endl;
+        return;
+    }
+
+    benchmarks.push_back(makeBenchmark<double>("full_model/1x1/dynamic", 1, []
+        {
+            std::ifstream jsonStream(model_file, std::ifstream::binary);
+            std::shared_ptr<Model<double>> model = json_parser::parseJson<double>(jsonStream);
+            model->reset();
+            return makeProcessor<double>(model);
+        }));
+
+#if MODELT_AVAILABLE
+    using FullModelType = ModelT<double, 1, 1,
+        DenseT<double, 1, 8>,
+        TanhActivationT<double, 8>,
+        Conv1DT<double, 8, 4, 3, 2>,
+        TanhActivationT<double, 4>,
+        GRULayerT<double, 4, 8>,
+        DenseT<double, 8, 1>>;
+    benchmarks.push_back(templatedBenchmark<double, FullModelType>("full_model/1x1/templated", [](auto& m)
+        {
+            std::ifstream jsonStream(model_file, std::ifstream::binary);
+            m.parseJson(jsonStream);
+        }));
+#endif
+}
+
+void help()
+{
+    std::cout << "RTNeural cold-cache benchmarks:" << std::endl;
+    std::cout << "Usage: rtneural_cold_bench [options]" << std::endl;
+    std::cout << "Compares the per-block cost of a single instance in a hot loop (steady)" << std::endl;
+    std::cout << "against many instances processed round-robin, and against a single" << std::endl;
+    std::cout << "instance with the caches flushed before every block (evicted)." << std::endl;
+    std::cout << "    --instances <n>     Number of interleaved instances (default 50)" << std::endl;
+    std::cout << "    --block-size <n>    Only run this block size (default 64, 128 and 512)" << std::endl;
+    std::cout << "    --blocks <n>        Number of timed blocks per measurement (default 200)" << std::endl;
+    std::cout << "    --evict-mb <n>      Size of the buffer used to flush the caches (default 64)" << std::endl;
+    std::cout << "    --filter <str>      Only run benchmarks whose name contains <str>" << std::endl;
+    std::cout << "    --csv <file>        Write the results as CSV" << std::endl;
+    std::cout << "    --list              List the benchmarks and exit" << std::endl;
+    std::cout << "    --cpu <n>           Pin the benchmarks to CPU core <n> (Linux only)" << std::endl;
+    std::cout << "Run from the RTNeural directory to include the json model benchmarks." << std::endl;
+}
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    bench::ColdConfig config;
+    std::string filter;
+    std::string csv_file;
+    int cpu = -1;
+    bool list_only = false;
+
+    for(int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        const bool has_value = i + 1 < argc;
+
+        if(arg == "--help" || arg == "-h")
+        {
+            help();
+            return 0;
+        }
+        else if(arg == "--list")
+            list_only = true;
+        else if(arg == "--instances" && has_value)
+            config.instances = std::max(1, std::atoi(argv[++i]));
+        else if(arg == "--block-size" && has_value)
+            config.block_sizes = { std::max(1, std::atoi(argv[++i])) };
+        else if(arg == "--blocks" && has_value)
+            config.blocks = std::max(1, std::atoi(argv[++i]));
+        else if(arg == "--evict-mb" && has_value)
+            config.evict_bytes = (size_t)std::max(1, std::atoi(argv[++i])) << 20;
+        else if(arg == "--filter" && has_value)
+            filter = argv[++i];
+        else if(arg == "--csv" && has_value)
+            csv_file = argv[++i];
+        else if(arg == "--cpu" && has_value)
+            cpu = std::atoi(argv[++i]);
+        else
+        {
+            std::cout << "Unknown argument: " << arg << std::endl;
+            help();
+            return 1;
+        }
+    }
+
+    if(cpu >= 0 && !bench::pinToCpu(cpu))
+        std::cout << "Unable to pin the benchmarks to CPU " << cpu << std::endl;
+
+    if(!list_only)
+        bench::printSystemHints(cpu, std::cout);
+
+    std::vector<ColdBenchmark> benchmarks;
+    addLayerBenchmarks(benchmarks);
+    addModelBenchmarks(benchmarks);
+
+    if(list_only)
+    {
+        for(const auto& b : benchmarks)
+            std::cout << b.name << std::endl;
+        return 0;
+    }
+
+    std::cout << "RTNeural cold-cache benchmarks (" << bench::backendName() << " backend, "
+              << config.instances << " instances, " << config.blocks << " blocks, "
+              << (config.evict_bytes >> 20) << " MB eviction buffer)" << std::endl;
+
+    bench::CacheEvictor evictor(config.evict_bytes);
+    std::vector<bench::ColdResult> results;
+    bench::printColdHeader(std::cout, config.instances);
+
+    for(const auto& b : benchmarks)
+    {
+        if(!filter.empty() && b.name.find(filter) == std::string::npos)
+            continue;
+
+        for(auto block_size : config.block_sizes)
+        {
+            auto result = b.run(config, block_size, evictor);
+            bench::printColdResult(std::cout, result);
+            results.push_back(result);
+        }
+    }
+
+    if(!csv_file.empty() && !bench::writeColdCsv(csv_file, bench::backendName(), results))
+    {
+        std::cout << "Unable to write " << csv_file << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -44,6 +44,7 @@ int main(int argc, char* argv[])
     if(layer == nullptr)
         return 1;
 
+
     // generate audio
     constexpr double sample_rate = 48000.0;
     const auto n_samples = static_cast<size_t>(sample_rate * length_seconds);
@@ -66,11 +67,32 @@ int main(int argc, char* argv[])
         std::cout << length_seconds / nonTemplatedDur << "x real-time" << std::endl;
     }
 
+    if(layer->getArenaSize() > 0)
+    {
+        // the same layer, with its weights and state moved into a model's arena
+        RTNeural::Model<double> model((int)in_size);
+        model.addLayer(create_layer(layer_type, in_size, out_size).release());
+        std::cout << "Testing layer in a model arena ("
+                  << model.layers[0]->getArenaSize() * sizeof(double) << " bytes)..." << std::endl;
+
+        auto start = clock_t::now();
+        for(size_t i = 0; i < n_samples; ++i)
+            model.forward(signal[i].data());
+        const auto arenaDur = std::chrono::duration_cast<second_t>(clock_t::now() - start).count();
+
+        std::cout << "Processed " << length_seconds << " seconds of signal in "
+                  << arenaDur << " seconds" << std::endl;
+        std::cout << length_seconds / arenaDur << "x real-time" << std::endl;
+    }
+
 #if MODELT_AVAILABLE
     std::cout << "Testing templated implementation..." << std::endl;
     double templatedDur = 0.0;
     {
         templatedDur = runTemplatedBench(signal, n_samples, layer_type, in_size, out_size);
+        if(templatedDur < 0.0)
+            return 0;
+
         std::cout << "Processed " << length_seconds << " seconds of signal in "
                   << templatedDur << " seconds" << std::endl;
         std::cout << length_seconds / templatedDur << "x real-time" << std::endl;
@@ -3,13 +3,13 @@
 #include <RTNeural.h>
 #include <random>
 
-template <typename DenseType>
+template <typename T = double, typename DenseType>
 void randomise_dense(DenseType &dense) {
   std::default_random_engine generator;
   std::uniform_real_distribution<double> distribution(-1.0, 1.0);
 
   // random weights
-  std::vector<std::vector<double>> denseWeights(dense.out_size);
+  std::vector<std::vector<T>> denseWeights(dense.out_size);
   for (auto &w : denseWeights)
     w.resize(dense.in_size, 0.0);
 
@@ -20,20 +20,20 @@ void randomise_dense(DenseType &dense) {
   dense.setWeights(denseWeights);
 
   // random biases
-  std::vector<double> denseBias(dense.out_size);
+  std::vector<T> denseBias(dense.out_size);
   for (size_t i = 0; i < dense.out_size; ++i)
     denseBias[i] = distribution(generator);
 
   dense.setBias(denseBias.data());
 }
 
-template <typename ConvType>
+template <typename T = double, typename ConvType>
 void randomise_conv1d(ConvType &conv, size_t kernel_size) {
   std::default_random_engine generator;
   std::uniform_real_distribution<double> distribution(-1.0, 1.0);
 
   // random weights
-  std::vector<std::vector<std::vector<double>>> convWeights(conv.out_size);
+  std::vector<std::vector<std::vector<T>>> convWeights(conv.out_size);
   for(auto& wIn : convWeights)
   {
       wIn.resize(conv.in_size);
@@ -49,20 +49,20 @@ void randomise_conv1d(ConvType &conv, size_t kernel_size) {
   conv.setWeights(convWeights);
 
   // random biases
-  std::vector<double> convBias(conv.out_size);
+  std::vector<T> convBias(conv.out_size);
   for (size_t i = 0; i < conv.out_size; ++i)
     convBias[i] = distribution(generator);
 
   conv.setBias(convBias);
 }
 
-template <typename GruType>
+template <typename T = double, typename GruType>
 void randomise_gru(GruType &gru) {
   std::default_random_engine generator;
   std::uniform_real_distribution<double> distribution(-1.0, 1.0);
 
   // kernel weights
-  std::vector<std::vector<double>> kernelWeights(gru.in_size);
+  std::vector<std::vector<T>> kernelWeights(gru.in_size);
   for (auto &w : kernelWeights)
     w.resize(3 * gru.out_size, 0.0);
 
@@ -73,7 +73,7 @@ void randomise_gru(GruType &gru) {
   gru.setWVals(kernelWeights);
 
   // recurrent weights
-  std::vector<std::vector<double>> recurrentWeights(gru.out_size);
+  std::vector<std::vector<T>> recurrentWeights(gru.out_size);
   for (auto &w : recurrentWeights)
     w.resize(3 * gru.out_size, 0.0);
 
@@ -84,7 +84,7 @@ void randomise_gru(GruType &gru) {
   gru.setUVals(recurrentWeights);
 
   // biases
-  std::vector<std::vector<double>> gru_bias(2);
+  std::vector<std::vector<T>> gru_bias(2);
   for (auto &w : gru_bias)
     w.resize(3 * gru.out_size, 0.0);
 
@@ -95,13 +95,13 @@ void randomise_gru(GruType &gru) {
   gru.setBVals(gru_bias);
 }
 
-template <typename LstmType>
+template <typename T = double, typename LstmType>
 void randomise_lstm(LstmType &lstm) {
   std::default_random_engine generator;
   std::uniform_real_distribution<double> distribution(-1.0, 1.0);
 
   // kernel weights
-  std::vector<std::vector<double>> kernelWeights(lstm.in_size);
+  std::vector<std::vector<T>> kernelWeights(lstm.in_size);
   for (auto &w : kernelWeights)
     w.resize(4 * lstm.out_size, 0.0);
 
@@ -112,7 +112,7 @@ void randomise_lstm(LstmType &lstm) {
   lstm.setWVals(kernelWeights);
 
   // recurrent weights
-  std::vector<std::vector<double>> recurrentWeights(lstm.out_size);
+  std::vector<std::vector<T>> recurrentWeights(lstm.out_size);
   for (auto &w : recurrentWeights)
     w.resize(4 * lstm.out_size, 0.0);
 
@@ -123,13 +123,52 @@ void randomise_lstm(LstmType &lstm) {
   lstm.setUVals(recurrentWeights);
 
   // biases
-  std::vector<double> lstm_bias(4 * lstm.out_size);
+  std::vector<T> lstm_bias(4 * lstm.out_size);
   for (size_t i = 0; i < 4 * lstm.out_size; ++i)
     lstm_bias[i] = distribution(generator);
 
   lstm.setBVals(lstm_bias);
 }
 
+template <typename T = double, typename StackType>
+void randomise_dilated_conv_stack(StackType &stack) {
+  std::default_random_engine generator;
+  std::uniform_real_distribution<double> distribution(-0.5, 0.5);
+
+  const auto random_vector = [&](int size) {
+    std::vector<T> vec((size_t)size);
+    for (auto &x : vec)
+      x = (T)distribution(generator);
+    return vec;
+  };
+
+  const auto random_matrix = [&](int rows, int cols) {
+    std::vector<std::vector<T>> mat((size_t)rows);
+    for (auto &row : mat)
+      row = random_vector(cols);
+    return mat;
+  };
+
+  constexpr int channels = StackType::getNumChannels();
+  constexpr int kernel_size = StackType::getKernelSize();
+  stack.setInputWeights(random_matrix(channels, StackType::in_size),
+                        random_vector(channels));
+
+  for (int l = 0; l < StackType::getNumLayers(); ++l) {
+    std::vector<std::vector<std::vector<T>>> convWeights(2 * channels);
+    for (auto &w : convWeights)
+      w = random_matrix(channels, kernel_size);
+
+    stack.setLayerWeights(l, convWeights, random_vector(2 * channels),
+                          random_matrix(channels, channels),
+                          random_vector(channels));
+  }
+
+  stack.setMixWeights(
+      random_matrix(StackType::out_size, StackType::getNumLayers() * channels),
+      random_vector(StackType::out_size));
+}
+
 std::unique_ptr<RTNeural::Layer<double>>
 create_layer(const std::string &layer_type, size_t in_size, size_t out_size) {
   if (layer_type == "dense") {
@@ -0,0 +1,240 @@
+#include "bench_stats.hpp"
+#include <RTNeural.h>
+#include <fstream>
+#include <iostream>
+#include <random>
+
+namespace
+{
+using namespace RTNeural;
+using clock_t = std::chrono::steady_clock;
+using second_t = std::chrono::duration<double>;
+
+constexpr double pi = 3.14159265358979323846;
+constexpr double sample_rate = 48000.0;
+
+/**
+ * Loads a model from either an RTNeural json file (with a "layers" array),
+ * or a PyTorch state_dict with an "lstm." layer followed by a "dense." layer.
+ */
+std::unique_ptr<Model<float>> loadModel(const std::string& model_file)
+{
+    std::ifstream jsonStream(model_file, std::ifstream::binary);
+    if(!jsonStream.good())
+        return {};
+
+    nlohmann::json modelJson;
+    jsonStream >> modelJson;
+    if(modelJson.contains("layers"))
+        return json_parser::parseJson<float>(modelJson);
+
+    if(!modelJson.contains("lstm.weight_hh_l0") || !modelJson.contains("dense.weight"))
+        return {};
+
+    const auto in_size = (int)modelJson.at("lstm.weight_ih_l0").at(0).size();
+    const auto hidden_size = (int)modelJson.at("lstm.weight_hh_l0").at(0).size();
+    const auto out_size = (int)modelJson.at("dense.weight").size();
+
+    auto model = std::make_unique<Model<float>>(in_size);
+    auto lstm = std::make_unique<LSTMLayer<float>>(in_size, hidden_size);
+    auto dense = std::make_unique<Dense<float>>(hidden_size, out_size);
+    torch_helpers::loadLSTM<float>(modelJson, "lstm.", *lstm);
+    torch_helpers::loadDense<float>(modelJson, "dense.", *dense);
+    model->addLayer(lstm.release());
+    model->addLayer(dense.release());
+    return model;
+}
+
+/** A sine sweep (20 Hz to 20 kHz) on the first input, with every other input (e.g. a knob) at 0.5. */
+std::vector<float> makeInput(int in_size, double seconds)
+{
+    const auto num_frames = (size_t)(sample_rate * seconds);
+    std::vector<float> input(num_frames * (size_t)in_size, 0.5f);
+    const auto rate = std::log(1000.0) / seconds;
+    for(size_t n = 0; n < num_frames; ++n)
+    {
+        const auto t = (double)n / sample_rate;
+        input[n * (size_t)in_size] = (float)(0.5 * std::sin(2.0 * pi * 20.0 * (std::exp(rate * t) - 1.0) / rate));
+    }
+    return input;
+}
+
+/** Runs the model over the input, and returns the number of seconds it took. */
+double render(Model<float>& model, const std::vector<float>& input, std::vector<float>& output)
+{
+    const auto in_size = model.getInSize();
+    output.resize(input.size() / (size_t)in_size);
+
+    model.reset();
+    const auto start = clock_t::now();
+    for(size_t n = 0; n < output.size(); ++n)
+        output[n] = model.forward(input.data() + n * (size_t)in_size);
+    return second_t(clock_t::now() - start).count();
+}
+
+/** Error of a render relative to the reference render, in dB. */
+double errorDb(const std::vector<float>& test, const std::vector<float>& reference)
+{
+    double error_squares = 0.0;
+    double reference_squares = 0.0;
+    for(size_t n = 0; n < reference.size(); ++n)
+    {
+        error_squares += ((double)test[n] - (double)reference[n]) * ((double)test[n] - (double)reference[n]);
+        reference_squares += (double)reference[n] * (double)reference[n];
+    }
+    return 10.0 * std::log10(error_squares / (reference_squares + 1.0e-30) + 1.0e-30);
+}
+
+/** Sets the tolerance of every recurrent layer, and returns their ranks (the size of the layer for full rank). */
+std::string useLowRankWeights(Model<float>& model, float tolerance)
+{
+    std::string ranks;
+    for(auto* layer : model.layers)
+    {
+        int rank = -1;
+        if(auto* lstm = dynamic_cast<LSTMLayer<float>*>(layer))
+            rank = lstm->useLowRankWeights(tolerance) ? lstm->getLowRank() : lstm->out_size;
+        else if(auto* gru = dynamic_cast<GRULayer<float>*>(layer))
+            rank = gru->useLowRankWeights(tolerance) ? gru->getLowRank() : gru->out_size;
+
+        if(rank >= 0)
+            ranks += (ranks.empty() ? "" : ", ") + std::to_string(rank);
+    }
+    return ranks;
+}
+
+#if MODELT_AVAILABLE
+/** Times a static LSTM layer with a given rank (0 is full rank) on random weights. */
+template <int hidden_size, int rank>
+double timeStaticLSTM(int num_frames)
+{
+    std::default_random_engine generator(0x1234);
+    std::uniform_real_distribution<float> distribution(-0.2f, 0.2f);
+    const auto randomWeights = [&](int num_in, int num_out)
+    {
+        std::vector<std::vector<float>> weights((size_t)num_in, std::vector<float>((size_t)num_out));
+        for(auto& row : weights)
+            for(auto& w : row)
+                w = distribution(generator);
+        return weights;
+    };
+
+    auto lstm = std::make_unique<LSTMLayerT<float, 1, hidden_size, SampleRateCorrectionMode::None, rank>>();
+    lstm->setWVals(randomWeights(1, 4 * hidden_size));
+    lstm->setUVals(randomWeights(hidden_size, 4 * hidden_size));
+    lstm->setBVals(randomWeights(1, 4 * hidden_size)[0]);
+    lstm->reset();
+
+#if RTNEURAL_USE_XSIMD
+    xsimd::simd_type<float> frame[1];
+#elif RTNEURAL_USE_EIGEN
+    Eigen::Matrix<float, 1, 1> frame;
+#else
+    alignas(RTNEURAL_DEFAULT_ALIGNMENT) float frame[1];
+#endif
+
+    const auto start = clock_t::now();
+    for(int n = 0; n < num_frames; ++n)
+    {
+        frame[0] = (float)std::sin(0.01 * (double)n);
+        lstm->forward(frame);
+    }
+    const auto seconds = second_t(clock_t::now() - start).count();
+
+    // keeps the compiler from dropping the loop
+    std::vector<float> state((size_t)lstm->getStateSize());
+    lstm->getState(state.data());
+    if(std::isnan(state[0]))
+        std::cout << state[0];
+    return seconds;
+}
+
+template <int hidden_size, int... ranks>
+void printStaticLSTM(int num_frames)
+{
+    const auto full_rank_seconds = timeStaticLSTM<hidden_size, 0>(num_frames);
+    std::cout << "  LSTMLayerT<" << hidden_size << ">: full rank " << full_rank_seconds * 1.0e9 / (double)num_frames << " ns/frame";
+    for(auto rank_seconds : { std::make_pair(ranks, timeStaticLSTM<hidden_size, ranks>(num_frames))... })
+        std::cout << ", rank " << rank_seconds.first << " " << full_rank_seconds / rank_seconds.second << "x";
+    std::cout << std::endl;
+}
+#endif
+
+void help()
+{
+    std::cout << "RTNeural low-rank recurrent weights benchmark:" << std::endl;
+    std::cout << "Usage: rtneural_low_rank_bench [options]" << std::endl;
+    std::cout << "Runs a model with low-rank recurrent weights at a range of tolerances (the error" << std::endl;
+    std::cout << "of the factorization relative to the norm of the weights), and reports the rank," << std::endl;
+    std::cout << "the speed-up, and the error of a sine sweep relative to the full-rank model." << std::endl;
+    std::cout << "It then times static LSTM layers with 32, 64 and 96 units at a few ranks." << std::endl;
+    std::cout << "    --seconds <n>       Length of the sweep (default 10)" << std::endl;
+    std::cout << "    --model <file>      RTNeural model file, or PyTorch LSTM model with \"lstm.\" and \"dense.\" layers" << std::endl;
+    std::cout << "                        (default ../final_models/model_dist.json, run from the RTNeural directory)" << std::endl;
+}
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    double length_seconds = 10.0;
+    std::string model_file = "../final_models/model_dist.json";
+
+    for(int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        const bool has_value = i + 1 < argc;
+
+        if(arg == "--help" || arg == "-h")
+        {
+            help();
+            return 0;
+        }
+        else if(arg == "--seconds" && has_value)
+            length_seconds = std::max(1.0, std::atof(argv[++i]));
+        else if(arg == "--model" && has_value)
+            model_file = argv[++i];
+        else
+        {
+            std::cout << "Unknown argument: " << arg << std::endl;
+            help();
+            return 1;
+        }
+    }
+
+#if !RTNEURAL_USE_ACCELERATE
+    std::cout << "RTNeural low-rank benchmark (" << bench::backendName() << " backend, "
+              << length_seconds << " seconds of signal)" << std::endl;
+
+    auto model = loadModel(model_file);
+    if(model == nullptr)
+    {
+        std::cout << "Unable to load model file: " << model_file << std::endl;
+        return 1;
+    }
+
+    const auto input = makeInput(model->getInSize(), length_seconds);
+    std::vector<float> reference;
+    const auto full_rank_seconds = render(*model, input, reference);
+    std::cout << "  full rank: " << full_rank_seconds << " seconds" << std::endl;
+
+    std::vector<float> output;
+    for(auto tolerance : { 0.005f, 0.01f, 0.02f, 0.05f, 0.1f, 0.2f, 0.3f, 0.5f })
+    {
+        const auto ranks = useLowRankWeights(*model, tolerance);
+        const auto seconds = render(*model, input, output);
+        std::cout << "  tolerance " << tolerance << ": rank " << ranks << ", " << seconds << " seconds ("
+                  << full_rank_seconds / seconds << "x), output error: " << errorDb(output, reference) << " dB" << std::endl;
+    }
+
+#if MODELT_AVAILABLE
+    const auto num_frames = (int)(sample_rate * length_seconds);
+    printStaticLSTM<32, 4, 8, 16>(num_frames);
+    printStaticLSTM<64, 8, 16, 32>(num_frames);
+    printStaticLSTM<96, 12, 24, 48>(num_frames);
+#endif
+#else
+    std::cout << "Low-rank weights are not supported by the Accelerate backend" << std::endl;
+#endif
+
+    return 0;
+}
@@ -39,6 +39,9 @@ int main(int argc, char* argv[])
         std::ifstream jsonStream(model_file, std::ifstream::binary);
         auto model = RTNeural::json_parser::parseJson<double>(jsonStream);
         nonTemplatedDur = runBench(*model.get(), bench_time);
+#if RTNEURAL_ENABLE_LAYER_TIMING
+        model->printLayerTimings(std::cout);
+#endif
     }
 
 #if MODELT_AVAILABLE
@@ -58,6 +61,9 @@ int main(int argc, char* argv[])
         std::ifstream jsonStream(model_file, std::ifstream::binary);
         modelT.parseJson(jsonStream);
         templatedDur = runBench(modelT, bench_time);
+#if RTNEURAL_ENABLE_LAYER_TIMING
+        modelT.printLayerTimings(std::cout);
+#endif
     }
 
     std::cout << "Templated model is " << nonTemplatedDur / templatedDur << "x faster!" << std::endl;
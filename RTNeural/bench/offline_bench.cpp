@@ -0,0 +1,161 @@
+#include "bench_stats.hpp"
+#include "layer_creator.hpp"
+#include <RTNeural.h>
+#include <iostream>
+
+namespace
+{
+using namespace RTNeural;
+using clock_t = std::chrono::steady_clock;
+using second_t = std::chrono::duration<double>;
+
+/** Renders the signal on a single thread, and then with renderChunked(). */
+template <typename T, typename ModelFactory>
+void runOfflineBench(const std::string& name, ModelFactory&& makeModel, const bench_vec<T>& signal, ChunkedRenderSettings settings, double length_seconds)
+{
+    std::vector<T> output(signal.size());
+    const auto num_threads = settings.num_threads;
+
+    settings.num_threads = 1;
+    settings.verify = false;
+    auto start = clock_t::now();
+    renderChunked<T>(makeModel, signal.data(), output.data(), (int)signal.size(), 1, 1, settings);
+    const auto single_duration = second_t(clock_t::now() - start).count();
+
+    settings.num_threads = num_threads;
+    start = clock_t::now();
+    const auto result = renderChunked<T>(makeModel, signal.data(), output.data(), (int)signal.size(), 1, 1, settings);
+    const auto chunked_duration = second_t(clock_t::now() - start).count();
+
+    // measure the deviation separately, so that it doesn't count towards the render time
+    settings.verify = true;
+    const auto verify_result = renderChunked<T>(makeModel, signal.data(), output.data(), (int)signal.size(), 1, 1, settings);
+
+    std::cout << name << ":" << std::endl;
+    std::cout << "    1 thread:  " << single_duration << " seconds (" << length_seconds / single_duration << "x real-time)" << std::endl;
+    std::cout << "    " << result.num_threads << " threads: " << chunked_duration << " seconds ("
+              << length_seconds / chunked_duration << "x real-time, " << single_duration / chunked_duration << "x speed-up)" << std::endl;
+    std::cout << "    max deviation: " << verify_result.max_deviation << ", rms deviation: " << verify_result.rms_deviation << std::endl;
+}
+
+/** Splits the signal into fragments, and runs them on a single thread, and then with runBatch(). */
+template <typename T, typename ModelFactory>
+void runBatchBench(const std::string& name, ModelFactory&& makeModel, const bench_vec<T>& signal, int num_threads, double fragment_seconds)
+{
+    // fragments of 0.5x to 1.5x the given length, like the ones of a dataset split at the silences
+    std::vector<T> output(signal.size());
+    std::vector<BatchSequence<T>> sequences;
+    const auto fragment_frames = std::max(1, (int)(48000.0 * fragment_seconds));
+    for(int start = 0; start < (int)signal.size();)
+    {
+        const auto num_frames = std::min(fragment_frames / 2 + (int)(sequences.size() * 7919) % fragment_frames + 1, (int)signal.size() - start);
+        sequences.push_back({ signal.data() + start, output.data() + start, num_frames });
+        start += num_frames;
+    }
+
+    BatchRunSettings settings;
+    settings.num_threads = 1;
+    auto start = clock_t::now();
+    runBatch<T>(makeModel, sequences.data(), (int)sequences.size(), 1, 1, settings);
+    const auto single_duration = second_t(clock_t::now() - start).count();
+
+    settings.num_threads = num_threads;
+    start = clock_t::now();
+    const auto result = runBatch<T>(makeModel, sequences.data(), (int)sequences.size(), 1, 1, settings);
+    const auto batch_duration = second_t(clock_t::now() - start).count();
+
+    std::cout << name << " (" << sequences.size() << " fragments):" << std::endl;
+    std::cout << "    1 thread:  " << single_duration << " seconds" << std::endl;
+    std::cout << "    " << result.num_threads << " threads: " << batch_duration << " seconds ("
+              << single_duration / batch_duration << "x speed-up, " << result.num_steals << " steals)" << std::endl;
+}
+
+void help()
+{
+    std::cout << "RTNeural offline rendering benchmarks:" << std::endl;
+    std::cout << "Usage: rtneural_offline_bench [options]" << std::endl;
+    std::cout << "Compares rendering a long signal on a single thread against" << std::endl;
+    std::cout << "renderChunked() on all of the available threads. Then splits it into" << std::endl;
+    std::cout << "fragments, and compares running them on a single thread against runBatch()." << std::endl;
+    std::cout << "    --seconds <n>       Length of the signal, at 48 kHz (default 600)" << std::endl;
+    std::cout << "    --threads <n>       Number of threads (default: all available)" << std::endl;
+    std::cout << "    --warmup <n>        Number of pre-roll frames per chunk (default 8192)" << std::endl;
+    std::cout << "    --crossfade <n>     Number of cross-faded frames per chunk (default 0)" << std::endl;
+    std::cout << "    --fragment <n>      Average length of the fragments, in seconds (default 1)" << std::endl;
+}
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    double length_seconds = 600.0;
+    double fragment_seconds = 1.0;
+    ChunkedRenderSettings settings;
+
+    for(int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        const bool has_value = i + 1 < argc;
+
+        if(arg == "--help" || arg == "-h")
+        {
+            help();
+            return 0;
+        }
+        else if(arg == "--seconds" && has_value)
+            length_seconds = std::max(1.0, std::atof(argv[++i]));
+        else if(arg == "--threads" && has_value)
+            settings.num_threads = std::max(1, std::atoi(argv[++i]));
+        else if(arg == "--warmup" && has_value)
+            settings.warmup_frames = std::max(0, std::atoi(argv[++i]));
+        else if(arg == "--crossfade" && has_value)
+            settings.crossfade_frames = std::max(0, std::atoi(argv[++i]));
+        else if(arg == "--fragment" && has_value)
+            fragment_seconds = std::max(0.01, std::atof(argv[++i]));
+        else
+        {
+            std::cout << "Unknown argument: " << arg << std::endl;
+            help();
+            return 1;
+        }
+    }
+
+    std::cout << "RTNeural offline rendering benchmarks (" << bench::backendName() << " backend, "
+              << length_seconds << " seconds of signal, " << std::thread::hardware_concurrency() << " hardware threads)" << std::endl;
+
+    const auto num_frames = (size_t)(48000.0 * length_seconds);
+    const auto signal = bench::generateSignal<float>(num_frames, 1, 1);
+
+    // An LSTM(16) -> Dense(1) model, like the one used by the MagicKnob plugin
+    const auto makeDynamicModel = []
+    {
+        auto model = std::make_unique<Model<float>>(1);
+        auto lstm = new LSTMLayer<float>(1, 16);
+        auto dense = new Dense<float>(16, 1);
+        randomise_lstm<float>(*lstm);
+        randomise_dense<float>(*dense);
+        model->addLayer(lstm);
+        model->addLayer(dense);
+        model->reset();
+        return model;
+    };
+    runOfflineBench<float>("lstm/1x1/dynamic", makeDynamicModel, signal, settings, length_seconds);
+
+#if MODELT_AVAILABLE
+    using ModelType = ModelT<float, 1, 1, LSTMLayerT<float, 1, 16>, DenseT<float, 16, 1>>;
+    runOfflineBench<float>(
+        "lstm/1x1/templated", []
+        {
+            auto model = std::make_unique<ModelType>();
+            randomise_lstm<float>(model->get<0>());
+            randomise_dense<float>(model->get<1>());
+            model->reset();
+            return model;
+        },
+        signal, settings, length_seconds);
+#endif
+
+    const auto num_threads = settings.num_threads > 0 ? settings.num_threads : (int)std::thread::hardware_concurrency();
+    runBatchBench<float>("lstm/1x1/dynamic batch", makeDynamicModel, signal, num_threads, fragment_seconds);
+
+    return 0;
+}
@@ -0,0 +1,276 @@
+#include "bench_stats.hpp"
+#include <RTNeural.h>
+#include <fstream>
+#include <iostream>
+
+namespace
+{
+using namespace RTNeural;
+using clock_t = std::chrono::steady_clock;
+using second_t = std::chrono::duration<double>;
+
+constexpr double pi = 3.14159265358979323846;
+constexpr double model_rate = 44100.0; // the rate that the model is assumed to be trained at
+constexpr double test_freq = 1000.0;
+constexpr int num_harmonics = 8;
+constexpr int block_size = 256;
+
+#if MODELT_AVAILABLE
+template <SampleRateCorrectionMode mode>
+using ModelType = ModelT<float, 1, 1,
+    DenseT<float, 1, 8>,
+    TanhActivationT<float, 8>,
+    LSTMLayerT<float, 8, 8, mode>,
+    DenseT<float, 8, 1>>;
+#endif
+
+template <typename ModelClass>
+bool loadModel(ModelClass& model, const std::string& model_file)
+{
+    std::ifstream jsonStream(model_file, std::ifstream::binary);
+    if(!jsonStream.good())
+        return false;
+
+    model.parseJson(jsonStream);
+    model.reset();
+    return true;
+}
+
+std::vector<float> makeSine(double sample_rate, double seconds)
+{
+    std::vector<float> signal((size_t)(sample_rate * seconds));
+    for(size_t n = 0; n < signal.size(); ++n)
+        signal[n] = (float)(0.5 * std::sin(2.0 * pi * test_freq * (double)n / sample_rate));
+    return signal;
+}
+
+/** Measures the magnitudes of the harmonics of the test tone over the last half second of a signal. */
+std::array<double, num_harmonics> measureHarmonics(const std::vector<float>& signal, double sample_rate)
+{
+    std::array<double, num_harmonics> magnitudes {};
+    const auto num_samples = (size_t)(0.5 * sample_rate);
+    const auto start = signal.size() - num_samples;
+    for(int h = 0; h < num_harmonics; ++h)
+    {
+        double re = 0.0;
+        double im = 0.0;
+        const auto w = 2.0 * pi * test_freq * (double)(h + 1) / sample_rate;
+        for(size_t n = 0; n < num_samples; ++n)
+        {
+            re += (double)signal[start + n] * std::cos(w * (double)n);
+            im -= (double)signal[start + n] * std::sin(w * (double)n);
+        }
+        magnitudes[(size_t)h] = 2.0 * std::sqrt(re * re + im * im) / (double)num_samples;
+    }
+    return magnitudes;
+}
+
+/** Difference between the harmonic spectra of a render and the reference, relative to the reference fundamental. */
+double harmonicErrorDb(const std::array<double, num_harmonics>& test, const std::array<double, num_harmonics>& reference)
+{
+    double sum_squares = 0.0;
+    for(int h = 0; h < num_harmonics; ++h)
+        sum_squares += (test[(size_t)h] - reference[(size_t)h]) * (test[(size_t)h] - reference[(size_t)h]);
+    return 20.0 * std::log10(std::sqrt(sum_squares) / reference[0] + 1.0e-12);
+}
+
+/**
+ * Returns the power of everything except the harmonics of the tone in `tone_bin`
+ * (i.e. the aliasing) below 20 kHz, relative to the total power below 20 kHz, over
+ * the last `fft_size` samples of a signal. The tone must be centred on an FFT bin.
+ */
+double measureAliasingDb(const std::vector<float>& signal, double sample_rate, int fft_size, int tone_bin)
+{
+    fft_detail::RealFFT<double> fft(fft_size);
+    std::vector<double> x(signal.end() - fft_size, signal.end());
+    std::vector<double> re((size_t)fft.getNumBins());
+    std::vector<double> im((size_t)fft.getNumBins());
+    fft.forward(x.data(), re.data(), im.data());
+
+    double total_power = 0.0;
+    double alias_power = 0.0;
+    const auto max_bin = (int)(20000.0 / sample_rate * (double)fft_size);
+    for(int bin = 1; bin < max_bin; ++bin)
+    {
+        const auto power = re[(size_t)bin] * re[(size_t)bin] + im[(size_t)bin] * im[(size_t)bin];
+        total_power += power;
+        if(bin % tone_bin != 0)
+            alias_power += power;
+    }
+
+    return 10.0 * std::log10(alias_power / total_power + 1.0e-30);
+}
+
+/** Processes a signal in blocks, and returns the number of seconds it took. */
+template <typename BlockProcessor>
+double timeBlocks(std::vector<float>& signal, BlockProcessor&& process_block)
+{
+    const auto start = clock_t::now();
+    for(size_t n = 0; n < signal.size(); n += block_size)
+        process_block(signal.data() + n, (int)std::min((size_t)block_size, signal.size() - n));
+    return second_t(clock_t::now() - start).count();
+}
+
+template <typename ModelClass>
+void processModel(ModelClass& model, float* buffer, int num_samples) noexcept
+{
+    alignas(RTNEURAL_DEFAULT_ALIGNMENT) float frame[1];
+    for(int n = 0; n < num_samples; ++n)
+    {
+        frame[0] = buffer[n];
+        buffer[n] = model.forward(frame);
+    }
+}
+
+void printResult(const std::string& name, double seconds, double length_seconds, double error_db)
+{
+    std::cout << "    " << name << ": " << seconds << " seconds (" << length_seconds / seconds
+              << "x real-time), harmonic error: " << error_db << " dB" << std::endl;
+}
+
+void help()
+{
+    std::cout << "RTNeural sample rate benchmarks:" << std::endl;
+    std::cout << "Usage: rtneural_resampling_bench [options]" << std::endl;
+    std::cout << "Compares the CPU cost and accuracy of running a model trained at 44.1 kHz" << std::endl;
+    std::cout << "at a higher host sample rate: directly, with the sample rate corrected" << std::endl;
+    std::cout << "LSTM delay (SampleRateCorrectionMode::LinInterp), and resampled to 44.1 kHz" << std::endl;
+    std::cout << "with ModelResampler. The accuracy is the difference between the harmonics" << std::endl;
+    std::cout << "of a 1 kHz tone and those of the model running at 44.1 kHz." << std::endl;
+    std::cout << "It then runs the model at 48 kHz with 1x, 2x, 4x and 8x oversampling (Oversampler)," << std::endl;
+    std::cout << "and compares the CPU cost with the aliasing of a heavily driven 5 kHz tone below 20 kHz." << std::endl;
+    std::cout << "    --seconds <n>       Length of the signal (default 10)" << std::endl;
+    std::cout << "    --model <file>      Model file, with a Dense(8) -> tanh -> LSTM(8) -> Dense(1) architecture" << std::endl;
+    std::cout << "                        (default models/lstm.json, run from the repository root)" << std::endl;
+}
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    double length_seconds = 10.0;
+    std::string model_file = "models/lstm.json";
+
+    for(int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        const bool has_value = i + 1 < argc;
+
+        if(arg == "--help" || arg == "-h")
+        {
+            help();
+            return 0;
+        }
+        else if(arg == "--seconds" && has_value)
+            length_seconds = std::max(1.0, std::atof(argv[++i]));
+        else if(arg == "--model" && has_value)
+            model_file = argv[++i];
+        else
+        {
+            std::cout << "Unknown argument: " << arg << std::endl;
+            help();
+            return 1;
+        }
+    }
+
+#if MODELT_AVAILABLE
+    std::cout << "RTNeural sample rate benchmarks (" << bench::backendName() << " backend, "
+              << length_seconds << " seconds of signal, model trained at " << model_rate << " Hz)" << std::endl;
+
+    ModelType<SampleRateCorrectionMode::None> model;
+    if(!loadModel(model, model_file))
+    {
+        std::cout << "Unable to load model file: " << model_file << std::endl;
+        return 1;
+    }
+
+    auto reference_signal = makeSine(model_rate, length_seconds);
+    const auto reference_seconds = timeBlocks(reference_signal, [&](float* buffer, int num_samples)
+        { processModel(model, buffer, num_samples); });
+    const auto reference = measureHarmonics(reference_signal, model_rate);
+    std::cout << "  " << model_rate << " Hz (reference):" << std::endl;
+    printResult("model", reference_seconds, length_seconds, -240.0);
+
+    for(auto host_rate : { 48000.0, 96000.0, 192000.0 })
+    {
+        std::cout << "  " << host_rate << " Hz:" << std::endl;
+
+        auto signal = makeSine(host_rate, length_seconds);
+        model.reset();
+        const auto direct_seconds = timeBlocks(signal, [&](float* buffer, int num_samples)
+            { processModel(model, buffer, num_samples); });
+        printResult("direct", direct_seconds, length_seconds, harmonicErrorDb(measureHarmonics(signal, host_rate), reference));
+
+        ModelType<SampleRateCorrectionMode::LinInterp> corrected_model;
+        loadModel(corrected_model, model_file);
+        corrected_model.get<2>().prepare((float)(host_rate / model_rate));
+        corrected_model.reset();
+        signal = makeSine(host_rate, length_seconds);
+        const auto corrected_seconds = timeBlocks(signal, [&](float* buffer, int num_samples)
+            { processModel(corrected_model, buffer, num_samples); });
+        printResult("rnn correction", corrected_seconds, length_seconds, harmonicErrorDb(measureHarmonics(signal, host_rate), reference));
+
+        ModelResampler<float> resampler;
+        resampler.prepare(host_rate, model_rate, block_size);
+        model.reset();
+        signal = makeSine(host_rate, length_seconds);
+        const auto resampled_seconds = timeBlocks(signal, [&](float* buffer, int num_samples)
+            { resampler.process(buffer, num_samples, [&](float* x, int n)
+                  { processModel(model, x, n); }); });
+        printResult("resampled", resampled_seconds, length_seconds, harmonicErrorDb(measureHarmonics(signal, host_rate), reference));
+
+        // the cost of the conversion on its own
+        resampler.reset();
+        signal = makeSine(host_rate, length_seconds);
+        const auto conversion_seconds = timeBlocks(signal, [&](float* buffer, int num_samples)
+            { resampler.process(buffer, num_samples, [](float*, int) {}); });
+        std::cout << "    (conversion only: " << conversion_seconds << " seconds, latency "
+                  << resampler.getLatencySamples() << " samples)" << std::endl;
+    }
+
+    // a tone on an odd FFT bin, so that none of its aliased harmonics fall on another harmonic
+    constexpr double host_rate = 48000.0;
+    constexpr int fft_size = 65536;
+    constexpr int tone_bin = 6827; // ~5 kHz
+    constexpr double drive = 20.0; // drives the model's first tanh hard, so it distorts
+    const auto tone_freq = (double)tone_bin * host_rate / (double)fft_size;
+    const auto makeTone = [&]
+    {
+        std::vector<float> signal((size_t)std::max(host_rate * length_seconds, (double)fft_size));
+        for(size_t n = 0; n < signal.size(); ++n)
+            signal[n] = (float)(drive * std::sin(2.0 * pi * tone_freq * (double)n / host_rate));
+        return signal;
+    };
+
+    std::cout << "  Oversampling at " << host_rate << " Hz (" << tone_freq << " Hz tone):" << std::endl;
+    for(int factor = 1; factor <= Oversampler<float>::max_factor; factor *= 2)
+    {
+        // the model runs at `factor` times the rate it was trained at
+        ModelType<SampleRateCorrectionMode::LinInterp> oversampled_model;
+        loadModel(oversampled_model, model_file);
+        oversampled_model.get<2>().prepare((float)factor);
+        oversampled_model.reset();
+
+        Oversampler<float> oversampler;
+        oversampler.prepare(factor, block_size);
+
+        auto signal = makeTone();
+        const auto seconds = timeBlocks(signal, [&](float* buffer, int num_samples)
+            { oversampler.process(buffer, num_samples, [&](float* x, int n)
+                  { processModel(oversampled_model, x, n); }); });
+        const auto aliasing_db = measureAliasingDb(signal, host_rate, fft_size, tone_bin);
+
+        oversampler.reset();
+        signal = makeTone();
+        const auto filter_seconds = timeBlocks(signal, [&](float* buffer, int num_samples)
+            { oversampler.process(buffer, num_samples, [](float*, int) {}); });
+
+        std::cout << "    " << factor << "x: " << seconds << " seconds (" << (double)signal.size() / host_rate / seconds
+                  << "x real-time), filters only: " << filter_seconds << " seconds, aliasing: " << aliasing_db
+                  << " dB, latency " << oversampler.getLatencySamples() << " samples" << std::endl;
+    }
+#else
+    std::cout << "The sample rate benchmarks need the static models, which are not available with this backend" << std::endl;
+#endif
+
+    return 0;
+}
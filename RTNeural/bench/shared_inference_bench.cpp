@@ -0,0 +1,212 @@
+#include "bench_stats.hpp"
+#include <RTNeural.h>
+#include <iostream>
+#include <random>
+
+namespace
+{
+using namespace RTNeural;
+using clock_t = std::chrono::steady_clock;
+using second_t = std::chrono::duration<double>;
+
+constexpr int in_size = 2;
+constexpr double sample_rate = 48000.0;
+
+/** A PyTorch state_dict with random weights, for an "lstm." layer followed by a "dense." layer. */
+nlohmann::json makeModelJson(int hidden_size)
+{
+    std::default_random_engine generator(0x1234);
+    std::uniform_real_distribution<float> distribution(-0.2f, 0.2f);
+    const auto randomWeights = [&](int num_out, int num_in)
+    {
+        std::vector<std::vector<float>> weights((size_t)num_out, std::vector<float>((size_t)num_in));
+        for(auto& row : weights)
+            for(auto& w : row)
+                w = distribution(generator);
+        return weights;
+    };
+
+    nlohmann::json model_json;
+    model_json["lstm.weight_ih_l0"] = randomWeights(4 * hidden_size, in_size);
+    model_json["lstm.weight_hh_l0"] = randomWeights(4 * hidden_size, hidden_size);
+    model_json["lstm.bias_ih_l0"] = randomWeights(1, 4 * hidden_size)[0];
+    model_json["lstm.bias_hh_l0"] = randomWeights(1, 4 * hidden_size)[0];
+    model_json["dense.weight"] = randomWeights(1, hidden_size);
+    model_json["dense.bias"] = randomWeights(1, 1)[0];
+    return model_json;
+}
+
+/** Interleaved [audio, knob] frames for one block of every stream. */
+std::vector<float> makeInputs(int num_streams, int block_size)
+{
+    std::vector<float> inputs((size_t)(num_streams * block_size * in_size));
+    for(int s = 0; s < num_streams; ++s)
+    {
+        for(int n = 0; n < block_size; ++n)
+        {
+            inputs[(size_t)((s * block_size + n) * in_size)] = (float)(0.5 * std::sin(0.01 * (double)((s + 1) * n)));
+            inputs[(size_t)((s * block_size + n) * in_size + 1)] = 0.5f;
+        }
+    }
+    return inputs;
+}
+
+#if MODELT_AVAILABLE
+/** Runs every stream on its own static model, one block at a time, and returns the number of seconds it took. */
+template <int hidden_size>
+double timeSeparateModels(const nlohmann::json& model_json, int num_streams, int block_size, int num_blocks)
+{
+    using ModelType = ModelT<float, in_size, 1, LSTMLayerT<float, in_size, hidden_size>, DenseT<float, hidden_size, 1>>;
+
+    bench_vec<ModelType> models((size_t)num_streams);
+    for(auto& model : models)
+    {
+        torch_helpers::loadLSTM<float>(model_json, "lstm.", model.template get<0>());
+        torch_helpers::loadDense<float>(model_json, "dense.", model.template get<1>());
+        model.reset();
+    }
+
+    const auto inputs = makeInputs(num_streams, block_size);
+    std::vector<float> output((size_t)block_size);
+    alignas(RTNEURAL_DEFAULT_ALIGNMENT) float frame[in_size];
+    float sum = 0.0f;
+
+    const auto start = clock_t::now();
+    for(int b = 0; b < num_blocks; ++b)
+    {
+        for(int s = 0; s < num_streams; ++s)
+        {
+            const auto* input = inputs.data() + s * block_size * in_size;
+            for(int n = 0; n < block_size; ++n)
+            {
+                // the static models need an aligned input frame
+                std::copy(input + n * in_size, input + (n + 1) * in_size, frame);
+                output[(size_t)n] = models[(size_t)s].forward(frame);
+            }
+            sum += output[0];
+        }
+    }
+    const auto seconds = second_t(clock_t::now() - start).count();
+
+    // keeps the compiler from dropping the loop
+    if(std::isnan(sum))
+        std::cout << sum;
+    return seconds;
+}
+#endif
+
+/** Runs every stream through a shared service, with the batches on the calling thread, and returns the number of seconds it took. */
+double timeSharedService(const nlohmann::json& model_json, int hidden_size, int num_streams, int block_size, int num_blocks)
+{
+    BatchedLSTMDense<float> batched_model(in_size, hidden_size);
+    torch_helpers::loadLSTM<float>(model_json, "lstm.", batched_model.lstm);
+    torch_helpers::loadDense<float>(model_json, "dense.", batched_model.dense);
+
+    SharedInferenceSettings settings;
+    settings.batch_size = block_size;
+    settings.max_streams = num_streams;
+    settings.group_size = num_streams;
+    settings.num_workers = 0;
+
+    SharedInferenceService<float> service(std::move(batched_model), settings);
+    std::vector<int> streams;
+    for(int s = 0; s < num_streams; ++s)
+        streams.push_back(service.registerStream(block_size));
+
+    const auto inputs = makeInputs(num_streams, block_size);
+    std::vector<float> output((size_t)block_size);
+    float sum = 0.0f;
+
+    const auto start = clock_t::now();
+    for(int b = 0; b < num_blocks; ++b)
+    {
+        for(int s = 0; s < num_streams; ++s)
+        {
+            service.process(streams[(size_t)s], inputs.data() + s * block_size * in_size, output.data(), block_size);
+            sum += output[0];
+        }
+        service.processPending();
+    }
+    const auto seconds = second_t(clock_t::now() - start).count();
+
+    if(std::isnan(sum))
+        std::cout << sum;
+    return seconds;
+}
+
+/** Times both ways of running a growing number of streams of an LSTM model with `hidden_size` units. */
+template <int hidden_size>
+void printStreams(int max_streams, int block_size, int num_blocks)
+{
+    std::cout << "  LSTM with " << hidden_size << " units:" << std::endl;
+
+    const auto model_json = makeModelJson(hidden_size);
+    const auto ns_per_sample = [&](double seconds, int num_streams)
+    { return seconds * 1.0e9 / ((double)num_blocks * (double)block_size * (double)num_streams); };
+
+    for(int num_streams = 1; num_streams <= max_streams; num_streams *= 2)
+    {
+        const auto shared_seconds = timeSharedService(model_json, hidden_size, num_streams, block_size, num_blocks);
+        std::cout << "    " << num_streams << " streams: shared " << ns_per_sample(shared_seconds, num_streams) << " ns/sample";
+
+#if MODELT_AVAILABLE
+        const auto separate_seconds = timeSeparateModels<hidden_size>(model_json, num_streams, block_size, num_blocks);
+        std::cout << ", separate " << ns_per_sample(separate_seconds, num_streams) << " ns/sample (shared is "
+                  << separate_seconds / shared_seconds << "x faster)";
+#endif
+        std::cout << std::endl;
+    }
+}
+
+void help()
+{
+    std::cout << "RTNeural shared inference benchmark:" << std::endl;
+    std::cout << "Usage: rtneural_shared_inference_bench [options]" << std::endl;
+    std::cout << "Runs a growing number of streams (e.g. plugin instances) of 2-input LSTM models with 32" << std::endl;
+    std::cout << "and 96 units, on their own static models, and as one batch with SharedInferenceService" << std::endl;
+    std::cout << "(on the calling thread), and reports the time per stream and per sample for each." << std::endl;
+    std::cout << "    --seconds <n>       Length of the signal of each stream (default 1)" << std::endl;
+    std::cout << "    --block <n>         Block size (default 128)" << std::endl;
+    std::cout << "    --streams <n>       Largest number of streams (default 128)" << std::endl;
+}
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    double length_seconds = 1.0;
+    int block_size = 128;
+    int max_streams = 128;
+
+    for(int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        const bool has_value = i + 1 < argc;
+
+        if(arg == "--help" || arg == "-h")
+        {
+            help();
+            return 0;
+        }
+        else if(arg == "--seconds" && has_value)
+            length_seconds = std::max(0.1, std::atof(argv[++i]));
+        else if(arg == "--block" && has_value)
+            block_size = std::max(1, std::atoi(argv[++i]));
+        else if(arg == "--streams" && has_value)
+            max_streams = std::max(1, std::atoi(argv[++i]));
+        else
+        {
+            std::cout << "Unknown argument: " << arg << std::endl;
+            help();
+            return 1;
+        }
+    }
+
+    std::cout << "RTNeural shared inference benchmark (" << bench::backendName() << " backend, "
+              << length_seconds << " seconds of signal per stream, " << block_size << "-sample blocks)" << std::endl;
+
+    const auto num_blocks = std::max(1, (int)(sample_rate * length_seconds) / block_size);
+    printStreams<32>(max_streams, block_size, num_blocks);
+    printStreams<96>(max_streams, block_size, num_blocks);
+
+    return 0;
+}
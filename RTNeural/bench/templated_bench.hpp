@@ -7,257 +7,194 @@
 
 #if MODELT_AVAILABLE
 
-double runTemplatedBench(const std::vector<vec_type>& signal, const size_t n_samples,
-    const std::string& layer_type, size_t in_size, size_t out_size)
+/**
+ * The compile-time benchmarks are generated from these size lists.
+ * Every (in, out) pair in the cartesian product of a layer's lists
+ * gets its own ModelT instantiation, so keep the grids reasonable.
+ */
+template <int... Sizes>
+using size_list = std::integer_sequence<int, Sizes...>;
+
+using DenseInSizes = size_list<1, 2, 4, 8, 16, 24, 32, 64>;
+using DenseOutSizes = size_list<1, 4, 8, 16, 24, 32, 64, 128>;
+
+using RecurrentInSizes = size_list<1, 2, 4, 8, 16, 32, 64>;
+using RecurrentHiddenSizes = size_list<4, 8, 16, 24, 32, 64, 128>;
+
+using Conv1DInSizes = size_list<2, 4, 8, 16, 32>; // kernel_size = in_size - 1
+using Conv1DOutSizes = size_list<4, 8, 16, 32>;
+
+using ActivationSizes = size_list<4, 8, 16, 24, 32, 64, 128>;
+
+namespace templated_bench_detail
 {
-    using namespace RTNeural;
-    using clock_t = std::chrono::high_resolution_clock;
-    using second_t = std::chrono::duration<double>;
+using clock_t = std::chrono::high_resolution_clock;
+using second_t = std::chrono::duration<double>;
+using bench_fn = double (*)(const std::vector<vec_type>&, size_t);
 
-    auto run_layer = [=, &signal] (auto& layer) -> double
-    {
-        auto start = clock_t::now();
-        for(size_t i = 0; i < n_samples; ++i)
-            layer.forward(signal[i].data());
-        return std::chrono::duration_cast<second_t>(clock_t::now() - start).count();
-    };
+/** One entry in a dispatch table. */
+struct BenchEntry
+{
+    int in_size;
+    int out_size;
+    bench_fn run;
+};
 
-    double duration = 10000.0;
-    if(layer_type == "dense")
-    {
-        if(in_size == 4 && out_size == 4)
-        {
-            ModelT<double, 4, 4, DenseT<double, 4, 4>> model;
-            randomise_dense (model.get<0>());
-            duration = run_layer(model);
-        }
-        else if(in_size == 8 && out_size == 8)
-        {
-            ModelT<double, 8, 8, DenseT<double, 8, 8>> model;
-            randomise_dense (model.get<0>());
-            duration = run_layer(model);
-        }
-        else if(in_size == 16 && out_size == 16)
-        {
-            ModelT<double, 16, 16, DenseT<double, 16, 16>> model;
-            randomise_dense (model.get<0>());
-            duration = run_layer(model);
-        }
-        else if(in_size == 24 && out_size == 1)
-        {
-            ModelT<double, 24, 1, DenseT<double, 24, 1>> model;
-            randomise_dense (model.get<0>());
-            duration = run_layer(model);
-        }
-        else
-        {
-            std::cout << "Layer size not supported for templated benchmarks!" << std::endl;
-        }
-    }
-    else if(layer_type == "conv1d")
-    {
-        if(in_size == 4 && out_size == 4)
-        {
-            constexpr size_t kernel_size = 3; // in_size - 1
-            ModelT<double, 4, 4, Conv1DT<double, 4, 4, kernel_size, 1>> model;
-            randomise_conv1d (model.get<0>(), kernel_size);
-            duration = run_layer(model);
-        }
-        else if(in_size == 8 && out_size == 8)
-        {
-            constexpr size_t kernel_size = 7; // in_size - 1
-            constexpr size_t dilation_rate = 2; // in_size / 4
-            ModelT<double, 8, 8, Conv1DT<double, 8, 8, kernel_size, dilation_rate>> model;
-            randomise_conv1d (model.get<0>(), kernel_size);
-            duration = run_layer(model);
-        }
-        else if(in_size == 16 && out_size == 16)
-        {
-            constexpr size_t kernel_size = 15; // in_size - 1
-            constexpr size_t dilation_rate = 4; // in_size / 4
-            ModelT<double, 16, 16, Conv1DT<double, 16, 16, kernel_size, dilation_rate>> model;
-            randomise_conv1d (model.get<0>(), kernel_size);
-            duration = run_layer(model);
-        }
-        else
-        {
-            std::cout << "Layer size not supported for templated benchmarks!" << std::endl;
-        }
-    }
-    else if(layer_type == "gru")
-    {
-        if(in_size == 4 && out_size == 4)
-        {
-            ModelT<double, 4, 4, GRULayerT<double, 4, 4>> model;
-            randomise_gru (model.get<0>());
-            duration = run_layer(model);
-        }
-        else if(in_size == 8 && out_size == 8)
-        {
-            ModelT<double, 8, 8, GRULayerT<double, 8, 8>> model;
-            randomise_gru (model.get<0>());
-            duration = run_layer(model);
-        }
-        else if(in_size == 16 && out_size == 16)
-        {
-            ModelT<double, 16, 16, GRULayerT<double, 16, 16>> model;
-            randomise_gru (model.get<0>());
-            duration = run_layer(model);
-        }
-        else if(in_size == 1 && out_size == 24)
-        {
-            ModelT<double, 1, 24, GRULayerT<double, 1, 24>> model;
-            randomise_gru (model.get<0>());
-            duration = run_layer(model);
-        }
-        else
-        {
-            std::cout << "Layer size not supported for templated benchmarks!" << std::endl;
-        }
-    }
-    else if(layer_type == "lstm")
+template <typename ModelType>
+double runModel(ModelType& model, const std::vector<vec_type>& signal, size_t n_samples)
+{
+    auto start = clock_t::now();
+    for(size_t i = 0; i < n_samples; ++i)
+        model.forward(signal[i].data());
+    return std::chrono::duration_cast<second_t>(clock_t::now() - start).count();
+}
+
+struct DenseBench
+{
+    template <int in_size, int out_size>
+    static double run(const std::vector<vec_type>& signal, size_t n_samples)
     {
-        if(in_size == 4 && out_size == 4)
-        {
-            ModelT<double, 4, 4, LSTMLayerT<double, 4, 4>> model;
-            randomise_lstm (model.get<0>());
-            duration = run_layer(model);
-        }
-        else if(in_size == 8 && out_size == 8)
-        {
-            ModelT<double, 8, 8, LSTMLayerT<double, 8, 8>> model;
-            randomise_lstm (model.get<0>());
-            duration = run_layer(model);
-        }
-        else if(in_size == 16 && out_size == 16)
-        {
-            ModelT<double, 16, 16, LSTMLayerT<double, 16, 16>> model;
-            randomise_lstm (model.get<0>());
-            duration = run_layer(model);
-        }
-        else if(in_size == 1 && out_size == 24)
-        {
-            ModelT<double, 1, 24, LSTMLayerT<double, 1, 24>> model;
-            randomise_lstm (model.get<0>());
-            duration = run_layer(model);
-        }
-        else
-        {
-            std::cout << "Layer size not supported for templated benchmarks!" << std::endl;
-        }
+        RTNeural::ModelT<double, in_size, out_size, RTNeural::DenseT<double, in_size, out_size>> model;
+        randomise_dense(model.template get<0>());
+        return runModel(model, signal, n_samples);
     }
-    else if(layer_type == "tanh")
+};
+
+struct Conv1DBench
+{
+    template <int in_size, int out_size>
+    static double run(const std::vector<vec_type>& signal, size_t n_samples)
     {
-        if(in_size == 4 && out_size == 4)
-        {
-            ModelT<double, 4, 4, TanhActivationT<double, 4>> model;
-            duration = run_layer(model);
-        }
-        else if(in_size == 8 && out_size == 8)
-        {
-            ModelT<double, 8, 8, TanhActivationT<double, 8>> model;
-            duration = run_layer(model);
-        }
-        else if(in_size == 16 && out_size == 16)
-        {
-            ModelT<double, 16, 16, TanhActivationT<double, 16>> model;
-            duration = run_layer(model);
-        }
-        else
-        {
-            std::cout << "Layer size not supported for templated benchmarks!" << std::endl;
-        }
+        constexpr int kernel_size = in_size - 1; // matches create_layer()
+        RTNeural::ModelT<double, in_size, out_size, RTNeural::Conv1DT<double, in_size, out_size, kernel_size, 1>> model;
+        randomise_conv1d(model.template get<0>(), kernel_size);
+        return runModel(model, signal, n_samples);
     }
-    else if(layer_type == "fast_tanh")
+};
+
+struct GRUBench
+{
+    template <int in_size, int out_size>
+    static double run(const std::vector<vec_type>& signal, size_t n_samples)
     {
-        if(in_size == 4 && out_size == 4)
-        {
-            ModelT<double, 4, 4, FastTanhT<double, 4>> model;
-            duration = run_layer(model);
-        }
-        else if(in_size == 8 && out_size == 8)
-        {
-            ModelT<double, 8, 8, FastTanhT<double, 8>> model;
-            duration = run_layer(model);
-        }
-        else if(in_size == 16 && out_size == 16)
-        {
-            ModelT<double, 16, 16, FastTanhT<double, 16>> model;
-            duration = run_layer(model);
-        }
-        else
-        {
-            std::cout << "Layer size not supported for templated benchmarks!" << std::endl;
-        }
+        RTNeural::ModelT<double, in_size, out_size, RTNeural::GRULayerT<double, in_size, out_size>> model;
+        randomise_gru(model.template get<0>());
+        return runModel(model, signal, n_samples);
     }
-    else if(layer_type == "relu")
+};
+
+struct LSTMBench
+{
+    template <int in_size, int out_size>
+    static double run(const std::vector<vec_type>& signal, size_t n_samples)
     {
-        if(in_size == 4 && out_size == 4)
-        {
-            ModelT<double, 4, 4, ReLuActivationT<double, 4>> model;
-            duration = run_layer(model);
-        }
-        else if(in_size == 8 && out_size == 8)
-        {
-            ModelT<double, 8, 8, ReLuActivationT<double, 8>> model;
-            duration = run_layer(model);
-        }
-        else if(in_size == 16 && out_size == 16)
-        {
-            ModelT<double, 16, 16, ReLuActivationT<double, 16>> model;
-            duration = run_layer(model);
-        }
-        else
-        {
-            std::cout << "Layer size not supported for templated benchmarks!" << std::endl;
-        }
+        RTNeural::ModelT<double, in_size, out_size, RTNeural::LSTMLayerT<double, in_size, out_size>> model;
+        randomise_lstm(model.template get<0>());
+        return runModel(model, signal, n_samples);
     }
-    else if(layer_type == "sigmoid")
+};
+
+template <template <typename, int> class ActivationType>
+struct ActivationBench
+{
+    template <int in_size, int out_size>
+    static double run(const std::vector<vec_type>& signal, size_t n_samples)
     {
-        if(in_size == 4 && out_size == 4)
-        {
-            ModelT<double, 4, 4, SigmoidActivationT<double, 4>> model;
-            duration = run_layer(model);
-        }
-        else if(in_size == 8 && out_size == 8)
-        {
-            ModelT<double, 8, 8, SigmoidActivationT<double, 8>> model;
-            duration = run_layer(model);
-        }
-        else if(in_size == 16 && out_size == 16)
-        {
-            ModelT<double, 16, 16, SigmoidActivationT<double, 16>> model;
-            duration = run_layer(model);
-        }
-        else
-        {
-            std::cout << "Layer size not supported for templated benchmarks!" << std::endl;
-        }
+        static_assert(in_size == out_size, "Activation layers must have the same input and output size!");
+        RTNeural::ModelT<double, in_size, out_size, ActivationType<double, in_size>> model;
+        return runModel(model, signal, n_samples);
     }
-    else if(layer_type == "softmax")
+};
+
+template <typename Bench, int in_size, int... OutSizes>
+void addRow(std::vector<BenchEntry>& table, size_list<OutSizes...>)
+{
+    (void)std::initializer_list<int> { (table.push_back({ in_size, OutSizes, &Bench::template run<in_size, OutSizes> }), 0)... };
+}
+
+/** Builds a dispatch table covering every (in, out) pair from the two size lists. */
+template <typename Bench, int... InSizes, typename OutList>
+std::vector<BenchEntry> makeTable(size_list<InSizes...>, OutList out_sizes)
+{
+    std::vector<BenchEntry> table;
+    (void)std::initializer_list<int> { (addRow<Bench, InSizes>(table, out_sizes), 0)... };
+    return table;
+}
+
+/** Builds a dispatch table for layers where in_size == out_size. */
+template <typename Bench, int... Sizes>
+std::vector<BenchEntry> makeSquareTable(size_list<Sizes...>)
+{
+    return { { Sizes, Sizes, &Bench::template run<Sizes, Sizes> }... };
+}
+
+inline const std::vector<BenchEntry>* getTable(const std::string& layer_type)
+{
+    using namespace RTNeural;
+
+    static const std::vector<BenchEntry> dense_table = makeTable<DenseBench>(DenseInSizes {}, DenseOutSizes {});
+    static const std::vector<BenchEntry> conv1d_table = makeTable<Conv1DBench>(Conv1DInSizes {}, Conv1DOutSizes {});
+    static const std::vector<BenchEntry> gru_table = makeTable<GRUBench>(RecurrentInSizes {}, RecurrentHiddenSizes {});
+    static const std::vector<BenchEntry> lstm_table = makeTable<LSTMBench>(RecurrentInSizes {}, RecurrentHiddenSizes {});
+    static const std::vector<BenchEntry> tanh_table = makeSquareTable<ActivationBench<TanhActivationT>>(ActivationSizes {});
+    static const std::vector<BenchEntry> fast_tanh_table = makeSquareTable<ActivationBench<FastTanhT>>(ActivationSizes {});
+    static const std::vector<BenchEntry> relu_table = makeSquareTable<ActivationBench<ReLuActivationT>>(ActivationSizes {});
+    static const std::vector<BenchEntry> sigmoid_table = makeSquareTable<ActivationBench<SigmoidActivationT>>(ActivationSizes {});
+    static const std::vector<BenchEntry> softmax_table = makeSquareTable<ActivationBench<SoftmaxActivationT>>(ActivationSizes {});
+
+    if(layer_type == "dense")
+        return &dense_table;
+    if(layer_type == "conv1d")
+        return &conv1d_table;
+    if(layer_type == "gru")
+        return &gru_table;
+    if(layer_type == "lstm")
+        return &lstm_table;
+    if(layer_type == "tanh")
+        return &tanh_table;
+    if(layer_type == "fast_tanh")
+        return &fast_tanh_table;
+    if(layer_type == "relu")
+        return &relu_table;
+    if(layer_type == "sigmoid")
+        return &sigmoid_table;
+    if(layer_type == "softmax")
+        return &softmax_table;
+
+    return nullptr;
+}
+} // namespace templated_bench_detail
+
+/** Prints the (in, out) sizes available for the templated benchmark of a layer type. */
+inline void printTemplatedSizes(const std::string& layer_type)
+{
+    const auto* table = templated_bench_detail::getTable(layer_type);
+    if(table == nullptr)
+        return;
+
+    std::cout << "Supported sizes for templated " << layer_type << " benchmarks:";
+    for(const auto& entry : *table)
+        std::cout << " " << entry.in_size << "x" << entry.out_size;
+    std::cout << std::endl;
+}
+
+/** Returns the duration of the templated benchmark, or a negative value if the size is not supported. */
+double runTemplatedBench(const std::vector<vec_type>& signal, const size_t n_samples,
+    const std::string& layer_type, size_t in_size, size_t out_size)
+{
+    const auto* table = templated_bench_detail::getTable(layer_type);
+    if(table != nullptr)
     {
-        if(in_size == 4 && out_size == 4)
-        {
-            ModelT<double, 4, 4, SoftmaxActivationT<double, 4>> model;
-            duration = run_layer(model);
-        }
-        else if(in_size == 8 && out_size == 8)
-        {
-            ModelT<double, 8, 8, SoftmaxActivationT<double, 8>> model;
-            duration = run_layer(model);
-        }
-        else if(in_size == 16 && out_size == 16)
-        {
-            ModelT<double, 16, 16, SoftmaxActivationT<double, 16>> model;
-            duration = run_layer(model);
-        }
-        else
+        for(const auto& entry : *table)
         {
-            std::cout << "Layer size not supported for templated benchmarks!" << std::endl;
+            if((size_t)entry.in_size == in_size && (size_t)entry.out_size == out_size)
+                return entry.run(signal, n_samples);
         }
     }
 
-    return duration;
+    std::cout << "Layer size not supported for templated benchmarks!" << std::endl;
+    printTemplatedSizes(layer_type);
+    return -1.0;
 }
 
 #endif // MODELT_AVAILABLE
@@ -0,0 +1,179 @@
+#pragma once
+
+#include <iostream>
+#include <random>
+#include <RTNeural.h>
+
+namespace batched_test
+{
+constexpr int in_size = 3;
+constexpr int hidden_size = 8;
+constexpr int batch_size = 5;
+constexpr int kernel_size = 3;
+constexpr int dilation_rate = 2;
+constexpr int num_frames = 200;
+
+/** Returns a json array of random weights with dimensions [num_out][num_in]. */
+nlohmann::json randomWeights(std::default_random_engine& generator, int num_out, int num_in)
+{
+    std::uniform_real_distribution<double> distribution(-0.5, 0.5);
+    std::vector<std::vector<double>> weights((size_t)num_out, std::vector<double>((size_t)num_in));
+    for(auto& row : weights)
+        for(auto& w : row)
+            w = distribution(generator);
+
+    return weights;
+}
+
+/** A PyTorch state_dict with "lstm.", "gru.", "dense." and "conv." layers, that all take in_size inputs. */
+nlohmann::json makeModelJson()
+{
+    std::default_random_engine generator(2468);
+
+    nlohmann::json model_json;
+    for(const auto& rnn : { std::make_pair(std::string("lstm."), 4), std::make_pair(std::string("gru."), 3) })
+    {
+        model_json[rnn.first + "weight_ih_l0"] = randomWeights(generator, rnn.second * hidden_size, in_size);
+        model_json[rnn.first + "weight_hh_l0"] = randomWeights(generator, rnn.second * hidden_size, hidden_size);
+        model_json[rnn.first + "bias_ih_l0"] = randomWeights(generator, 1, rnn.second * hidden_size)[0];
+        model_json[rnn.first + "bias_hh_l0"] = randomWeights(generator, 1, rnn.second * hidden_size)[0];
+    }
+
+    model_json["dense.weight"] = randomWeights(generator, hidden_size, in_size);
+    model_json["dense.bias"] = randomWeights(generator, 1, hidden_size)[0];
+
+    std::vector<nlohmann::json> conv_weights;
+    for(int i = 0; i < hidden_size; ++i)
+        conv_weights.push_back(randomWeights(generator, in_size, kernel_size));
+    model_json["conv.weight"] = conv_weights;
+    model_json["conv.bias"] = randomWeights(generator, 1, hidden_size)[0];
+    return model_json;
+}
+
+/**
+ * Runs batch_size different input sequences through the batched layer, and
+ * compares each one with the same sequence on its own run-time layer.
+ */
+template <typename T, typename BatchedLayerType, typename LayerFactory>
+int testLayer(const std::string& name, BatchedLayerType& batched_layer, LayerFactory&& makeLayer, T tolerance)
+{
+    std::cout << "    " << name << std::endl;
+
+    std::default_random_engine generator(1357);
+    std::uniform_real_distribution<double> distribution(-1.0, 1.0);
+    std::vector<T> inputs((size_t)(num_frames * in_size * batch_size));
+    for(auto& x : inputs)
+        x = (T)distribution(generator);
+
+    std::vector<std::unique_ptr<RTNeural::Layer<T>>> layers;
+    for(int b = 0; b < batch_size; ++b)
+    {
+        layers.push_back(makeLayer());
+        layers.back()->reset();
+    }
+    batched_layer.reset();
+
+    constexpr auto out_size = BatchedLayerType::out_size;
+    T batched_input alignas(RTNEURAL_DEFAULT_ALIGNMENT)[in_size * batch_size];
+    std::vector<T> input((size_t)in_size), output((size_t)out_size);
+    T max_error = (T)0;
+    for(int n = 0; n < num_frames; ++n)
+    {
+        // value i of sequence b is at index i * batch_size + b
+        const auto* frame = inputs.data() + n * in_size * batch_size;
+        std::copy(frame, frame + in_size * batch_size, batched_input);
+        batched_layer.forward(batched_input);
+
+        for(int b = 0; b < batch_size; ++b)
+        {
+            for(int i = 0; i < in_size; ++i)
+                input[(size_t)i] = frame[i * batch_size + b];
+
+            layers[(size_t)b]->forward(input.data(), output.data());
+            for(int i = 0; i < out_size; ++i)
+                max_error = std::max(max_error, std::abs(batched_layer.outs[i * batch_size + b] - output[(size_t)i]));
+        }
+    }
+
+    if(max_error > tolerance)
+    {
+        std::cout << "        FAIL! Maximum error: " << max_error << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
+
+template <typename T>
+int runTests(T tolerance)
+{
+    const auto model_json = makeModelJson();
+    int result = 0;
+
+    {
+        auto dense = std::make_unique<RTNeural::DenseBatchT<T, in_size, hidden_size, batch_size>>();
+        RTNeural::torch_helpers::loadDense<T>(model_json, "dense.", *dense);
+        result |= testLayer<T>("dense", *dense, [&]
+            {
+                auto layer = std::make_unique<RTNeural::Dense<T>>(in_size, hidden_size);
+                RTNeural::torch_helpers::loadDense<T>(model_json, "dense.", *layer);
+                return layer;
+            },
+            tolerance);
+    }
+
+    {
+        auto lstm = std::make_unique<RTNeural::LSTMLayerBatchT<T, in_size, hidden_size, batch_size>>();
+        RTNeural::torch_helpers::loadLSTM<T>(model_json, "lstm.", *lstm);
+        result |= testLayer<T>("lstm", *lstm, [&]
+            {
+                auto layer = std::make_unique<RTNeural::LSTMLayer<T>>(in_size, hidden_size);
+                RTNeural::torch_helpers::loadLSTM<T>(model_json, "lstm.", *layer);
+                return layer;
+            },
+            tolerance);
+    }
+
+    {
+        auto gru = std::make_unique<RTNeural::GRULayerBatchT<T, in_size, hidden_size, batch_size>>();
+        RTNeural::torch_helpers::loadGRU<T>(model_json, "gru.", *gru);
+        result |= testLayer<T>("gru", *gru, [&]
+            {
+                auto layer = std::make_unique<RTNeural::GRULayer<T>>(in_size, hidden_size);
+                RTNeural::torch_helpers::loadGRU<T>(model_json, "gru.", *layer);
+                return layer;
+            },
+            tolerance);
+    }
+
+    {
+        auto conv = std::make_unique<RTNeural::Conv1DBatchT<T, in_size, hidden_size, kernel_size, dilation_rate, batch_size>>();
+        RTNeural::torch_helpers::loadConv1D<T>(model_json, "conv.", *conv);
+        result |= testLayer<T>("conv1d", *conv, [&]
+            {
+                auto layer = std::make_unique<RTNeural::Conv1D<T>>(in_size, hidden_size, kernel_size, dilation_rate);
+                RTNeural::torch_helpers::loadConv1D<T>(model_json, "conv.", *layer);
+                return layer;
+            },
+            tolerance);
+    }
+
+    return result;
+}
+} // namespace batched_test
+
+int batchedTest()
+{
+    std::cout << "TESTING BATCHED LAYERS..." << std::endl;
+
+    int result = 0;
+    std::cout << "  float:" << std::endl;
+    result |= batched_test::runTests<float>(1.0e-5f);
+    std::cout << "  double:" << std::endl;
+    result |= batched_test::runTests<double>(1.0e-10);
+
+    if(result == 0)
+        std::cout << "SUCCESS!" << std::endl;
+
+    return result;
+}
@@ -0,0 +1,239 @@
+#pragma once
+
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <RTNeural.h>
+
+namespace block_sparse_test
+{
+constexpr int in_size = 2;
+constexpr int hidden_size = 16;
+constexpr int prune_block = 8;
+constexpr int num_frames = 1000;
+
+/**
+ * Returns a json array of random weights with dimensions [num_in][num_out],
+ * where each block of `prune_block` consecutive outputs of an input is
+ * kept with probability `density`, and otherwise pruned to zero.
+ */
+nlohmann::json prunedWeights(std::default_random_engine& generator, int num_in, int num_out, double density)
+{
+    std::uniform_real_distribution<double> distribution(-0.5, 0.5);
+    std::uniform_real_distribution<double> keep(0.0, 1.0);
+
+    std::vector<std::vector<double>> weights((size_t)num_in, std::vector<double>((size_t)num_out, 0.0));
+    for(int i = 0; i < num_in; ++i)
+    {
+        for(int kb = 0; kb < num_out; kb += prune_block)
+        {
+            if(keep(generator) >= density)
+                continue;
+
+            for(int k = kb; k < std::min(kb + prune_block, num_out); ++k)
+                weights[(size_t)i][(size_t)k] = distribution(generator);
+        }
+    }
+
+    return weights;
+}
+
+/** dense(2 -> 16, tanh) -> lstm(16) -> gru(16) -> dense(16 -> 1), with all but the first layer pruned. */
+nlohmann::json makeModelJson(double density)
+{
+    std::default_random_engine generator(2468);
+
+    nlohmann::json dense_in;
+    dense_in["type"] = "dense";
+    dense_in["activation"] = "tanh";
+    dense_in["shape"] = { nullptr, nullptr, hidden_size };
+    dense_in["weights"] = { prunedWeights(generator, in_size, hidden_size, 1.0), prunedWeights(generator, 1, hidden_size, 1.0)[0] };
+
+    nlohmann::json lstm;
+    lstm["type"] = "lstm";
+    lstm["shape"] = { nullptr, nullptr, hidden_size };
+    lstm["weights"] = { prunedWeights(generator, hidden_size, 4 * hidden_size, 1.0),
+        prunedWeights(generator, hidden_size, 4 * hidden_size, density),
+        prunedWeights(generator, 1, 4 * hidden_size, 1.0)[0] };
+
+    nlohmann::json gru;
+    gru["type"] = "gru";
+    gru["shape"] = { nullptr, nullptr, hidden_size };
+    gru["weights"] = { prunedWeights(generator, hidden_size, 3 * hidden_size, 1.0),
+        prunedWeights(generator, hidden_size, 3 * hidden_size, density),
+        prunedWeights(generator, 2, 3 * hidden_size, 1.0) };
+
+    nlohmann::json dense_out;
+    dense_out["type"] = "dense";
+    dense_out["activation"] = "";
+    dense_out["shape"] = { nullptr, nullptr, 1 };
+    dense_out["weights"] = { prunedWeights(generator, hidden_size, 1, density), prunedWeights(generator, 1, 1, 1.0)[0] };
+
+    nlohmann::json model_json;
+    model_json["in_shape"] = { nullptr, nullptr, in_size };
+    model_json["layers"] = { dense_in, lstm, gru, dense_out };
+    return model_json;
+}
+
+template <typename T>
+std::vector<T> runModel(RTNeural::Model<T>& model)
+{
+    std::default_random_engine generator(1357);
+    std::uniform_real_distribution<T> distribution((T)-1, (T)1);
+
+    model.reset();
+    std::vector<T> outputs((size_t)num_frames);
+    for(auto& y : outputs)
+    {
+        T frame alignas(RTNEURAL_DEFAULT_ALIGNMENT)[in_size];
+        for(auto& x : frame)
+            x = distribution(generator);
+        y = model.forward(frame);
+    }
+    return outputs;
+}
+
+template <typename T>
+int compareOutputs(const std::vector<T>& test, const std::vector<T>& expected, T tolerance)
+{
+    T max_error = (T)0;
+    for(size_t n = 0; n < expected.size(); ++n)
+        max_error = std::max(max_error, std::abs(test[n] - expected[n]));
+
+    if(max_error > tolerance)
+    {
+        std::cout << "        FAIL! Maximum error: " << max_error << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
+
+/** Checks the block-sparse product against a dense reference, for every block size. */
+template <typename T>
+int testMatrix(T tolerance)
+{
+    std::cout << "    block-sparse matrix" << std::endl;
+
+    // the row count is not a multiple of any block size
+    constexpr int rows = 13;
+    constexpr int cols = 7;
+    std::default_random_engine generator(9753);
+    std::uniform_real_distribution<T> distribution((T)-1, (T)1);
+    std::vector<T> weights(rows * cols, (T)0);
+    for(int k = 0; k < cols; k += 2)
+        for(int i = 0; i < rows; ++i)
+            weights[(size_t)(i * cols + k)] = distribution(generator);
+    const auto weight = [&weights](int i, int k)
+    { return weights[(size_t)(i * cols + k)]; };
+
+    std::vector<T> in(cols);
+    for(auto& x : in)
+        x = distribution(generator);
+
+    std::vector<T> expected(rows, (T)0);
+    for(int i = 0; i < rows; ++i)
+        for(int k = 0; k < cols; ++k)
+            expected[(size_t)i] += weight(i, k) * in[(size_t)k];
+
+    int result = 0;
+    for(int block_rows : { 1, 2, 4, 8, 16 })
+    {
+        RTNeural::BlockSparseMatrix<T> matrix(block_rows);
+        if(std::abs(matrix.getDensity(rows, cols, weight) - (T)4 / (T)7) > tolerance)
+        {
+            std::cout << "        FAIL! Wrong density for block size " << block_rows << std::endl;
+            return 1;
+        }
+
+        if(matrix.setWeights(rows, cols, (T)0.5, weight) || !matrix.isEmpty())
+        {
+            std::cout << "        FAIL! Matrix should be too dense for block size " << block_rows << std::endl;
+            return 1;
+        }
+
+        if(!matrix.setWeights(rows, cols, (T)0.6, weight))
+        {
+            std::cout << "        FAIL! Unable to store matrix for block size " << block_rows << std::endl;
+            return 1;
+        }
+
+        std::vector<T> out(rows, (T)0);
+        matrix.multiply(in.data(), out.data());
+        result |= compareOutputs(out, expected, tolerance);
+    }
+
+    return result;
+}
+
+template <typename T>
+int testModel(T tolerance)
+{
+    std::cout << "    pruned model" << std::endl;
+
+    const auto model_json = makeModelJson(0.2);
+    auto model = RTNeural::json_parser::parseJson<T>(model_json);
+
+    auto* dense_in = dynamic_cast<RTNeural::Dense<T>*>(model->layers[0]);
+    auto* lstm = dynamic_cast<RTNeural::LSTMLayer<T>*>(model->layers[2]);
+    auto* gru = dynamic_cast<RTNeural::GRULayer<T>*>(model->layers[3]);
+    auto* dense_out = dynamic_cast<RTNeural::Dense<T>*>(model->layers[4]);
+    if(dense_in == nullptr || lstm == nullptr || gru == nullptr || dense_out == nullptr)
+    {
+        std::cout << "        FAIL! Unexpected model layers" << std::endl;
+        return 1;
+    }
+
+    if(dense_in->hasSparseWeights() || !lstm->hasSparseWeights() || !gru->hasSparseWeights() || !dense_out->hasSparseWeights())
+    {
+        std::cout << "        FAIL! Expected only the pruned layers to use block-sparse weights" << std::endl;
+        return 1;
+    }
+
+    const auto sparse_outputs = runModel<T>(*model);
+
+    lstm->useSparseWeights((T)0);
+    gru->useSparseWeights((T)0);
+    dense_out->useSparseWeights((T)0);
+    if(lstm->hasSparseWeights() || gru->hasSparseWeights() || dense_out->hasSparseWeights())
+    {
+        std::cout << "        FAIL! Expected the layers to go back to dense weights" << std::endl;
+        return 1;
+    }
+
+    int result = compareOutputs(sparse_outputs, runModel<T>(*model), tolerance);
+
+    // setting weights that are too dense goes back to the dense kernel
+    dense_out->useSparseWeights((T)0.5);
+    dense_out->setWeights(std::vector<std::vector<T>>(1, std::vector<T>(hidden_size, (T)0.1)));
+    if(dense_out->hasSparseWeights())
+    {
+        std::cout << "        FAIL! Dense weights should not be stored as block-sparse" << std::endl;
+        return 1;
+    }
+
+    return result;
+}
+} // namespace block_sparse_test
+
+int blockSparseTest()
+{
+    std::cout << "TESTING BLOCK-SPARSE WEIGHTS..." << std::endl;
+
+    int result = 0;
+#if !RTNEURAL_USE_ACCELERATE
+    std::cout << "  float:" << std::endl;
+    result |= block_sparse_test::testMatrix<float>(1.0e-6f);
+    result |= block_sparse_test::testModel<float>(1.0e-5f);
+    std::cout << "  double:" << std::endl;
+    result |= block_sparse_test::testMatrix<double>(1.0e-12);
+    result |= block_sparse_test::testModel<double>(1.0e-12);
+#else
+    std::cout << "  Block-sparse weights are not supported by the Accelerate backend" << std::endl;
+#endif
+
+    if(result == 0)
+        std::cout << "SUCCESS!" << std::endl;
+
+    return result;
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <iostream>
+#include <random>
+#include <RTNeural.h>
+
+namespace conv1d_block_test
+{
+template <typename T>
+void randomiseConv1D(RTNeural::Conv1D<T>& conv, std::default_random_engine& generator)
+{
+    std::uniform_real_distribution<double> distribution(-1.0, 1.0);
+
+    std::vector<std::vector<std::vector<T>>> weights((size_t)conv.out_size,
+        std::vector<std::vector<T>>((size_t)conv.in_size, std::vector<T>((size_t)conv.getKernelSize())));
+    for(auto& w_out : weights)
+        for(auto& w_in : w_out)
+            for(auto& w : w_in)
+                w = (T)distribution(generator);
+    conv.setWeights(weights);
+
+    std::vector<T> bias((size_t)conv.out_size);
+    for(auto& b : bias)
+        b = (T)distribution(generator);
+    conv.setBias(bias);
+}
+
+/** Checks that forwardBlock() gives exactly the same outputs as calling forward() for every frame. */
+template <typename T>
+int testBlockMatchesStreaming(int in_size, int out_size, int kernel_size, int dilation)
+{
+    std::cout << "    " << in_size << "x" << out_size << ", kernel: " << kernel_size << ", dilation: " << dilation << std::endl;
+
+    std::default_random_engine generator;
+    RTNeural::Conv1D<T> streaming_conv(in_size, out_size, kernel_size, dilation);
+    randomiseConv1D(streaming_conv, generator);
+    streaming_conv.reset();
+
+    RTNeural::Conv1D<T> block_conv(in_size, out_size, kernel_size, dilation);
+    std::default_random_engine block_generator;
+    randomiseConv1D(block_conv, block_generator);
+    block_conv.reset();
+
+    static constexpr int num_samples = 3000;
+    std::uniform_real_distribution<double> distribution(-1.0, 1.0);
+    std::vector<T> input((size_t)(num_samples * in_size));
+    for(auto& x : input)
+        x = (T)distribution(generator);
+
+    std::vector<T> streaming_output((size_t)(num_samples * out_size));
+    for(int n = 0; n < num_samples; ++n)
+        streaming_conv.forward(input.data() + n * in_size, streaming_output.data() + n * out_size);
+
+    // mix block sizes shorter and longer than the kernel span, and single-sample calls
+    static const int block_sizes[] = { 1, 7, 64, 65, 1, 200, 3, 1024, 31 };
+    std::vector<T> block_output((size_t)(num_samples * out_size));
+    int n = 0;
+    for(int b = 0; n < num_samples; ++b)
+    {
+        const auto block_size = std::min(block_sizes[b % 9], num_samples - n);
+        if(block_size == 1 && b % 2 == 0)
+            block_conv.forward(input.data() + n * in_size, block_output.data() + n * out_size);
+        else
+            block_conv.forwardBlock(input.data() + n * in_size, block_output.data() + n * out_size, block_size);
+        n += block_size;
+    }
+
+    for(size_t i = 0; i < streaming_output.size(); ++i)
+    {
+        if(streaming_output[i] != block_output[i])
+        {
+            std::cout << "        FAIL! Block output differs at sample " << i / (size_t)out_size
+                      << ": " << block_output[i] << " != " << streaming_output[i] << std::endl;
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+template <typename T>
+int testConv1DBlock()
+{
+    int result = 0;
+    result |= testBlockMatchesStreaming<T>(1, 1, 1, 1);
+    result |= testBlockMatchesStreaming<T>(1, 8, 5, 1);
+    result |= testBlockMatchesStreaming<T>(4, 1, 3, 2);
+    result |= testBlockMatchesStreaming<T>(8, 8, 3, 1);
+    result |= testBlockMatchesStreaming<T>(3, 5, 4, 7);
+    result |= testBlockMatchesStreaming<T>(16, 12, 2, 100);
+    result |= testBlockMatchesStreaming<T>(32, 32, 3, 16);
+    return result;
+}
+} // namespace conv1d_block_test
+
+int conv1DBlockTest()
+{
+    std::cout << "TESTING CONV1D BLOCK PROCESSING WITH DATA TYPE: FLOAT" << std::endl;
+    int result = conv1d_block_test::testConv1DBlock<float>();
+
+    std::cout << "TESTING CONV1D BLOCK PROCESSING WITH DATA TYPE: DOUBLE" << std::endl;
+    result |= conv1d_block_test::testConv1DBlock<double>();
+
+    if(result == 0)
+        std::cout << "SUCCESS" << std::endl;
+
+    return result;
+}
@@ -0,0 +1,160 @@
+#pragma once
+
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <RTNeural.h>
+
+namespace conv1d_fft_test
+{
+template <typename T>
+std::vector<std::vector<std::vector<T>>> randomWeights(int in_size, int out_size, int kernel_size, std::default_random_engine& generator)
+{
+    std::uniform_real_distribution<double> distribution(-1.0, 1.0);
+
+    std::vector<std::vector<std::vector<T>>> weights((size_t)out_size,
+        std::vector<std::vector<T>>((size_t)in_size, std::vector<T>((size_t)kernel_size)));
+    for(auto& w_out : weights)
+        for(auto& w_in : w_out)
+            for(auto& w : w_in)
+                w = (T)(distribution(generator) / std::sqrt((double)(kernel_size * in_size)));
+    return weights;
+}
+
+/** Runs both layers over the same random input, and compares the outputs. */
+template <typename T>
+int compareLayers(RTNeural::Layer<T>& direct, RTNeural::Layer<T>& fft, int num_samples, T tolerance)
+{
+    std::default_random_engine generator(1234);
+    std::uniform_real_distribution<double> distribution(-1.0, 1.0);
+
+    direct.reset();
+    fft.reset();
+
+    std::vector<T> input((size_t)direct.in_size);
+    std::vector<T> direct_out((size_t)direct.out_size);
+    std::vector<T> fft_out((size_t)fft.out_size);
+    for(int n = 0; n < num_samples; ++n)
+    {
+        for(auto& x : input)
+            x = (T)distribution(generator);
+
+        direct.forward(input.data(), direct_out.data());
+        fft.forward(input.data(), fft_out.data());
+
+        for(size_t i = 0; i < direct_out.size(); ++i)
+        {
+            if(std::abs(direct_out[i] - fft_out[i]) > tolerance)
+            {
+                std::cout << "        FAIL! FFT output differs at sample " << n << ": "
+                          << fft_out[i] << " != " << direct_out[i] << std::endl;
+                return 1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+template <typename T>
+int testFFTMatchesDirect(int in_size, int out_size, int kernel_size, int dilation, int partition_size, T tolerance)
+{
+    RTNeural::FFTConv1D<T> fft_conv(in_size, out_size, kernel_size, dilation, partition_size);
+    std::cout << "    " << in_size << "x" << out_size << ", kernel: " << kernel_size << ", dilation: " << dilation
+              << ", partition: " << fft_conv.getPartitionSize() << " (" << fft_conv.getNumFFTPartitions() << " FFT partitions)" << std::endl;
+
+    std::default_random_engine generator;
+    const auto weights = randomWeights<T>(in_size, out_size, kernel_size, generator);
+    std::vector<T> bias((size_t)out_size);
+    for(size_t i = 0; i < bias.size(); ++i)
+        bias[i] = (T)0.1 * (T)i;
+
+    RTNeural::Conv1D<T> direct_conv(in_size, out_size, kernel_size, dilation);
+    direct_conv.setWeights(weights);
+    direct_conv.setBias(bias);
+    fft_conv.setWeights(weights);
+    fft_conv.setBias(bias);
+
+    const auto span = (kernel_size - 1) * dilation + 1;
+    return compareLayers<T>(direct_conv, fft_conv, 3 * span + 100, tolerance);
+}
+
+/** Checks that parseJson() loads long conv1d kernels as FFTConv1D layers. */
+template <typename T>
+int testJsonLoading(T tolerance)
+{
+    constexpr int in_size = 2;
+    constexpr int out_size = 3;
+    constexpr int kernel_size = RTNEURAL_FFT_CONV1D_THRESHOLD > 0 ? RTNEURAL_FFT_CONV1D_THRESHOLD : 128;
+    constexpr int dilation = 2;
+    std::cout << "    loading " << in_size << "x" << out_size << ", kernel: " << kernel_size << " from json" << std::endl;
+
+    // json weights are [kernel_size][in_size][out_size]
+    std::default_random_engine generator;
+    std::uniform_real_distribution<double> distribution(-0.1, 0.1);
+    nlohmann::json kernel = nlohmann::json::array();
+    for(int k = 0; k < kernel_size; ++k)
+    {
+        nlohmann::json k_weights = nlohmann::json::array();
+        for(int j = 0; j < in_size; ++j)
+        {
+            nlohmann::json j_weights = nlohmann::json::array();
+            for(int i = 0; i < out_size; ++i)
+                j_weights.push_back(distribution(generator));
+            k_weights.push_back(j_weights);
+        }
+        kernel.push_back(k_weights);
+    }
+
+    nlohmann::json layer;
+    layer["type"] = "conv1d";
+    layer["activation"] = "";
+    layer["shape"] = { nullptr, nullptr, out_size };
+    layer["kernel_size"] = { kernel_size };
+    layer["dilation"] = { dilation };
+    layer["weights"] = { kernel, { 0.1, -0.2, 0.3 } };
+
+    nlohmann::json model_json;
+    model_json["in_shape"] = { nullptr, nullptr, in_size };
+    model_json["layers"] = { layer };
+
+    auto model = RTNeural::json_parser::parseJson<T>(model_json);
+    if(model == nullptr || model->layers.size() != 1 || model->layers[0]->getName() != "conv1d_fft")
+    {
+        std::cout << "        FAIL! Long conv1d kernel was not loaded as conv1d_fft" << std::endl;
+        return 1;
+    }
+
+    auto direct = RTNeural::json_parser::createConv1D<T>(in_size, out_size, kernel_size, dilation, layer["weights"]);
+    return compareLayers<T>(*direct, *model->layers[0], 2000, tolerance);
+}
+
+template <typename T>
+int testConv1DFFT(T tolerance)
+{
+    int result = 0;
+    result |= testFFTMatchesDirect<T>(1, 1, 8, 1, 16, tolerance); // head partition only
+    result |= testFFTMatchesDirect<T>(1, 1, 300, 1, 0, tolerance);
+    result |= testFFTMatchesDirect<T>(1, 1, 257, 1, 2, tolerance);
+    result |= testFFTMatchesDirect<T>(2, 3, 200, 3, 0, tolerance);
+    result |= testFFTMatchesDirect<T>(4, 2, 1000, 1, 64, tolerance);
+    result |= testFFTMatchesDirect<T>(3, 1, 100, 20, 0, tolerance);
+    result |= testFFTMatchesDirect<T>(2, 2, 50, 7, 32, tolerance);
+    result |= testJsonLoading<T>(tolerance);
+    return result;
+}
+} // namespace conv1d_fft_test
+
+int conv1DFFTTest()
+{
+    std::cout << "TESTING CONV1D FFT WITH DATA TYPE: FLOAT" << std::endl;
+    int result = conv1d_fft_test::testConv1DFFT<float>(1.0e-4f);
+
+    std::cout << "TESTING CONV1D FFT WITH DATA TYPE: DOUBLE" << std::endl;
+    result |= conv1d_fft_test::testConv1DFFT<double>(1.0e-10);
+
+    if(result == 0)
+        std::cout << "SUCCESS" << std::endl;
+
+    return result;
+}
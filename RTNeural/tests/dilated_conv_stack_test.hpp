@@ -0,0 +1,191 @@
+#pragma once
+
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <RTNeural.h>
+
+namespace dilated_conv_stack_test
+{
+using Weights3D = std::vector<std::vector<std::vector<double>>>;
+
+Weights3D randomConvWeights(int out_size, int in_size, int kernel_size, std::default_random_engine& generator)
+{
+    std::uniform_real_distribution<double> distribution(-0.5, 0.5);
+    Weights3D weights((size_t)out_size, std::vector<std::vector<double>>((size_t)in_size, std::vector<double>((size_t)kernel_size)));
+    for(auto& w_out : weights)
+        for(auto& w_in : w_out)
+            for(auto& w : w_in)
+                w = distribution(generator);
+    return weights;
+}
+
+std::vector<double> randomBias(int size, std::default_random_engine& generator)
+{
+    std::uniform_real_distribution<double> distribution(-0.1, 0.1);
+    std::vector<double> bias((size_t)size);
+    for(auto& b : bias)
+        b = distribution(generator);
+    return bias;
+}
+
+/** Creates a PedalNetRT-style WaveNet state_dict with random weights. */
+nlohmann::json createStateDict(int in_size, int out_size, int channels, int kernel_size, int num_layers)
+{
+    std::default_random_engine generator;
+    nlohmann::json state_dict;
+    state_dict["input_layer.weight"] = randomConvWeights(channels, in_size, 1, generator);
+    state_dict["input_layer.bias"] = randomBias(channels, generator);
+
+    for(int l = 0; l < num_layers; ++l)
+    {
+        const auto idx = std::to_string(l);
+        state_dict["hidden." + idx + ".weight"] = randomConvWeights(2 * channels, channels, kernel_size, generator);
+        state_dict["hidden." + idx + ".bias"] = randomBias(2 * channels, generator);
+        state_dict["residuals." + idx + ".weight"] = randomConvWeights(channels, channels, 1, generator);
+        state_dict["residuals." + idx + ".bias"] = randomBias(channels, generator);
+    }
+
+    state_dict["linear_mix.weight"] = randomConvWeights(out_size, channels * num_layers, 1, generator);
+    state_dict["linear_mix.bias"] = randomBias(out_size, generator);
+    return state_dict;
+}
+
+/**
+ * Straightforward WaveNet implementation using the PyTorch weight layout,
+ * that keeps the full input history of every layer.
+ */
+std::vector<std::vector<double>> referenceOutputs(const nlohmann::json& state_dict, const std::vector<std::vector<double>>& inputs,
+    int channels, int kernel_size, const std::vector<int>& dilations)
+{
+    const Weights3D input_w = state_dict.at("input_layer.weight");
+    const std::vector<double> input_b = state_dict.at("input_layer.bias");
+    const Weights3D mix_w = state_dict.at("linear_mix.weight");
+    const std::vector<double> mix_b = state_dict.at("linear_mix.bias");
+
+    const auto num_layers = dilations.size();
+    std::vector<std::vector<std::vector<double>>> histories(num_layers);
+    std::vector<std::vector<double>> outputs;
+
+    for(const auto& input : inputs)
+    {
+        std::vector<double> x(input_b);
+        for(int o = 0; o < channels; ++o)
+            for(size_t c = 0; c < input.size(); ++c)
+                x[(size_t)o] += input_w[(size_t)o][c][0] * input[c];
+
+        std::vector<double> skips;
+        for(size_t l = 0; l < num_layers; ++l)
+        {
+            const Weights3D hidden_w = state_dict.at("hidden." + std::to_string(l) + ".weight");
+            const std::vector<double> hidden_b = state_dict.at("hidden." + std::to_string(l) + ".bias");
+            const Weights3D residual_w = state_dict.at("residuals." + std::to_string(l) + ".weight");
+            const std::vector<double> residual_b = state_dict.at("residuals." + std::to_string(l) + ".bias");
+
+            auto& history = histories[l];
+            history.push_back(x);
+            const auto t = (int)history.size() - 1;
+
+            // PyTorch Conv1d: the last kernel tap is applied to the newest input
+            std::vector<double> a(hidden_b);
+            for(int o = 0; o < 2 * channels; ++o)
+                for(int c = 0; c < channels; ++c)
+                    for(int k = 0; k < kernel_size; ++k)
+                    {
+                        const auto idx = t - (kernel_size - 1 - k) * dilations[l];
+                        if(idx >= 0)
+                            a[(size_t)o] += hidden_w[(size_t)o][(size_t)c][(size_t)k] * history[(size_t)idx][(size_t)c];
+                    }
+
+            std::vector<double> z((size_t)channels);
+            for(int c = 0; c < channels; ++c)
+                z[(size_t)c] = std::tanh(a[(size_t)c]) / (1.0 + std::exp(-a[(size_t)(channels + c)]));
+            skips.insert(skips.end(), z.begin(), z.end());
+
+            for(int o = 0; o < channels; ++o)
+            {
+                x[(size_t)o] += residual_b[(size_t)o];
+                for(int c = 0; c < channels; ++c)
+                    x[(size_t)o] += residual_w[(size_t)o][(size_t)c][0] * z[(size_t)c];
+            }
+        }
+
+        std::vector<double> y(mix_b);
+        for(size_t o = 0; o < y.size(); ++o)
+            for(size_t c = 0; c < skips.size(); ++c)
+                y[o] += mix_w[o][c][0] * skips[c];
+        outputs.push_back(y);
+    }
+
+    return outputs;
+}
+
+template <typename T, int in_size, int out_size, int channels, int kernel_size, int... dilations>
+int testDilatedConvStack(T tolerance)
+{
+    using StackType = RTNeural::DilatedConvStackT<T, in_size, out_size, channels, kernel_size, dilations...>;
+    std::cout << "    " << in_size << "x" << out_size << ", channels: " << channels << ", kernel: " << kernel_size
+              << ", layers: " << StackType::getNumLayers() << std::endl;
+
+    const auto state_dict = createStateDict(in_size, out_size, channels, kernel_size, StackType::getNumLayers());
+
+    auto model = std::make_unique<RTNeural::ModelT<T, in_size, out_size, StackType>>();
+    RTNeural::torch_helpers::loadDilatedConvStack<T>(state_dict, "", model->template get<0>());
+    model->reset();
+
+    std::default_random_engine generator(4321);
+    std::uniform_real_distribution<double> distribution(-1.0, 1.0);
+    std::vector<std::vector<double>> inputs(2000, std::vector<double>((size_t)in_size));
+    for(auto& input : inputs)
+        for(auto& x : input)
+            x = distribution(generator);
+
+    const auto expected = referenceOutputs(state_dict, inputs, channels, kernel_size, { dilations... });
+
+    for(size_t n = 0; n < inputs.size(); ++n)
+    {
+        T input alignas(RTNEURAL_DEFAULT_ALIGNMENT)[in_size];
+        for(int c = 0; c < in_size; ++c)
+            input[c] = (T)inputs[n][(size_t)c];
+
+        model->forward(input);
+        for(int o = 0; o < out_size; ++o)
+        {
+            const auto err = std::abs((double)model->getOutputs()[o] - expected[n][(size_t)o]);
+            if(err > (double)tolerance)
+            {
+                std::cout << "        FAIL! Output differs at sample " << n << ": "
+                          << model->getOutputs()[o] << " != " << expected[n][(size_t)o] << std::endl;
+                return 1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+template <typename T>
+int testDilatedConvStacks(T tolerance)
+{
+    int result = 0;
+    result |= testDilatedConvStack<T, 1, 1, 8, 3, 1, 2, 4, 8, 16, 32>(tolerance);
+    result |= testDilatedConvStack<T, 2, 3, 4, 2, 1, 2, 4, 8, 1, 2, 4, 8>(tolerance);
+    result |= testDilatedConvStack<T, 1, 2, 5, 1, 1>(tolerance);
+    result |= testDilatedConvStack<T, 3, 1, 16, 5, 3, 27>(tolerance);
+    return result;
+}
+} // namespace dilated_conv_stack_test
+
+int dilatedConvStackTest()
+{
+    std::cout << "TESTING DILATED CONV STACK WITH DATA TYPE: FLOAT" << std::endl;
+    int result = dilated_conv_stack_test::testDilatedConvStacks<float>(1.0e-4f);
+
+    std::cout << "TESTING DILATED CONV STACK WITH DATA TYPE: DOUBLE" << std::endl;
+    result |= dilated_conv_stack_test::testDilatedConvStacks<double>(1.0e-10);
+
+    if(result == 0)
+        std::cout << "SUCCESS" << std::endl;
+
+    return result;
+}
@@ -0,0 +1,265 @@
+#pragma once
+
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <RTNeural.h>
+
+namespace low_rank_test
+{
+constexpr int in_size = 2;
+constexpr int hidden_size = 16;
+constexpr int weights_rank = 3;
+constexpr int num_frames = 1000;
+
+/** Returns a json array of random weights with dimensions [num_in][num_out]. */
+nlohmann::json randomWeights(std::default_random_engine& generator, int num_in, int num_out)
+{
+    std::uniform_real_distribution<double> distribution(-0.5, 0.5);
+    std::vector<std::vector<double>> weights((size_t)num_in, std::vector<double>((size_t)num_out));
+    for(auto& row : weights)
+        for(auto& w : row)
+            w = distribution(generator);
+
+    return weights;
+}
+
+/** Returns a json array of random weights with dimensions [num_in][num_out], and the given rank. */
+nlohmann::json lowRankWeights(std::default_random_engine& generator, int num_in, int num_out, int rank)
+{
+    const auto left = randomWeights(generator, num_in, rank);
+    const auto right = randomWeights(generator, rank, num_out);
+
+    std::vector<std::vector<double>> weights((size_t)num_in, std::vector<double>((size_t)num_out, 0.0));
+    for(int i = 0; i < num_in; ++i)
+        for(int k = 0; k < num_out; ++k)
+            for(int j = 0; j < rank; ++j)
+                weights[(size_t)i][(size_t)k] += left[(size_t)i][(size_t)j].get<double>() * right[(size_t)j][(size_t)k].get<double>();
+
+    return weights;
+}
+
+/** dense(2 -> 16, tanh) -> lstm(16) -> gru(16) -> dense(16 -> 1), with rank-3 recurrent weights. */
+nlohmann::json makeModelJson()
+{
+    std::default_random_engine generator(8642);
+
+    nlohmann::json dense_in;
+    dense_in["type"] = "dense";
+    dense_in["activation"] = "tanh";
+    dense_in["shape"] = { nullptr, nullptr, hidden_size };
+    dense_in["weights"] = { randomWeights(generator, in_size, hidden_size), randomWeights(generator, 1, hidden_size)[0] };
+
+    nlohmann::json lstm;
+    lstm["type"] = "lstm";
+    lstm["shape"] = { nullptr, nullptr, hidden_size };
+    lstm["weights"] = { randomWeights(generator, hidden_size, 4 * hidden_size),
+        lowRankWeights(generator, hidden_size, 4 * hidden_size, weights_rank),
+        randomWeights(generator, 1, 4 * hidden_size)[0] };
+
+    nlohmann::json gru;
+    gru["type"] = "gru";
+    gru["shape"] = { nullptr, nullptr, hidden_size };
+    gru["weights"] = { randomWeights(generator, hidden_size, 3 * hidden_size),
+        lowRankWeights(generator, hidden_size, 3 * hidden_size, weights_rank),
+        randomWeights(generator, 2, 3 * hidden_size) };
+
+    nlohmann::json dense_out;
+    dense_out["type"] = "dense";
+    dense_out["activation"] = "";
+    dense_out["shape"] = { nullptr, nullptr, 1 };
+    dense_out["weights"] = { randomWeights(generator, hidden_size, 1), randomWeights(generator, 1, 1)[0] };
+
+    nlohmann::json model_json;
+    model_json["in_shape"] = { nullptr, nullptr, in_size };
+    model_json["layers"] = { dense_in, lstm, gru, dense_out };
+    return model_json;
+}
+
+template <typename T, typename ModelType>
+std::vector<T> runModel(ModelType& model)
+{
+    std::default_random_engine generator(1357);
+    std::uniform_real_distribution<T> distribution((T)-1, (T)1);
+
+    model.reset();
+    std::vector<T> outputs((size_t)num_frames);
+    for(auto& y : outputs)
+    {
+        T frame alignas(RTNEURAL_DEFAULT_ALIGNMENT)[in_size];
+        for(auto& x : frame)
+            x = distribution(generator);
+        y = model.forward(frame);
+    }
+    return outputs;
+}
+
+template <typename T>
+int compareOutputs(const std::vector<T>& test, const std::vector<T>& expected, T tolerance)
+{
+    T max_error = (T)0;
+    for(size_t n = 0; n < expected.size(); ++n)
+        max_error = std::max(max_error, std::abs(test[n] - expected[n]));
+
+    if(max_error > tolerance)
+    {
+        std::cout << "        FAIL! Maximum error: " << max_error << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
+
+/** Checks the low-rank factorization and product against a dense reference. */
+template <typename T>
+int testMatrix(T tolerance)
+{
+    std::cout << "    low-rank matrix" << std::endl;
+
+    constexpr int rows = 12;
+    constexpr int cols = 8;
+    std::default_random_engine generator(9753);
+    const auto weights = lowRankWeights(generator, rows, cols, weights_rank);
+    const auto weight = [&weights](int i, int k)
+    { return weights[(size_t)i][(size_t)k].get<T>(); };
+
+    std::uniform_real_distribution<T> distribution((T)-1, (T)1);
+    std::vector<T> in(cols);
+    for(auto& x : in)
+        x = distribution(generator);
+
+    std::vector<T> expected(rows, (T)0);
+    for(int i = 0; i < rows; ++i)
+        for(int k = 0; k < cols; ++k)
+            expected[(size_t)i] += weight(i, k) * in[(size_t)k];
+
+    const auto singular_values = RTNeural::LowRankMatrix<T>::getSingularValues(rows, cols, weight);
+    if(singular_values.size() != (size_t)cols || RTNeural::LowRankMatrix<T>::getRankForTolerance(singular_values, tolerance) != weights_rank)
+    {
+        std::cout << "        FAIL! Expected a rank-" << weights_rank << " matrix" << std::endl;
+        return 1;
+    }
+
+    if(RTNeural::LowRankMatrix<T>::getError(singular_values, weights_rank - 1) < (T)0.01)
+    {
+        std::cout << "        FAIL! Dropping a non-zero singular value should be reported as an error" << std::endl;
+        return 1;
+    }
+
+    RTNeural::LowRankMatrix<T> matrix;
+    if(!matrix.setWeightsForTolerance(rows, cols, tolerance, weight) || matrix.getRank() != weights_rank)
+    {
+        std::cout << "        FAIL! Unable to factorize matrix" << std::endl;
+        return 1;
+    }
+
+    std::vector<T> out(rows, (T)0);
+    matrix.multiply(in.data(), out.data());
+    int result = compareOutputs(out, expected, tolerance);
+
+    // the full rank is never cheaper than the matrix itself
+    const auto full_rank_weights = randomWeights(generator, rows, cols);
+    if(matrix.setWeightsForTolerance(rows, cols, tolerance, [&full_rank_weights](int i, int k)
+           { return full_rank_weights[(size_t)i][(size_t)k].get<T>(); })
+        || !matrix.isEmpty())
+    {
+        std::cout << "        FAIL! A full-rank matrix should not be factorized" << std::endl;
+        return 1;
+    }
+
+    // the static matrix at full rank is exact
+    RTNeural::LowRankMatrixT<T, rows, cols, cols> static_matrix;
+    if(static_matrix.setWeights(weight) > tolerance)
+    {
+        std::cout << "        FAIL! Expected an exact full-rank factorization" << std::endl;
+        return 1;
+    }
+
+    std::fill(out.begin(), out.end(), (T)0);
+    static_matrix.multiply(in.data(), out.data());
+    result |= compareOutputs(out, expected, tolerance);
+
+    return result;
+}
+
+template <typename T>
+int testModel(T tolerance)
+{
+    std::cout << "    dynamic model" << std::endl;
+
+    const auto model_json = makeModelJson();
+    auto model = RTNeural::json_parser::parseJson<T>(model_json);
+    const auto expected = runModel<T>(*model);
+
+    auto* lstm = dynamic_cast<RTNeural::LSTMLayer<T>*>(model->layers[2]);
+    auto* gru = dynamic_cast<RTNeural::GRULayer<T>*>(model->layers[3]);
+    if(lstm == nullptr || gru == nullptr)
+    {
+        std::cout << "        FAIL! Unexpected model layers" << std::endl;
+        return 1;
+    }
+
+    if(!lstm->useLowRankWeights(tolerance) || !gru->useLowRankWeights(tolerance)
+        || lstm->getLowRank() != weights_rank || gru->getLowRank() != weights_rank)
+    {
+        std::cout << "        FAIL! Expected rank-" << weights_rank << " recurrent weights" << std::endl;
+        return 1;
+    }
+
+    int result = compareOutputs(runModel<T>(*model), expected, tolerance);
+
+    lstm->useLowRankWeights((T)0);
+    gru->useLowRankWeights((T)0);
+    if(lstm->getLowRank() != 0 || gru->getLowRank() != 0)
+    {
+        std::cout << "        FAIL! Expected the layers to go back to full-rank weights" << std::endl;
+        return 1;
+    }
+
+    result |= compareOutputs(runModel<T>(*model), expected, tolerance);
+
+#if MODELT_AVAILABLE
+    std::cout << "    static model" << std::endl;
+    RTNeural::ModelT<T, in_size, 1,
+        RTNeural::DenseT<T, in_size, hidden_size>,
+        RTNeural::TanhActivationT<T, hidden_size>,
+        RTNeural::LSTMLayerT<T, hidden_size, hidden_size, RTNeural::SampleRateCorrectionMode::None, weights_rank>,
+        RTNeural::GRULayerT<T, hidden_size, hidden_size, RTNeural::SampleRateCorrectionMode::None, weights_rank>,
+        RTNeural::DenseT<T, hidden_size, 1>>
+        model_t;
+    model_t.parseJson(model_json);
+
+    if(model_t.template get<2>().getLowRankError() > tolerance || model_t.template get<3>().getLowRankError() > tolerance)
+    {
+        std::cout << "        FAIL! Expected an exact rank-" << weights_rank << " factorization" << std::endl;
+        return 1;
+    }
+
+    result |= compareOutputs(runModel<T>(model_t), expected, tolerance);
+#endif
+
+    return result;
+}
+} // namespace low_rank_test
+
+int lowRankTest()
+{
+    std::cout << "TESTING LOW-RANK WEIGHTS..." << std::endl;
+
+    int result = 0;
+#if !RTNEURAL_USE_ACCELERATE
+    std::cout << "  float:" << std::endl;
+    result |= low_rank_test::testMatrix<float>(1.0e-4f);
+    result |= low_rank_test::testModel<float>(1.0e-4f);
+    std::cout << "  double:" << std::endl;
+    result |= low_rank_test::testMatrix<double>(1.0e-10);
+    result |= low_rank_test::testModel<double>(1.0e-10);
+#else
+    std::cout << "  Low-rank weights are not supported by the Accelerate backend" << std::endl;
+#endif
+
+    if(result == 0)
+        std::cout << "SUCCESS!" << std::endl;
+
+    return result;
+}
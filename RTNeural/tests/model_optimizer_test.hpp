@@ -0,0 +1,217 @@
+#pragma once
+
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <RTNeural.h>
+
+namespace model_optimizer_test
+{
+constexpr int in_size = 2;
+constexpr int num_frames = 1000;
+
+/** Returns a json array of random weights with the given dimensions. */
+nlohmann::json randomWeights(std::default_random_engine& generator, std::initializer_list<int> dims)
+{
+    std::uniform_real_distribution<double> distribution(-0.5, 0.5);
+    nlohmann::json weights = nlohmann::json::array();
+    if(dims.size() == 1)
+    {
+        for(int i = 0; i < *dims.begin(); ++i)
+            weights.push_back(distribution(generator));
+        return weights;
+    }
+
+    for(int i = 0; i < *dims.begin(); ++i)
+    {
+        if(dims.size() == 2)
+            weights.push_back(randomWeights(generator, { *(dims.begin() + 1) }));
+        else
+            weights.push_back(randomWeights(generator, { *(dims.begin() + 1), *(dims.begin() + 2) }));
+    }
+    return weights;
+}
+
+nlohmann::json makeBatchNorm(std::default_random_engine& generator, int size, bool affine)
+{
+    std::uniform_real_distribution<double> distribution(0.5, 2.0);
+    nlohmann::json running_var = nlohmann::json::array();
+    for(int i = 0; i < size; ++i)
+        running_var.push_back(distribution(generator));
+
+    nlohmann::json layer;
+    layer["type"] = "batchnorm";
+    layer["shape"] = { nullptr, nullptr, size };
+    layer["epsilon"] = 0.001;
+    if(affine)
+        layer["weights"] = { randomWeights(generator, { size }), randomWeights(generator, { size }), randomWeights(generator, { size }), running_var };
+    else
+        layer["weights"] = { randomWeights(generator, { size }), running_var };
+    return layer;
+}
+
+nlohmann::json makeActivation(const std::string& type, int size)
+{
+    nlohmann::json layer;
+    layer["type"] = "activation";
+    layer["activation"] = type;
+    layer["shape"] = { nullptr, nullptr, size };
+    layer["weights"] = nlohmann::json::array();
+    return layer;
+}
+
+/**
+ * dense(2 -> 8) -> batchnorm -> tanh -> conv1d(8 -> 4) -> batchnorm (non-affine) -> relu
+ * -> relu -> batchnorm (identity) -> dense(4 -> 1)
+ */
+nlohmann::json makeModelJson()
+{
+    std::default_random_engine generator(4321);
+
+    nlohmann::json dense_in;
+    dense_in["type"] = "dense";
+    dense_in["activation"] = "";
+    dense_in["shape"] = { nullptr, nullptr, 8 };
+    dense_in["weights"] = { randomWeights(generator, { in_size, 8 }), randomWeights(generator, { 8 }) };
+
+    nlohmann::json conv;
+    conv["type"] = "conv1d";
+    conv["activation"] = "";
+    conv["shape"] = { nullptr, nullptr, 4 };
+    conv["kernel_size"] = { 3 };
+    conv["dilation"] = { 2 };
+    conv["weights"] = { randomWeights(generator, { 3, 8, 4 }), randomWeights(generator, { 4 }) };
+
+    nlohmann::json identity_batch_norm;
+    identity_batch_norm["type"] = "batchnorm";
+    identity_batch_norm["shape"] = { nullptr, nullptr, 4 };
+    identity_batch_norm["epsilon"] = 0.0;
+    identity_batch_norm["weights"] = { { 1.0, 1.0, 1.0, 1.0 }, { 0.0, 0.0, 0.0, 0.0 }, { 0.0, 0.0, 0.0, 0.0 }, { 1.0, 1.0, 1.0, 1.0 } };
+
+    nlohmann::json dense_out;
+    dense_out["type"] = "dense";
+    dense_out["activation"] = "";
+    dense_out["shape"] = { nullptr, nullptr, 1 };
+    dense_out["weights"] = { randomWeights(generator, { 4, 1 }), randomWeights(generator, { 1 }) };
+
+    nlohmann::json model_json;
+    model_json["in_shape"] = { nullptr, nullptr, in_size };
+    model_json["layers"] = {
+        dense_in,
+        makeBatchNorm(generator, 8, true),
+        makeActivation("tanh", 8),
+        conv,
+        makeBatchNorm(generator, 4, false),
+        makeActivation("relu", 4),
+        makeActivation("relu", 4),
+        identity_batch_norm,
+        dense_out,
+    };
+    return model_json;
+}
+
+template <typename T, typename ModelType>
+std::vector<T> runModel(ModelType& model)
+{
+    std::default_random_engine generator(1234);
+    std::uniform_real_distribution<T> distribution((T)-1, (T)1);
+
+    model.reset();
+    std::vector<T> outputs((size_t)num_frames);
+    for(auto& y : outputs)
+    {
+        T frame alignas(RTNEURAL_DEFAULT_ALIGNMENT)[in_size];
+        for(auto& x : frame)
+            x = distribution(generator);
+        y = model.forward(frame);
+    }
+    return outputs;
+}
+
+template <typename T>
+int compareOutputs(const std::vector<T>& test, const std::vector<T>& expected, T tolerance)
+{
+    T max_error = (T)0;
+    for(size_t n = 0; n < expected.size(); ++n)
+        max_error = std::max(max_error, std::abs(test[n] - expected[n]));
+
+    if(max_error > tolerance)
+    {
+        std::cout << "        FAIL! Maximum error: " << max_error << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
+
+template <typename T>
+int testModelOptimizer(T tolerance)
+{
+    const auto model_json = makeModelJson();
+    auto model = RTNeural::json_parser::parseJson<T>(model_json);
+    const auto expected = runModel<T>(*model);
+
+    std::cout << "    dynamic model" << std::endl;
+    if(model->optimize() != 4 || model->layers.size() != 5)
+    {
+        std::cout << "        FAIL! Expected the three batch-norms and the second relu to be removed" << std::endl;
+        return 1;
+    }
+
+#if !RTNEURAL_ENABLE_LAYER_TIMING
+    if(model->getNumPlanSteps() != 3)
+    {
+        std::cout << "        FAIL! Expected the dense and conv1d activations to be fused" << std::endl;
+        return 1;
+    }
+#endif
+
+    int result = compareOutputs(runModel<T>(*model), expected, tolerance);
+
+    // a batch-norm that follows an activation can't be folded
+    auto unfoldable_json = model_json;
+    unfoldable_json["layers"][0]["activation"] = "tanh";
+    unfoldable_json["layers"].erase(2);
+    auto unfoldable = RTNeural::json_parser::parseJson<T>(unfoldable_json);
+    const auto unfoldable_expected = runModel<T>(*unfoldable);
+    if(unfoldable->optimize() != 3 || unfoldable->layers[2]->getName() != "batchnorm")
+    {
+        std::cout << "        FAIL! Batch-norm after an activation should not be folded" << std::endl;
+        return 1;
+    }
+    result |= compareOutputs(runModel<T>(*unfoldable), unfoldable_expected, tolerance);
+
+#if MODELT_AVAILABLE
+    std::cout << "    static model" << std::endl;
+    RTNeural::ModelT<T, in_size, 1,
+        RTNeural::DenseT<T, in_size, 8>,
+        RTNeural::TanhActivationT<T, 8>,
+        RTNeural::Conv1DT<T, 8, 4, 3, 2>,
+        RTNeural::ReLuActivationT<T, 4>,
+        RTNeural::ReLuActivationT<T, 4>,
+        RTNeural::BatchNorm1DT<T, 4>,
+        RTNeural::DenseT<T, 4, 1>>
+        model_t;
+    model_t.parseJson(model_json);
+    result |= compareOutputs(runModel<T>(model_t), expected, tolerance);
+#endif
+
+    return result;
+}
+} // namespace model_optimizer_test
+
+int modelOptimizerTest()
+{
+    std::cout << "TESTING MODEL OPTIMIZER..." << std::endl;
+
+    int result = 0;
+    std::cout << "  float:" << std::endl;
+    result |= model_optimizer_test::testModelOptimizer<float>(1.0e-5f);
+    std::cout << "  double:" << std::endl;
+    result |= model_optimizer_test::testModelOptimizer<double>(1.0e-12);
+
+    if(result == 0)
+        std::cout << "SUCCESS!" << std::endl;
+
+    return result;
+}
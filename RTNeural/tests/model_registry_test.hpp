@@ -0,0 +1,156 @@
+#pragma once
+
+#include <RTNeural.h>
+#include "load_csv.hpp"
+
+namespace model_registry_test
+{
+#if MODELT_AVAILABLE
+template <typename T>
+using FullModelType = RTNeural::ModelT<T, 1, 1,
+    RTNeural::DenseT<T, 1, 8>,
+    RTNeural::TanhActivationT<T, 8>,
+    RTNeural::Conv1DT<T, 8, 4, 3, 2>,
+    RTNeural::TanhActivationT<T, 4>,
+    RTNeural::GRULayerT<T, 4, 8>,
+    RTNeural::DenseT<T, 8, 1>>;
+
+template <typename T, int hidden_size>
+using LSTMModelType = RTNeural::ModelT<T, 1, 1, RTNeural::LSTMLayerT<T, 1, hidden_size>, RTNeural::DenseT<T, hidden_size, 1>>;
+
+/** Runs the model handle over the inputs, in blocks of varying size. */
+template <typename T>
+std::vector<T> processHandle(RTNeural::ModelHandle<T>& model, const std::vector<T>& inputs)
+{
+    std::vector<T> outputs(inputs.size(), (T)0);
+    int block_size = 1;
+    for(int n = 0; n < (int)inputs.size(); n += block_size)
+    {
+        block_size = std::min(2 * block_size + 1, (int)inputs.size() - n);
+        model.process(inputs.data() + n, outputs.data() + n, block_size);
+    }
+
+    return outputs;
+}
+
+template <typename T>
+int compareOutputs(const std::vector<T>& outputs, const std::vector<T>& expected, T tolerance)
+{
+    for(size_t n = 0; n < outputs.size(); ++n)
+    {
+        if(std::abs(outputs[n] - expected[n]) > tolerance)
+        {
+            std::cout << "    FAIL! Output differs at sample " << n << ": " << outputs[n] << " != " << expected[n] << std::endl;
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/** Checks that a json model is loaded as the matching static model, or as a dynamic model if nothing matches. */
+template <typename T>
+int testJsonModel(T tolerance)
+{
+    std::ifstream jsonStream("models/full_model.json", std::ifstream::binary);
+    nlohmann::json modelJson;
+    jsonStream >> modelJson;
+
+    std::ifstream pythonX("test_data/dense_x_python.csv");
+    const auto inputs = load_csv::loadFile<T>(pythonX);
+
+    auto refModel = RTNeural::json_parser::parseJson<T>(modelJson);
+    refModel->reset();
+    std::vector<T> expected(inputs.size(), (T)0);
+    for(size_t n = 0; n < inputs.size(); ++n)
+        expected[n] = refModel->forward(&inputs[n]);
+
+    using Registry = RTNeural::ModelRegistry<T, LSTMModelType<T, 16>, FullModelType<T>>;
+    if(Registry::findModel(*refModel) != 1)
+    {
+        std::cout << "    FAIL! Full model did not match the expected architecture" << std::endl;
+        return 1;
+    }
+
+    std::cout << "    static model from json" << std::endl;
+    auto staticModel = Registry::create(modelJson);
+    if(!staticModel->isStatic())
+    {
+        std::cout << "    FAIL! Full model was not loaded as a static model" << std::endl;
+        return 1;
+    }
+
+    int result = compareOutputs(processHandle(*staticModel, inputs), expected, tolerance);
+
+    std::cout << "    dynamic fallback from json" << std::endl;
+    auto dynamicModel = RTNeural::ModelRegistry<T, LSTMModelType<T, 16>>::create(modelJson);
+    if(dynamicModel->isStatic())
+    {
+        std::cout << "    FAIL! Unregistered model was loaded as a static model" << std::endl;
+        return 1;
+    }
+
+    result |= compareOutputs(processHandle(*dynamicModel, inputs), expected, (T)0);
+    return result;
+}
+
+/** Checks loading a PyTorch state dict, by building a dynamic LSTM model first. */
+template <typename T>
+int testTorchModel(T tolerance)
+{
+    std::cout << "    static model from torch state dict" << std::endl;
+    std::ifstream jsonStream("models/lstm_torch.json", std::ifstream::binary);
+    nlohmann::json modelJson;
+    jsonStream >> modelJson;
+
+    const auto hidden_size = (int)modelJson.at("lstm.weight_hh_l0").at(0).size();
+    auto model = std::make_unique<RTNeural::Model<T>>(1);
+    auto lstm = std::make_unique<RTNeural::LSTMLayer<T>>(1, hidden_size);
+    auto dense = std::make_unique<RTNeural::Dense<T>>(hidden_size, 1);
+    RTNeural::torch_helpers::loadLSTM<T>(modelJson, "lstm.", *lstm);
+    RTNeural::torch_helpers::loadDense<T>(modelJson, "dense.", *dense);
+    model->addLayer(lstm.release());
+    model->addLayer(dense.release());
+
+    using Registry = RTNeural::ModelRegistry<T, LSTMModelType<T, 16>, LSTMModelType<T, 8>>;
+    auto handle = Registry::create(std::move(model), [&modelJson](auto& staticModel)
+        {
+            RTNeural::torch_helpers::loadLSTM<T>(modelJson, "lstm.", staticModel.template get<0>());
+            RTNeural::torch_helpers::loadDense<T>(modelJson, "dense.", staticModel.template get<1>());
+        });
+
+    if(!handle->isStatic())
+    {
+        std::cout << "    FAIL! Torch model was not loaded as a static model" << std::endl;
+        return 1;
+    }
+
+    std::ifstream modelInputsFile { "test_data/lstm_torch_x_python.csv" };
+    const auto inputs = load_csv::loadFile<T>(modelInputsFile);
+    std::ifstream modelOutputsFile { "test_data/lstm_torch_y_python.csv" };
+    const auto expected = load_csv::loadFile<T>(modelOutputsFile);
+
+    return compareOutputs(processHandle(*handle, inputs), expected, tolerance);
+}
+#endif
+} // namespace model_registry_test
+
+int modelRegistryTest()
+{
+#if MODELT_AVAILABLE
+    std::cout << "TESTING MODEL REGISTRY WITH DATA TYPE: FLOAT" << std::endl;
+    int result = model_registry_test::testJsonModel<float>(1.0e-6f);
+    result |= model_registry_test::testTorchModel<float>(1.0e-6f);
+
+    std::cout << "TESTING MODEL REGISTRY WITH DATA TYPE: DOUBLE" << std::endl;
+    result |= model_registry_test::testJsonModel<double>(1.0e-12);
+    result |= model_registry_test::testTorchModel<double>(1.0e-6);
+
+    if(result == 0)
+        std::cout << "SUCCESS" << std::endl;
+
+    return result;
+#else
+    return 0;
+#endif
+}
@@ -37,6 +37,21 @@ int model_test()
         std::ifstream jsonStream(model_file, std::ifstream::binary);
         auto modelRef = RTNeural::json_parser::parseJson<TestType>(jsonStream, true);
         processModel(*modelRef.get(), xData, yRefData);
+
+#if !RTNEURAL_ENABLE_LAYER_TIMING
+        // the Dense and Conv1D layers and their tanh activations should each run as one step
+        if(modelRef->getNumPlanSteps() != (int)modelRef->layers.size() - 2)
+        {
+            std::cout << "FAIL: Dense/Conv1D + activation was not fused in the execution plan!" << std::endl;
+            return 1;
+        }
+#endif
+
+        if(modelRef->getOutputs()[0] != yRefData.back())
+        {
+            std::cout << "FAIL: getOutputs() does not match the model output!" << std::endl;
+            return 1;
+        }
     }
 
 #if MODELT_AVAILABLE
@@ -0,0 +1,211 @@
+#pragma once
+
+#include <iostream>
+#include <random>
+#include <RTNeural.h>
+
+namespace offline_render_test
+{
+template <typename T>
+std::vector<T> randomSignal(int num_frames)
+{
+    std::default_random_engine generator(1234);
+    std::uniform_real_distribution<double> distribution(-1.0, 1.0);
+    std::vector<T> signal((size_t)num_frames);
+    for(size_t n = 0; n < signal.size(); ++n)
+        signal[n] = (T)(0.5 * std::sin(0.01 * (double)n) + 0.25 * distribution(generator));
+    return signal;
+}
+
+template <typename T>
+std::unique_ptr<RTNeural::Model<T>> loadModel(const std::string& model_file)
+{
+    std::ifstream jsonStream(model_file, std::ifstream::binary);
+    auto model = RTNeural::json_parser::parseJson<T>(jsonStream);
+    model->reset();
+    return model;
+}
+
+template <typename T, typename ModelFactory>
+int testRender(const std::string& name, ModelFactory&& makeModel, const RTNeural::ChunkedRenderSettings& settings, double tolerance)
+{
+    constexpr int num_frames = 20000;
+    const auto input = randomSignal<T>(num_frames);
+    std::vector<T> output((size_t)num_frames);
+
+    const auto result = RTNeural::renderChunked<T>(makeModel, input.data(), output.data(), num_frames, 1, 1, settings);
+    std::cout << "    " << name << ": " << result.num_chunks << " chunks on " << result.num_threads << " threads, max deviation: "
+              << result.max_deviation << " (frame " << result.max_deviation_frame << "), rms: " << result.rms_deviation << std::endl;
+
+    if(result.max_deviation > tolerance)
+    {
+        std::cout << "        FAIL! Deviation from the single-threaded render is too large!" << std::endl;
+        return 1;
+    }
+
+    // without a cross-fade, the first chunk should match the single-threaded render exactly
+    if(settings.crossfade_frames == 0 && result.max_deviation_frame >= 0 && result.max_deviation_frame < num_frames / result.num_chunks - 1)
+    {
+        std::cout << "        FAIL! First chunk differs from the single-threaded render!" << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
+
+template <typename T>
+int testChunkedRender(double tolerance)
+{
+    RTNeural::ChunkedRenderSettings settings;
+    settings.num_threads = 4;
+    settings.verify = true;
+
+    int result = 0;
+
+    // without recurrent layers, the output is identical once the pre-roll covers the receptive field
+    settings.warmup_frames = 16;
+    result |= testRender<T>("conv (4 chunks)", []
+        { return loadModel<T>("models/conv.json"); },
+        settings, 0.0);
+
+    // more chunks than threads: each thread restores the initial state between chunks
+    settings.chunk_size = 1500;
+    result |= testRender<T>("conv (14 chunks)", []
+        { return loadModel<T>("models/conv.json"); },
+        settings, 0.0);
+
+    // recurrent models converge towards the single-threaded state during the pre-roll
+    settings.chunk_size = 0;
+    settings.warmup_frames = 2000;
+    result |= testRender<T>("lstm", []
+        { return loadModel<T>("models/lstm.json"); },
+        settings, tolerance);
+    result |= testRender<T>("full_model", []
+        { return loadModel<T>("models/full_model.json"); },
+        settings, tolerance);
+
+    // without a pre-roll, the verify mode should catch the discontinuities at the chunk boundaries
+    {
+        auto no_warmup = settings;
+        no_warmup.warmup_frames = 0;
+        const auto input = randomSignal<T>(4000);
+        std::vector<T> output(input.size());
+        const auto no_warmup_result = RTNeural::renderChunked<T>([]
+            { return loadModel<T>("models/lstm.json"); },
+            input.data(), output.data(), (int)input.size(), 1, 1, no_warmup);
+        std::cout << "    lstm (no pre-roll): max deviation: " << no_warmup_result.max_deviation << std::endl;
+        if(no_warmup_result.max_deviation <= tolerance || no_warmup_result.max_deviation_frame < 1000)
+        {
+            std::cout << "        FAIL! Expected a deviation after the first chunk!" << std::endl;
+            result |= 1;
+        }
+    }
+
+    settings.crossfade_frames = 64;
+    result |= testRender<T>("full_model (cross-fade)", []
+        { return loadModel<T>("models/full_model.json"); },
+        settings, tolerance);
+
+#if MODELT_AVAILABLE
+    settings.crossfade_frames = 0;
+    using LSTMModelType = RTNeural::ModelT<T, 1, 1,
+        RTNeural::DenseT<T, 1, 8>,
+        RTNeural::TanhActivationT<T, 8>,
+        RTNeural::LSTMLayerT<T, 8, 8>,
+        RTNeural::DenseT<T, 8, 1>>;
+    result |= testRender<T>("lstm (templated)", []
+        {
+            auto model = std::make_unique<LSTMModelType>();
+            std::ifstream jsonStream("models/lstm.json", std::ifstream::binary);
+            model->parseJson(jsonStream);
+            model->reset();
+            return model;
+        },
+        settings, tolerance);
+#endif
+
+    return result;
+}
+
+/** Runs fragments of different lengths with runBatch(), and compares them to running each one on a freshly loaded model. */
+template <typename T, typename ModelFactory>
+int testBatch(const std::string& name, ModelFactory&& makeModel, int num_sequences, int num_threads)
+{
+    const auto signal = randomSignal<T>(20000);
+    std::vector<RTNeural::BatchSequence<T>> sequences((size_t)num_sequences);
+    std::vector<std::vector<T>> outputs((size_t)num_sequences);
+    for(int i = 0; i < num_sequences; ++i)
+    {
+        const auto num_frames = 200 + (i * 733) % 1800;
+        outputs[(size_t)i].resize((size_t)num_frames);
+        sequences[(size_t)i].input = signal.data() + (i * 311) % (20000 - num_frames);
+        sequences[(size_t)i].output = outputs[(size_t)i].data();
+        sequences[(size_t)i].num_frames = num_frames;
+    }
+
+    RTNeural::BatchRunSettings settings;
+    settings.num_threads = num_threads;
+    const auto result = RTNeural::runBatch<T>(makeModel, sequences.data(), num_sequences, 1, 1, settings);
+    std::cout << "    " << name << ": " << num_sequences << " sequences on " << result.num_threads << " threads, "
+              << result.num_steals << " steals" << std::endl;
+
+    if(result.num_threads != std::min(num_threads, num_sequences))
+    {
+        std::cout << "        FAIL! Unexpected number of threads!" << std::endl;
+        return 1;
+    }
+
+    // every sequence starts from the initial state, so the outputs are identical
+    for(int i = 0; i < num_sequences; ++i)
+    {
+        const auto& sequence = sequences[(size_t)i];
+        auto model = makeModel();
+        std::vector<T> reference((size_t)sequence.num_frames);
+        RTNeural::offline_render_detail::processFrames<T>(*model, sequence.input, reference.data(), sequence.num_frames, 1, 1);
+        if(reference != outputs[(size_t)i])
+        {
+            std::cout << "        FAIL! Sequence " << i << " differs from a single model!" << std::endl;
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+template <typename T>
+int testBatches()
+{
+    int result = 0;
+    result |= testBatch<T>("lstm batch", []
+        { return loadModel<T>("models/lstm.json"); },
+        37, 4);
+    result |= testBatch<T>("full_model batch", []
+        { return loadModel<T>("models/full_model.json"); },
+        12, 3);
+
+    // more threads than sequences
+    result |= testBatch<T>("conv batch", []
+        { return loadModel<T>("models/conv.json"); },
+        2, 4);
+
+    return result;
+}
+} // namespace offline_render_test
+
+int offlineRenderTest()
+{
+    std::cout << "TESTING OFFLINE RENDERING..." << std::endl;
+
+    int result = 0;
+    std::cout << "  float:" << std::endl;
+    result |= offline_render_test::testChunkedRender<float>(1.0e-4);
+    result |= offline_render_test::testBatches<float>();
+    std::cout << "  double:" << std::endl;
+    result |= offline_render_test::testChunkedRender<double>(1.0e-6);
+    result |= offline_render_test::testBatches<double>();
+
+    if(result == 0)
+        std::cout << "SUCCESS!" << std::endl;
+
+    return result;
+}
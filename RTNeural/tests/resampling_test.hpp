@@ -0,0 +1,305 @@
+#pragma once
+
+#include <iostream>
+#include <random>
+#include <RTNeural.h>
+
+namespace resampling_test
+{
+/** Runs a sine wave through the resampler, with random block sizes, and returns the output. */
+template <typename T, typename Callback>
+std::vector<T> processSine(RTNeural::ModelResampler<T>& resampler, double host_rate, double freq, int max_block_size, bool random_blocks, Callback&& callback)
+{
+    constexpr double pi = 3.14159265358979323846;
+    std::vector<T> signal((size_t)(host_rate * 0.5));
+    for(size_t n = 0; n < signal.size(); ++n)
+        signal[n] = (T)(0.5 * std::sin(2.0 * pi * freq * (double)n / host_rate));
+
+    std::default_random_engine generator(0x1234);
+    std::uniform_int_distribution<int> distribution(1, max_block_size);
+    for(int start = 0; start < (int)signal.size();)
+    {
+        const auto block_size = std::min(random_blocks ? distribution(generator) : max_block_size, (int)signal.size() - start);
+        resampler.process(signal.data() + start, block_size, callback);
+        start += block_size;
+    }
+
+    return signal;
+}
+
+/**
+ * Converts a sine wave to the model rate and back, and checks that it comes
+ * out as the same sine wave, delayed by the reported latency, and that the
+ * result doesn't depend on the block sizes.
+ */
+template <typename T>
+int testRoundTrip(double host_rate, double model_rate, double tolerance)
+{
+    constexpr double pi = 3.14159265358979323846;
+    constexpr double freq = 1000.0;
+    constexpr int max_block_size = 256;
+
+    RTNeural::ModelResampler<T> resampler;
+    resampler.prepare(host_rate, model_rate, max_block_size);
+
+    int num_model_samples = 0;
+    bool block_too_large = false;
+    const auto count_samples = [&](T*, int num_samples)
+    {
+        num_model_samples += num_samples;
+        block_too_large |= num_samples > resampler.getMaxModelBlockSize();
+    };
+
+    const auto output = processSine(resampler, host_rate, freq, max_block_size, true, count_samples);
+
+    resampler.reset();
+    const auto fixed_block_output = processSine(resampler, host_rate, freq, max_block_size, false, [](T*, int) {});
+
+    const auto latency = resampler.getLatency();
+    double max_error = 0.0;
+    for(size_t n = (size_t)(latency + host_rate * 0.01); n < output.size(); ++n)
+    {
+        const auto expected = 0.5 * std::sin(2.0 * pi * freq * ((double)n - latency) / host_rate);
+        max_error = std::max(max_error, std::abs((double)output[n] - expected));
+    }
+
+    const auto expected_model_samples = (double)output.size() * model_rate / host_rate;
+    std::cout << "    " << host_rate << " Hz -> " << model_rate << " Hz: " << resampler.getNumHalfbandStages()
+              << " halfband stages, latency " << latency << " samples, max error " << max_error << std::endl;
+
+    if(max_error > tolerance)
+    {
+        std::cout << "        FAIL! Round trip output differs from the delayed input!" << std::endl;
+        return 1;
+    }
+
+    if(output != fixed_block_output)
+    {
+        std::cout << "        FAIL! Output depends on the block sizes!" << std::endl;
+        return 1;
+    }
+
+    if(block_too_large || std::abs((double)num_model_samples - expected_model_samples) > 2.0)
+    {
+        std::cout << "        FAIL! Unexpected number of samples at the model rate ("
+                  << num_model_samples << ", expected " << expected_model_samples << ")" << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
+
+/** Checks that a tone above the model's Nyquist frequency is removed before it reaches the model. */
+template <typename T>
+int testAliasRejection(double host_rate, double model_rate, double freq)
+{
+    constexpr int max_block_size = 128;
+
+    RTNeural::ModelResampler<T> resampler;
+    resampler.prepare(host_rate, model_rate, max_block_size);
+
+    int num_model_samples = 0;
+    double sum_squares = 0.0;
+    processSine(resampler, host_rate, freq, max_block_size, false, [&](T* buffer, int num_samples)
+        {
+            for(int n = 0; n < num_samples; ++n, ++num_model_samples)
+            {
+                // skip the filter transients
+                if(num_model_samples > 1000)
+                    sum_squares += (double)buffer[n] * (double)buffer[n];
+            }
+        });
+
+    const auto rms_db = 20.0 * std::log10(std::sqrt(sum_squares / (double)(num_model_samples - 1000)) / (0.5 / std::sqrt(2.0)));
+    std::cout << "    " << freq << " Hz tone at " << host_rate << " Hz -> " << model_rate << " Hz: " << rms_db << " dB" << std::endl;
+
+    if(rms_db > -60.0)
+    {
+        std::cout << "        FAIL! Tone above the model's Nyquist frequency is not attenuated enough!" << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
+
+/** Runs a sine wave through the oversampler, with random block sizes, and returns the output. */
+template <typename T, typename Callback>
+std::vector<T> oversampleSine(RTNeural::Oversampler<T>& oversampler, double sample_rate, double freq, int max_block_size, bool random_blocks, Callback&& callback)
+{
+    constexpr double pi = 3.14159265358979323846;
+    std::vector<T> signal((size_t)sample_rate);
+    for(size_t n = 0; n < signal.size(); ++n)
+        signal[n] = (T)(0.5 * std::sin(2.0 * pi * freq * (double)n / sample_rate));
+
+    std::default_random_engine generator(0x4321);
+    std::uniform_int_distribution<int> distribution(1, max_block_size);
+    for(int start = 0; start < (int)signal.size();)
+    {
+        const auto block_size = std::min(random_blocks ? distribution(generator) : max_block_size, (int)signal.size() - start);
+        oversampler.process(signal.data() + start, block_size, callback);
+        start += block_size;
+    }
+
+    return signal;
+}
+
+/** Checks that oversampling without any processing only delays the signal by the reported latency. */
+template <typename T>
+int testOversamplingRoundTrip(int factor, double tolerance)
+{
+    constexpr double pi = 3.14159265358979323846;
+    constexpr double sample_rate = 48000.0;
+    constexpr double freq = 1000.0;
+    constexpr int max_block_size = 256;
+
+    RTNeural::Oversampler<T> oversampler;
+    oversampler.prepare(factor, max_block_size);
+
+    int num_oversampled = 0;
+    const auto output = oversampleSine(oversampler, sample_rate, freq, max_block_size, true, [&](T*, int num_samples)
+        { num_oversampled += num_samples; });
+
+    oversampler.reset();
+    const auto fixed_block_output = oversampleSine(oversampler, sample_rate, freq, max_block_size, false, [](T*, int) {});
+
+    const auto latency = oversampler.getLatency();
+    double max_error = 0.0;
+    for(size_t n = (size_t)(latency + sample_rate * 0.01); n < output.size(); ++n)
+    {
+        const auto expected = 0.5 * std::sin(2.0 * pi * freq * ((double)n - latency) / sample_rate);
+        max_error = std::max(max_error, std::abs((double)output[n] - expected));
+    }
+
+    std::cout << "    " << factor << "x oversampling: latency " << latency << " samples, max error " << max_error << std::endl;
+
+    if(max_error > tolerance)
+    {
+        std::cout << "        FAIL! Oversampled output differs from the delayed input!" << std::endl;
+        return 1;
+    }
+
+    if(output != fixed_block_output)
+    {
+        std::cout << "        FAIL! Output depends on the block sizes!" << std::endl;
+        return 1;
+    }
+
+    if(num_oversampled != factor * (int)output.size())
+    {
+        std::cout << "        FAIL! Unexpected number of oversampled samples!" << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
+
+/**
+ * Returns the power of everything except the harmonics of `freq` (i.e. the aliasing)
+ * below 5/6 of the Nyquist frequency (20 kHz at 48 kHz), relative to the total power in
+ * that band, over the last second of a signal. The sample rate must be a power of 2.
+ */
+template <typename T>
+double measureAliasingDb(const std::vector<T>& signal, int sample_rate, int freq)
+{
+    // with a window of exactly one second, every bin is 1 Hz wide, so every harmonic falls on a bin
+    RTNeural::fft_detail::RealFFT<double> fft(sample_rate);
+    std::vector<double> x(signal.end() - sample_rate, signal.end());
+    std::vector<double> re((size_t)fft.getNumBins());
+    std::vector<double> im((size_t)fft.getNumBins());
+    fft.forward(x.data(), re.data(), im.data());
+
+    double total_power = 0.0;
+    double alias_power = 0.0;
+    for(int bin = 1; bin < sample_rate * 5 / 12; ++bin)
+    {
+        const auto power = re[(size_t)bin] * re[(size_t)bin] + im[(size_t)bin] * im[(size_t)bin];
+        total_power += power;
+        if(bin % freq != 0)
+            alias_power += power;
+    }
+
+    return 10.0 * std::log10(std::max(alias_power, 1.0e-30 * total_power) / total_power);
+}
+
+/** Checks that oversampling a hard clipper reduces the aliased harmonics. */
+template <typename T>
+int testOversamplingAliasing()
+{
+    constexpr int sample_rate = 65536; // a power of 2, for the FFT
+    constexpr int freq = 4999; // harmonics don't alias onto other harmonics
+    constexpr int max_block_size = 128;
+
+    const auto clip = [](T* buffer, int num_samples)
+    {
+        for(int n = 0; n < num_samples; ++n)
+            buffer[n] = std::max((T)-0.2, std::min((T)0.2, buffer[n]));
+    };
+
+    double aliasing_db[4] {};
+    for(int i = 0; i < 4; ++i)
+    {
+        RTNeural::Oversampler<T> oversampler;
+        oversampler.prepare(1 << i, max_block_size);
+
+        // two seconds, so that the filters have settled when the aliasing is measured
+        std::vector<T> signal;
+        for(int rep = 0; rep < 2; ++rep)
+        {
+            auto block = oversampleSine(oversampler, sample_rate, freq, max_block_size, false, clip);
+            signal.insert(signal.end(), block.begin(), block.end());
+        }
+        aliasing_db[i] = measureAliasingDb(signal, sample_rate, freq);
+        std::cout << "    clipper at " << (1 << i) << "x: aliasing " << aliasing_db[i] << " dB" << std::endl;
+    }
+
+    if(aliasing_db[1] > aliasing_db[0] - 6.0 || aliasing_db[3] > aliasing_db[1] - 6.0)
+    {
+        std::cout << "        FAIL! Oversampling does not reduce the aliasing!" << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
+
+template <typename T>
+int testResampling(double tolerance)
+{
+    int result = 0;
+    result |= testRoundTrip<T>(44100.0, 44100.0, tolerance);
+    result |= testRoundTrip<T>(48000.0, 44100.0, tolerance);
+    result |= testRoundTrip<T>(88200.0, 44100.0, tolerance);
+    result |= testRoundTrip<T>(96000.0, 44100.0, tolerance);
+    result |= testRoundTrip<T>(192000.0, 44100.0, tolerance);
+    result |= testRoundTrip<T>(32000.0, 44100.0, tolerance);
+    result |= testRoundTrip<T>(22050.0, 44100.0, tolerance);
+    result |= testRoundTrip<T>(47999.0, 44100.0, tolerance);
+
+    result |= testAliasRejection<T>(48000.0, 44100.0, 23000.0);
+    result |= testAliasRejection<T>(96000.0, 44100.0, 30000.0);
+    result |= testAliasRejection<T>(192000.0, 44100.0, 70000.0);
+
+    result |= testOversamplingRoundTrip<T>(1, tolerance);
+    result |= testOversamplingRoundTrip<T>(2, tolerance);
+    result |= testOversamplingRoundTrip<T>(4, tolerance);
+    result |= testOversamplingRoundTrip<T>(8, tolerance);
+    result |= testOversamplingAliasing<T>();
+
+    return result;
+}
+} // namespace resampling_test
+
+int resamplingTest()
+{
+    std::cout << "TESTING MODEL RESAMPLING..." << std::endl;
+
+    int result = 0;
+    std::cout << "  float:" << std::endl;
+    result |= resampling_test::testResampling<float>(2.0e-4);
+    std::cout << "  double:" << std::endl;
+    result |= resampling_test::testResampling<double>(2.0e-4);
+
+    if(result == 0)
+        std::cout << "SUCCESS!" << std::endl;
+
+    return result;
+}
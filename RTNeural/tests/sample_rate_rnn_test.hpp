@@ -16,8 +16,15 @@ auto getSampleRateVector(double sampleRate)
     return x;
 }
 
+/**
+ * Compares a model running at a multiple of its training sample rate
+ * against the same model at the training sample rate. If
+ * `initialSampleRateMult` is non-zero, the model is first prepared
+ * for (and run at) that rate, to check that the delay line can be
+ * re-prepared for a different rate.
+ */
 template <template <RTNeural::SampleRateCorrectionMode> class ModelType, RTNeural::SampleRateCorrectionMode mode, int RLayerIdx, typename MultType>
-int runModelTest(const std::string& modelFile, MultType sampleRateMult)
+int runModelTest(const std::string& modelFile, MultType sampleRateMult, MultType initialSampleRateMult = 0)
 {
     static constexpr auto baseSampleRate = 48000.0;
 
@@ -33,6 +40,12 @@ int runModelTest(const std::string& modelFile, MultType sampleRateMult)
     std::ifstream jsonStream2("models/" + modelFile, std::ifstream::binary);
     testSampleRateModel.parseJson(jsonStream2);
     testSampleRateModel.reset();
+    if(initialSampleRateMult > 0)
+    {
+        testSampleRateModel.template get<RLayerIdx>().prepare(initialSampleRateMult);
+        for(auto sample : getSampleRateVector(baseSampleRate * initialSampleRateMult))
+            testSampleRateModel.forward(&sample);
+    }
     testSampleRateModel.template get<RLayerIdx>().prepare(sampleRateMult);
     auto testSampleRateSignal = getSampleRateVector(baseSampleRate * sampleRateMult);
     for(auto& sample : testSampleRateSignal)
@@ -92,21 +105,31 @@ int runTestAtSampleRateOffset(const std::string& model)
     {
         result |= runModelTest<GRUModel, SampleRateCorrectionMode::NoInterp, 2>("gru.json", 3);
         result |= runModelTest<GRUModel, SampleRateCorrectionMode::LinInterp, 2>("gru.json", 1.75);
+        result |= runModelTest<GRUModel, SampleRateCorrectionMode::NoInterp, 2>("gru.json", 8);
+        result |= runModelTest<GRUModel, SampleRateCorrectionMode::NoInterp, 2>("gru.json", 5, 8);
+        result |= runModelTest<GRUModel, SampleRateCorrectionMode::LinInterp, 2>("gru.json", 7.5);
     }
     else if(model == "gru_1d")
     {
         result |= runModelTest<GRU1DModel, SampleRateCorrectionMode::NoInterp, 0>("gru_1d.json", 3);
         result |= runModelTest<GRU1DModel, SampleRateCorrectionMode::LinInterp, 0>("gru_1d.json", 1.75);
+        result |= runModelTest<GRU1DModel, SampleRateCorrectionMode::NoInterp, 0>("gru_1d.json", 6, 2);
+        result |= runModelTest<GRU1DModel, SampleRateCorrectionMode::LinInterp, 0>("gru_1d.json", 3.5, 6.25);
     }
     else if(model == "lstm")
     {
         result |= runModelTest<LSTMModel, SampleRateCorrectionMode::NoInterp, 2>("lstm.json", 4);
         result |= runModelTest<LSTMModel, SampleRateCorrectionMode::LinInterp, 2>("lstm.json", 2.5);
+        result |= runModelTest<LSTMModel, SampleRateCorrectionMode::NoInterp, 2>("lstm.json", 8);
+        result |= runModelTest<LSTMModel, SampleRateCorrectionMode::NoInterp, 2>("lstm.json", 3, 8);
+        result |= runModelTest<LSTMModel, SampleRateCorrectionMode::LinInterp, 2>("lstm.json", 7.5);
     }
     else if(model == "lstm_1d")
     {
         result |= runModelTest<LSTM1DModel, SampleRateCorrectionMode::NoInterp, 0>("lstm_1d.json", 2);
         result |= runModelTest<LSTM1DModel, SampleRateCorrectionMode::LinInterp, 0>("lstm_1d.json", 2.25);
+        result |= runModelTest<LSTM1DModel, SampleRateCorrectionMode::NoInterp, 0>("lstm_1d.json", 7, 4);
+        result |= runModelTest<LSTM1DModel, SampleRateCorrectionMode::LinInterp, 0>("lstm_1d.json", 4.25, 1.5);
     }
 
     return result;
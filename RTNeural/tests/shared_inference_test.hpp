@@ -0,0 +1,292 @@
+#pragma once
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <RTNeural.h>
+
+namespace shared_inference_test
+{
+constexpr int in_size = 2;
+constexpr int hidden_size = 8;
+constexpr int num_streams = 6;
+constexpr int num_frames = 960;
+
+/** Returns a json array of random weights with dimensions [num_out][num_in]. */
+nlohmann::json randomWeights(std::default_random_engine& generator, int num_out, int num_in)
+{
+    std::uniform_real_distribution<double> distribution(-0.5, 0.5);
+    std::vector<std::vector<double>> weights((size_t)num_out, std::vector<double>((size_t)num_in));
+    for(auto& row : weights)
+        for(auto& w : row)
+            w = distribution(generator);
+
+    return weights;
+}
+
+/** A PyTorch state_dict with an "lstm." layer (2 -> 8) followed by a "dense." layer (8 -> 1). */
+nlohmann::json makeModelJson()
+{
+    std::default_random_engine generator(3579);
+
+    nlohmann::json model_json;
+    model_json["lstm.weight_ih_l0"] = randomWeights(generator, 4 * hidden_size, in_size);
+    model_json["lstm.weight_hh_l0"] = randomWeights(generator, 4 * hidden_size, hidden_size);
+    model_json["lstm.bias_ih_l0"] = randomWeights(generator, 1, 4 * hidden_size)[0];
+    model_json["lstm.bias_hh_l0"] = randomWeights(generator, 1, 4 * hidden_size)[0];
+    model_json["dense.weight"] = randomWeights(generator, 1, hidden_size);
+    model_json["dense.bias"] = randomWeights(generator, 1, 1)[0];
+    return model_json;
+}
+
+template <typename T>
+std::unique_ptr<RTNeural::Model<T>> makeModel(const nlohmann::json& model_json)
+{
+    auto model = std::make_unique<RTNeural::Model<T>>(in_size);
+    auto lstm = std::make_unique<RTNeural::LSTMLayer<T>>(in_size, hidden_size);
+    auto dense = std::make_unique<RTNeural::Dense<T>>(hidden_size, 1);
+    RTNeural::torch_helpers::loadLSTM<T>(model_json, "lstm.", *lstm);
+    RTNeural::torch_helpers::loadDense<T>(model_json, "dense.", *dense);
+    model->addLayer(lstm.release());
+    model->addLayer(dense.release());
+    model->reset();
+    return model;
+}
+
+template <typename T>
+RTNeural::BatchedLSTMDense<T> makeBatchedModel(const nlohmann::json& model_json)
+{
+    RTNeural::BatchedLSTMDense<T> model(in_size, hidden_size, 1);
+    RTNeural::torch_helpers::loadLSTM<T>(model_json, "lstm.", model.lstm);
+    RTNeural::torch_helpers::loadDense<T>(model_json, "dense.", model.dense);
+    return model;
+}
+
+/** Interleaved [audio, knob] input frames, that are different for every stream. */
+template <typename T>
+std::vector<T> makeInput(int stream)
+{
+    std::default_random_engine generator((unsigned)(100 + stream));
+    std::uniform_real_distribution<double> distribution(-0.25, 0.25);
+    std::vector<T> input((size_t)(num_frames * in_size));
+    for(int n = 0; n < num_frames; ++n)
+    {
+        input[(size_t)(n * in_size)] = (T)(0.5 * std::sin(0.02 * (double)((stream + 1) * n)) + distribution(generator));
+        input[(size_t)(n * in_size + 1)] = (T)(0.1 * (double)stream);
+    }
+    return input;
+}
+
+template <typename T>
+std::vector<T> runReference(const nlohmann::json& model_json, const std::vector<T>& input)
+{
+    auto model = makeModel<T>(model_json);
+    std::vector<T> output((size_t)num_frames);
+    for(int n = 0; n < num_frames; ++n)
+        output[(size_t)n] = model->forward(input.data() + n * in_size);
+    return output;
+}
+
+/** Compares the output with the reference delayed by `latency` frames (and silence before that). */
+template <typename T>
+int compareOutputs(const std::vector<T>& test, const std::vector<T>& reference, int latency, int num_valid, T tolerance)
+{
+    T max_error = (T)0;
+    for(int n = 0; n < num_valid; ++n)
+    {
+        const auto expected = n < latency ? (T)0 : reference[(size_t)(n - latency)];
+        max_error = std::max(max_error, std::abs(test[(size_t)n] - expected));
+    }
+
+    if(max_error > tolerance)
+    {
+        std::cout << "        FAIL! Maximum error: " << max_error << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
+
+/** Checks every stream of one batched pass against its own model. */
+template <typename T>
+int testBatchedModel(const nlohmann::json& model_json, T tolerance)
+{
+    std::cout << "    batched model" << std::endl;
+
+    const auto model = makeBatchedModel<T>(model_json);
+    std::vector<std::vector<T>> inputs, references;
+    for(int s = 0; s < num_streams; ++s)
+    {
+        inputs.push_back(makeInput<T>(s));
+        references.push_back(runReference<T>(model_json, inputs.back()));
+    }
+
+    std::vector<T> frame(in_size * num_streams), h(hidden_size * num_streams, (T)0), c(h.size(), (T)0);
+    std::vector<T> out(num_streams), scratch((size_t)model.getScratchSize(num_streams));
+    std::vector<std::vector<T>> outputs(num_streams, std::vector<T>(num_frames));
+    for(int n = 0; n < num_frames; ++n)
+    {
+        for(int s = 0; s < num_streams; ++s)
+            for(int i = 0; i < in_size; ++i)
+                frame[(size_t)(i * num_streams + s)] = inputs[(size_t)s][(size_t)(n * in_size + i)];
+
+        model.forward(frame.data(), h.data(), c.data(), out.data(), num_streams, scratch.data());
+        for(int s = 0; s < num_streams; ++s)
+            outputs[(size_t)s][(size_t)n] = out[(size_t)s];
+    }
+
+    int result = 0;
+    for(int s = 0; s < num_streams; ++s)
+        result |= compareOutputs(outputs[(size_t)s], references[(size_t)s], 0, num_frames, tolerance);
+    return result;
+}
+
+/**
+ * Runs every stream through the service in blocks of `block_size` frames.
+ * Stream `stalled_stream` (if any) stops halfway through, and is then
+ * unregistered and registered again, starting from a reset state.
+ */
+template <typename T>
+int testService(const nlohmann::json& model_json, const RTNeural::SharedInferenceSettings& settings, int block_size,
+    int stalled_stream, T tolerance)
+{
+    RTNeural::SharedInferenceService<T> service(makeBatchedModel<T>(model_json), settings);
+
+    int streams[num_streams];
+    std::vector<std::vector<T>> inputs, references;
+    std::vector<std::vector<T>> outputs(num_streams, std::vector<T>(num_frames));
+    for(int s = 0; s < num_streams; ++s)
+    {
+        streams[s] = service.registerStream(block_size);
+        inputs.push_back(makeInput<T>(s));
+        references.push_back(runReference<T>(model_json, inputs.back()));
+    }
+
+    const auto latency = service.getLatency(streams[0]);
+    const auto expected_latency = block_size % settings.batch_size == 0 ? block_size : block_size + settings.batch_size - 1;
+    if(streams[num_streams - 1] != num_streams - 1 || latency != expected_latency)
+    {
+        std::cout << "        FAIL! Unexpected streams or latency: " << latency << std::endl;
+        return 1;
+    }
+
+    const auto manual = settings.num_workers == 0;
+    const auto stall_frame = num_frames / 2;
+    for(int start = 0; start < num_frames; start += block_size)
+    {
+        const auto num_block = std::min(block_size, num_frames - start);
+        for(int s = 0; s < num_streams; ++s)
+        {
+            if(s == stalled_stream && start >= stall_frame)
+                continue;
+
+            // a host that waits for the workers (e.g. when rendering offline)
+            const auto wait_start = std::chrono::steady_clock::now();
+            while(!manual && start > 0 && service.getNumOutputFrames(streams[s]) < num_block)
+            {
+                if(std::chrono::steady_clock::now() - wait_start > std::chrono::seconds(10))
+                {
+                    std::cout << "        FAIL! The workers did not process stream " << s << std::endl;
+                    return 1;
+                }
+                std::this_thread::yield();
+            }
+
+            service.process(streams[s], inputs[(size_t)s].data() + start * in_size, outputs[(size_t)s].data() + start, num_block);
+
+            // the batches wait for every stream of the group
+            if(manual && start == 0 && s == 0 && stalled_stream < 0 && service.processPending() != 0)
+            {
+                std::cout << "        FAIL! A batch ran before the other streams were ready" << std::endl;
+                return 1;
+            }
+        }
+
+        if(manual)
+            service.processPending();
+    }
+
+    int result = 0;
+    for(int s = 0; s < num_streams; ++s)
+    {
+        const auto num_valid = s == stalled_stream ? stall_frame : num_frames;
+        result |= compareOutputs(outputs[(size_t)s], references[(size_t)s], latency, num_valid, tolerance);
+
+        if(service.getNumUnderruns(streams[s]) != 0)
+        {
+            std::cout << "        FAIL! Stream " << s << " had " << service.getNumUnderruns(streams[s]) << " underruns" << std::endl;
+            return 1;
+        }
+    }
+
+    if(stalled_stream < 0)
+        return result;
+
+    // a new stream takes the free slot, with a reset state
+    service.unregisterStream(streams[stalled_stream]);
+    if(service.registerStream(block_size) != streams[stalled_stream])
+    {
+        std::cout << "        FAIL! Expected the stream to be registered again in its old slot" << std::endl;
+        return 1;
+    }
+
+    auto& output = outputs[(size_t)stalled_stream];
+    std::fill(output.begin(), output.end(), (T)0);
+    for(int start = 0; start < num_frames; start += block_size)
+    {
+        const auto num_block = std::min(block_size, num_frames - start);
+        service.process(streams[stalled_stream], inputs[(size_t)stalled_stream].data() + start * in_size, output.data() + start, num_block);
+        service.processPending();
+    }
+
+    result |= compareOutputs(output, references[(size_t)stalled_stream], latency, num_frames, tolerance);
+    return result;
+}
+
+template <typename T>
+int runTests(T tolerance)
+{
+    const auto model_json = makeModelJson();
+    int result = testBatchedModel<T>(model_json, tolerance);
+
+    RTNeural::SharedInferenceSettings settings;
+    settings.batch_size = 16;
+    settings.group_size = 4;
+    settings.max_streams = 8;
+    settings.num_workers = 0;
+    settings.max_wait_ms = 10000.0;
+
+    std::cout << "    manual processing" << std::endl;
+    result |= testService<T>(model_json, settings, 16, -1, tolerance);
+    result |= testService<T>(model_json, settings, 24, -1, tolerance);
+
+    std::cout << "    stalled stream" << std::endl;
+    settings.max_wait_ms = 0.0;
+    result |= testService<T>(model_json, settings, 32, 1, tolerance);
+
+    std::cout << "    worker threads" << std::endl;
+    settings.num_workers = 2;
+    settings.max_wait_ms = 1.0;
+    result |= testService<T>(model_json, settings, 32, -1, tolerance);
+
+    return result;
+}
+} // namespace shared_inference_test
+
+int sharedInferenceTest()
+{
+    std::cout << "TESTING SHARED INFERENCE..." << std::endl;
+
+    int result = 0;
+    std::cout << "  float:" << std::endl;
+    result |= shared_inference_test::runTests<float>(1.0e-5f);
+    std::cout << "  double:" << std::endl;
+    result |= shared_inference_test::runTests<double>(1.0e-10);
+
+    if(result == 0)
+        std::cout << "SUCCESS!" << std::endl;
+
+    return result;
+}
@@ -0,0 +1,215 @@
+#pragma once
+
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <RTNeural.h>
+#include "conv1d_fft_test.hpp"
+#include "dilated_conv_stack_test.hpp"
+
+namespace state_test
+{
+constexpr int max_in_size = 32;
+
+std::vector<double> randomInputs(int num_frames, int in_size, unsigned int seed)
+{
+    std::default_random_engine generator(seed);
+    std::uniform_real_distribution<double> distribution(-1.0, 1.0);
+    std::vector<double> inputs((size_t)(num_frames * in_size));
+    for(auto& x : inputs)
+        x = distribution(generator);
+    return inputs;
+}
+
+/** Runs the model over the inputs, and returns all of the outputs. */
+template <typename T, typename ModelType>
+std::vector<T> runModel(ModelType& model, const std::vector<double>& inputs, int in_size, int out_size)
+{
+    const auto num_frames = (int)inputs.size() / in_size;
+    std::vector<T> outputs((size_t)(num_frames * out_size));
+    for(int n = 0; n < num_frames; ++n)
+    {
+        T frame alignas(RTNEURAL_DEFAULT_ALIGNMENT)[max_in_size] {};
+        for(int i = 0; i < in_size; ++i)
+            frame[i] = (T)inputs[(size_t)(n * in_size + i)];
+
+        model.forward(frame);
+        std::copy(model.getOutputs(), model.getOutputs() + out_size, outputs.begin() + n * out_size);
+    }
+
+    return outputs;
+}
+
+/**
+ * Takes a snapshot of a model part way through a signal, and checks
+ * that restoring the snapshot (into the same model, or into a second
+ * model with the same weights) reproduces the rest of the signal exactly.
+ */
+template <typename T, typename ModelType>
+int testSnapshot(const std::string& name, ModelType& model, ModelType& warm_model, int state_size, int in_size, int out_size)
+{
+    std::cout << "    " << name << " (" << state_size << " state values)" << std::endl;
+
+    const auto pre_roll = randomInputs(500, in_size, 1234);
+    const auto inputs = randomInputs(500, in_size, 5678);
+
+    model.reset();
+    runModel<T>(model, pre_roll, in_size, out_size);
+
+    std::vector<T> state((size_t)state_size);
+    model.getState(state.data());
+    const auto expected = runModel<T>(model, inputs, in_size, out_size);
+
+    model.setState(state.data());
+    if(runModel<T>(model, inputs, in_size, out_size) != expected)
+    {
+        std::cout << "        FAIL! Restored model output differs from the original!" << std::endl;
+        return 1;
+    }
+
+    warm_model.reset();
+    if(runModel<T>(warm_model, inputs, in_size, out_size) == expected)
+    {
+        std::cout << "        FAIL! Model output does not depend on its state!" << std::endl;
+        return 1;
+    }
+
+    warm_model.reset();
+    warm_model.setState(state.data());
+    if(runModel<T>(warm_model, inputs, in_size, out_size) != expected)
+    {
+        std::cout << "        FAIL! Warm-started model output differs from the original!" << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
+
+template <typename T>
+int testJsonModel(const std::string& model_file, int in_size)
+{
+    std::ifstream jsonStream(model_file, std::ifstream::binary);
+    nlohmann::json modelJson;
+    jsonStream >> modelJson;
+
+    auto model = RTNeural::json_parser::parseJson<T>(modelJson);
+    auto warm_model = RTNeural::json_parser::parseJson<T>(modelJson);
+    return testSnapshot<T>(model_file + " (dynamic)", *model, *warm_model, model->getStateSize(), in_size, model->getOutSize());
+}
+
+template <typename T>
+int testFFTConv1D()
+{
+    const int in_size = 2;
+    const int out_size = 3;
+    const int kernel_size = 100;
+
+    auto makeModel = [=]
+    {
+        std::default_random_engine generator;
+        auto layer = std::make_unique<RTNeural::FFTConv1D<T>>(in_size, out_size, kernel_size, 1, 16);
+        layer->setWeights(conv1d_fft_test::randomWeights<T>(in_size, out_size, kernel_size, generator));
+        layer->setBias(std::vector<T>((size_t)out_size, (T)0));
+
+        auto model = std::make_unique<RTNeural::Model<T>>(in_size);
+        model->addLayer(layer.release());
+        return model;
+    };
+
+    auto model = makeModel();
+    auto warm_model = makeModel();
+    return testSnapshot<T>("fft_conv1d (dynamic)", *model, *warm_model, model->getStateSize(), in_size, out_size);
+}
+
+#if MODELT_AVAILABLE
+template <typename T, typename ModelType>
+int testTemplatedJsonModel(const std::string& model_file)
+{
+    // the snapshot size is known at compile-time
+    using StateType = std::array<T, ModelType::state_size>;
+    static_assert(ModelType::state_size > 0, "Model should have some state!");
+
+    auto model = std::make_unique<ModelType>();
+    auto warm_model = std::make_unique<ModelType>();
+    for(auto* m : { model.get(), warm_model.get() })
+    {
+        std::ifstream jsonStream(model_file, std::ifstream::binary);
+        m->parseJson(jsonStream);
+    }
+
+    return testSnapshot<T>(model_file + " (templated)", *model, *warm_model, (int)std::tuple_size<StateType>::value,
+        ModelType::input_size, ModelType::output_size);
+}
+
+template <typename T>
+int testDilatedConvStack()
+{
+    using StackType = RTNeural::DilatedConvStackT<T, 1, 1, 4, 3, 1, 2, 4, 8>;
+    using ModelType = RTNeural::ModelT<T, 1, 1, StackType>;
+    const auto state_dict = dilated_conv_stack_test::createStateDict(1, 1, 4, 3, StackType::getNumLayers());
+
+    auto model = std::make_unique<ModelType>();
+    auto warm_model = std::make_unique<ModelType>();
+    RTNeural::torch_helpers::loadDilatedConvStack<T>(state_dict, "", model->template get<0>());
+    RTNeural::torch_helpers::loadDilatedConvStack<T>(state_dict, "", warm_model->template get<0>());
+
+    return testSnapshot<T>("dilated_conv_stack (templated)", *model, *warm_model, ModelType::state_size, 1, 1);
+}
+#endif
+
+template <typename T>
+int testStateRestore()
+{
+    int result = 0;
+    result |= testJsonModel<T>("models/full_model.json", 1);
+    result |= testJsonModel<T>("models/lstm.json", 1);
+    result |= testFFTConv1D<T>();
+
+#if !RTNEURAL_AVX_ENABLED
+    result |= testJsonModel<T>("models/conv2d.json", 23);
+#endif
+
+#if MODELT_AVAILABLE
+    result |= testTemplatedJsonModel<T, RTNeural::ModelT<T, 1, 1,
+                                            RTNeural::DenseT<T, 1, 8>,
+                                            RTNeural::TanhActivationT<T, 8>,
+                                            RTNeural::Conv1DT<T, 8, 4, 3, 2>,
+                                            RTNeural::TanhActivationT<T, 4>,
+                                            RTNeural::GRULayerT<T, 4, 8>,
+                                            RTNeural::DenseT<T, 8, 1>>>("models/full_model.json");
+    result |= testTemplatedJsonModel<T, RTNeural::ModelT<T, 1, 1,
+                                            RTNeural::DenseT<T, 1, 8>,
+                                            RTNeural::TanhActivationT<T, 8>,
+                                            RTNeural::LSTMLayerT<T, 8, 8>,
+                                            RTNeural::DenseT<T, 8, 1>>>("models/lstm.json");
+#if !RTNEURAL_AVX_ENABLED
+    result |= testTemplatedJsonModel<T, RTNeural::ModelT2D<T, 1, 23, 1, 8,
+                                            RTNeural::Conv2DT<T, 1, 2, 23, 5, 5, 2, 1, true>,
+                                            RTNeural::BatchNorm2DT<T, 2, 19, false>,
+                                            RTNeural::ReLuActivationT<T, 2 * 19>,
+                                            RTNeural::Conv2DT<T, 2, 3, 19, 4, 3, 1, 2, false>,
+                                            RTNeural::BatchNorm2DT<T, 3, 10, true>,
+                                            RTNeural::Conv2DT<T, 3, 1, 10, 2, 3, 3, 1, true>>>("models/conv2d.json");
+#endif
+    result |= testDilatedConvStack<T>();
+#endif
+
+    return result;
+}
+} // namespace state_test
+
+int stateTest()
+{
+    std::cout << "TESTING STATE SNAPSHOT/RESTORE..." << std::endl;
+
+    int result = 0;
+    std::cout << "  float:" << std::endl;
+    result |= state_test::testStateRestore<float>();
+    std::cout << "  double:" << std::endl;
+    result |= state_test::testStateRestore<double>();
+
+    if(result == 0)
+        std::cout << "SUCCESS!" << std::endl;
+
+    return result;
+}
@@ -1,9 +1,20 @@
 #include "approx_tests.hpp"
 #include "bad_model_test.hpp"
+#include "block_sparse_test.hpp"
+#include "conv1d_block_test.hpp"
+#include "conv1d_fft_test.hpp"
+#include "dilated_conv_stack_test.hpp"
 #include "conv2d_model.h"
 #include "load_csv.hpp"
+#include "low_rank_test.hpp"
+#include "model_optimizer_test.hpp"
+#include "model_registry_test.hpp"
 #include "model_test.hpp"
+#include "offline_render_test.hpp"
+#include "resampling_test.hpp"
 #include "sample_rate_rnn_test.hpp"
+#include "shared_inference_test.hpp"
+#include "state_test.hpp"
 #include "templated_tests.hpp"
 #include "test_configs.hpp"
 #include "torch_conv1d_test.hpp"
@@ -29,6 +40,17 @@ void help()
     for(auto& testConfig : tests)
         std::cout << "    " << testConfig.first << std::endl;
     std::cout << "    conv2d" << std::endl;
+    std::cout << "    conv1d_block" << std::endl;
+    std::cout << "    conv1d_fft" << std::endl;
+    std::cout << "    dilated_conv_stack" << std::endl;
+    std::cout << "    model_registry" << std::endl;
+    std::cout << "    state" << std::endl;
+    std::cout << "    offline_render" << std::endl;
+    std::cout << "    resampling" << std::endl;
+    std::cout << "    model_optimizer" << std::endl;
+    std::cout << "    block_sparse" << std::endl;
+    std::cout << "    low_rank" << std::endl;
+    std::cout << "    shared_inference" << std::endl;
 }
 
 template <typename T>
@@ -114,6 +136,17 @@ int main(int argc, char* argv[])
         result |= torchGRUTest();
         result |= torchConv1DTest();
         result |= torchLSTMTest();
+        result |= conv1DBlockTest();
+        result |= conv1DFFTTest();
+        result |= dilatedConvStackTest();
+        result |= modelRegistryTest();
+        result |= stateTest();
+        result |= offlineRenderTest();
+        result |= resamplingTest();
+        result |= modelOptimizerTest();
+        result |= blockSparseTest();
+        result |= lowRankTest();
+        result |= sharedInferenceTest();
 
         for(auto& testConfig : tests)
         {
@@ -164,6 +197,61 @@ int main(int argc, char* argv[])
         return result;
     }
 
+    if(arg == "conv1d_block")
+    {
+        return conv1DBlockTest();
+    }
+
+    if(arg == "conv1d_fft")
+    {
+        return conv1DFFTTest();
+    }
+
+    if(arg == "dilated_conv_stack")
+    {
+        return dilatedConvStackTest();
+    }
+
+    if(arg == "model_registry")
+    {
+        return modelRegistryTest();
+    }
+
+    if(arg == "state")
+    {
+        return stateTest();
+    }
+
+    if(arg == "offline_render")
+    {
+        return offlineRenderTest();
+    }
+
+    if(arg == "resampling")
+    {
+        return resamplingTest();
+    }
+
+    if(arg == "model_optimizer")
+    {
+        return modelOptimizerTest();
+    }
+
+    if(arg == "block_sparse")
+    {
+        return blockSparseTest();
+    }
+
+    if(arg == "low_rank")
+    {
+        return lowRankTest();
+    }
+
+    if(arg == "shared_inference")
+    {
+        return sharedInferenceTest();
+    }
+
     if(arg == "conv2d_model")
     {
         return conv2d_test();